@@ -0,0 +1,202 @@
+/**
+ * @file       bl_bufreader.c
+ * @brief      Buffered read-ahead layer for files read by Bootloader
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <string.h>
+#include "bl_util.h"
+#include "bl_bufreader.h"
+
+/// Attached reader
+static BL_THREAD_LOCAL bl_bufreader_t* attached = NULL;
+
+/**
+ * Returns reader attached to a file
+ *
+ * @param file  file handle
+ * @return      pointer to reader, or NULL if the file has no reader attached
+ */
+static inline bl_bufreader_t* reader_of(bl_file_t file) {
+  return (attached && attached->file == file) ? attached : NULL;
+}
+
+/**
+ * Checks if current position of a reader is inside its window
+ *
+ * @param p_rd  pointer to reader
+ * @return      true if the byte at current position is in the window
+ */
+static inline bool in_window(const bl_bufreader_t* p_rd) {
+  return p_rd->pos >= p_rd->win_pos &&
+         p_rd->pos - p_rd->win_pos < (bl_foffset_t)p_rd->win_len;
+}
+
+/**
+ * Reads data from media, seeking only if needed
+ *
+ * A read returning less than requested marks the end of file.
+ *
+ * @param p_rd  pointer to reader
+ * @param pos   position in file
+ * @param dst   buffer receiving data
+ * @param len   number of bytes to read
+ * @return      number of bytes read
+ */
+static size_t media_read(bl_bufreader_t* p_rd, bl_foffset_t pos, void* dst,
+                         size_t len) {
+  if (p_rd->end_pos >= 0 && pos >= p_rd->end_pos) {
+    return 0U;
+  }
+  if (pos != p_rd->file_pos) {
+    if (0 != blsys_fseek(p_rd->file, pos, SEEK_SET)) {
+      p_rd->file_pos = -1;
+      return 0U;
+    }
+  }
+  size_t n_read = blsys_fread(dst, 1U, len, p_rd->file);
+  p_rd->file_pos = pos + (bl_foffset_t)n_read;
+  ++p_rd->n_media_reads;
+  p_rd->media_bytes += n_read;
+  if (n_read < len) {
+    p_rd->end_pos = p_rd->file_pos;
+  }
+  return n_read;
+}
+
+/**
+ * Fills the window from an aligned position preceding current position
+ *
+ * @param p_rd  pointer to reader
+ * @return      true if the window contains the byte at current position
+ */
+static bool fill_window(bl_bufreader_t* p_rd) {
+  if (p_rd->end_pos >= 0 && p_rd->pos >= p_rd->end_pos) {
+    return false;  // The window already holds the tail of the file, if any
+  }
+  p_rd->win_pos = p_rd->pos - p_rd->pos % (bl_foffset_t)p_rd->align;
+  p_rd->win_len = 0U;  // Invalidate the window before reading
+  p_rd->win_len = media_read(p_rd, p_rd->win_pos, p_rd->buf, p_rd->buf_size);
+  return in_window(p_rd);
+}
+
+bool blbuf_attach(bl_bufreader_t* p_rd, bl_file_t file, void* buf,
+                  size_t buf_size, size_t align) {
+  if (p_rd && file && buf && align && buf_size && 0U == buf_size % align) {
+    bl_foffset_t pos = blsys_ftell(file);
+    if (pos >= 0) {
+      if (attached) {
+        blbuf_detach(attached);
+      }
+      memset(p_rd, 0, sizeof(bl_bufreader_t));
+      p_rd->file = file;
+      p_rd->buf = (uint8_t*)buf;
+      p_rd->buf_size = buf_size;
+      p_rd->align = align;
+      p_rd->pos = pos;
+      p_rd->file_pos = pos;
+      p_rd->end_pos = -1;
+      attached = p_rd;
+      return true;
+    }
+  }
+  return false;
+}
+
+void blbuf_detach(bl_bufreader_t* p_rd) {
+  if (p_rd && attached == p_rd) {
+    attached = NULL;
+    if (p_rd->file_pos != p_rd->pos) {
+      (void)blsys_fseek(p_rd->file, p_rd->pos, SEEK_SET);
+    }
+  }
+}
+
+size_t blbuf_fread(void* ptr, size_t size, size_t count, bl_file_t file) {
+  bl_bufreader_t* p_rd = reader_of(file);
+  if (!p_rd) {
+    return blsys_fread(ptr, size, count, file);
+  }
+  if (!ptr || !size || !count || count > SIZE_MAX / size) {
+    return 0U;
+  }
+
+  uint8_t* p_dst = (uint8_t*)ptr;
+  size_t len = size * count;
+  size_t done = 0U;
+  bool miss = false;
+  while (done < len) {
+    if (in_window(p_rd)) {
+      size_t offset = (size_t)(p_rd->pos - p_rd->win_pos);
+      size_t copy_len = p_rd->win_len - offset;
+      copy_len = (copy_len < len - done) ? copy_len : len - done;
+      memcpy(p_dst + done, p_rd->buf + offset, copy_len);
+      done += copy_len;
+      p_rd->pos += (bl_foffset_t)copy_len;
+    } else {
+      miss = true;
+      size_t rm_bytes = len - done;
+      if (rm_bytes >= p_rd->buf_size &&
+          0 == p_rd->pos % (bl_foffset_t)p_rd->align) {
+        // Large read: whole aligned blocks go directly to the destination
+        size_t direct_len = rm_bytes - rm_bytes % p_rd->align;
+        size_t n_read = media_read(p_rd, p_rd->pos, p_dst + done, direct_len);
+        done += n_read;
+        p_rd->pos += (bl_foffset_t)n_read;
+        if (n_read < direct_len) {
+          break;
+        }
+      } else if (!fill_window(p_rd)) {
+        break;
+      }
+    }
+  }
+  if (miss) {
+    ++p_rd->n_misses;
+  } else {
+    ++p_rd->n_hits;
+  }
+  return done / size;
+}
+
+bl_foffset_t blbuf_ftell(bl_file_t file) {
+  bl_bufreader_t* p_rd = reader_of(file);
+  return p_rd ? p_rd->pos : blsys_ftell(file);
+}
+
+int blbuf_fseek(bl_file_t file, bl_foffset_t offset, int origin) {
+  bl_bufreader_t* p_rd = reader_of(file);
+  if (!p_rd) {
+    return blsys_fseek(file, offset, origin);
+  }
+  bl_foffset_t base = 0;
+  switch (origin) {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = p_rd->pos;
+      break;
+    case SEEK_END:
+      base = (bl_foffset_t)blsys_fsize(file);
+      break;
+    default:
+      return -1;
+  }
+  if (offset < 0 && base < -offset) {
+    return -1;
+  }
+  p_rd->pos = base + offset;
+  return 0;
+}
+
+bl_fsize_t blbuf_fsize(bl_file_t file) { return blsys_fsize(file); }
+
+int blbuf_feof(bl_file_t file) {
+  bl_bufreader_t* p_rd = reader_of(file);
+  if (!p_rd) {
+    return blsys_feof(file);
+  }
+  return (in_window(p_rd) || fill_window(p_rd)) ? 0 : 1;
+}
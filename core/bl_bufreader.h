@@ -0,0 +1,135 @@
+/**
+ * @file       bl_bufreader.h
+ * @brief      Buffered read-ahead layer for files read by Bootloader
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * A reader attached to an open file serves small reads and seeks made by the
+ * core from a window prefetched from the media with one large read, aligned
+ * to a given boundary (SD card block or FAT cluster). Reads larger than the
+ * window bypass it and go straight to the media, also aligned. Functions of
+ * this module replace blsys_fread(), blsys_fseek() and friends in the core:
+ * for a file with no reader attached they call the system directly.
+ */
+
+#ifndef BL_BUFREADER_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define BL_BUFREADER_H_INCLUDED
+
+#include "bl_syscalls.h"
+
+/// Buffered reader
+typedef struct bl_bufreader_t {
+  /// File served by the reader
+  bl_file_t file;
+  /// Window buffer
+  uint8_t* buf;
+  /// Size of the window buffer, a multiple of alignment
+  size_t buf_size;
+  /// Alignment of reads from media in bytes
+  size_t align;
+  /// File offset of the first byte in the window
+  bl_foffset_t win_pos;
+  /// Number of valid bytes in the window
+  size_t win_len;
+  /// Current position, as returned by blbuf_ftell()
+  bl_foffset_t pos;
+  /// Position of the file on media, -1 if unknown
+  bl_foffset_t file_pos;
+  /// File size, if known from a short read, otherwise -1
+  bl_foffset_t end_pos;
+  /// Number of reads served from the window only
+  uint32_t n_hits;
+  /// Number of reads needing data from media
+  uint32_t n_misses;
+  /// Number of read transactions made to media
+  uint32_t n_media_reads;
+  /// Number of bytes read from media
+  uint64_t media_bytes;
+} bl_bufreader_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Attaches a buffered reader to an open file
+ *
+ * Only one reader is attached at a time (per thread when built with
+ * BL_REENTRANT), a previously attached reader is detached. The current
+ * position of the file is taken as the position of the reader.
+ *
+ * @param p_rd      pointer to reader, initialized by this function
+ * @param file      open file
+ * @param buf       window buffer, must stay valid while attached
+ * @param buf_size  size of the window buffer, a non-zero multiple of align
+ * @param align     alignment of reads from media, non-zero
+ * @return          true if successful
+ */
+bool blbuf_attach(bl_bufreader_t* p_rd, bl_file_t file, void* buf,
+                  size_t buf_size, size_t align);
+
+/**
+ * Detaches a buffered reader, moving file position to the reader's position
+ *
+ * Counters of the reader remain valid.
+ *
+ * @param p_rd  pointer to reader, no-op if it is not attached
+ */
+void blbuf_detach(bl_bufreader_t* p_rd);
+
+/**
+ * Reads data from a file, like blsys_fread()
+ *
+ * @param ptr    buffer receiving data
+ * @param size   size of an item in bytes
+ * @param count  number of items to read
+ * @param file   file handle
+ * @return       number of items read
+ */
+size_t blbuf_fread(void* ptr, size_t size, size_t count, bl_file_t file);
+
+/**
+ * Returns current position in a file, like blsys_ftell()
+ *
+ * @param file  file handle
+ * @return      current position, or -1 in case of error
+ */
+bl_foffset_t blbuf_ftell(bl_file_t file);
+
+/**
+ * Sets position in a file, like blsys_fseek()
+ *
+ * With a reader attached, the position is only changed in the reader.
+ *
+ * @param file    file handle
+ * @param offset  offset from the origin
+ * @param origin  SEEK_SET, SEEK_CUR or SEEK_END
+ * @return        0 if successful
+ */
+int blbuf_fseek(bl_file_t file, bl_foffset_t offset, int origin);
+
+/**
+ * Returns size of a file, like blsys_fsize()
+ *
+ * @param file  file handle
+ * @return      size of the file in bytes
+ */
+bl_fsize_t blbuf_fsize(bl_file_t file);
+
+/**
+ * Tests for the end of a file, like blsys_feof()
+ *
+ * With a reader attached, the end is reached when the position is at or
+ * beyond the end of the file, as in FatFs.
+ *
+ * @param file  file handle
+ * @return      non-zero if the end of the file is reached
+ */
+int blbuf_feof(bl_file_t file);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BL_BUFREADER_H_INCLUDED
@@ -0,0 +1,63 @@
+/**
+ * @file       bl_crc_chunks.c
+ * @brief      CRC of data processed by independent chunks in any order
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * CRC32 with initial and final inversion satisfies
+ *   crc(A || B) = crc(A) * x^(8 * |B|) ^ crc(B)  (mod P),
+ * so CRC of a block is the sum of CRCs of its chunks, each multiplied by
+ * x^(8 * number of bytes following the chunk). The sum does not depend on the
+ * order of its terms.
+ */
+
+#include "crc32.h"
+#include "bl_crc_chunks.h"
+
+void bl_crc_chunks_init(bl_crc_chunks_t* p_acc, uint32_t total_size) {
+  if (p_acc) {
+    p_acc->total_size = total_size;
+    p_acc->done_size = 0U;
+    p_acc->crc = 0U;
+  }
+}
+
+bool bl_crc_chunks_add(bl_crc_chunks_t* p_acc, uint32_t offset, uint32_t size,
+                       uint32_t chunk_crc) {
+  if (p_acc && offset <= p_acc->total_size &&
+      size <= p_acc->total_size - offset &&
+      size <= p_acc->total_size - p_acc->done_size) {
+    uint32_t n_following = p_acc->total_size - offset - size;
+    p_acc->crc ^= crc32_shift(chunk_crc, n_following);
+    p_acc->done_size += size;
+    return true;
+  }
+  return false;
+}
+
+bool bl_crc_chunks_update(bl_crc_chunks_t* p_acc, uint32_t offset,
+                          const uint8_t* data, uint32_t size) {
+  if (data || !size) {
+    return bl_crc_chunks_add(p_acc, offset, size,
+                             size ? crc32_fast(data, size, 0U) : 0U);
+  }
+  return false;
+}
+
+bool bl_crc_chunks_merge(bl_crc_chunks_t* p_dst, const bl_crc_chunks_t* p_src) {
+  if (p_dst && p_src && p_dst->total_size == p_src->total_size &&
+      p_src->done_size <= p_dst->total_size - p_dst->done_size) {
+    p_dst->crc ^= p_src->crc;
+    p_dst->done_size += p_src->done_size;
+    return true;
+  }
+  return false;
+}
+
+bool bl_crc_chunks_final(const bl_crc_chunks_t* p_acc, uint32_t* p_crc) {
+  if (p_acc && p_crc && p_acc->done_size == p_acc->total_size) {
+    *p_crc = p_acc->crc;
+    return true;
+  }
+  return false;
+}
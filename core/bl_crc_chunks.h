@@ -0,0 +1,94 @@
+/**
+ * @file       bl_crc_chunks.h
+ * @brief      CRC of data processed by independent chunks in any order
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef BL_CRC_CHUNKS_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define BL_CRC_CHUNKS_H_INCLUDED
+
+#include "bl_util.h"
+
+/**
+ * Accumulator of CRC32 over a data block of known size
+ *
+ * The data block is split into chunks of arbitrary size, CRC of each chunk is
+ * calculated independently with crc32_fast() starting from 0, for example by
+ * several host threads or as DMA transfers complete. CRCs of chunks are then
+ * added in any order. Several accumulators of the same block may be merged,
+ * so each thread is able to use its own accumulator without locking. Each
+ * byte of the block must be covered by exactly one chunk; overlapping chunks
+ * are not detected.
+ */
+typedef struct bl_crc_chunks_t {
+  /// Size of the whole data block
+  uint32_t total_size;
+  /// Number of bytes covered by added chunks
+  uint32_t done_size;
+  /// Sum of CRCs of added chunks, each shifted to the end of the block
+  uint32_t crc;
+} bl_crc_chunks_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initializes accumulator of CRC over a data block
+ *
+ * @param p_acc       pointer to accumulator, contents are don't care
+ * @param total_size  size of the whole data block
+ */
+void bl_crc_chunks_init(bl_crc_chunks_t* p_acc, uint32_t total_size);
+
+/**
+ * Adds CRC of a chunk of data block
+ *
+ * @param p_acc      pointer to accumulator
+ * @param offset     offset of the chunk from the beginning of the block
+ * @param size       size of the chunk
+ * @param chunk_crc  CRC of the chunk calculated by crc32_fast() from 0
+ * @return           true if successful, false if the chunk is outside of the
+ *                   block or more bytes are added than the block has
+ */
+bool bl_crc_chunks_add(bl_crc_chunks_t* p_acc, uint32_t offset, uint32_t size,
+                       uint32_t chunk_crc);
+
+/**
+ * Calculates CRC of a chunk of data block and adds it to the accumulator
+ *
+ * @param p_acc   pointer to accumulator
+ * @param offset  offset of the chunk from the beginning of the block
+ * @param data    buffer with data of the chunk
+ * @param size    size of the chunk
+ * @return        true if successful
+ */
+bool bl_crc_chunks_update(bl_crc_chunks_t* p_acc, uint32_t offset,
+                          const uint8_t* data, uint32_t size);
+
+/**
+ * Merges accumulator of the same data block into another one
+ *
+ * @param p_dst  pointer to destination accumulator
+ * @param p_src  pointer to merged accumulator
+ * @return       true if successful, false if accumulators belong to blocks of
+ *               different size or more bytes are added than the block has
+ */
+bool bl_crc_chunks_merge(bl_crc_chunks_t* p_dst, const bl_crc_chunks_t* p_src);
+
+/**
+ * Returns CRC of the whole data block when all chunks are added
+ *
+ * @param p_acc  pointer to accumulator
+ * @param p_crc  pointer to variable receiving CRC of the block
+ * @return       true if successful, false if not all bytes are covered
+ */
+bool bl_crc_chunks_final(const bl_crc_chunks_t* p_acc, uint32_t* p_crc);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BL_CRC_CHUNKS_H_INCLUDED
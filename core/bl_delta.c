@@ -0,0 +1,330 @@
+/**
+ * @file       bl_delta.c
+ * @brief      Delta sections: patching the Main Firmware in flash memory
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * WARNING: This code is not expected to be thread-safe, as Bootloader always
+ * runs non-concurrently!
+ *
+ * NOTE: Only little-endian machines are supported. Support of natively
+ * big-endian machines is not planned.
+ */
+
+#include <string.h>
+#include "crc32.h"
+#include "sha2.h"
+#include "bl_delta.h"
+#include "bl_bufreader.h"
+
+#ifdef BL_IO_BUF_SIZE
+/// Size of statically allocated shared IO buffer
+#define IO_BUF_SIZE BL_IO_BUF_SIZE
+#else
+/// Size of statically allocated shared IO buffer
+#define IO_BUF_SIZE 4096U
+#endif
+
+/// State of patch application
+typedef struct apply_state_t {
+  /// Layout of flash memory
+  const bl_delta_layout_t* p_layout;
+  /// File containing the patch
+  bl_file_t file;
+  /// Flag indicating that produced firmware is written to flash memory
+  bool write;
+  /// Remaining bytes of the patch in the file
+  uint32_t rm_patch;
+  /// CRC of the payload of the Delta section
+  uint32_t patch_crc;
+  /// CRC of produced firmware
+  uint32_t out_crc;
+  /// Size of produced firmware
+  uint32_t out_size;
+  /// Number of bytes of firmware produced so far
+  uint32_t out_pos;
+  /// Index of the block currently being written
+  uint32_t curr_block;
+  /// Context of SHA-256 calculated over the header and produced firmware
+  SHA256_CTX sha_ctx;
+} apply_state_t;
+
+/// Statically allocated contex
+static BL_THREAD_LOCAL struct {
+  // IO buffer
+  uint8_t io_buf[IO_BUF_SIZE];
+} ctx;
+
+bool bl_delta_check_layout(const bl_delta_layout_t* p_layout) {
+  if (p_layout && p_layout->block_size &&
+      0U == p_layout->fw_size % p_layout->block_size &&
+      p_layout->fw_size / p_layout->block_size >= 2U &&
+      p_layout->fw_addr <= UINT32_MAX - p_layout->fw_size &&
+      p_layout->scratch_size >= p_layout->block_size &&
+      p_layout->scratch_addr <= UINT32_MAX - p_layout->scratch_size) {
+    // Ensure that the scratch area does not overlap with the firmware area
+    return p_layout->scratch_addr >= p_layout->fw_addr + p_layout->fw_size ||
+           p_layout->scratch_addr + p_layout->scratch_size <=
+               p_layout->fw_addr;
+  }
+  return false;
+}
+
+uint32_t bl_delta_max_size(const bl_delta_layout_t* p_layout) {
+  return p_layout->fw_size - p_layout->block_size;
+}
+
+/**
+ * Copies an area of flash memory to another, already erased area
+ *
+ * @param dst_addr  destination address
+ * @param src_addr  source address
+ * @param size      number of bytes to copy
+ * @return          true if successful
+ */
+static bool copy_flash(bl_addr_t dst_addr, bl_addr_t src_addr, uint32_t size) {
+  uint32_t rm_bytes = size;
+  uint32_t offset = 0U;
+  while (rm_bytes) {
+    size_t copy_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
+    if (!blsys_flash_read(src_addr + offset, ctx.io_buf, copy_len) ||
+        !blsys_flash_write(dst_addr + offset, ctx.io_buf, copy_len)) {
+      return false;
+    }
+    offset += copy_len;
+    rm_bytes -= copy_len;
+  }
+  return true;
+}
+
+bool bl_delta_save_block(const bl_delta_layout_t* p_layout,
+                         uint32_t block_idx) {
+  if (p_layout &&
+      block_idx < p_layout->fw_size / p_layout->block_size - 1U) {
+    bl_addr_t block_addr =
+        p_layout->fw_addr + block_idx * p_layout->block_size;
+    return blsys_flash_erase(p_layout->scratch_addr,
+                             p_layout->scratch_size) &&
+           copy_flash(p_layout->scratch_addr, block_addr,
+                      p_layout->block_size);
+  }
+  return false;
+}
+
+bool bl_delta_restore_scratch(const bl_delta_layout_t* p_layout,
+                              bl_addr_t src_addr) {
+  if (p_layout) {
+    return blsys_flash_erase(p_layout->scratch_addr,
+                             p_layout->scratch_size) &&
+           copy_flash(p_layout->scratch_addr, src_addr,
+                      p_layout->scratch_size);
+  }
+  return false;
+}
+
+/**
+ * Reads a part of the patch from file, updating its CRC
+ *
+ * @param p_st  pointer to state of patch application
+ * @param buf   buffer receiving data
+ * @param len   number of bytes to read
+ * @return      true if successful
+ */
+static bool read_patch(apply_state_t* p_st, void* buf, uint32_t len) {
+  if (len <= p_st->rm_patch && !blbuf_feof(p_st->file)) {
+    if (blbuf_fread(buf, 1U, len, p_st->file) == len) {
+      p_st->patch_crc = crc32_fast(buf, len, p_st->patch_crc);
+      p_st->rm_patch -= len;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Reads data of the base firmware
+ *
+ * In write mode, data located in the current block is read from the scratch
+ * area, because the block itself is already erased.
+ *
+ * @param p_st     pointer to state of patch application
+ * @param src_off  offset of data in the base firmware
+ * @param buf      buffer receiving data
+ * @param len      number of bytes to read
+ * @return         true if successful
+ */
+static bool read_base(const apply_state_t* p_st, uint32_t src_off, void* buf,
+                      uint32_t len) {
+  const bl_delta_layout_t* p_layout = p_st->p_layout;
+  uint32_t block_start = p_st->curr_block * p_layout->block_size;
+  uint32_t block_end = block_start + p_layout->block_size;
+  uint8_t* p_dst = (uint8_t*)buf;
+  uint32_t offset = src_off;
+  uint32_t rm_bytes = len;
+
+  while (rm_bytes) {
+    uint32_t read_len = rm_bytes;
+    bl_addr_t addr = p_layout->fw_addr + offset;
+    if (p_st->write && offset < block_end) {
+      // Data of the current block are saved in the scratch area
+      uint32_t rm_block = block_end - offset;
+      read_len = (rm_bytes < rm_block) ? rm_bytes : rm_block;
+      addr = p_layout->scratch_addr + (offset - block_start);
+    }
+    if (!blsys_flash_read(addr, p_dst, read_len)) {
+      return false;
+    }
+    p_dst += read_len;
+    offset += read_len;
+    rm_bytes -= read_len;
+  }
+  return true;
+}
+
+/**
+ * Takes a chunk of produced firmware, hashing it and writing to flash memory
+ *
+ * @param p_st  pointer to state of patch application
+ * @param buf   buffer containing produced data
+ * @param len   number of bytes in buffer, not crossing the end of the block
+ * @return      true if successful
+ */
+static bool output_chunk(apply_state_t* p_st, const uint8_t* buf,
+                         uint32_t len) {
+  const bl_delta_layout_t* p_layout = p_st->p_layout;
+  p_st->out_crc = crc32_fast(buf, len, p_st->out_crc);
+  if (p_st->write &&
+      !blsys_flash_write(p_layout->fw_addr + p_st->out_pos, buf, len)) {
+    return false;
+  }
+  sha256_Update(&p_st->sha_ctx, buf, len);
+  p_st->out_pos += len;
+  return true;
+}
+
+/**
+ * Prepares the block where the next produced byte is placed
+ *
+ * When a new block is entered in write mode, its contents is saved to the
+ * scratch area and the block is erased. The first block is expected to be
+ * prepared by the caller.
+ *
+ * @param p_st  pointer to state of patch application
+ * @return      true if successful
+ */
+static bool enter_block(apply_state_t* p_st) {
+  uint32_t block_idx = p_st->out_pos / p_st->p_layout->block_size;
+  if (block_idx != p_st->curr_block) {
+    p_st->curr_block = block_idx;
+    if (p_st->write) {
+      bl_addr_t block_addr =
+          p_st->p_layout->fw_addr + block_idx * p_st->p_layout->block_size;
+      return bl_delta_save_block(p_st->p_layout, block_idx) &&
+             blsys_flash_erase(block_addr, p_st->p_layout->block_size);
+    }
+  }
+  return true;
+}
+
+/**
+ * Executes one operation of the patch
+ *
+ * @param p_st       pointer to state of patch application
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+static bool do_operation(apply_state_t* p_st, bl_cbarg_t progr_arg) {
+  const bl_delta_layout_t* p_layout = p_st->p_layout;
+  uint8_t op_code = 0U;
+  uint32_t args[2] = {0U, 0U};
+
+  // Read operation code and its arguments
+  if (!read_patch(p_st, &op_code, sizeof(op_code))) {
+    return false;
+  }
+  bool is_copy = (bl_delta_op_copy == op_code);
+  if (!is_copy && op_code != bl_delta_op_insert) {
+    return false;
+  }
+  uint32_t n_args = is_copy ? 2U : 1U;
+  if (!read_patch(p_st, args, n_args * sizeof(args[0]))) {
+    return false;
+  }
+  uint32_t src_off = is_copy ? args[0] : 0U;
+  uint32_t rm_bytes = is_copy ? args[1] : args[0];
+  if (!rm_bytes || rm_bytes > p_st->out_size - p_st->out_pos ||
+      (is_copy && (src_off > bl_delta_max_size(p_layout) ||
+                   rm_bytes > bl_delta_max_size(p_layout) - src_off))) {
+    return false;
+  }
+
+  // Produce data in chunks, each one fitting in the current block
+  while (rm_bytes) {
+    if (!enter_block(p_st)) {
+      return false;
+    }
+    uint32_t block_end = (p_st->curr_block + 1U) * p_layout->block_size;
+    uint32_t len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
+    len = (len < block_end - p_st->out_pos) ? len : block_end - p_st->out_pos;
+    if (is_copy) {
+      // Data of previous blocks are already overwritten
+      if (src_off < p_st->curr_block * p_layout->block_size ||
+          !read_base(p_st, src_off, ctx.io_buf, len)) {
+        return false;
+      }
+      src_off += len;
+    } else if (!read_patch(p_st, ctx.io_buf, len)) {
+      return false;
+    }
+    if (!output_chunk(p_st, ctx.io_buf, len)) {
+      return false;
+    }
+    rm_bytes -= len;
+    bl_report_progress(progr_arg, p_st->out_size, p_st->out_pos);
+  }
+  return true;
+}
+
+bool bl_delta_apply(const bl_section_t* p_delta_hdr,
+                    const bl_section_t* p_target_hdr, bl_file_t file,
+                    const bl_delta_layout_t* p_layout, bool write,
+                    bl_hash_t* p_result, bl_cbarg_t progr_arg) {
+  if (p_delta_hdr && p_target_hdr && blsect_is_payload(p_target_hdr) && file &&
+      bl_delta_check_layout(p_layout) && p_result &&
+      p_delta_hdr->pl_size > sizeof(bl_section_t) && p_target_hdr->pl_size &&
+      p_target_hdr->pl_size <= bl_delta_max_size(p_layout) &&
+      sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_target_hdr->name)) {
+    apply_state_t st = {
+        .p_layout = p_layout,
+        .file = file,
+        .write = write,
+        .rm_patch = p_delta_hdr->pl_size - sizeof(bl_section_t),
+        .patch_crc = crc32_fast(p_target_hdr, sizeof(bl_section_t), 0U),
+        .out_crc = 0U,
+        .out_size = p_target_hdr->pl_size,
+        .out_pos = 0U,
+        .curr_block = 0U};
+    sha256_Init(&st.sha_ctx);
+    sha256_Update(&st.sha_ctx, (const uint8_t*)p_target_hdr,
+                  sizeof(bl_section_t));
+
+    bl_report_progress(progr_arg, st.out_size, 0U);
+    while (st.out_pos < st.out_size) {
+      if (!do_operation(&st, progr_arg)) {
+        return false;
+      }
+    }
+
+    // The whole patch should be consumed, and both CRCs should match
+    if (!st.rm_patch && st.patch_crc == p_delta_hdr->pl_crc &&
+        st.out_crc == p_target_hdr->pl_crc) {
+      sha256_Final(&st.sha_ctx, p_result->digest);
+      memcpy(p_result->sect_name, p_target_hdr->name,
+             sizeof(p_result->sect_name));
+      p_result->pl_ver = p_target_hdr->pl_ver;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file       bl_delta.h
+ * @brief      Delta sections: patching the Main Firmware in flash memory
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef BL_DELTA_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define BL_DELTA_H_INCLUDED
+
+#include "bl_util.h"
+#include "bl_syscalls.h"
+#include "bl_section.h"
+
+/// Name of the Delta section holding a patch for the Main Firmware
+#define BL_DELTA_SECT_NAME "delta"
+/// Size of a header of a "copy" operation including operation code
+#define BL_DELTA_COPY_HDR_SIZE 9U
+/// Size of a header of an "insert" operation including operation code
+#define BL_DELTA_INSERT_HDR_SIZE 5U
+
+/**
+ * Operation codes of a patch
+ *
+ * A patch is a sequence of operations producing the new firmware from start to
+ * end. Each operation begins with a one-byte code, followed by 32-bit
+ * arguments stored in little-endian format:
+ *   - copy: { source offset in base firmware, length }
+ *   - insert: { length }, followed by inserted data
+ */
+typedef enum bl_delta_op_t {
+  bl_delta_op_copy = 1,   ///< Copies data from the base firmware
+  bl_delta_op_insert = 2  ///< Inserts data stored in the patch
+} bl_delta_op_t;
+
+/**
+ * Layout of flash memory used to apply a patch
+ *
+ * The firmware area is processed in blocks of fixed size. Before a block is
+ * erased and rewritten, its original contents is saved in the scratch area,
+ * allowing the patch to refer to it. Therefore a patch producing a block of new
+ * firmware may only refer to data of the base firmware located in the same or
+ * in the following blocks. The last block holds integrity and version check
+ * records and is never used for firmware data.
+ */
+typedef struct bl_delta_layout_t {
+  bl_addr_t fw_addr;       ///< Base address of the Main Firmware
+  uint32_t fw_size;        ///< Size reserved for the Main Firmware
+  uint32_t block_size;     ///< Size of a block, erased and rewritten at once
+  bl_addr_t scratch_addr;  ///< Address of the scratch area
+  uint32_t scratch_size;   ///< Size of the scratch area
+} bl_delta_layout_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Validates layout of flash memory used to apply a patch
+ *
+ * @param p_layout  pointer to layout structure
+ * @return          true if layout is valid
+ */
+bool bl_delta_check_layout(const bl_delta_layout_t* p_layout);
+
+/**
+ * Returns maximum size of firmware which can be produced by a patch
+ *
+ * @param p_layout  pointer to layout structure, assumed to be valid
+ * @return          size in bytes, all blocks except the last one
+ */
+uint32_t bl_delta_max_size(const bl_delta_layout_t* p_layout);
+
+/**
+ * Saves a block of the firmware area in the scratch area
+ *
+ * @param p_layout   pointer to layout structure, assumed to be valid
+ * @param block_idx  index of the block within the firmware area
+ * @return           true if successful
+ */
+bool bl_delta_save_block(const bl_delta_layout_t* p_layout, uint32_t block_idx);
+
+/**
+ * Applies a patch reading it from file
+ *
+ * This function expects that given file is open and its position indicator
+ * points to the first operation of the patch, following the header of the
+ * target firmware embedded in the payload of the Delta section.
+ *
+ * When write is false, the patch is applied in "dry run" mode: the base
+ * firmware is read directly from the firmware area and nothing is written.
+ * This allows to verify the patch and to calculate the hash of the produced
+ * firmware before flash memory is modified.
+ *
+ * When write is true, the first block should be already saved to the scratch
+ * area using bl_delta_save_block() and erased, while remaining blocks should
+ * hold the base firmware. Each following block is saved to the scratch area
+ * and erased just before it is written.
+ *
+ * In both modes, the produced firmware is validated using the CRC from the
+ * target header and the patch itself is validated using the CRC from the
+ * header of the Delta section. The hash is produced only if both are valid.
+ *
+ * @param p_delta_hdr   pointer to header of the Delta section, assumed valid
+ * @param p_target_hdr  pointer to header of the target firmware, assumed valid
+ * @param file          file with position set to the first operation
+ * @param p_layout      pointer to layout structure, assumed to be valid
+ * @param write         if true, produced firmware is written to flash memory
+ * @param p_result      pointer to variable receiving hash of the target
+ * @param progr_arg     argument passed to progress callback function
+ * @return              true if successful
+ */
+bool bl_delta_apply(const bl_section_t* p_delta_hdr,
+                    const bl_section_t* p_target_hdr, bl_file_t file,
+                    const bl_delta_layout_t* p_layout, bool write,
+                    bl_hash_t* p_result, bl_cbarg_t progr_arg);
+
+/**
+ * Restores the scratch area copying it from another area of flash memory
+ *
+ * @param p_layout  pointer to layout structure, assumed to be valid
+ * @param src_addr  address of the source area having the size of scratch area
+ * @return          true if successful
+ */
+bool bl_delta_restore_scratch(const bl_delta_layout_t* p_layout,
+                              bl_addr_t src_addr);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BL_DELTA_H_INCLUDED
@@ -0,0 +1,237 @@
+/**
+ * @file       bl_flash_plan.c
+ * @brief      Differential flashing: erasing and programming changed sectors
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * WARNING: This code is not expected to be thread-safe, as Bootloader always
+ * runs non-concurrently!
+ */
+
+#include <string.h>
+#include "bl_flash_plan.h"
+
+/// Size of a block of flash memory read at once for comparison
+#define CMP_BLOCK_SIZE 64U
+/// Combination of flags meaning that a sector needs to be erased
+#define NEEDS_ERASE ((uint8_t)bl_fplan_differs | (uint8_t)bl_fplan_used)
+
+/**
+ * Finds a sector containing given address
+ *
+ * @param p_plan  pointer to plan structure, assumed to be enabled
+ * @param addr    address in flash memory
+ * @return        index of the sector, or -1 if address is outside of the area
+ */
+static int find_sector(const bl_fplan_t* p_plan, bl_addr_t addr) {
+  for (uint32_t idx = 0U; idx < p_plan->n_sectors; ++idx) {
+    if (addr >= p_plan->sect_addr[idx] && addr < p_plan->sect_addr[idx + 1U]) {
+      return (int)idx;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Returns number of bytes from given address to the end of its sector
+ *
+ * @param p_plan  pointer to plan structure, assumed to be enabled
+ * @param idx     index of the sector, assumed to be valid
+ * @param addr    address within the sector
+ * @return        number of bytes
+ */
+static inline size_t sector_remainder(const bl_fplan_t* p_plan, int idx,
+                                      bl_addr_t addr) {
+  return (size_t)(p_plan->sect_addr[idx + 1] - addr);
+}
+
+/**
+ * Compares contents of flash memory with a buffer
+ *
+ * @param addr  start address in flash memory
+ * @param buf   buffer with data
+ * @param len   number of bytes to compare
+ * @return      true if contents of flash memory is equal to data
+ */
+static bool flash_equals(bl_addr_t addr, const uint8_t* buf, size_t len) {
+  uint8_t flash_buf[CMP_BLOCK_SIZE];
+  size_t pos = 0U;
+
+  while (pos < len) {
+    size_t chunk = len - pos < CMP_BLOCK_SIZE ? len - pos : CMP_BLOCK_SIZE;
+    if (!blsys_flash_read(addr + pos, flash_buf, chunk) ||
+        !bl_memeq(flash_buf, buf + pos, chunk)) {
+      return false;
+    }
+    pos += chunk;
+  }
+  return true;
+}
+
+bool bl_fplan_init(bl_fplan_t* p_plan, bl_addr_t area_addr, size_t area_size) {
+  if (!p_plan) {
+    return false;
+  }
+  memset(p_plan, 0, sizeof(bl_fplan_t));
+  if (!area_size || area_addr > BL_ADDR_MAX - area_size) {
+    return false;
+  }
+
+  bl_addr_t area_end = area_addr + area_size;
+  bl_addr_t addr = area_addr;
+  uint32_t n_sectors = 0U;
+  while (addr < area_end) {
+    bl_addr_t sect_addr = 0U;
+    size_t sect_size = 0U;
+    if (n_sectors >= FLASH_PLAN_MAX_SECTORS ||
+        !blsys_flash_get_sector(addr, &sect_addr, &sect_size) ||
+        sect_addr != addr || !sect_size || sect_size > area_end - addr) {
+      return false;
+    }
+    p_plan->sect_addr[n_sectors++] = addr;
+    addr += sect_size;
+  }
+  p_plan->sect_addr[n_sectors] = area_end;
+  p_plan->n_sectors = n_sectors;
+  p_plan->enabled = true;
+  return true;
+}
+
+bool bl_fplan_compare(bl_fplan_t* p_plan, bl_addr_t addr, const uint8_t* buf,
+                      size_t len) {
+  if (!p_plan) {
+    return false;
+  }
+  if (!p_plan->enabled) {
+    return true;
+  }
+
+  uint8_t flash_buf[CMP_BLOCK_SIZE];
+  size_t pos = 0U;
+  while (pos < len) {
+    int idx = find_sector(p_plan, addr + pos);
+    if (idx < 0) {
+      return false;
+    }
+    size_t chunk = sector_remainder(p_plan, idx, addr + pos);
+    chunk = (len - pos < chunk) ? len - pos : chunk;
+    uint8_t* p_flags = &p_plan->flags[idx];
+
+    // Nothing more to learn about a sector which differs and is not erased
+    if ((*p_flags & NEEDS_ERASE) != NEEDS_ERASE) {
+      chunk = (chunk < CMP_BLOCK_SIZE) ? chunk : CMP_BLOCK_SIZE;
+      if (!blsys_flash_read(addr + pos, flash_buf, chunk)) {
+        return false;
+      }
+      for (size_t i = 0U; i < chunk; ++i) {
+        uint8_t new_byte = buf ? buf[pos + i] : 0xFFU;
+        if (flash_buf[i] != new_byte) {
+          *p_flags |= (uint8_t)bl_fplan_differs;
+        }
+        if (flash_buf[i] != 0xFFU) {
+          *p_flags |= (uint8_t)bl_fplan_used;
+        }
+      }
+    }
+    pos += chunk;
+  }
+  return true;
+}
+
+void bl_fplan_touch(bl_fplan_t* p_plan, bl_addr_t addr, size_t size) {
+  if (p_plan && p_plan->enabled && size && addr <= BL_ADDR_MAX - size) {
+    for (uint32_t idx = 0U; idx < p_plan->n_sectors; ++idx) {
+      if (p_plan->sect_addr[idx] < addr + size &&
+          p_plan->sect_addr[idx + 1U] > addr) {
+        p_plan->flags[idx] |= NEEDS_ERASE;
+      }
+    }
+  }
+}
+
+bool bl_fplan_erase(bl_fplan_t* p_plan, bl_addr_t addr, size_t size) {
+  if (!p_plan || !size || addr > BL_ADDR_MAX - size) {
+    return false;
+  }
+  if (!p_plan->enabled) {
+    return blsys_flash_erase(addr, size);
+  }
+
+  // Find the range of sectors, checking that it is aligned to boundaries
+  int first = find_sector(p_plan, addr);
+  if (first < 0 || p_plan->sect_addr[first] != addr) {
+    return false;
+  }
+  uint32_t last = (uint32_t)first;
+  while (last < p_plan->n_sectors && p_plan->sect_addr[last] < addr + size) {
+    ++last;
+  }
+  if (p_plan->sect_addr[last] != addr + size) {
+    return false;
+  }
+
+  // Erase each run of adjacent sectors needing erase with a single call
+  uint32_t idx = (uint32_t)first;
+  while (idx < last) {
+    uint32_t run_end = idx;
+    while (run_end < last &&
+           (p_plan->flags[run_end] & NEEDS_ERASE) == NEEDS_ERASE) {
+      ++run_end;
+    }
+    if (run_end == idx) {
+      ++idx;
+      continue;
+    }
+    if (!blsys_flash_erase(p_plan->sect_addr[idx],
+                           p_plan->sect_addr[run_end] -
+                               p_plan->sect_addr[idx])) {
+      return false;
+    }
+    for (; idx < run_end; ++idx) {
+      p_plan->flags[idx] &= (uint8_t)~bl_fplan_used;
+    }
+  }
+  return true;
+}
+
+bool bl_fplan_write(const bl_fplan_t* p_plan, bl_addr_t addr,
+                    const uint8_t* buf, size_t len) {
+  if (!p_plan || !p_plan->enabled) {
+    return blsys_flash_write(addr, buf, len);
+  }
+  if (!buf || !len) {
+    return false;
+  }
+
+  size_t pos = 0U;
+  while (pos < len) {
+    int idx = find_sector(p_plan, addr + pos);
+    if (idx < 0) {
+      return false;
+    }
+    size_t chunk = sector_remainder(p_plan, idx, addr + pos);
+    chunk = (len - pos < chunk) ? len - pos : chunk;
+    // Sectors kept intact must already hold exactly the same data
+    if (p_plan->flags[idx] & bl_fplan_differs) {
+      if (!blsys_flash_write(addr + pos, buf + pos, chunk)) {
+        return false;
+      }
+    } else if (!flash_equals(addr + pos, buf + pos, chunk)) {
+      return false;
+    }
+    pos += chunk;
+  }
+  return true;
+}
+
+uint32_t bl_fplan_count_rewritten(const bl_fplan_t* p_plan) {
+  uint32_t count = 0U;
+  if (p_plan && p_plan->enabled) {
+    for (uint32_t idx = 0U; idx < p_plan->n_sectors; ++idx) {
+      if (p_plan->flags[idx] & bl_fplan_differs) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file       bl_flash_plan.h
+ * @brief      Differential flashing: erasing and programming changed sectors
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef BL_FLASH_PLAN_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define BL_FLASH_PLAN_H_INCLUDED
+
+#include "bl_util.h"
+#include "bl_syscalls.h"
+
+#ifdef BL_FLASH_PLAN_MAX_SECTORS
+/// Maximum number of sectors in a planned area of flash memory
+#define FLASH_PLAN_MAX_SECTORS BL_FLASH_PLAN_MAX_SECTORS
+#else
+/// Maximum number of sectors in a planned area of flash memory
+#define FLASH_PLAN_MAX_SECTORS 32U
+#endif
+
+/// Flags describing a sector of flash memory, a set of bits
+typedef enum bl_fplan_flags_t {
+  /// Contents of the sector differ from the new contents
+  bl_fplan_differs = (1 << 0),
+  /// Sector is not erased, some bytes differ from 0xFF
+  bl_fplan_used = (1 << 1)
+} bl_fplan_flags_t;
+
+/**
+ * Plan of update of an area in flash memory
+ *
+ * A plan is built by comparing the whole area with its new contents. Then only
+ * sectors having different contents are rewritten: they are erased unless
+ * already erased, and programmed. Sectors matching the new contents are kept
+ * as is. If sector geometry is not available on the platform, the plan is
+ * disabled and the whole area is erased and programmed as usual.
+ */
+typedef struct bl_fplan_t {
+  /// Flag indicating that the plan is in use
+  bool enabled;
+  /// Number of sectors in the area
+  uint32_t n_sectors;
+  /// Start addresses of sectors, followed by the end address of the area
+  bl_addr_t sect_addr[FLASH_PLAN_MAX_SECTORS + 1U];
+  /// Flags of each sector, a combination of bl_fplan_flags_t values
+  uint8_t flags[FLASH_PLAN_MAX_SECTORS];
+} bl_fplan_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initializes a plan of update of an area in flash memory
+ *
+ * The area must begin and end at sector boundaries and consist of no more than
+ * FLASH_PLAN_MAX_SECTORS sectors. Otherwise, or if the platform does not
+ * provide sector geometry, the plan is initialized as disabled.
+ *
+ * @param p_plan     pointer to plan structure, contents are don't care
+ * @param area_addr  start address of the area
+ * @param area_size  size of the area
+ * @return           true if the plan is enabled
+ */
+bool bl_fplan_init(bl_fplan_t* p_plan, bl_addr_t area_addr, size_t area_size);
+
+/**
+ * Compares contents of flash memory with new contents, updating the plan
+ *
+ * The whole area should be compared before the plan is used to erase and to
+ * write flash memory. Does nothing if the plan is disabled.
+ *
+ * @param p_plan  pointer to plan structure
+ * @param addr    start address in flash memory
+ * @param buf     buffer with new contents, or NULL if new contents is erased
+ *                state of flash memory (all 0xFF)
+ * @param len     number of bytes to compare
+ * @return        true if successful
+ */
+bool bl_fplan_compare(bl_fplan_t* p_plan, bl_addr_t addr, const uint8_t* buf,
+                      size_t len);
+
+/**
+ * Marks sectors of flash memory as modified
+ *
+ * Needed when a part of the area is written outside of the plan, so that
+ * corresponding sectors are erased and programmed once again. Does nothing if
+ * the plan is disabled.
+ *
+ * @param p_plan  pointer to plan structure
+ * @param addr    start address of modified data
+ * @param size    size of modified data
+ */
+void bl_fplan_touch(bl_fplan_t* p_plan, bl_addr_t addr, size_t size);
+
+/**
+ * Erases sectors within given range which are to be rewritten
+ *
+ * The range must begin and end at sector boundaries. Sectors matching the new
+ * contents or already erased are left intact. If the plan is disabled, the
+ * whole range is erased.
+ *
+ * @param p_plan  pointer to plan structure
+ * @param addr    start address of the range
+ * @param size    size of the range
+ * @return        true if successful
+ */
+bool bl_fplan_erase(bl_fplan_t* p_plan, bl_addr_t addr, size_t size);
+
+/**
+ * Writes new contents to flash memory according to the plan
+ *
+ * Data is programmed into sectors which are to be rewritten, and compared
+ * with contents of flash memory in all other sectors, so that on success
+ * flash memory always holds given data. If the plan is disabled, or if
+ * p_plan is NULL, data is programmed as is.
+ *
+ * @param p_plan  pointer to plan structure, or NULL
+ * @param addr    destination address in flash memory
+ * @param buf     buffer containing data to write
+ * @param len     number of bytes to write
+ * @return        true if successful
+ */
+bool bl_fplan_write(const bl_fplan_t* p_plan, bl_addr_t addr,
+                    const uint8_t* buf, size_t len);
+
+/**
+ * Returns number of sectors to be rewritten
+ *
+ * @param p_plan  pointer to plan structure
+ * @return        number of sectors having different contents, or 0 if the
+ *                plan is disabled
+ */
+uint32_t bl_fplan_count_rewritten(const bl_fplan_t* p_plan);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BL_FLASH_PLAN_H_INCLUDED
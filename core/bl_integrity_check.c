@@ -44,14 +44,89 @@ BL_STATIC_NO_TEST bool icr_struct_create_main(bl_integrity_check_rec_t* p_icr,
   return false;
 }
 
+/**
+ * Returns size of a block used in the block CRC table
+ *
+ * @param pl_size  size of payload
+ * @return         the smallest block size dividing payload into no more than
+ *                 BL_BCT_MAX_BLOCKS blocks
+ */
+static uint32_t bct_block_size(uint32_t pl_size) {
+  uint32_t min_size = pl_size / BL_BCT_MAX_BLOCKS +
+                      ((pl_size % BL_BCT_MAX_BLOCKS) ? 1U : 0U);
+  uint32_t block_size = BL_BCT_MIN_BLOCK_SIZE;
+  while (block_size < min_size) {
+    block_size <<= 1;
+  }
+  return block_size;
+}
+
+/**
+ * Returns start address and size of a block of payload
+ *
+ * @param p_bct      pointer to block CRC table, assumed to be valid
+ * @param pl_size    size of payload
+ * @param main_addr  starting address of the Main section in flash memory
+ * @param idx        index of the block, assumed to be valid
+ * @return           block range
+ */
+static bl_icr_range_t bct_block(const bl_block_crc_table_t* p_bct,
+                                uint32_t pl_size, bl_addr_t main_addr,
+                                uint32_t idx) {
+  uint32_t offset = idx * p_bct->block_size;
+  uint32_t size = pl_size - offset;
+  bl_icr_range_t block = {
+      .addr = main_addr + offset,
+      .size = (size < p_bct->block_size) ? size : p_bct->block_size};
+  return block;
+}
+
+/**
+ * Creates block CRC table structure for the Main section
+ *
+ * @param p_bct      pointer to variable receiving block CRC table
+ * @param p_icr      pointer to integrity check record, assumed to be valid
+ * @param main_addr  starting address of the Main section in flash memory
+ * @return           true if successful
+ */
+BL_STATIC_NO_TEST bool bct_struct_create(bl_block_crc_table_t* p_bct,
+                                         const bl_integrity_check_rec_t* p_icr,
+                                         bl_addr_t main_addr) {
+  if (p_bct && p_icr && p_icr->main_sect.pl_size) {
+    uint32_t pl_size = p_icr->main_sect.pl_size;
+    memset(p_bct, 0, sizeof(bl_block_crc_table_t));
+    p_bct->magic = BL_BCT_MAGIC;
+    p_bct->struct_rev = BL_BCT_STRUCT_REV;
+    p_bct->icr_crc = p_icr->struct_crc;
+    p_bct->block_size = bct_block_size(pl_size);
+    p_bct->n_blocks = (pl_size - 1U) / p_bct->block_size + 1U;
+    for (uint32_t idx = 0U; idx < p_bct->n_blocks; ++idx) {
+      bl_icr_range_t block = bct_block(p_bct, pl_size, main_addr, idx);
+      uint32_t crc = 0U;
+      if (!blsys_flash_crc32(&crc, block.addr, block.size)) {
+        return false;
+      }
+      p_bct->block_crc[idx] = crc;
+    }
+    p_bct->struct_crc = crc32_fast(p_bct, BCT_CRC_CHECKED_SIZE, 0U);
+    return true;
+  }
+  return false;
+}
+
 bool bl_icr_create(bl_addr_t sect_addr, uint32_t sect_size, uint32_t pl_size,
                    uint32_t pl_ver) {
   if (bl_icr_check_sect_size(sect_size, pl_size)) {
     bl_integrity_check_rec_t icr;
+    bl_block_crc_table_t bct;
     bl_addr_t icr_addr = sect_addr + sect_size - BL_ICR_OFFSET_FROM_END;
-    if (icr_struct_create_main(&icr, sect_addr, sect_size, pl_size, pl_ver)) {
-      return blsys_flash_write(icr_addr, &icr, sizeof(icr));
-    }
+    bl_addr_t bct_addr = sect_addr + sect_size - BL_BCT_OFFSET_FROM_END;
+    // The block CRC table is written first, the ICR makes it valid
+    return icr_struct_create_main(&icr, sect_addr, sect_size, pl_size,
+                                  pl_ver) &&
+           bct_struct_create(&bct, &icr, sect_addr) &&
+           blsys_flash_write(bct_addr, &bct, sizeof(bct)) &&
+           blsys_flash_write(icr_addr, &icr, sizeof(icr));
   }
   return false;
 }
@@ -111,6 +186,111 @@ static bool icr_get(bl_integrity_check_rec_t* p_icr, bl_addr_t sect_addr,
   return false;
 }
 
+/**
+ * Checks that CRCs of blocks combine into CRC of the whole payload
+ *
+ * @param p_bct  pointer to block CRC table with valid geometry
+ * @param p_icr  pointer to integrity check record, assumed to be valid
+ * @return       true if the table matches payload CRC of the record
+ */
+static bool bct_check_pl_crc(const bl_block_crc_table_t* p_bct,
+                             const bl_integrity_check_rec_t* p_icr) {
+  uint32_t pl_size = p_icr->main_sect.pl_size;
+  uint32_t crc = 0U;
+  for (uint32_t idx = 0U; idx < p_bct->n_blocks; ++idx) {
+    bl_icr_range_t block = bct_block(p_bct, pl_size, 0U, idx);
+    crc = crc32_combine(crc, p_bct->block_crc[idx], block.size);
+  }
+  return crc == p_icr->main_sect.pl_crc;
+}
+
+/**
+ * Validates a block CRC table
+ *
+ * Besides the structure itself, CRCs of blocks must combine into payload CRC
+ * of the integrity check record, so that verification of all blocks is
+ * equivalent to verification of the whole payload.
+ *
+ * @param p_bct  pointer to block CRC table
+ * @param p_icr  pointer to integrity check record, assumed to be valid
+ * @return       true if the table is valid for the given record
+ */
+BL_STATIC_NO_TEST bool bct_validate(const bl_block_crc_table_t* p_bct,
+                                    const bl_integrity_check_rec_t* p_icr) {
+  if (p_bct && p_icr) {
+    uint32_t pl_size = p_icr->main_sect.pl_size;
+    return (BL_BCT_MAGIC == p_bct->magic &&
+            BL_BCT_STRUCT_REV == p_bct->struct_rev &&
+            crc32_fast(p_bct, BCT_CRC_CHECKED_SIZE, 0U) == p_bct->struct_crc &&
+            p_icr->struct_crc == p_bct->icr_crc && pl_size &&
+            p_bct->block_size >= BL_BCT_MIN_BLOCK_SIZE &&
+            0U == (p_bct->block_size & (p_bct->block_size - 1U)) &&
+            p_bct->n_blocks <= BL_BCT_MAX_BLOCKS &&
+            p_bct->n_blocks == (pl_size - 1U) / p_bct->block_size + 1U &&
+            bct_check_pl_crc(p_bct, p_icr));
+  }
+  return false;
+}
+
+/**
+ * Reads the block CRC table of a firmware section
+ *
+ * @param p_bct      pointer to variable receiving block CRC table
+ * @param p_icr      pointer to integrity check record, assumed to be valid
+ * @param sect_addr  address of section in flash memory
+ * @param sect_size  full size of section in flash memory
+ * @return           true if a valid table is read
+ */
+static bool bct_get(bl_block_crc_table_t* p_bct,
+                    const bl_integrity_check_rec_t* p_icr, bl_addr_t sect_addr,
+                    uint32_t sect_size) {
+  bl_addr_t bct_addr = sect_addr + sect_size - BL_BCT_OFFSET_FROM_END;
+  return blsys_flash_read(bct_addr, p_bct, sizeof(bl_block_crc_table_t)) &&
+         bct_validate(p_bct, p_icr);
+}
+
+/**
+ * Verifies one block of payload
+ *
+ * @param p_bct      pointer to block CRC table, assumed to be valid
+ * @param p_icr      pointer to integrity check record, assumed to be valid
+ * @param main_addr  starting address of the Main section in flash memory
+ * @param idx        index of the block, assumed to be valid
+ * @return           true if the block is valid
+ */
+static bool bct_verify_block(const bl_block_crc_table_t* p_bct,
+                             const bl_integrity_check_rec_t* p_icr,
+                             bl_addr_t main_addr, uint32_t idx) {
+  bl_icr_range_t block =
+      bct_block(p_bct, p_icr->main_sect.pl_size, main_addr, idx);
+  uint32_t crc = 0U;
+  return blsys_flash_crc32(&crc, block.addr, block.size) &&
+         crc == p_bct->block_crc[idx];
+}
+
+/**
+ * Verifies payload of a section, using the block CRC table if available
+ *
+ * @param p_icr      pointer to integrity check record, assumed to be valid
+ * @param sect_addr  address of section in flash memory
+ * @param sect_size  full size of section in flash memory
+ * @return           true if payload is valid
+ */
+static bool verify_payload(const bl_integrity_check_rec_t* p_icr,
+                           bl_addr_t sect_addr, uint32_t sect_size) {
+  bl_block_crc_table_t bct;
+  if (0U == p_icr->aux_sect.pl_size && 0U == p_icr->aux_sect.pl_crc &&
+      bct_get(&bct, p_icr, sect_addr, sect_size)) {
+    for (uint32_t idx = 0U; idx < bct.n_blocks; ++idx) {
+      if (!bct_verify_block(&bct, p_icr, sect_addr, idx)) {
+        return false;  // Stop at the first corrupted block
+      }
+    }
+    return true;
+  }
+  return icr_verify_main(p_icr, sect_addr);
+}
+
 bool bl_icr_verify(bl_addr_t sect_addr, uint32_t sect_size,
                    uint32_t* p_pl_ver) {
   if (sect_size) {
@@ -119,13 +299,143 @@ bool bl_icr_verify(bl_addr_t sect_addr, uint32_t sect_size,
     }
     bl_integrity_check_rec_t icr;
     if (icr_get(&icr, sect_addr, sect_size) &&
-        icr_verify_main(&icr, sect_addr)) {
+        verify_payload(&icr, sect_addr, sect_size)) {
+      if (p_pl_ver) {
+        *p_pl_ver = icr.pl_ver;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Validates a verification marker record
+ *
+ * @param p_vmr    pointer to verification marker record
+ * @param icr_crc  CRC of integrity check record, struct_crc
+ * @return         true if the marker is valid for the given record
+ */
+BL_STATIC_NO_TEST bool vmr_validate(const bl_verified_marker_rec_t* p_vmr,
+                                    uint32_t icr_crc) {
+  if (p_vmr) {
+    return (BL_VMR_MAGIC == p_vmr->magic &&
+            BL_VMR_STRUCT_REV == p_vmr->struct_rev &&
+            crc32_fast(p_vmr, VMR_CRC_CHECKED_SIZE, 0U) == p_vmr->struct_crc &&
+            icr_crc == p_vmr->icr_crc);
+  }
+  return false;
+}
+
+/**
+ * Checks if the section holds a verification marker which is still valid
+ *
+ * @param p_icr      pointer to integrity check record, assumed to be valid
+ * @param sect_addr  address of section in flash memory
+ * @param sect_size  full size of section in flash memory
+ * @return           true if the marker is valid for the given record and
+ *                   the section is write-protected
+ */
+static bool vmr_check(const bl_integrity_check_rec_t* p_icr,
+                      bl_addr_t sect_addr, uint32_t sect_size) {
+  bl_verified_marker_rec_t vmr;
+  bl_addr_t vmr_addr = sect_addr + sect_size - BL_VMR_OFFSET_FROM_END;
+  if (blsys_flash_read(vmr_addr, &vmr, sizeof(vmr)) &&
+      vmr_validate(&vmr, p_icr->struct_crc)) {
+    // Without write protection nothing guarantees that the payload is intact
+    return (vmr.flags & BL_VMR_FLAG_REQUIRE_WRP) &&
+           blsys_flash_is_write_protected(sect_addr, sect_size);
+  }
+  return false;
+}
+
+bool bl_icr_verify_cached(bl_addr_t sect_addr, uint32_t sect_size,
+                          uint32_t* p_pl_ver, bool full_check) {
+  if (!full_check && sect_size) {
+    if (p_pl_ver) {
+      *p_pl_ver = BL_VERSION_NA;
+    }
+    bl_integrity_check_rec_t icr;
+    if (icr_get(&icr, sect_addr, sect_size) && 0U == icr.aux_sect.pl_size &&
+        0U == icr.aux_sect.pl_crc && vmr_check(&icr, sect_addr, sect_size)) {
       if (p_pl_ver) {
         *p_pl_ver = icr.pl_ver;
       }
       return true;
     }
   }
+  return bl_icr_verify(sect_addr, sect_size, p_pl_ver);
+}
+
+bool bl_icr_certify(bl_addr_t sect_addr, uint32_t sect_size, bool require_wrp) {
+  bl_integrity_check_rec_t icr;
+  if (sect_size && icr_get(&icr, sect_addr, sect_size) &&
+      verify_payload(&icr, sect_addr, sect_size)) {
+    bl_verified_marker_rec_t vmr = {
+        .magic = BL_VMR_MAGIC,
+        .struct_rev = BL_VMR_STRUCT_REV,
+        .icr_crc = icr.struct_crc,
+        .flags = require_wrp ? BL_VMR_FLAG_REQUIRE_WRP : 0U,
+    };
+    vmr.struct_crc = crc32_fast(&vmr, VMR_CRC_CHECKED_SIZE, 0U);
+    bl_addr_t vmr_addr = sect_addr + sect_size - BL_VMR_OFFSET_FROM_END;
+    // Write record to flash memory and verify
+    bl_verified_marker_rec_t vmr_read;
+    return (blsys_flash_write(vmr_addr, &vmr, sizeof(vmr)) &&
+            blsys_flash_read(vmr_addr, &vmr_read, sizeof(vmr_read)) &&
+            bl_memeq(&vmr, &vmr_read, sizeof(vmr)));
+  }
+  return false;
+}
+
+bool bl_icr_verify_sample(bl_addr_t sect_addr, uint32_t sect_size,
+                          uint32_t first_block, uint32_t n_blocks) {
+  bl_integrity_check_rec_t icr;
+  bl_block_crc_table_t bct;
+  if (sect_size && icr_get(&icr, sect_addr, sect_size)) {
+    if (0U == icr.aux_sect.pl_size && 0U == icr.aux_sect.pl_crc &&
+        bct_get(&bct, &icr, sect_addr, sect_size)) {
+      uint32_t idx = first_block % bct.n_blocks;
+      for (uint32_t cnt = 0U; cnt < n_blocks && cnt < bct.n_blocks; ++cnt) {
+        if (!bct_verify_block(&bct, &icr, sect_addr, idx)) {
+          return false;
+        }
+        idx = (idx + 1U < bct.n_blocks) ? idx + 1U : 0U;
+      }
+      return true;
+    }
+    return icr_verify_main(&icr, sect_addr);
+  }
+  return false;
+}
+
+bool bl_icr_find_corruption(bl_addr_t sect_addr, uint32_t sect_size,
+                            bl_icr_range_t* p_range) {
+  bl_integrity_check_rec_t icr;
+  bl_block_crc_table_t bct;
+  if (p_range && sect_size && icr_get(&icr, sect_addr, sect_size)) {
+    if (0U == icr.aux_sect.pl_size && 0U == icr.aux_sect.pl_crc &&
+        bct_get(&bct, &icr, sect_addr, sect_size)) {
+      bool found = false;
+      for (uint32_t idx = 0U; idx < bct.n_blocks; ++idx) {
+        if (!bct_verify_block(&bct, &icr, sect_addr, idx)) {
+          bl_icr_range_t block =
+              bct_block(&bct, icr.main_sect.pl_size, sect_addr, idx);
+          if (!found) {
+            p_range->addr = block.addr;
+          }
+          p_range->size = block.addr + block.size - p_range->addr;
+          found = true;
+        }
+      }
+      return found;
+    }
+    if (!icr_verify_main(&icr, sect_addr)) {
+      p_range->addr = sect_addr;
+      p_range->size = icr.main_sect.pl_size;
+      return true;
+    }
+  }
   return false;
 }
 
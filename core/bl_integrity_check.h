@@ -24,14 +24,28 @@
 #define BL_ICR_SIZE 32U
 /// Size of version check record
 #define BL_VCR_SIZE 32U
+/// Size of verification marker record
+#define BL_VMR_SIZE 32U
+/// Size of block CRC table
+#define BL_BCT_SIZE 128U
 /// Total overhead from all metadata stored together with firmware
-#define BL_FW_SECT_OVERHEAD (BL_ICR_SIZE + BL_VCR_SIZE)
+#define BL_FW_SECT_OVERHEAD \
+  (BL_BCT_SIZE + BL_VMR_SIZE + BL_ICR_SIZE + BL_VCR_SIZE)
+// Offset of block CRC table from the end of firmware section
+#define BL_BCT_OFFSET_FROM_END \
+  (BL_BCT_SIZE + BL_VMR_SIZE + BL_ICR_SIZE + BL_VCR_SIZE)
+// Offset of VMR record from the end of firmware section
+#define BL_VMR_OFFSET_FROM_END (BL_VMR_SIZE + BL_ICR_SIZE + BL_VCR_SIZE)
 // Offset of ICR record from the end of firmware section
 #define BL_ICR_OFFSET_FROM_END (BL_ICR_SIZE + BL_VCR_SIZE)
 // Offset of VCR record from the end of firmware section
 #define BL_VCR_OFFSET_FROM_END (BL_VCR_SIZE)
 /// Magic word, "INTG" in LE
 #define BL_ICR_MAGIC 0x47544E49UL
+/// Magic word for verification marker record, "VRFD" in LE
+#define BL_VMR_MAGIC 0x44465256UL
+/// Magic word for block CRC table, "BCRC" in LE
+#define BL_BCT_MAGIC 0x43524342UL
 /// Magic string for version check record: 16 bytes with terminating '\0'
 #define BL_VCR_MAGIC "VERSIONCHECKREC"
 /// ICR: structure revision
@@ -42,6 +56,20 @@
 #define BL_VCR_STRUCT_REV 1U
 /// VCR: size of the part of integrity check record that is checked using CRC
 #define VCR_CRC_CHECKED_SIZE offsetof(bl_version_check_rec_t, struct_crc)
+/// VMR: structure revision
+#define BL_VMR_STRUCT_REV 1U
+/// VMR: size of the part of verification marker that is checked using CRC
+#define VMR_CRC_CHECKED_SIZE offsetof(bl_verified_marker_rec_t, struct_crc)
+/// VMR flag: marker is valid only while the section is write-protected
+#define BL_VMR_FLAG_REQUIRE_WRP (1U << 0)
+/// BCT: structure revision
+#define BL_BCT_STRUCT_REV 1U
+/// BCT: size of the part of block CRC table that is checked using CRC
+#define BCT_CRC_CHECKED_SIZE offsetof(bl_block_crc_table_t, struct_crc)
+/// BCT: maximum number of blocks
+#define BL_BCT_MAX_BLOCKS 26U
+/// BCT: minimum size of a block, the size is a power of two
+#define BL_BCT_MIN_BLOCK_SIZE 1024U
 
 /// One section of integrity check record
 typedef struct BL_ATTRS((packed)) bl_icr_sect_ {
@@ -76,8 +104,48 @@ typedef struct BL_ATTRS((packed)) bl_version_check_rec_t_ {
   uint32_t struct_crc;  ///< CRC of this structure using LE representation
 } bl_version_check_rec_t;
 
+/// Verification marker record
+///
+/// Placed right before the integrity check record, this record certifies that
+/// the payload was fully verified against the integrity check record having
+/// CRC stored in icr_crc. The structure has fixed size of 32 bytes. All 32-bit
+/// words are stored in little-endian format. CRC is calculated over first 28
+/// bytes of this structure.
+typedef struct BL_ATTRS((packed)) bl_verified_marker_rec_t_ {
+  uint32_t magic;       ///< Magic word, BL_VMR_MAGIC
+  uint32_t struct_rev;  ///< Revision of structure format
+  uint32_t icr_crc;     ///< CRC of certified integrity check record, struct_crc
+  uint32_t flags;       ///< Flags, a combination of BL_VMR_FLAG_xxx
+  uint32_t rsv[3];      ///< Reserved words
+  uint32_t struct_crc;  ///< CRC of this structure using LE representation
+} bl_verified_marker_rec_t;
+
+/// Block CRC table
+///
+/// Placed before the verification marker record, this table holds CRC of each
+/// block of the payload described by the integrity check record having CRC
+/// stored in icr_crc. The last block may be shorter than block_size. The
+/// structure has fixed size of 128 bytes. All 32-bit words are stored in
+/// little-endian format. CRC is calculated over first 124 bytes of this
+/// structure.
+typedef struct BL_ATTRS((packed)) bl_block_crc_table_t_ {
+  uint32_t magic;       ///< Magic word, BL_BCT_MAGIC
+  uint32_t struct_rev;  ///< Revision of structure format
+  uint32_t icr_crc;     ///< CRC of integrity check record, struct_crc
+  uint32_t block_size;  ///< Size of a block, a power of two
+  uint32_t n_blocks;    ///< Number of blocks
+  uint32_t block_crc[BL_BCT_MAX_BLOCKS];  ///< CRC of each block
+  uint32_t struct_crc;  ///< CRC of this structure using LE representation
+} bl_block_crc_table_t;
+
 #endif  // BL_ICR_DEFINE_PRIVATE_TYPES
 
+/// Range of flash memory
+typedef struct bl_icr_range_t_ {
+  bl_addr_t addr;  ///< Start address
+  uint32_t size;   ///< Size in bytes
+} bl_icr_range_t;
+
 /// Place of a version check record inside the firmware section
 typedef enum bl_vcr_place_t_ {
   /// At the beginning of the section
@@ -95,6 +163,9 @@ extern "C" {
 /**
  * Creates integrity check record in the flash memory
  *
+ * A block CRC table is created as well, allowing to verify the payload block
+ * by block.
+ *
  * @param sect_addr  address of section in flash memory
  * @param sect_size  full size of section in flash memory
  * @param pl_size    size of payload (firmware) stored in firmware section
@@ -107,6 +178,9 @@ bool bl_icr_create(bl_addr_t sect_addr, uint32_t sect_size, uint32_t pl_size,
 /**
  * Verifies integrity of payload stored in a section of flash memory
  *
+ * If the section has a block CRC table, the payload is verified block by block
+ * stopping at the first corrupted block.
+ *
  * @param sect_addr  address of section in flash memory
  * @param sect_size  full size of section in flash memory
  * @param p_pl_ver   pointer to variable receiving payload version, can be NULL
@@ -114,6 +188,75 @@ bool bl_icr_create(bl_addr_t sect_addr, uint32_t sect_size, uint32_t pl_size,
  */
 bool bl_icr_verify(bl_addr_t sect_addr, uint32_t sect_size, uint32_t* p_pl_ver);
 
+/**
+ * Verifies integrity of a part of payload using the block CRC table
+ *
+ * Verifies n_blocks consecutive blocks starting from block number first_block,
+ * wrapping around at the end of payload. Passing a different value of
+ * first_block on each boot allows to check all blocks over time. If the
+ * section has no block CRC table, the whole payload is verified.
+ *
+ * @param sect_addr    address of section in flash memory
+ * @param sect_size    full size of section in flash memory
+ * @param first_block  number of the first verified block, taken modulo number
+ *                     of blocks
+ * @param n_blocks     number of verified blocks
+ * @return             true if verified blocks are valid
+ */
+bool bl_icr_verify_sample(bl_addr_t sect_addr, uint32_t sect_size,
+                          uint32_t first_block, uint32_t n_blocks);
+
+/**
+ * Finds a corrupted range of payload stored in a section of flash memory
+ *
+ * All blocks are checked, and the range spans from the first to the last
+ * corrupted block. If the section has no block CRC table, the range covers the
+ * whole payload.
+ *
+ * @param sect_addr  address of section in flash memory
+ * @param sect_size  full size of section in flash memory
+ * @param p_range    pointer to variable receiving corrupted range
+ * @return           true if the payload is corrupted and the range is found,
+ *                   false if payload is valid or has no valid integrity check
+ *                   record
+ */
+bool bl_icr_find_corruption(bl_addr_t sect_addr, uint32_t sect_size,
+                            bl_icr_range_t* p_range);
+
+/**
+ * Verifies integrity of payload, skipping the CRC check if already verified
+ *
+ * The CRC of the payload is not calculated if the section holds a verification
+ * marker created by bl_icr_certify() for the current integrity check record
+ * with the BL_VMR_FLAG_REQUIRE_WRP flag, and the whole section is still
+ * write-protected. A marker without this flag is never trusted. Otherwise, or
+ * if full_check is true, this function works like bl_icr_verify().
+ *
+ * @param sect_addr   address of section in flash memory
+ * @param sect_size   full size of section in flash memory
+ * @param p_pl_ver    pointer to variable receiving payload version, can be NULL
+ * @param full_check  forces full verification of the payload
+ * @return            true if section contains valid payload
+ */
+bool bl_icr_verify_cached(bl_addr_t sect_addr, uint32_t sect_size,
+                          uint32_t* p_pl_ver, bool full_check);
+
+/**
+ * Verifies integrity of payload and creates a verification marker
+ *
+ * The marker is written to the flash memory only if payload is valid. It
+ * allows bl_icr_verify_cached() to skip the CRC check of the payload while the
+ * integrity check record stays the same.
+ *
+ * @param sect_addr    address of section in flash memory
+ * @param sect_size    full size of section in flash memory
+ * @param require_wrp  if true, the marker is valid only while the whole
+ *                     section is write-protected; if false, the marker is
+ *                     never trusted by bl_icr_verify_cached()
+ * @return             true if payload is valid and the marker is created
+ */
+bool bl_icr_certify(bl_addr_t sect_addr, uint32_t sect_size, bool require_wrp);
+
 /**
  * Returns version from an integrity check record without actual integrity check
  *
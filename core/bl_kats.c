@@ -9,8 +9,13 @@
 #include "sha2.h"
 #include "secp256k1.h"
 #include "secp256k1_preallocated.h"
+#include "secp256k1_schnorr_batch.h"
+#include "secp256k1_musig.h"
+#include "secp256k1_verify_ctx.h"
+#include "crc32.h"
 #include "bl_kats.h"
 #include "bl_util.h"
+#include "bl_syscalls.h"
 #include "bl_signature.h"
 
 /// Size of input message of ECDSA algorithm with secp256k1 curve
@@ -21,6 +26,54 @@
 #define ECDSA_SECKEY_SIZE 32U
 /// Size in bytes of an unpacked public key of ECDSA algorithm (secp256k1 curve)
 #define ECDSA_PUBKEY_SIZE 65U
+/// Number of BIP-340 test vectors
+#define SCHNORR_N_VECTORS 2U
+/// Number of public keys in MuSig2 key aggregation test vector
+#define MUSIG_N_KEYS 3U
+/// Size in bytes of a compressed public key
+#define COMPRESSED_PUBKEY_SIZE 33U
+
+/// Magic word of KAT record, "KATR" in LE
+#define KAT_REC_MAGIC 0x5254414BUL
+/// KAT record: structure revision
+#define KAT_REC_STRUCT_REV 1U
+/// KAT record: size of the part of the record that is checked using CRC
+#define KAT_REC_CRC_CHECKED_SIZE offsetof(kat_rec_t, struct_crc)
+
+/// Record of passed KATs kept in non-volatile memory
+///
+/// This structure has fixed size of 32 bytes. All 32-bit words are stored in
+/// little-endian format. CRC is calculated over first 28 bytes of this
+/// structure.
+typedef struct BL_ATTRS((packed)) kat_rec_t {
+  uint32_t magic;       ///< Magic word, KAT_REC_MAGIC
+  uint32_t struct_rev;  ///< Revision of structure format
+  uint32_t bl_version;  ///< Version of the Bootloader which passed KATs
+  uint32_t n_kats;      ///< Number of passed KATs
+  uint32_t rsv[3];      ///< Reserved words
+  uint32_t struct_crc;  ///< CRC of this structure using LE representation
+} kat_rec_t;
+
+/// Function performing a known answer test
+typedef bool (*kat_func_t)(void);
+
+/// Function performing a known answer test with secp256k1 context
+typedef bool (*kat_ctx_func_t)(secp256k1_context* ecdsa_ctx);
+
+/// Descriptor of a known answer test
+typedef struct kat_desc_t {
+  const char* name;       ///< Name of KAT
+  kat_func_t func;        ///< Function performing KAT
+  const char* algorithm;  ///< Signature algorithm requiring the KAT on demand,
+                          ///< or NULL if the KAT is scheduled for every upgrade
+} kat_desc_t;
+
+/// Test vector of BIP-340 Schnorr signature
+typedef struct schnorr_vector_t {
+  uint8_t pubkey[ECDSA_PUBKEY_SIZE];        ///< Public key, uncompressed
+  uint8_t msg[SECP256K1_SCHNORR_MSG_SIZE];  ///< Signed message
+  uint8_t sig[SECP256K1_SCHNORR_SIG_SIZE];  ///< Signature
+} schnorr_vector_t;
 
 // Reference message. Terminating null character should be ignored.
 static const char ref_message[] =
@@ -66,8 +119,78 @@ static const uint8_t ref_signature[ECDSA_SIG_COMPACT_SIZE] = {
     0xB1U, 0xC3U, 0x07U, 0xACU, 0x40U, 0xA8U, 0x44U, 0xB3U, 0x84U, 0xD7U, 0xA1U,
     0x0EU, 0xC6U, 0xF4U, 0x44U, 0x97U, 0xE7U, 0xACU, 0xE7U, 0x7DU};
 
+// Test vectors of BIP-340 Schnorr signature with public keys in uncompressed
+// form (having even Y coordinate)
+static const schnorr_vector_t schnorr_vectors[SCHNORR_N_VECTORS] = {
+    // Test vector #0 of BIP-340
+    {.pubkey = {0x04U, 0xF9U, 0x30U, 0x8AU, 0x01U, 0x92U, 0x58U, 0xC3U, 0x10U,
+                0x49U, 0x34U, 0x4FU, 0x85U, 0xF8U, 0x9DU, 0x52U, 0x29U, 0xB5U,
+                0x31U, 0xC8U, 0x45U, 0x83U, 0x6FU, 0x99U, 0xB0U, 0x86U, 0x01U,
+                0xF1U, 0x13U, 0xBCU, 0xE0U, 0x36U, 0xF9U, 0x38U, 0x8FU, 0x7BU,
+                0x0FU, 0x63U, 0x2DU, 0xE8U, 0x14U, 0x0FU, 0xE3U, 0x37U, 0xE6U,
+                0x2AU, 0x37U, 0xF3U, 0x56U, 0x65U, 0x00U, 0xA9U, 0x99U, 0x34U,
+                0xC2U, 0x23U, 0x1BU, 0x6CU, 0xB9U, 0xFDU, 0x75U, 0x84U, 0xB8U,
+                0xE6U, 0x72U},
+     .msg = {0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+             0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+             0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+             0x00U, 0x00U, 0x00U, 0x00U, 0x00U},
+     .sig = {0xE9U, 0x07U, 0x83U, 0x1FU, 0x80U, 0x84U, 0x8DU, 0x10U, 0x69U,
+             0xA5U, 0x37U, 0x1BU, 0x40U, 0x24U, 0x10U, 0x36U, 0x4BU, 0xDFU,
+             0x1CU, 0x5FU, 0x83U, 0x07U, 0xB0U, 0x08U, 0x4CU, 0x55U, 0xF1U,
+             0xCEU, 0x2DU, 0xCAU, 0x82U, 0x15U, 0x25U, 0xF6U, 0x6AU, 0x4AU,
+             0x85U, 0xEAU, 0x8BU, 0x71U, 0xE4U, 0x82U, 0xA7U, 0x4FU, 0x38U,
+             0x2DU, 0x2CU, 0xE5U, 0xEBU, 0xEEU, 0xE8U, 0xFDU, 0xB2U, 0x17U,
+             0x2FU, 0x47U, 0x7DU, 0xF4U, 0x90U, 0x0DU, 0x31U, 0x05U, 0x36U,
+             0xC0U}},
+    // Test vector #1 of BIP-340
+    {.pubkey = {0x04U, 0xDFU, 0xF1U, 0xD7U, 0x7FU, 0x2AU, 0x67U, 0x1CU, 0x5FU,
+                0x36U, 0x18U, 0x37U, 0x26U, 0xDBU, 0x23U, 0x41U, 0xBEU, 0x58U,
+                0xFEU, 0xAEU, 0x1DU, 0xA2U, 0xDEU, 0xCEU, 0xD8U, 0x43U, 0x24U,
+                0x0FU, 0x7BU, 0x50U, 0x2BU, 0xA6U, 0x59U, 0x2CU, 0xE1U, 0x9BU,
+                0x94U, 0x6CU, 0x4EU, 0xE5U, 0x85U, 0x46U, 0xF5U, 0x25U, 0x1DU,
+                0x44U, 0x1AU, 0x06U, 0x5EU, 0xA5U, 0x07U, 0x35U, 0x60U, 0x69U,
+                0x85U, 0xE5U, 0xB2U, 0x28U, 0x78U, 0x8BU, 0xECU, 0x4EU, 0x58U,
+                0x28U, 0x98U},
+     .msg = {0x24U, 0x3FU, 0x6AU, 0x88U, 0x85U, 0xA3U, 0x08U, 0xD3U, 0x13U,
+             0x19U, 0x8AU, 0x2EU, 0x03U, 0x70U, 0x73U, 0x44U, 0xA4U, 0x09U,
+             0x38U, 0x22U, 0x29U, 0x9FU, 0x31U, 0xD0U, 0x08U, 0x2EU, 0xFAU,
+             0x98U, 0xECU, 0x4EU, 0x6CU, 0x89U},
+     .sig = {0x68U, 0x96U, 0xBDU, 0x60U, 0xEEU, 0xAEU, 0x29U, 0x6DU, 0xB4U,
+             0x8AU, 0x22U, 0x9FU, 0xF7U, 0x1DU, 0xFEU, 0x07U, 0x1BU, 0xDEU,
+             0x41U, 0x3EU, 0x6DU, 0x43U, 0xF9U, 0x17U, 0xDCU, 0x8DU, 0xCFU,
+             0x8CU, 0x78U, 0xDEU, 0x33U, 0x41U, 0x89U, 0x06U, 0xD1U, 0x1AU,
+             0xC9U, 0x76U, 0xABU, 0xCCU, 0xB2U, 0x0BU, 0x09U, 0x12U, 0x92U,
+             0xBFU, 0xF4U, 0xEAU, 0x89U, 0x7EU, 0xFCU, 0xB6U, 0x39U, 0xEAU,
+             0x87U, 0x1CU, 0xFAU, 0x95U, 0xF6U, 0xDEU, 0x33U, 0x9EU, 0x4BU,
+             0x0AU}}};
+
+// Public keys from key aggregation test vectors of BIP-327
+static const uint8_t musig_pubkeys[MUSIG_N_KEYS][COMPRESSED_PUBKEY_SIZE] = {
+    {0x02U, 0xF9U, 0x30U, 0x8AU, 0x01U, 0x92U, 0x58U, 0xC3U, 0x10U, 0x49U,
+     0x34U, 0x4FU, 0x85U, 0xF8U, 0x9DU, 0x52U, 0x29U, 0xB5U, 0x31U, 0xC8U,
+     0x45U, 0x83U, 0x6FU, 0x99U, 0xB0U, 0x86U, 0x01U, 0xF1U, 0x13U, 0xBCU,
+     0xE0U, 0x36U, 0xF9U},
+    {0x03U, 0xDFU, 0xF1U, 0xD7U, 0x7FU, 0x2AU, 0x67U, 0x1CU, 0x5FU, 0x36U,
+     0x18U, 0x37U, 0x26U, 0xDBU, 0x23U, 0x41U, 0xBEU, 0x58U, 0xFEU, 0xAEU,
+     0x1DU, 0xA2U, 0xDEU, 0xCEU, 0xD8U, 0x43U, 0x24U, 0x0FU, 0x7BU, 0x50U,
+     0x2BU, 0xA6U, 0x59U},
+    {0x02U, 0x35U, 0x90U, 0xA9U, 0x4EU, 0x76U, 0x8FU, 0x8EU, 0x18U, 0x15U,
+     0xC2U, 0xF2U, 0x4BU, 0x4DU, 0x80U, 0xA8U, 0xE3U, 0x14U, 0x93U, 0x16U,
+     0xC3U, 0x51U, 0x8CU, 0xE7U, 0xB7U, 0xADU, 0x33U, 0x83U, 0x68U, 0xD0U,
+     0x38U, 0xCAU, 0x66U}};
+
+// X coordinate of the aggregate key of musig_pubkeys[] (BIP-327)
+static const uint8_t musig_agg_pubkey_x[COMPRESSED_PUBKEY_SIZE - 1U] = {
+    0x90U, 0x53U, 0x9EU, 0xEDU, 0xE5U, 0x65U, 0xF5U, 0xD0U, 0x54U, 0xF3U, 0x2CU,
+    0xC0U, 0xC2U, 0x20U, 0x12U, 0x68U, 0x89U, 0xEDU, 0x1EU, 0x5DU, 0x19U, 0x3BU,
+    0xAFU, 0x15U, 0xAEU, 0xF3U, 0x44U, 0xFEU, 0x59U, 0xD4U, 0x61U, 0x0CU};
+
 /// Buffer used by secp256k1 library to allocate context
-extern uint8_t blsig_ecdsa_buf[BLSIG_ECDSA_BUF_SIZE];
+extern BL_THREAD_LOCAL uint8_t blsig_ecdsa_buf[BLSIG_ECDSA_BUF_SIZE];
+/// Buffer used as scratch space for batch verification of Schnorr signatures
+extern BL_THREAD_LOCAL uint64_t
+    blsig_schnorr_scratch_buf[BLSIG_SCHNORR_SCRATCH_SIZE / sizeof(uint64_t)];
 
 /**
  * Tests two byte buffers for equality
@@ -174,18 +297,109 @@ static bool ecdsa_secp256k1_verify_kat(secp256k1_context* ecdsa_ctx) {
 }
 
 /**
- * Runs known answer tests for ECDSA functions with secp256k1 curve
+ * Performs signature KAT for BIP-340 Schnorr verification (secp256k1 curve)
  *
- * @return true  if all tests passed successfully
+ * Test vectors are verified one by one and then together in a batch, and
+ * finally the batch is verified with one corrupted message.
+ *
+ * @param ecdsa_ctx  secp256k1 context object, initialized for verification
+ * @return           true if the test passed successfully
  */
-BL_STATIC_NO_TEST bool do_ecdsa_secp256k1_kat(void) {
-  const unsigned int flags = SECP256K1_CONTEXT_VERIFY;
-  size_t ctx_size = secp256k1_context_preallocated_size(flags);
+static bool schnorr_secp256k1_verify_kat(secp256k1_context* ecdsa_ctx) {
+  if (ecdsa_ctx) {
+    secp256k1_scratch_space* scratch =
+        secp256k1_schnorr_scratch_create_preallocated(
+            blsig_schnorr_scratch_buf, sizeof(blsig_schnorr_scratch_buf));
+    secp256k1_pubkey pubkey_objs[SCHNORR_N_VECTORS];
+    const secp256k1_pubkey* pubkeys[SCHNORR_N_VECTORS];
+    const unsigned char* sigs[SCHNORR_N_VECTORS];
+    const unsigned char* msgs[SCHNORR_N_VECTORS];
+    memset(pubkey_objs, 0xEE, sizeof(pubkey_objs));
+
+    // Make a copy of the last message to corrupt it later
+    uint8_t msg_copy[SECP256K1_SCHNORR_MSG_SIZE];
+    memcpy(msg_copy, schnorr_vectors[SCHNORR_N_VECTORS - 1U].msg,
+           sizeof(msg_copy));
+
+    // Parse public keys and verify each signature separately
+    bool ok = (scratch != NULL);
+    for (size_t i = 0U; i < SCHNORR_N_VECTORS; ++i) {
+      ok = ok && (1 == secp256k1_ec_pubkey_parse(
+                           ecdsa_ctx, &pubkey_objs[i],
+                           schnorr_vectors[i].pubkey, ECDSA_PUBKEY_SIZE));
+      pubkeys[i] = &pubkey_objs[i];
+      sigs[i] = schnorr_vectors[i].sig;
+      msgs[i] = schnorr_vectors[i].msg;
+      ok = ok && (1 == secp256k1_schnorr_verify_batch(ecdsa_ctx, scratch,
+                                                      &sigs[i], &msgs[i],
+                                                      &pubkeys[i], 1U));
+    }
+    // Verify all signatures in a batch
+    ok = ok && (1 == secp256k1_schnorr_verify_batch(ecdsa_ctx, scratch, sigs,
+                                                    msgs, pubkeys,
+                                                    SCHNORR_N_VECTORS));
+    // Verify the batch with corrupted message
+    msg_copy[SECP256K1_SCHNORR_MSG_SIZE - 1U] ^= 1;
+    msgs[SCHNORR_N_VECTORS - 1U] = msg_copy;
+    ok = ok && (0 == secp256k1_schnorr_verify_batch(ecdsa_ctx, scratch, sigs,
+                                                    msgs, pubkeys,
+                                                    SCHNORR_N_VECTORS));
+    return ok;
+  }
+  return false;
+}
+
+/**
+ * Performs KAT for MuSig2 key aggregation (secp256k1 curve)
+ *
+ * @param ecdsa_ctx  secp256k1 context object, initialized for verification
+ * @return           true if the test passed successfully
+ */
+static bool musig_secp256k1_keyagg_kat(secp256k1_context* ecdsa_ctx) {
+  if (ecdsa_ctx) {
+    secp256k1_scratch_space* scratch =
+        secp256k1_schnorr_scratch_create_preallocated(
+            blsig_schnorr_scratch_buf, sizeof(blsig_schnorr_scratch_buf));
+    secp256k1_pubkey pubkey_objs[MUSIG_N_KEYS];
+    const secp256k1_pubkey* pubkeys[MUSIG_N_KEYS];
+    secp256k1_pubkey agg_pubkey;
+    uint8_t agg_pubkey_ser[COMPRESSED_PUBKEY_SIZE];
+    size_t ser_len = sizeof(agg_pubkey_ser);
+    memset(agg_pubkey_ser, 0, sizeof(agg_pubkey_ser));
+
+    bool ok = (scratch != NULL);
+    for (size_t i = 0U; i < MUSIG_N_KEYS; ++i) {
+      ok = ok && (1 == secp256k1_ec_pubkey_parse(ecdsa_ctx, &pubkey_objs[i],
+                                                 musig_pubkeys[i],
+                                                 COMPRESSED_PUBKEY_SIZE));
+      pubkeys[i] = &pubkey_objs[i];
+    }
+    ok = ok && (1 == secp256k1_musig_pubkey_agg(ecdsa_ctx, scratch,
+                                                &agg_pubkey, pubkeys,
+                                                MUSIG_N_KEYS));
+    ok = ok && (1 == secp256k1_ec_pubkey_serialize(
+                         ecdsa_ctx, agg_pubkey_ser, &ser_len, &agg_pubkey,
+                         SECP256K1_EC_COMPRESSED));
+    ok = ok && buf_equal(&agg_pubkey_ser[1], musig_agg_pubkey_x,
+                         sizeof(musig_agg_pubkey_x));
+    return ok;
+  }
+  return false;
+}
+
+/**
+ * Runs a known answer test with a secp256k1 context created for verification
+ *
+ * @param func  function performing KAT
+ * @return      true if the test passed successfully
+ */
+static bool run_with_verify_ctx(kat_ctx_func_t func) {
+  size_t ctx_size = secp256k1_verify_context_preallocated_size();
   if (ctx_size <= BLSIG_ECDSA_BUF_SIZE) {
     secp256k1_context* ecdsa_ctx =
-        secp256k1_context_preallocated_create(blsig_ecdsa_buf, flags);
+        secp256k1_verify_context_preallocated_create(blsig_ecdsa_buf);
     if (ecdsa_ctx) {
-      bool success = ecdsa_secp256k1_verify_kat(ecdsa_ctx);
+      bool success = func(ecdsa_ctx);
       secp256k1_context_preallocated_destroy(ecdsa_ctx);
       return success;
     }
@@ -193,8 +407,193 @@ BL_STATIC_NO_TEST bool do_ecdsa_secp256k1_kat(void) {
   return false;
 }
 
+/**
+ * Runs known answer tests for ECDSA functions with secp256k1 curve
+ *
+ * @return true  if all tests passed successfully
+ */
+BL_STATIC_NO_TEST bool do_ecdsa_secp256k1_kat(void) {
+  return run_with_verify_ctx(ecdsa_secp256k1_verify_kat);
+}
+
+/**
+ * Runs known answer tests for BIP-340 Schnorr batch verification
+ *
+ * @return true  if all tests passed successfully
+ */
+BL_STATIC_NO_TEST bool do_schnorr_secp256k1_kat(void) {
+  return run_with_verify_ctx(schnorr_secp256k1_verify_kat);
+}
+
+/**
+ * Runs known answer tests for MuSig2 key aggregation
+ *
+ * @return true  if all tests passed successfully
+ */
+BL_STATIC_NO_TEST bool do_musig_secp256k1_kat(void) {
+  return run_with_verify_ctx(musig_secp256k1_keyagg_kat);
+}
+
+/// Descriptors of known answer tests
+static const kat_desc_t kat_desc[bl_n_kats_] = {
+    [bl_kat_sha256] = {.name = "SHA-256", .func = do_sha256_kat},
+    [bl_kat_secp256k1] = {.name = "secp256k1", .func = do_ecdsa_secp256k1_kat},
+    [bl_kat_schnorr] = {.name = "Schnorr",
+                        .func = do_schnorr_secp256k1_kat,
+                        .algorithm = ALG_SECP256K1_SCHNORR_SHA256},
+    [bl_kat_musig] = {.name = "MuSig2",
+                      .func = do_musig_secp256k1_kat,
+                      .algorithm = ALG_SECP256K1_MUSIG2_SHA256}};
+
+/**
+ * Checks if a known answer test is scheduled for every upgrade
+ *
+ * @param id  identifier of KAT
+ * @return    true if the KAT is scheduled, false if it is run on demand
+ */
+static inline bool is_scheduled(int id) { return !kat_desc[id].algorithm; }
+
+/// States of known answer tests
+static BL_THREAD_LOCAL bl_kat_state_t kat_state[bl_n_kats_];
+/// Durations of known answer tests in microseconds
+static BL_THREAD_LOCAL uint32_t kat_time_us[bl_n_kats_];
+
+/**
+ * Sets all known answer tests to pending state
+ */
+static void reset_kats(void) {
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    kat_state[id] = bl_kat_pending;
+    kat_time_us[id] = 0U;
+  }
+}
+
+/**
+ * Runs a known answer test measuring its duration
+ *
+ * @param id  identifier of KAT
+ * @return    true if the test passed successfully
+ */
+static bool run_kat(bl_kat_id_t id) {
+  uint32_t start_us = blsys_time_us();
+  bool passed = kat_desc[id].func();
+  kat_time_us[id] = blsys_time_us() - start_us;
+  kat_state[id] = passed ? bl_kat_passed : bl_kat_failed;
+  return passed;
+}
+
+/**
+ * Validates a record of passed KATs
+ *
+ * @param p_rec       pointer to KAT record
+ * @param bl_version  version of the running Bootloader
+ * @return            true if the record is valid and made by the same version
+ */
+static bool kat_rec_validate(const kat_rec_t* p_rec, uint32_t bl_version) {
+  return (KAT_REC_MAGIC == p_rec->magic &&
+          KAT_REC_STRUCT_REV == p_rec->struct_rev &&
+          crc32_fast(p_rec, KAT_REC_CRC_CHECKED_SIZE, 0U) ==
+              p_rec->struct_crc &&
+          bl_version == p_rec->bl_version && bl_n_kats_ == p_rec->n_kats);
+}
+
 bool bl_run_kats(void) {
-  bool success = do_sha256_kat();
-  success = success && do_ecdsa_secp256k1_kat();
-  return success;
+  reset_kats();
+  bool passed = true;
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    passed = run_kat((bl_kat_id_t)id) && passed;
+  }
+  return passed;
+}
+
+bool bl_kats_begin(bl_kat_policy_t policy, uint32_t bl_version) {
+  reset_kats();
+  if (bl_kat_policy_overlapped == policy) {
+    return true;
+  }
+  if (bl_kat_policy_once_per_version == policy &&
+      BL_VERSION_NA != bl_version) {
+    kat_rec_t rec;
+    if (blsys_nvrec_read(&rec, sizeof(rec)) &&
+        kat_rec_validate(&rec, bl_version)) {
+      for (int id = 0; id < bl_n_kats_; ++id) {
+        if (is_scheduled(id)) {
+          kat_state[id] = bl_kat_skipped;
+        }
+      }
+      return true;
+    }
+    if (bl_kats_complete()) {
+      memset(&rec, 0, sizeof(rec));
+      rec.magic = KAT_REC_MAGIC;
+      rec.struct_rev = KAT_REC_STRUCT_REV;
+      rec.bl_version = bl_version;
+      rec.n_kats = bl_n_kats_;
+      rec.struct_crc = crc32_fast(&rec, KAT_REC_CRC_CHECKED_SIZE, 0U);
+      // If the record is not stored, KATs are simply run again next time
+      (void)blsys_nvrec_write(&rec, sizeof(rec));
+      return true;
+    }
+    return false;
+  }
+  return bl_kats_complete();
+}
+
+bool bl_kats_step(void) {
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    if (bl_kat_failed == kat_state[id]) {
+      return false;
+    }
+    if (bl_kat_pending == kat_state[id] && is_scheduled(id)) {
+      return run_kat((bl_kat_id_t)id);
+    }
+  }
+  return true;
+}
+
+bool bl_kats_complete(void) {
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    if (bl_kat_pending == kat_state[id] && is_scheduled(id)) {
+      (void)run_kat((bl_kat_id_t)id);
+    }
+    if (bl_kat_failed == kat_state[id]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool bl_kats_run_for_algorithm(const char* algorithm) {
+  bool passed = true;
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    if (!is_scheduled(id) && bl_streq(algorithm, kat_desc[id].algorithm)) {
+      if (bl_kat_pending == kat_state[id]) {
+        (void)run_kat((bl_kat_id_t)id);
+      }
+      passed = passed && bl_kat_failed != kat_state[id];
+    }
+  }
+  return passed;
+}
+
+bl_kat_state_t bl_kat_get_state(bl_kat_id_t id) {
+  if ((int)id >= 0 && (int)id < bl_n_kats_) {
+    return kat_state[id];
+  }
+  return bl_kat_failed;
+}
+
+uint32_t bl_kat_get_time_us(bl_kat_id_t id) {
+  if ((int)id >= 0 && (int)id < bl_n_kats_) {
+    return kat_time_us[id];
+  }
+  return 0U;
+}
+
+const char* bl_kat_name(bl_kat_id_t id) {
+  static const char* unknown = "unknown";
+  if ((int)id >= 0 && (int)id < bl_n_kats_) {
+    return kat_desc[id].name;
+  }
+  return unknown;
 }
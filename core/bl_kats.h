@@ -13,6 +13,40 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/// Policies of scheduling of known answer tests
+typedef enum bl_kat_policy_t {
+  /// All KATs are run before each upgrade
+  bl_kat_policy_always = 0,
+  /// KATs are run once per version of the Bootloader, the result is kept in a
+  /// CRC-protected record in non-volatile memory
+  bl_kat_policy_once_per_version,
+  /// KATs are run one by one while the upgrade file is read and completed
+  /// before any cryptographic function is used
+  bl_kat_policy_overlapped
+} bl_kat_policy_t;
+
+#ifndef BL_KAT_POLICY
+/// Policy of scheduling of KATs selected at build time
+#define BL_KAT_POLICY bl_kat_policy_always
+#endif
+
+/// Known answer tests
+typedef enum bl_kat_id_t {
+  bl_kat_sha256 = 0,  ///< SHA-256 hash function
+  bl_kat_secp256k1,   ///< ECDSA with secp256k1 curve
+  bl_kat_schnorr,     ///< BIP-340 Schnorr batch verification, on demand
+  bl_kat_musig,       ///< MuSig2 key aggregation, on demand
+  bl_n_kats_          ///< Number of KATs, not a valid identifier
+} bl_kat_id_t;
+
+/// States of a known answer test
+typedef enum bl_kat_state_t {
+  bl_kat_pending = 0,  ///< Not run yet
+  bl_kat_passed,       ///< Passed
+  bl_kat_failed,       ///< Failed
+  bl_kat_skipped       ///< Skipped, passed earlier by the same version
+} bl_kat_state_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,6 +58,84 @@ extern "C" {
  */
 bool bl_run_kats(void);
 
+/**
+ * Schedules known answer tests according to a policy
+ *
+ * Only KATs of functions used by every upgrade are scheduled. KATs of
+ * functions used by a single signature algorithm are run on demand by
+ * bl_kats_run_for_algorithm().
+ *
+ * With bl_kat_policy_always all KATs are run immediately. With
+ * bl_kat_policy_once_per_version KATs are skipped if the record in
+ * non-volatile memory shows that the same version of the Bootloader has
+ * passed them. Otherwise they are run immediately, and the record is written
+ * if all of them pass. If the version is not available, or the platform has
+ * no non-volatile record, this policy works like bl_kat_policy_always. With
+ * bl_kat_policy_overlapped no KAT is run here, they are run by
+ * bl_kats_step() and bl_kats_complete().
+ *
+ * @param policy      policy of scheduling of KATs
+ * @param bl_version  version of the running Bootloader, or BL_VERSION_NA
+ * @return            false if some KAT has failed
+ */
+bool bl_kats_begin(bl_kat_policy_t policy, uint32_t bl_version);
+
+/**
+ * Runs the next pending known answer test, if any
+ *
+ * KATs use buffers of the signature module, so this function must not be
+ * called while a Signature section is being verified.
+ *
+ * @return  false if some KAT has failed
+ */
+bool bl_kats_step(void);
+
+/**
+ * Runs all pending known answer tests
+ *
+ * This function must return true before any cryptographic function is used.
+ *
+ * @return  true if all KATs have passed or were skipped
+ */
+bool bl_kats_complete(void);
+
+/**
+ * Runs pending known answer tests required by a signature algorithm
+ *
+ * These KATs are run regardless of the scheduling policy, and only when an
+ * upgrade file is signed with the algorithm needing them. Like
+ * bl_kats_step(), this function must not be called while a Signature section
+ * is being verified.
+ *
+ * @param algorithm  string, identifying signature algorithm
+ * @return           false if some KAT required by the algorithm has failed
+ */
+bool bl_kats_run_for_algorithm(const char* algorithm);
+
+/**
+ * Returns state of a known answer test
+ *
+ * @param id  identifier of KAT
+ * @return    state of KAT
+ */
+bl_kat_state_t bl_kat_get_state(bl_kat_id_t id);
+
+/**
+ * Returns time spent in a known answer test
+ *
+ * @param id  identifier of KAT
+ * @return    duration in microseconds, 0 if not run or not measured
+ */
+uint32_t bl_kat_get_time_us(bl_kat_id_t id);
+
+/**
+ * Returns name of a known answer test
+ *
+ * @param id  identifier of KAT
+ * @return    name of KAT, like "SHA-256"
+ */
+const char* bl_kat_name(bl_kat_id_t id);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,88 @@
+/**
+ * @file       bl_lzss.c
+ * @brief      Streaming LZSS decoder for compressed Payload sections
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * WARNING: This code is not expected to be thread-safe, as Bootloader always
+ * runs non-concurrently!
+ */
+
+#include <string.h>
+#include "bl_lzss.h"
+
+/// Mask selecting position within the window
+#define WINDOW_MASK (BL_LZSS_WINDOW_SIZE - 1U)
+
+void bl_lzss_init(bl_lzss_t* p_state) {
+  if (p_state) {
+    memset(p_state, 0, sizeof(bl_lzss_t));
+  }
+}
+
+bool bl_lzss_is_idle(const bl_lzss_t* p_state) {
+  return p_state && !p_state->match_rm && !p_state->token_len;
+}
+
+/**
+ * Outputs one decoded byte, storing it in the window
+ *
+ * @param p_state  pointer to state of the decoder
+ * @param out      output buffer
+ * @param p_pos    pointer to position in the output buffer
+ * @param byte     decoded byte
+ */
+static inline void put_byte(bl_lzss_t* p_state, uint8_t* out, size_t* p_pos,
+                            uint8_t byte) {
+  p_state->window[p_state->out_total & WINDOW_MASK] = byte;
+  ++p_state->out_total;
+  out[(*p_pos)++] = byte;
+}
+
+bool bl_lzss_decode(bl_lzss_t* p_state, const uint8_t* in, size_t* p_in_len,
+                    uint8_t* out, size_t* p_out_len) {
+  if (!p_state || !in || !p_in_len || !out || !p_out_len) {
+    return false;
+  }
+  size_t in_pos = 0U;
+  size_t out_pos = 0U;
+
+  while (out_pos < *p_out_len) {
+    if (p_state->match_rm) {  // Continue copying the current match
+      uint8_t byte = p_state->window[(p_state->out_total -
+                                      p_state->match_offset) & WINDOW_MASK];
+      put_byte(p_state, out, &out_pos, byte);
+      --p_state->match_rm;
+      continue;
+    }
+    if (in_pos >= *p_in_len) {
+      break;  // Input exhausted
+    }
+    if (!p_state->n_items) {  // Start a new group
+      p_state->flags = in[in_pos++];
+      p_state->n_items = 8U;
+      continue;
+    }
+    if (p_state->flags & 1U) {  // Literal byte
+      put_byte(p_state, out, &out_pos, in[in_pos++]);
+    } else if (!p_state->token_len) {  // The first byte of a match token
+      p_state->token_lo = in[in_pos++];
+      p_state->token_len = 1U;
+      continue;  // Item is not complete
+    } else {  // The second byte of a match token
+      uint32_t token = p_state->token_lo | ((uint32_t)in[in_pos++] << 8);
+      p_state->token_len = 0U;
+      p_state->match_offset = (token & WINDOW_MASK) + 1U;
+      p_state->match_rm = (token >> BL_LZSS_OFFSET_BITS) + BL_LZSS_MIN_MATCH;
+      if (p_state->match_offset > p_state->out_total) {
+        return false;  // Reference before the beginning of the stream
+      }
+    }
+    p_state->flags >>= 1;
+    --p_state->n_items;
+  }
+
+  *p_in_len = in_pos;
+  *p_out_len = out_pos;
+  return true;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file       bl_lzss.h
+ * @brief      Streaming LZSS decoder for compressed Payload sections
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef BL_LZSS_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define BL_LZSS_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/// Identifier of compression algorithm stored in bl_attr_compression
+#define BL_LZSS_ALGORITHM "lzss"
+/// Number of bits coding an offset of a match
+#define BL_LZSS_OFFSET_BITS 11U
+/// Number of bits coding a length of a match
+#define BL_LZSS_LENGTH_BITS 5U
+/// Size of the sliding window in bytes
+#define BL_LZSS_WINDOW_SIZE (1U << BL_LZSS_OFFSET_BITS)
+/// Minimum length of a match
+#define BL_LZSS_MIN_MATCH 3U
+/// Maximum length of a match
+#define BL_LZSS_MAX_MATCH (BL_LZSS_MIN_MATCH + (1U << BL_LZSS_LENGTH_BITS) - 1U)
+
+/**
+ * State of the decoder
+ *
+ * Compressed stream consists of groups, each beginning with a flag byte whose
+ * bits, starting from the least significant one, describe up to 8 following
+ * items: 1 - a literal byte, 0 - a match coded as 16-bit little-endian word
+ * { offset - 1 : BL_LZSS_OFFSET_BITS, length - BL_LZSS_MIN_MATCH :
+ * BL_LZSS_LENGTH_BITS }. Offset is counted back from the current position.
+ */
+typedef struct bl_lzss_t {
+  /// Sliding window holding the last decoded bytes
+  uint8_t window[BL_LZSS_WINDOW_SIZE];
+  /// Total number of decoded bytes
+  uint32_t out_total;
+  /// Flags of the current group, shifted as items are decoded
+  uint8_t flags;
+  /// Number of items remaining in the current group
+  uint8_t n_items;
+  /// Number of bytes of a match token received so far
+  uint8_t token_len;
+  /// The first byte of a match token
+  uint8_t token_lo;
+  /// Offset of the current match
+  uint32_t match_offset;
+  /// Remaining length of the current match
+  uint32_t match_rm;
+} bl_lzss_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initializes the decoder
+ *
+ * @param p_state  pointer to state of the decoder
+ */
+void bl_lzss_init(bl_lzss_t* p_state);
+
+/**
+ * Decodes a part of compressed stream
+ *
+ * Decoding stops when either input is exhausted or the output buffer is full.
+ * This function may be called repeatedly, the state is preserved between
+ * calls.
+ *
+ * @param p_state    pointer to state of the decoder
+ * @param in         buffer with compressed data
+ * @param p_in_len   pointer to variable holding number of bytes in the input
+ *                   buffer, filled with number of consumed bytes on return
+ * @param out        buffer receiving decoded data
+ * @param p_out_len  pointer to variable holding capacity of the output buffer,
+ *                   filled with number of produced bytes on return
+ * @return           true if successful, false if the stream is malformed
+ */
+bool bl_lzss_decode(bl_lzss_t* p_state, const uint8_t* in, size_t* p_in_len,
+                    uint8_t* out, size_t* p_out_len);
+
+/**
+ * Checks if the decoder is between items, i.e. no match is pending
+ *
+ * @param p_state  pointer to state of the decoder
+ * @return         true if the stream may end at the current position
+ */
+bool bl_lzss_is_idle(const bl_lzss_t* p_state);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BL_LZSS_H_INCLUDED
@@ -16,6 +16,8 @@
 #include "sha2.h"
 #include "bl_section.h"
 #include "bl_util.h"
+#include "bl_bufreader.h"
+#include "bl_lzss.h"
 #include "segwit_addr.h"
 
 /// Name used to identify signature section
@@ -27,14 +29,41 @@
 /// Size of statically allocated shared IO buffer
 #define IO_BUF_SIZE 4096U
 #endif
+/// Size of input buffer holding compressed payload
+#define IN_BUF_SIZE 512U
+#ifdef BL_CRC_HASH_BLOCK_SIZE
+/// Size of block passed to CRC and SHA-256 in turn, expected to stay in cache
+#define CRC_HASH_BLOCK_SIZE BL_CRC_HASH_BLOCK_SIZE
+#else
+/// Size of block passed to CRC and SHA-256 in turn, expected to stay in cache
+#define CRC_HASH_BLOCK_SIZE 1024U
+#endif
 
 /// Maximum size of human readable part of signature message (including '\0')
 #define SIG_MSG_HRP_MAX (sizeof("b77.777.777rc77-77.777.777rc77-"))
 
+/// Reader of payload from file, decompressing it if needed
+typedef struct payload_reader_t {
+  /// File with position set to the unread part of payload
+  bl_file_t file;
+  /// Flag indicating that payload is compressed
+  bool compressed;
+  /// Remaining bytes of stored payload not yet read from file
+  uint32_t rm_stored;
+  /// Position of the first unprocessed byte in the input buffer
+  size_t in_pos;
+  /// Number of bytes in the input buffer
+  size_t in_len;
+} payload_reader_t;
+
 /// Statically allocated contex
-static struct {
+static BL_THREAD_LOCAL struct {
   // IO buffer
   uint8_t io_buf[IO_BUF_SIZE];
+  // Input buffer for compressed payload
+  uint8_t in_buf[IN_BUF_SIZE];
+  // State of the decoder
+  bl_lzss_t lzss;
 } ctx;
 
 /**
@@ -122,6 +151,28 @@ BL_STATIC_NO_TEST bool validate_attributes(const uint8_t* attr_list,
   return false;
 }
 
+/**
+ * Validates compression-related attributes of a header
+ *
+ * @param p_hdr  pointer to header with validated attribute list
+ * @return       true if the section is either not compressed or compressed
+ *               using a supported algorithm with valid stored size
+ */
+static bool validate_compression(const bl_section_t* p_hdr) {
+  char algorithm[BL_ATTR_STR_MAX] = "";
+  bl_uint_t stored_size = 0U;
+  bool has_algorithm = blsect_get_attr_str(p_hdr, bl_attr_compression,
+                                           algorithm, sizeof(algorithm));
+  bool has_size =
+      blsect_get_attr_uint(p_hdr, bl_attr_stored_size, &stored_size);
+  if (!has_algorithm && !has_size) {
+    return true;
+  }
+  return has_algorithm && has_size && blsect_is_payload(p_hdr) &&
+         bl_streq(algorithm, BL_LZSS_ALGORITHM) && stored_size &&
+         stored_size <= BL_PAYLOAD_SIZE_MAX;
+}
+
 bool blsect_validate_header(const bl_section_t* p_hdr) {
   if (p_hdr) {
     if (BL_SECT_MAGIC == p_hdr->magic &&
@@ -131,7 +182,8 @@ bool blsect_validate_header(const bl_section_t* p_hdr) {
           validate_section_name(p_hdr->name, sizeof(p_hdr->name)) &&
           p_hdr->pl_ver <= BL_VERSION_MAX && p_hdr->pl_size &&
           p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX &&
-          validate_attributes(p_hdr->attr_list, sizeof(p_hdr->attr_list))) {
+          validate_attributes(p_hdr->attr_list, sizeof(p_hdr->attr_list)) &&
+          validate_compression(p_hdr)) {
         return true;
       }
     }
@@ -147,28 +199,180 @@ bool blsect_validate_payload(const bl_section_t* p_hdr, const uint8_t* pl_buf) {
   return false;
 }
 
-bool blsect_validate_payload_from_file(const bl_section_t* p_hdr,
-                                       bl_file_t file, bl_cbarg_t progr_arg) {
-  if (p_hdr && p_hdr->pl_size && p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX &&
-      file) {
-    size_t rm_bytes = p_hdr->pl_size;
-    uint32_t crc = 0U;
+/**
+ * Initializes reader of payload from file
+ *
+ * @param p_rd   pointer to reader
+ * @param p_hdr  pointer to header, assumed to be valid
+ * @param file   file with position set to beginning of the payload
+ * @return       true if successful
+ */
+static bool reader_init(payload_reader_t* p_rd, const bl_section_t* p_hdr,
+                        bl_file_t file) {
+  memset(p_rd, 0, sizeof(payload_reader_t));
+  p_rd->file = file;
+  p_rd->compressed = blsect_is_compressed(p_hdr);
+  p_rd->rm_stored = blsect_stored_size(p_hdr);
+  if (p_rd->compressed) {
+    bl_lzss_init(&ctx.lzss);
+  }
+  return p_rd->rm_stored != 0U;
+}
 
-    bl_report_progress(progr_arg, p_hdr->pl_size, 0U);
-    while (rm_bytes) {
-      if (blsys_feof(file)) {
+/**
+ * Reads a part of payload, decompressing it if needed
+ *
+ * @param p_rd  pointer to reader
+ * @param buf   buffer receiving payload
+ * @param len   number of bytes to read
+ * @return      true if exactly len bytes are read
+ */
+static bool reader_read(payload_reader_t* p_rd, uint8_t* buf, size_t len) {
+  if (!p_rd->compressed) {
+    if (len > p_rd->rm_stored || blbuf_feof(p_rd->file) ||
+        blbuf_fread(buf, 1U, len, p_rd->file) != len) {
+      return false;
+    }
+    p_rd->rm_stored -= len;
+    return true;
+  }
+
+  size_t out_pos = 0U;
+  while (out_pos < len) {
+    if (p_rd->in_pos >= p_rd->in_len) {  // Refill the input buffer
+      size_t read_len =
+          (p_rd->rm_stored < IN_BUF_SIZE) ? p_rd->rm_stored : IN_BUF_SIZE;
+      if (!read_len || blbuf_feof(p_rd->file) ||
+          blbuf_fread(ctx.in_buf, 1U, read_len, p_rd->file) != read_len) {
         return false;
       }
-      size_t read_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
-      size_t got_len = blsys_fread(ctx.io_buf, 1U, read_len, file);
-      if (got_len != read_len) {
+      p_rd->rm_stored -= read_len;
+      p_rd->in_pos = 0U;
+      p_rd->in_len = read_len;
+    }
+    size_t in_len = p_rd->in_len - p_rd->in_pos;
+    size_t out_len = len - out_pos;
+    if (!bl_lzss_decode(&ctx.lzss, ctx.in_buf + p_rd->in_pos, &in_len,
+                        buf + out_pos, &out_len)) {
+      return false;
+    }
+    p_rd->in_pos += in_len;
+    out_pos += out_len;
+  }
+  return true;
+}
+
+/**
+ * Checks that the whole stored payload is consumed by the reader
+ *
+ * @param p_rd  pointer to reader
+ * @return      true if there is no unread data
+ */
+static bool reader_is_complete(const payload_reader_t* p_rd) {
+  if (p_rd->compressed) {
+    return !p_rd->rm_stored && p_rd->in_pos == p_rd->in_len &&
+           bl_lzss_is_idle(&ctx.lzss);
+  }
+  return !p_rd->rm_stored;
+}
+
+/**
+ * Updates CRC and, optionally, SHA-256 context with a block of data
+ *
+ * Data is passed to both algorithms in turn by blocks small enough to remain
+ * in the data cache, so that it is fetched from memory only once.
+ *
+ * @param crc        initial CRC value
+ * @param p_sha_ctx  pointer to SHA-256 context, or NULL
+ * @param buf        buffer with data
+ * @param len        number of bytes in the buffer
+ * @return           updated CRC value
+ */
+static uint32_t crc_and_hash_update(uint32_t crc, SHA256_CTX* p_sha_ctx,
+                                    const uint8_t* buf, size_t len) {
+  if (!p_sha_ctx) {
+    return crc32_fast(buf, len, crc);
+  }
+  while (len) {
+    size_t blk_len = (len < CRC_HASH_BLOCK_SIZE) ? len : CRC_HASH_BLOCK_SIZE;
+    crc = crc32_fast(buf, blk_len, crc);
+    sha256_Update(p_sha_ctx, buf, blk_len);
+    buf += blk_len;
+    len -= blk_len;
+  }
+  return crc;
+}
+
+/**
+ * Reads payload from file validating it with CRC, and optionally writing it
+ * to flash memory (or comparing with flash memory) and hashing
+ *
+ * @param p_hdr       pointer to header, assumed to be valid
+ * @param file        file with position set to beginning of the payload
+ * @param p_pl_addr   pointer to destination address in flash memory, or NULL
+ *                    if flash memory is not accessed
+ * @param p_wr_plan   pointer to plan used to write flash memory, or NULL if
+ *                    payload is written as is
+ * @param p_cmp_plan  pointer to plan updated comparing payload with flash
+ *                    memory instead of writing it, or NULL
+ * @param p_sha_ctx   pointer to SHA-256 context updated with payload, or NULL
+ * @param p_crc       pointer to variable receiving CRC of payload, or NULL.
+ *                    If provided, CRC is not compared with the header.
+ * @param progr_arg   argument passed to progress callback function
+ * @return            true if the whole payload is processed and CRC is valid
+ */
+static bool process_payload_from_file(const bl_section_t* p_hdr,
+                                      bl_file_t file,
+                                      const bl_addr_t* p_pl_addr,
+                                      const bl_fplan_t* p_wr_plan,
+                                      bl_fplan_t* p_cmp_plan,
+                                      SHA256_CTX* p_sha_ctx, uint32_t* p_crc,
+                                      bl_cbarg_t progr_arg) {
+  payload_reader_t reader;
+  if (!reader_init(&reader, p_hdr, file)) {
+    return false;
+  }
+  size_t rm_bytes = p_hdr->pl_size;
+  bl_addr_t curr_addr = p_pl_addr ? *p_pl_addr : 0U;
+  uint32_t crc = 0U;
+
+  bl_report_progress(progr_arg, p_hdr->pl_size, 0U);
+  while (rm_bytes) {
+    size_t read_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
+    if (!reader_read(&reader, ctx.io_buf, read_len)) {
+      return false;
+    }
+    // Written data is verified by blsys_flash_write(), and data in sectors
+    // skipped by the plan is compared with flash memory. So the buffer holds
+    // exactly what is now stored in flash memory and is hashed as such.
+    if (p_pl_addr) {
+      if (p_cmp_plan
+              ? !bl_fplan_compare(p_cmp_plan, curr_addr, ctx.io_buf, read_len)
+              : !bl_fplan_write(p_wr_plan, curr_addr, ctx.io_buf, read_len)) {
         return false;
       }
-      crc = crc32_fast(ctx.io_buf, read_len, crc);
-      rm_bytes -= read_len;
-      bl_report_progress(progr_arg, p_hdr->pl_size, p_hdr->pl_size - rm_bytes);
     }
-    return crc == p_hdr->pl_crc;
+    crc = crc_and_hash_update(crc, p_sha_ctx, ctx.io_buf, read_len);
+    curr_addr += read_len;
+    rm_bytes -= read_len;
+    bl_report_progress(progr_arg, p_hdr->pl_size, p_hdr->pl_size - rm_bytes);
+  }
+  if (!reader_is_complete(&reader)) {
+    return false;
+  }
+  if (p_crc) {
+    *p_crc = crc;
+    return true;
+  }
+  return crc == p_hdr->pl_crc;
+}
+
+bool blsect_validate_payload_from_file(const bl_section_t* p_hdr,
+                                       bl_file_t file, bl_cbarg_t progr_arg) {
+  if (p_hdr && p_hdr->pl_size && p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX &&
+      file) {
+    return process_payload_from_file(p_hdr, file, NULL, NULL, NULL, NULL, NULL,
+                                     progr_arg);
   }
   return false;
 }
@@ -196,6 +400,27 @@ bool blsect_validate_payload_from_flash(const bl_section_t* p_hdr,
   return false;
 }
 
+bool blsect_is_compressed(const bl_section_t* p_hdr) {
+  if (p_hdr) {
+    char algorithm[BL_ATTR_STR_MAX];
+    return blsect_get_attr_str(p_hdr, bl_attr_compression, algorithm,
+                               sizeof(algorithm));
+  }
+  return false;
+}
+
+uint32_t blsect_stored_size(const bl_section_t* p_hdr) {
+  if (p_hdr) {
+    bl_uint_t stored_size = 0U;
+    if (blsect_is_compressed(p_hdr) &&
+        blsect_get_attr_uint(p_hdr, bl_attr_stored_size, &stored_size)) {
+      return (stored_size <= BL_PAYLOAD_SIZE_MAX) ? (uint32_t)stored_size : 0U;
+    }
+    return p_hdr->pl_size;
+  }
+  return 0U;
+}
+
 bool blsect_is_payload(const bl_section_t* p_hdr) {
   if (p_hdr) {
     return !blsect_is_signature(p_hdr);
@@ -300,6 +525,22 @@ bool blsect_get_attr_str(const bl_section_t* p_hdr, bl_attr_t attr_id,
   return false;
 }
 
+/**
+ * Finalizes SHA-256 calculation and saves the hash of a Payload section
+ *
+ * @param p_context  SHA-256 context updated with the header and the payload
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param p_result   pointer to variable receiving produced hash
+ */
+static void save_hash(SHA256_CTX* p_context, const bl_section_t* p_hdr,
+                      bl_hash_t* p_result) {
+  // Save calculated digest
+  sha256_Final(p_context, p_result->digest);
+  // Save additional information
+  memcpy(p_result->sect_name, p_hdr->name, sizeof(p_result->sect_name));
+  p_result->pl_ver = p_hdr->pl_ver;
+}
+
 bool blsect_hash_over_flash(const bl_section_t* p_hdr, bl_addr_t pl_addr,
                             bl_hash_t* p_result, bl_cbarg_t progr_arg) {
   if (p_hdr && blsect_is_payload(p_hdr) && p_result &&
@@ -324,16 +565,145 @@ bool blsect_hash_over_flash(const bl_section_t* p_hdr, bl_addr_t pl_addr,
       bl_report_progress(progr_arg, p_hdr->pl_size, p_hdr->pl_size - rm_bytes);
     }
 
-    // Save calculated digest
-    sha256_Final(&context, p_result->digest);
-    // Save additional information
-    memcpy(p_result->sect_name, p_hdr->name, sizeof(p_result->sect_name));
-    p_result->pl_ver = p_hdr->pl_ver;
+    save_hash(&context, p_hdr, p_result);
+    return true;
+  }
+  return false;
+}
+
+bool blsect_hash_over_file(const bl_section_t* p_hdr, bl_file_t file,
+                           bl_hash_t* p_result, bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && file && p_result &&
+      sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_hdr->name)) {
+    SHA256_CTX context;
+    sha256_Init(&context);
+    sha256_Update(&context, (const uint8_t*)p_hdr, sizeof(bl_section_t));
+
+    if (process_payload_from_file(p_hdr, file, NULL, NULL, NULL, &context,
+                                  NULL, progr_arg)) {
+      save_hash(&context, p_hdr, p_result);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool blsect_crc_and_hash_over_flash(const bl_section_t* p_hdr,
+                                    bl_addr_t pl_addr, uint32_t* p_crc,
+                                    bl_hash_t* p_result, bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && p_crc && p_result &&
+      sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_hdr->name)) {
+    size_t rm_bytes = p_hdr->pl_size;
+    bl_addr_t curr_addr = pl_addr;
+    uint32_t crc = 0U;
+    SHA256_CTX context;
+    sha256_Init(&context);
+
+    sha256_Update(&context, (const uint8_t*)p_hdr, sizeof(bl_section_t));
+    bl_report_progress(progr_arg, p_hdr->pl_size, 0U);
+    while (rm_bytes) {
+      size_t read_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
+      if (!blsys_flash_read(curr_addr, ctx.io_buf, read_len)) {
+        return false;
+      }
+      crc = crc_and_hash_update(crc, &context, ctx.io_buf, read_len);
+      curr_addr += read_len;
+      rm_bytes -= read_len;
+      bl_report_progress(progr_arg, p_hdr->pl_size, p_hdr->pl_size - rm_bytes);
+    }
+
+    *p_crc = crc;
+    save_hash(&context, p_hdr, p_result);
     return true;
   }
   return false;
 }
 
+bool blsect_crc_and_hash_over_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   uint32_t* p_crc, bl_hash_t* p_result,
+                                   bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && file && p_crc && p_result &&
+      sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_hdr->name)) {
+    SHA256_CTX context;
+    sha256_Init(&context);
+    sha256_Update(&context, (const uint8_t*)p_hdr, sizeof(bl_section_t));
+
+    if (process_payload_from_file(p_hdr, file, NULL, NULL, NULL, &context,
+                                  p_crc, progr_arg)) {
+      save_hash(&context, p_hdr, p_result);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool blsect_plan_payload_from_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   bl_addr_t pl_addr, bl_fplan_t* p_plan,
+                                   bl_addr_t area_end, bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && file && p_plan &&
+      pl_addr <= area_end && p_hdr->pl_size <= area_end - pl_addr) {
+    // The rest of the area is expected to be erased after an upgrade
+    bl_addr_t pl_end = pl_addr + p_hdr->pl_size;
+    return process_payload_from_file(p_hdr, file, &pl_addr, NULL, p_plan,
+                                     NULL, NULL, progr_arg) &&
+           bl_fplan_compare(p_plan, pl_end, NULL, area_end - pl_end);
+  }
+  return false;
+}
+
+bool blsect_plan_and_hash_payload_from_file(const bl_section_t* p_hdr,
+                                            bl_file_t file, bl_addr_t pl_addr,
+                                            bl_fplan_t* p_plan,
+                                            bl_addr_t area_end,
+                                            bl_hash_t* p_result,
+                                            bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && file && p_plan &&
+      pl_addr <= area_end && p_hdr->pl_size <= area_end - pl_addr &&
+      p_result && sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_hdr->name)) {
+    SHA256_CTX context;
+    sha256_Init(&context);
+    sha256_Update(&context, (const uint8_t*)p_hdr, sizeof(bl_section_t));
+
+    bl_addr_t pl_end = pl_addr + p_hdr->pl_size;
+    if (process_payload_from_file(p_hdr, file, &pl_addr, NULL, p_plan,
+                                  &context, NULL, progr_arg) &&
+        bl_fplan_compare(p_plan, pl_end, NULL, area_end - pl_end)) {
+      save_hash(&context, p_hdr, p_result);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool blsect_copy_payload_from_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   bl_addr_t pl_addr, const bl_fplan_t* p_plan,
+                                   bl_hash_t* p_result, bl_cbarg_t progr_arg) {
+  if (p_hdr && blsect_is_payload(p_hdr) && p_hdr->pl_size &&
+      p_hdr->pl_size <= BL_PAYLOAD_SIZE_MAX && file && p_result &&
+      sizeof(p_result->digest) == SHA256_DIGEST_LENGTH &&
+      sizeof(p_result->sect_name) == sizeof(p_hdr->name)) {
+    SHA256_CTX context;
+    sha256_Init(&context);
+    sha256_Update(&context, (const uint8_t*)p_hdr, sizeof(bl_section_t));
+
+    if (process_payload_from_file(p_hdr, file, &pl_addr, p_plan, NULL,
+                                  &context, NULL, progr_arg)) {
+      save_hash(&context, p_hdr, p_result);
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * Returns brief section name
  *
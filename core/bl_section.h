@@ -11,6 +11,7 @@
 
 #include "bl_util.h"
 #include "bl_syscalls.h"
+#include "bl_flash_plan.h"
 /// Magic word, "SECT" in LE
 #define BL_SECT_MAGIC 0x54434553UL
 /// Structure revision
@@ -32,7 +33,11 @@ typedef enum bl_attr_t {
   bl_attr_algorithm = 1,    ///< Digital signature algorithm, string
   bl_attr_base_addr = 2,    ///< Base address of firmware
   bl_attr_entry_point = 3,  ///< Entry point of firmware
-  bl_attr_platform = 4      ///< Platform identifier, string
+  bl_attr_platform = 4,     ///< Platform identifier, string
+  bl_attr_base_version = 5, ///< Version of firmware patched by Delta section
+  bl_attr_delta_block = 6,  ///< Block size used by Delta section
+  bl_attr_compression = 7,  ///< Compression algorithm of payload, string
+  bl_attr_stored_size = 8   ///< Size of compressed payload stored in file
 } bl_attr_t;
 
 /**
@@ -76,6 +81,26 @@ extern "C" {
  */
 bool blsect_validate_header(const bl_section_t* p_hdr);
 
+/**
+ * Checks if payload of the section is stored in compressed form
+ *
+ * Payload size and CRC in the header of a compressed section, as well as its
+ * hash, are always defined over the decompressed payload.
+ *
+ * @param p_hdr  pointer to header, assumed to be valid
+ * @return       true if payload is compressed
+ */
+bool blsect_is_compressed(const bl_section_t* p_hdr);
+
+/**
+ * Returns number of bytes occupied by payload in an upgrade file
+ *
+ * @param p_hdr  pointer to header, assumed to be valid
+ * @return       size of compressed payload if the section is compressed,
+ *               otherwise payload size from the header
+ */
+uint32_t blsect_stored_size(const bl_section_t* p_hdr);
+
 /**
  * Validates payload from memory
  *
@@ -91,7 +116,8 @@ bool blsect_validate_payload(const bl_section_t* p_hdr, const uint8_t* pl_buf);
  * This function expects that given file is open and its position indicator
  * points to the beginning of payload. After successful execution, position
  * indicator will be moved to the end of payload. If the function fails,
- * resulting file position is undefined.
+ * resulting file position is undefined. Compressed payload is decompressed
+ * while being read.
  *
  * @param p_hdr      pointer to header, assumed to be valid
  * @param file       file with position set to beginning of the payload
@@ -163,6 +189,141 @@ bool blsect_get_attr_str(const bl_section_t* p_hdr, bl_attr_t attr_id,
 bool blsect_hash_over_flash(const bl_section_t* p_hdr, bl_addr_t pl_addr,
                             bl_hash_t* p_result, bl_cbarg_t progr_arg);
 
+/**
+ * Calculates hash of a Payload section reading payload from file
+ *
+ * Along with hashing, payload is validated using CRC, so that both operations
+ * need a single pass over the file. This function expects that given file is
+ * open and its position indicator points to the beginning of payload. The
+ * hash is produced only if the CRC of payload is valid. If the function fails,
+ * resulting file position is undefined. Compressed payload is decompressed
+ * while being read.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param file       file with position set to beginning of the payload
+ * @param p_result   pointer to variable receiving produced hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_hash_over_file(const bl_section_t* p_hdr, bl_file_t file,
+                           bl_hash_t* p_result, bl_cbarg_t progr_arg);
+
+/**
+ * Calculates CRC and hash of a Payload section in a single pass over flash
+ *
+ * Each block of payload read from flash memory is passed to CRC and SHA-256
+ * calculation in turn while it is still in cache. The CRC is not compared
+ * with the one stored in the header; it is returned to the caller instead.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param pl_addr    address of payload in flash memory
+ * @param p_crc      pointer to variable receiving CRC of payload
+ * @param p_result   pointer to variable receiving produced hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_crc_and_hash_over_flash(const bl_section_t* p_hdr,
+                                    bl_addr_t pl_addr, uint32_t* p_crc,
+                                    bl_hash_t* p_result, bl_cbarg_t progr_arg);
+
+/**
+ * Calculates CRC and hash of a Payload section in a single pass over file
+ *
+ * Works like blsect_hash_over_file() except that the CRC of (decompressed)
+ * payload is returned to the caller instead of being compared with the one
+ * stored in the header, and the hash is produced regardless of it. This
+ * function expects that given file is open and its position indicator points
+ * to the beginning of payload. If the function fails, resulting file position
+ * is undefined.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param file       file with position set to beginning of the payload
+ * @param p_crc      pointer to variable receiving CRC of payload
+ * @param p_result   pointer to variable receiving produced hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_crc_and_hash_over_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   uint32_t* p_crc, bl_hash_t* p_result,
+                                   bl_cbarg_t progr_arg);
+
+/**
+ * Plans update of flash memory comparing its contents with payload from file
+ *
+ * Payload is read from the file, validated with CRC and compared with flash
+ * memory at the destination address. The rest of the planned area following
+ * the payload is compared with erased state. This function expects that given
+ * file is open and its position indicator points to the beginning of payload.
+ * If the function fails, resulting file position and the plan are undefined.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param file       file with position set to beginning of the payload
+ * @param pl_addr    destination address of payload in flash memory
+ * @param p_plan     pointer to initialized plan, updated on return
+ * @param area_end   end address of the planned area
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_plan_payload_from_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   bl_addr_t pl_addr, bl_fplan_t* p_plan,
+                                   bl_addr_t area_end, bl_cbarg_t progr_arg);
+
+/**
+ * Plans update of flash memory like blsect_plan_payload_from_file(), also
+ * calculating hash of the section in the same pass
+ *
+ * Allows an upgrade file to be verified and compared with flash memory reading
+ * it only once.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param file       file with position set to beginning of the payload
+ * @param pl_addr    destination address of payload in flash memory
+ * @param p_plan     pointer to initialized plan, updated on return
+ * @param area_end   end address of the planned area
+ * @param p_result   pointer to variable receiving produced hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_plan_and_hash_payload_from_file(const bl_section_t* p_hdr,
+                                            bl_file_t file, bl_addr_t pl_addr,
+                                            bl_fplan_t* p_plan,
+                                            bl_addr_t area_end,
+                                            bl_hash_t* p_result,
+                                            bl_cbarg_t progr_arg);
+
+/**
+ * Copies payload from file to flash memory, validating and hashing it on the
+ * fly
+ *
+ * Payload is read from the file only once: each block is used to update the
+ * payload CRC, programmed into flash memory and then added to the hash of the
+ * section. The hash is therefore calculated over the programmed data, relying
+ * on blsys_flash_write() to verify what it writes.
+ *
+ * This function expects that given file is open and its position indicator
+ * points to the beginning of payload, and that the destination area of flash
+ * memory is erased. The hash is produced only if the whole payload is copied
+ * and its CRC is valid. If the function fails, resulting file position and
+ * contents of the destination area are undefined. Compressed payload is
+ * decompressed on the fly, so that decompressed firmware is written and
+ * hashed.
+ *
+ * If a plan is given, only sectors to be rewritten are programmed, and the
+ * payload is compared with contents of all other sectors.
+ *
+ * @param p_hdr      pointer to header, assumed to be valid
+ * @param file       file with position set to beginning of the payload
+ * @param pl_addr    destination address of payload in flash memory
+ * @param p_plan     pointer to plan of flash memory update with erased sectors
+ *                   to be rewritten, or NULL if the destination area is erased
+ * @param p_result   pointer to variable receiving produced hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+bool blsect_copy_payload_from_file(const bl_section_t* p_hdr, bl_file_t file,
+                                   bl_addr_t pl_addr, const bl_fplan_t* p_plan,
+                                   bl_hash_t* p_result, bl_cbarg_t progr_arg);
+
 /**
  * Creates a message to be used with signature algorithm from a set of section
  * hashes
@@ -11,20 +11,124 @@
 #include "sha2.h"
 #include "secp256k1.h"
 #include "secp256k1_preallocated.h"
+#include "secp256k1_schnorr_batch.h"
+#include "secp256k1_musig.h"
+#include "secp256k1_verify_ctx.h"
 #include "bl_syscalls.h"
 #include "bl_signature.h"
 #include "bl_util.h"
+#if BLSIG_PARALLEL_WORKERS > 1
+#include <pthread.h>
+#include <stdlib.h>
+#endif
 
 /// Size of input message of ECDSA algorithm with secp256k1 curve
 #define ECDSA_MESSAGE_SIZE 32U
-/// Digital signature algorithm string: secp256k1-sha256
-#define ALG_SECP256K1_SHA256 "secp256k1-sha256"
 /// "Magic" prefix of Bitcoin message
 #define BITCOIN_SIG_PREFIX \
   ("\x18"                  \
    "Bitcoin Signed Message:\n")
 /// Maximum value of a single-byte integer using variable length encoding
 #define VARINT_MAX_ONE_BYTE 0xFCU
+/// Number of public keys hashed at once when checking fingerprint index
+#define INDEX_CHECK_BATCH 8U
+/// Maximum payload size of a Signature section with an aggregated signature
+#define AGGREGATE_PL_MAX \
+  (sizeof(signature_t) + SECP256K1_MUSIG_MAX_KEYS * sizeof(fingerprint_t))
+
+/// Batch of Schnorr signatures waiting for verification
+typedef struct schnorr_batch_t {
+  /// Scratch space used for multi-scalar multiplication
+  secp256k1_scratch_space* scratch;
+  /// Copies of signatures, the source buffer may be reused while streaming
+  signature_t sig_copies[SECP256K1_SCHNORR_BATCH_MAX];
+  /// Pointers to signatures
+  const uint8_t* sigs[SECP256K1_SCHNORR_BATCH_MAX];
+  /// Pointers to signed messages (digests)
+  const uint8_t* msgs[SECP256K1_SCHNORR_BATCH_MAX];
+  /// Pointers to parsed public keys
+  const secp256k1_pubkey* p_pubkeys[SECP256K1_SCHNORR_BATCH_MAX];
+  /// Number of signatures in the batch
+  size_t n_items;
+} schnorr_batch_t;
+
+/// Signature verification algorithms
+typedef enum sig_algorithm_t {
+  sig_alg_ecdsa = 0,  ///< secp256k1-sha256
+  sig_alg_schnorr,    ///< secp256k1-schnorr-sha256
+  sig_alg_musig       ///< secp256k1-musig2-sha256
+} sig_algorithm_t;
+
+/// State of parsing of a public key in the store
+typedef enum key_parse_state_t {
+  key_not_parsed = 0,  ///< Public key is not parsed yet
+  key_parsed,          ///< Public key is parsed successfully
+  key_invalid          ///< Public key failed to parse
+} key_parse_state_t;
+
+/// Entry of the store of public keys of a key set
+typedef struct key_store_entry_t {
+  fingerprint_t fingerprint;    ///< Fingerprint of the public key
+  const bl_pubkey_t* p_pubkey;  ///< Public key in one of public key lists
+  bool used;  ///< Set when a signature record made with the key is received
+  key_parse_state_t parse_state;  ///< State of parsing of the public key
+  secp256k1_pubkey pubkey;  ///< Parsed public key, valid if key_parsed
+} key_store_entry_t;
+
+/// State of streaming verification of a Signature section
+typedef struct sig_stream_t {
+  /// secp256k1 context object, NULL if no verification is in progress
+  secp256k1_context* verify_ctx;
+  /// Number of valid signatures so far, or one of blsig_error_t constants
+  int32_t result;
+  /// Signature verification algorithm
+  sig_algorithm_t algorithm;
+  /// Set when a signature made with a known key has failed verification
+  bool sig_failed;
+  /// Public keys of the key set in ascending order of fingerprints
+  key_store_entry_t keys[BLSIG_MAX_PUBKEYS];
+  /// Number of public keys in the store
+  size_t n_keys;
+  /// Verified message
+  const uint8_t* message;
+  /// Length of the message in bytes
+  size_t message_len;
+  /// Digest of the message, signed with Schnorr signatures
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  /// Argument passed to progress callback function
+  bl_cbarg_t progr_arg;
+  /// Size of the payload of the Signature section
+  size_t pl_size;
+  /// Number of payload bytes received so far
+  size_t pl_received;
+  /// Beginning of an incomplete record, or the whole payload of a Signature
+  /// section with an aggregated signature
+  uint8_t buf[AGGREGATE_PL_MAX];
+  /// Number of bytes in the buffer
+  size_t buf_len;
+  /// Batch of Schnorr signatures
+  schnorr_batch_t batch;
+} sig_stream_t;
+
+#if BLSIG_PARALLEL_WORKERS > 1
+/// Job of a worker thread, verifying every step-th signature record
+typedef struct verify_job_t {
+  /// State of verification providing keys and message, accessed read-only
+  const sig_stream_t* p_st;
+  /// Signature records
+  const signature_rec_t* sig_recs;
+  /// Total number of signature records
+  uint32_t n_recs;
+  /// Index of the first record verified by the worker
+  uint32_t first;
+  /// Distance between records verified by the worker
+  uint32_t step;
+  /// Number of valid signatures, or one of blsig_error_t constants
+  int32_t result;
+  /// Set when the worker has processed all its records
+  bool completed;
+} verify_job_t;
+#endif
 
 /// Table of error strings
 const char* error_text[] = {
@@ -35,7 +139,14 @@ const char* error_text[] = {
     [-(int) blsig_err_verification_fail] = "Signature verification failed"};
 
 // Buffer used by secp256k1 library to allocate context
-uint8_t blsig_ecdsa_buf[BLSIG_ECDSA_BUF_SIZE];
+BL_THREAD_LOCAL uint8_t blsig_ecdsa_buf[BLSIG_ECDSA_BUF_SIZE];
+// Buffer used as scratch space for batch verification of Schnorr signatures
+BL_THREAD_LOCAL uint64_t
+    blsig_schnorr_scratch_buf[BLSIG_SCHNORR_SCRATCH_SIZE / sizeof(uint64_t)];
+
+/// State of streaming verification of a Signature section
+static BL_THREAD_LOCAL sig_stream_t stream = {.verify_ctx = NULL,
+                                              .result = blsig_err_bad_arg};
 
 /**
  * Tests if two signature records have the same public key fingerprint
@@ -54,93 +165,308 @@ static bool fingerprint_eq(const fingerprint_t* p_fp1,
 }
 
 /**
- * Checks if there are duplicating signatures inside a Signature section
+ * Calculates fingerprint of a public key
  *
- * @param sig_recs  buffer containing signature records
- * @param n_sig     number of signature records
- * @return          true if there is no duplicating signatures
+ * @param p_result  pointer to variable receiving calculated fingerprint
+ * @param p_pubkey  pointer to public key
  */
-BL_STATIC_NO_TEST bool check_duplicating_signatures(
-    const signature_rec_t* sig_recs, uint32_t n_sig) {
-  if (sig_recs && n_sig) {
-    if (n_sig >= 2) {
-      for (uint32_t ref = 0U; ref < n_sig - 1U; ++ref) {
-        for (uint32_t check = ref + 1U; check < n_sig; ++check) {
-          if (fingerprint_eq(&sig_recs[check].fingerprint,
-                             &sig_recs[ref].fingerprint)) {
-            // Duplication: two signatures with the same public key fingerprint
+BL_STATIC_NO_TEST void pubkey_fingerprint(fingerprint_t* p_result,
+                                          const bl_pubkey_t* p_pubkey) {
+  if (sizeof(p_result->bytes) <= SHA256_DIGEST_LENGTH) {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    sha256_Raw(p_pubkey->bytes, sizeof(p_pubkey->bytes), digest);
+    memcpy(p_result->bytes, digest, sizeof(p_result->bytes));
+  } else {
+    blsys_fatal_error(BL_INTERNAL_ERROR);
+  }
+}
+
+/**
+ * Checks if a public key belongs to one of the lists of a key set
+ *
+ * Only pointers are compared, so that no key is hashed.
+ *
+ * @param pubkey_set  NULL-terminated list of pointers to public key lists
+ * @param p_pubkey    pointer to public key
+ * @return            true if the public key is an element of some list
+ */
+static bool pubkey_set_contains(const bl_pubkey_t** pubkey_set,
+                                const bl_pubkey_t* p_pubkey) {
+  if (pubkey_set && p_pubkey) {
+    for (const bl_pubkey_t** p_list = pubkey_set; *p_list; ++p_list) {
+      for (const bl_pubkey_t* p_key = *p_list; !bl_pubkey_is_end_record(p_key);
+           ++p_key) {
+        if (p_key == p_pubkey) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool blsig_check_pubkey_index(const bl_pubkey_t** pubkey_set,
+                              const bl_pubkey_index_t* p_index) {
+  if (pubkey_set && p_index && (p_index->entries || !p_index->n_entries)) {
+    const bl_pubkey_index_entry_t* entries = p_index->entries;
+    size_t n_entries = p_index->n_entries;
+
+    // Count keys in the key set
+    size_t n_keys = 0U;
+    for (const bl_pubkey_t** p_list = pubkey_set; *p_list; ++p_list) {
+      for (const bl_pubkey_t* p_key = *p_list; !bl_pubkey_is_end_record(p_key);
+           ++p_key) {
+        ++n_keys;
+      }
+    }
+    if (n_keys != n_entries) {
+      return false;
+    }
+
+    // Check entries, hashing keys in batches
+    for (size_t base = 0U; base < n_entries; base += INDEX_CHECK_BATCH) {
+      size_t n_batch = n_entries - base;
+      n_batch = n_batch > INDEX_CHECK_BATCH ? INDEX_CHECK_BATCH : n_batch;
+      const uint8_t* keys[INDEX_CHECK_BATCH];
+      size_t key_sizes[INDEX_CHECK_BATCH];
+      uint8_t digests[INDEX_CHECK_BATCH][SHA256_DIGEST_LENGTH];
+
+      for (size_t i = 0U; i < n_batch; ++i) {
+        const bl_pubkey_t* p_key = entries[base + i].p_pubkey;
+        if (!pubkey_set_contains(pubkey_set, p_key)) {
+          return false;
+        }
+        keys[i] = p_key->bytes;
+        key_sizes[i] = sizeof(p_key->bytes);
+      }
+      sha256_RawMulti(keys, key_sizes, n_batch, digests);
+
+      for (size_t i = 0U; i < n_batch; ++i) {
+        size_t idx = base + i;
+        // Fingerprint must be correct and not less than the previous one
+        if (!bl_memeq(entries[idx].fingerprint, digests[i],
+                      BL_PUBKEY_FINGERPRINT_SIZE) ||
+            (idx && memcmp(entries[idx - 1U].fingerprint,
+                           entries[idx].fingerprint,
+                           BL_PUBKEY_FINGERPRINT_SIZE) > 0)) {
+          return false;
+        }
+        // Every key must have exactly one entry. Entries of the same key have
+        // the same fingerprint, so only the preceding run of entries with
+        // equal fingerprints is searched.
+        for (size_t prev = idx; prev-- > 0U &&
+                                bl_memeq(entries[prev].fingerprint,
+                                         entries[idx].fingerprint,
+                                         BL_PUBKEY_FINGERPRINT_SIZE);) {
+          if (entries[prev].p_pubkey == entries[idx].p_pubkey) {
             return false;
           }
         }
       }
     }
-    return true;  // Section is valid, no duplicating signatures found
+    return true;
   }
-  return false;  // To indicate argument error
+  return false;
 }
 
 /**
- * Calculates fingerprint of a public key
+ * Searches for the position of a fingerprint in the store of public keys
  *
- * @param p_result  pointer to variable receiving calculated fingerprint
+ * @param p_st   pointer to state of verification holding the store
+ * @param p_fp   pointer to public key fingerprint
+ * @return       index of the first key having fingerprint not less than the
+ *               given one, or number of keys if there is no such key
+ */
+static size_t key_store_lower_bound(const sig_stream_t* p_st,
+                                    const fingerprint_t* p_fp) {
+  size_t first = 0U;
+  size_t last = p_st->n_keys;
+  while (first < last) {
+    size_t mid = first + (last - first) / 2U;
+    if (memcmp(p_st->keys[mid].fingerprint.bytes, p_fp->bytes,
+               sizeof(p_fp->bytes)) < 0) {
+      first = mid + 1U;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+/**
+ * Searches for a public key in the store by its fingerprint
+ *
+ * @param p_st   pointer to state of verification holding the store
+ * @param p_fp   pointer to public key fingerprint
+ * @return       index of found key, or number of keys if not found
+ */
+static size_t key_store_find(const sig_stream_t* p_st,
+                             const fingerprint_t* p_fp) {
+  size_t idx = key_store_lower_bound(p_st, p_fp);
+  if (idx < p_st->n_keys &&
+      !fingerprint_eq(&p_st->keys[idx].fingerprint, p_fp)) {
+    idx = p_st->n_keys;
+  }
+  return idx;
+}
+
+/**
+ * Adds a public key to the store keeping it sorted by fingerprint
+ *
+ * A key having the same fingerprint as a stored key is the same key present
+ * in another list of the key set, and is not added again.
+ *
+ * @param p_st      pointer to state of verification holding the store
+ * @param p_fp      pointer to fingerprint of the public key
  * @param p_pubkey  pointer to public key
+ * @return          true if successful, false if the store is full
  */
-BL_STATIC_NO_TEST void pubkey_fingerprint(fingerprint_t* p_result,
-                                          const bl_pubkey_t* p_pubkey) {
-  if (sizeof(p_result->bytes) <= SHA256_DIGEST_LENGTH) {
-    uint8_t digest[SHA256_DIGEST_LENGTH];
-    sha256_Raw(p_pubkey->bytes, sizeof(p_pubkey->bytes), digest);
-    memcpy(p_result->bytes, digest, sizeof(p_result->bytes));
-  } else {
-    blsys_fatal_error(BL_INTERNAL_ERROR);
+static bool key_store_add(sig_stream_t* p_st, const fingerprint_t* p_fp,
+                          const bl_pubkey_t* p_pubkey) {
+  size_t idx = key_store_lower_bound(p_st, p_fp);
+  if (idx < p_st->n_keys &&
+      fingerprint_eq(&p_st->keys[idx].fingerprint, p_fp)) {
+    return true;
   }
+  if (p_st->n_keys >= BLSIG_MAX_PUBKEYS) {
+    return false;
+  }
+  memmove(&p_st->keys[idx + 1U], &p_st->keys[idx],
+          (p_st->n_keys - idx) * sizeof(key_store_entry_t));
+  key_store_entry_t* p_entry = &p_st->keys[idx];
+  p_entry->fingerprint = *p_fp;
+  p_entry->p_pubkey = p_pubkey;
+  p_entry->used = false;
+  p_entry->parse_state = key_not_parsed;
+  ++p_st->n_keys;
+  return true;
 }
 
 /**
- * Searches for a public key in the key set (list of lists) by its fingerprint
+ * Builds the store of public keys of a key set used by verification
+ *
+ * Keys are stored once per verification in ascending order of fingerprints,
+ * so that each signature record is looked up with a binary search. If an index
+ * of fingerprints is provided, the store is filled from the index without
+ * hashing keys. Otherwise each key of the key set is hashed once. Keys are
+ * parsed later, on first use, see key_store_pubkey().
  *
- * @param pubkey_set     NULL-terminated list of pointers to public key lists
- * @param p_fingerprint  pointer to public key fingerprint
- * @return               pointer to found public key or NULL if not found
+ * @param pubkey_set  NULL-terminated list of pointers to public key lists
+ * @param p_index     pointer to index of fingerprints covering all keys of the
+ *                    key set, or NULL
+ * @return            true if successful, false if arguments are invalid or
+ *                    the key set has more than BLSIG_MAX_PUBKEYS keys
  */
-BL_STATIC_NO_TEST const bl_pubkey_t* find_pubkey(
-    const bl_pubkey_t** pubkey_set, const fingerprint_t* p_fingerprint) {
-  if (pubkey_set && p_fingerprint) {
-    const bl_pubkey_t** p_list = pubkey_set;
-    while (*p_list != NULL) {
-      const bl_pubkey_t* p_key = *p_list;
-      while (!bl_pubkey_is_end_record(p_key)) {
+BL_STATIC_NO_TEST bool build_key_store(const bl_pubkey_t** pubkey_set,
+                                       const bl_pubkey_index_t* p_index) {
+  stream.n_keys = 0U;
+  if (!pubkey_set || (p_index && !p_index->entries && p_index->n_entries)) {
+    return false;
+  }
+  if (p_index) {
+    for (size_t idx = 0U; idx < p_index->n_entries; ++idx) {
+      const bl_pubkey_index_entry_t* p_entry = &p_index->entries[idx];
+      if (pubkey_set_contains(pubkey_set, p_entry->p_pubkey)) {
         fingerprint_t fp;
-        pubkey_fingerprint(&fp, p_key);
-        if (fingerprint_eq(&fp, p_fingerprint)) {
-          return p_key;
+        memcpy(fp.bytes, p_entry->fingerprint, sizeof(fp.bytes));
+        if (!key_store_add(&stream, &fp, p_entry->p_pubkey)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  for (const bl_pubkey_t** p_list = pubkey_set; *p_list; ++p_list) {
+    for (const bl_pubkey_t* p_key = *p_list; !bl_pubkey_is_end_record(p_key);
+         ++p_key) {
+      fingerprint_t fp;
+      pubkey_fingerprint(&fp, p_key);
+      if (!key_store_add(&stream, &fp, p_key)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks if there are duplicating signatures inside a Signature section
+ *
+ * Records are looked up in the store of public keys built by
+ * build_key_store(), marking found keys as used. A record made with a key
+ * which is already used is a duplication. Records made with unknown keys are
+ * ignored here as in verification, so that the check needs no memory beyond
+ * the store and takes O(n*log(k)) comparisons for n records and k keys.
+ *
+ * @param sig_recs  buffer containing signature records
+ * @param n_sig     number of signature records
+ * @return          true if there is no duplicating signatures
+ */
+BL_STATIC_NO_TEST bool check_duplicating_signatures(
+    const signature_rec_t* sig_recs, uint32_t n_sig) {
+  if (sig_recs && n_sig) {
+    for (uint32_t idx = 0U; idx < n_sig; ++idx) {
+      size_t key = key_store_find(&stream, &sig_recs[idx].fingerprint);
+      if (key < stream.n_keys) {
+        if (stream.keys[key].used) {
+          return false;
         }
-        ++p_key;
+        stream.keys[key].used = true;
       }
-      ++p_list;
+    }
+    return true;  // Section is valid, no duplicating signatures found
+  }
+  return false;  // To indicate argument error
+}
+
+/**
+ * Returns a parsed public key from the store, parsing it on first use
+ *
+ * Parsing of a public key includes a check that the point is on the curve,
+ * which is costly. Each key of the store is parsed at most once per
+ * verification, and the result is kept in the store, including a failure.
+ *
+ * @param verify_ctx  secp256k1 context object
+ * @param p_st        pointer to state of verification holding the store
+ * @param key         index of the key in the store
+ * @return            pointer to parsed public key, or NULL if the key is
+ *                    invalid or arguments are invalid
+ */
+static const secp256k1_pubkey* key_store_pubkey(secp256k1_context* verify_ctx,
+                                                sig_stream_t* p_st,
+                                                size_t key) {
+  if (verify_ctx && p_st && key < p_st->n_keys) {
+    key_store_entry_t* p_entry = &p_st->keys[key];
+    if (key_not_parsed == p_entry->parse_state) {
+      p_entry->parse_state =
+          (1 == secp256k1_ec_pubkey_parse(verify_ctx, &p_entry->pubkey,
+                                          p_entry->p_pubkey->bytes,
+                                          sizeof(p_entry->p_pubkey->bytes)))
+              ? key_parsed
+              : key_invalid;
+    }
+    if (key_parsed == p_entry->parse_state) {
+      return &p_entry->pubkey;
     }
   }
   return NULL;
 }
 
 /**
- * Verifies signature using "secp256k1-sha256" algorithm
+ * Calculates digest of a message with "magic" prefix of Bitcoin message
  *
- * @param verify_ctx   secp256k1 context object, initialized for verification
- * @param p_sig        pointer to signature
- * @param message      message to be verified
+ * The digest is double SHA-256 of the message with a prefix. It is used as
+ * signed 32-byte message by both supported signature algorithms.
+ *
+ * @param message      message to be hashed
  * @param message_len  length of the message in bytes
- * @param p_pubkey     pointer to public key, can be NULL (returning false)
- * @return             true if signature is valid
+ * @param digest       buffer receiving digest, SHA256_DIGEST_LENGTH bytes
+ * @return             true if successful
  */
-BL_STATIC_NO_TEST bool verify_signature(secp256k1_context* verify_ctx,
-                                        const signature_t* p_sig,
-                                        const uint8_t* message,
-                                        size_t message_len,
-                                        const bl_pubkey_t* p_pubkey) {
-  if (verify_ctx && p_sig && message && message_len &&
-      message_len <= VARINT_MAX_ONE_BYTE && p_pubkey &&
-      ECDSA_MESSAGE_SIZE == SHA256_DIGEST_LENGTH) {
+static bool message_digest(const uint8_t* message, size_t message_len,
+                           uint8_t* digest) {
+  if (message && message_len && message_len <= VARINT_MAX_ONE_BYTE &&
+      digest) {
     // Calculate "inside" SHA-256 of the message with a "magic" prefix
     uint8_t len_byte[1] = {(uint8_t)message_len};
     SHA256_CTX context;
@@ -153,40 +479,77 @@ BL_STATIC_NO_TEST bool verify_signature(secp256k1_context* verify_ctx,
     sha256_Final(&context, digest_in);
 
     // Calculate "outside" SHA-256
-    sha256_Init(&context);
-    sha256_Update(&context, digest_in, sizeof(digest_in));
-    uint8_t digest[SHA256_DIGEST_LENGTH];
-    sha256_Final(&context, digest);
+    sha256_Raw(digest_in, sizeof(digest_in), digest);
+    return true;
+  }
+  return false;
+}
 
-    // Parse the public key
-    secp256k1_pubkey pubkey_obj;
-    bool valid = (1 == secp256k1_ec_pubkey_parse(verify_ctx, &pubkey_obj,
-                                                 p_pubkey->bytes,
-                                                 sizeof(p_pubkey->bytes)));
+/**
+ * Verifies a signature of a digest using "secp256k1-sha256" algorithm
+ *
+ * @param verify_ctx  secp256k1 context object, initialized for verification
+ * @param p_sig       pointer to signature
+ * @param digest      signed digest, SHA256_DIGEST_LENGTH bytes
+ * @param p_pubkey    pointer to parsed public key, can be NULL (returning
+ *                    false)
+ * @return            true if signature is valid
+ */
+static bool verify_ecdsa(secp256k1_context* verify_ctx,
+                         const signature_t* p_sig, const uint8_t* digest,
+                         const secp256k1_pubkey* p_pubkey) {
+  if (verify_ctx && p_sig && digest && p_pubkey &&
+      ECDSA_MESSAGE_SIZE == SHA256_DIGEST_LENGTH) {
     // Parse compact signature
     secp256k1_ecdsa_signature sig_obj;
-    valid = valid && (1 == secp256k1_ecdsa_signature_parse_compact(
-                               verify_ctx, &sig_obj, p_sig->bytes));
+    bool valid = (1 == secp256k1_ecdsa_signature_parse_compact(
+                           verify_ctx, &sig_obj, p_sig->bytes));
 
     // Verify the signature
     valid = valid && (1 == secp256k1_ecdsa_verify(verify_ctx, &sig_obj, digest,
-                                                  &pubkey_obj));
+                                                  p_pubkey));
     return valid;
   }
   return false;
 }
 
+/**
+ * Verifies signature using "secp256k1-sha256" algorithm
+ *
+ * @param verify_ctx   secp256k1 context object, initialized for verification
+ * @param p_sig        pointer to signature
+ * @param message      message to be verified
+ * @param message_len  length of the message in bytes
+ * @param p_pubkey     pointer to public key, can be NULL (returning false)
+ * @return             true if signature is valid
+ */
+BL_STATIC_NO_TEST bool verify_signature(secp256k1_context* verify_ctx,
+                                        const signature_t* p_sig,
+                                        const uint8_t* message,
+                                        size_t message_len,
+                                        const bl_pubkey_t* p_pubkey) {
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  if (verify_ctx && p_pubkey && message_digest(message, message_len, digest)) {
+    // Parse the public key
+    secp256k1_pubkey pubkey_obj;
+    return 1 == secp256k1_ec_pubkey_parse(verify_ctx, &pubkey_obj,
+                                          p_pubkey->bytes,
+                                          sizeof(p_pubkey->bytes)) &&
+           verify_ecdsa(verify_ctx, p_sig, digest, &pubkey_obj);
+  }
+  return false;
+}
+
 /**
  * Create a secp256k1 context object initialized for verification
  *
  * @return a newly created context object
  */
 BL_STATIC_NO_TEST secp256k1_context* create_verify_ctx(void) {
-  const unsigned int flags = SECP256K1_CONTEXT_VERIFY;
-  size_t req_size = secp256k1_context_preallocated_size(flags);
+  size_t req_size = secp256k1_verify_context_preallocated_size();
 
   if (req_size <= BLSIG_ECDSA_BUF_SIZE) {
-    return secp256k1_context_preallocated_create(blsig_ecdsa_buf, flags);
+    return secp256k1_verify_context_preallocated_create(blsig_ecdsa_buf);
   }
   return NULL;
 }
@@ -203,77 +566,533 @@ BL_STATIC_NO_TEST void destroy_verify_ctx(secp256k1_context* verify_ctx) {
 }
 
 /**
- * Performs verification of multiple signatures using secp256k1-sha256 algorithm
+ * Verifies all Schnorr signatures collected in a batch and empties the batch
+ *
+ * @param verify_ctx  secp256k1 context object, initialized for verification
+ * @param p_batch     pointer to batch of signatures
+ * @return            true if all signatures are valid or the batch is empty
+ */
+static bool schnorr_batch_verify(secp256k1_context* verify_ctx,
+                                 schnorr_batch_t* p_batch) {
+  if (verify_ctx && p_batch) {
+    size_t n_items = p_batch->n_items;
+    p_batch->n_items = 0U;
+    return 0U == n_items ||
+           1 == secp256k1_schnorr_verify_batch(
+                    verify_ctx, p_batch->scratch, p_batch->sigs,
+                    p_batch->msgs, p_batch->p_pubkeys, n_items);
+  }
+  return false;
+}
+
+/**
+ * Adds a Schnorr signature to a batch, verifying the batch when it is full
+ *
+ * @param verify_ctx     secp256k1 context object, initialized for verification
+ * @param p_batch        pointer to batch of signatures
+ * @param p_sig          pointer to signature
+ * @param digest         signed digest, SHA256_DIGEST_LENGTH bytes, must remain
+ *                       valid until the batch is verified
+ * @param p_pubkey       pointer to parsed public key, must remain valid until
+ *                       the batch is verified, can be NULL (returning false)
+ * @return               true if successful, false if the public key is
+ *                       missing or the full batch fails verification
+ */
+static bool schnorr_batch_add(secp256k1_context* verify_ctx,
+                              schnorr_batch_t* p_batch,
+                              const signature_t* p_sig, const uint8_t* digest,
+                              const secp256k1_pubkey* p_pubkey) {
+  if (verify_ctx && p_batch && p_sig && digest && p_pubkey &&
+      p_batch->n_items < SECP256K1_SCHNORR_BATCH_MAX &&
+      SECP256K1_SCHNORR_MSG_SIZE == SHA256_DIGEST_LENGTH &&
+      SECP256K1_SCHNORR_SIG_SIZE == sizeof(p_sig->bytes)) {
+    size_t item = p_batch->n_items;
+    p_batch->sig_copies[item] = *p_sig;
+    p_batch->sigs[item] = p_batch->sig_copies[item].bytes;
+    p_batch->msgs[item] = digest;
+    p_batch->p_pubkeys[item] = p_pubkey;
+    if (++p_batch->n_items == SECP256K1_SCHNORR_BATCH_MAX) {
+      return schnorr_batch_verify(verify_ctx, p_batch);
+    }
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Processes one signature record of a Signature section
+ *
+ * Records with unknown public keys are skipped. A record made with a key used
+ * by a previous record is a duplication. Otherwise, the signature is verified
+ * or added to the batch of Schnorr signatures. After a signature has failed
+ * verification, remaining records are only checked for duplication, so that
+ * the result does not depend on the order of records.
+ *
+ * @param p_st   pointer to state of streaming verification
+ * @param p_rec  pointer to signature record
+ * @return       number of valid signatures, or a negative number in case of
+ *               error (one of blsig_error_t constants)
+ */
+static int32_t stream_process_record(sig_stream_t* p_st,
+                                     const signature_rec_t* p_rec) {
+  const fingerprint_t* p_fp = &p_rec->fingerprint;
+  size_t key = key_store_find(p_st, p_fp);
+  if (key >= p_st->n_keys) {
+    return p_st->result;  // Signature made with an unknown key is ignored
+  }
+  if (p_st->keys[key].used) {
+    return blsig_err_duplicating_sig;
+  }
+  p_st->keys[key].used = true;
+  if (p_st->sig_failed) {
+    return p_st->result;
+  }
+
+  const secp256k1_pubkey* p_pubkey =
+      key_store_pubkey(p_st->verify_ctx, p_st, key);
+  const signature_t* p_sig = &p_rec->signature;
+  if (sig_alg_schnorr == p_st->algorithm
+          ? schnorr_batch_add(p_st->verify_ctx, &p_st->batch, p_sig,
+                              p_st->digest, p_pubkey)
+          : verify_ecdsa(p_st->verify_ctx, p_sig, p_st->digest, p_pubkey)) {
+    return p_st->result + 1;
+  }
+  p_st->sig_failed = true;
+  return p_st->result;
+}
+
+/**
+ * Processes received payload of a Signature section with signature records
+ *
+ * Records are processed directly from the source buffer, and only a record
+ * split between two calls is collected in the buffer of the stream.
+ *
+ * @param p_st  pointer to state of streaming verification
+ * @param data  pointer to payload data
+ * @param len   length of data in bytes
+ */
+static void stream_process_records(sig_stream_t* p_st, const uint8_t* data,
+                                   size_t len) {
+  const size_t rec_size = sizeof(signature_rec_t);
+  uint32_t n_recs = p_st->pl_size / rec_size;
+
+  while (len && p_st->result >= 0) {
+    const signature_rec_t* p_rec = NULL;
+    if (p_st->buf_len || len < rec_size) {
+      size_t copy_len = rec_size - p_st->buf_len;
+      copy_len = (len < copy_len) ? len : copy_len;
+      memcpy(&p_st->buf[p_st->buf_len], data, copy_len);
+      p_st->buf_len += copy_len;
+      data += copy_len;
+      len -= copy_len;
+      if (rec_size == p_st->buf_len) {
+        p_rec = (const signature_rec_t*)p_st->buf;
+        p_st->buf_len = 0U;
+      }
+    } else {
+      p_rec = (const signature_rec_t*)data;
+      data += rec_size;
+      len -= rec_size;
+    }
+    if (p_rec) {
+      p_st->result = stream_process_record(p_st, p_rec);
+      p_st->pl_received += rec_size;
+      bl_report_progress(p_st->progr_arg, n_recs, p_st->pl_received / rec_size);
+    }
+  }
+}
+
+/**
+ * Verifies an aggregated signature using secp256k1-musig2-sha256 algorithm
+ *
+ * The Signature section contains one BIP-340 signature followed by
+ * fingerprints of all signers in ascending order. Public keys of the signers
+ * are aggregated according to BIP-327 and the signature is verified with the
+ * aggregate key. The cost is one multi-scalar multiplication plus one
+ * signature verification, regardless of the number of signers.
  *
  * @param verify_ctx   secp256k1 context object, initialized for verification
  * @param sig_pl       pointer to contents of Signature section (its payload)
  * @param sig_pl_size  size of the contents of Signature section in bytes
- * @param pubkey_set   NULL-terminated list of pointers to public key lists
+ * @param p_st         pointer to state of verification holding public keys
  * @param message      message used to generate signature
  * @param message_len  length of the message in bytes
  * @param progr_arg    argument passed to progress callback function
- * @return             number of verified signatures, or a negative number in
- *                     case of error (one of blsig_error_t constants)
+ * @return             number of signers, or a negative number in case of error
+ *                     (one of blsig_error_t constants)
  */
-static int32_t blsig_verify_multisig_internal(
+static int32_t blsig_verify_aggregate(
     secp256k1_context* verify_ctx, const uint8_t* sig_pl, size_t sig_pl_size,
-    const bl_pubkey_t** pubkey_set, const uint8_t* message, size_t message_len,
+    sig_stream_t* p_st, const uint8_t* message, size_t message_len,
     bl_cbarg_t progr_arg) {
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+
   // Validate all arguments
-  if (verify_ctx && sig_pl && sig_pl_size >= sizeof(signature_rec_t) &&
-      0U == (sig_pl_size % sizeof(signature_rec_t)) && pubkey_set && message &&
-      message_len) {
-    // Convert payload to signature records
-    const signature_rec_t* sig_recs = (const signature_rec_t*)sig_pl;
-    uint32_t n_sig = sig_pl_size / sizeof(signature_rec_t);
-
-    // Look for duplicating signatures and check record number (paranoid)
-    if (check_duplicating_signatures(sig_recs, n_sig) && n_sig <= INT32_MAX) {
-      int32_t n_valid = 0;                 // Number of valid signatures
-      const bl_pubkey_t* p_pubkey = NULL;  // Pointer to current public key
-
-      // Process all signature records
-      bl_report_progress(progr_arg, n_sig, 0U);
-      for (uint32_t idx = 0U; idx < n_sig; ++idx) {
-        // Search for a public key with a matching fingerprint
-        p_pubkey = find_pubkey(pubkey_set, &sig_recs[idx].fingerprint);
-        if (p_pubkey) {  // If public key is found, verify the signature
-          if (verify_signature(verify_ctx, &sig_recs[idx].signature, message,
-                               message_len, p_pubkey)) {
-            ++n_valid;
-          } else {  // Invalid signature found
-            return blsig_err_verification_fail;
-          }
-        }
-        bl_report_progress(progr_arg, n_sig, idx + 1U);
+  if (verify_ctx && sig_pl && sig_pl_size > sizeof(signature_t) &&
+      0U == ((sig_pl_size - sizeof(signature_t)) % sizeof(fingerprint_t)) &&
+      p_st && message_digest(message, message_len, digest)) {
+    const signature_t* p_sig = (const signature_t*)sig_pl;
+    const fingerprint_t* signers =
+        (const fingerprint_t*)(sig_pl + sizeof(signature_t));
+    size_t n_signers =
+        (sig_pl_size - sizeof(signature_t)) / sizeof(fingerprint_t);
+    if (n_signers > SECP256K1_MUSIG_MAX_KEYS) {
+      return blsig_err_bad_arg;
+    }
+
+    // Fingerprints are sorted, so duplicates can only be neighbours
+    for (size_t idx = 1U; idx < n_signers; ++idx) {
+      int cmp = memcmp(signers[idx - 1U].bytes, signers[idx].bytes,
+                       sizeof(signers[idx].bytes));
+      if (0 == cmp) {
+        return blsig_err_duplicating_sig;
+      } else if (cmp > 0) {
+        return blsig_err_bad_arg;
       }
-      return n_valid;
     }
-    return blsig_err_duplicating_sig;
+
+    // Every signer must be found in the key set
+    const secp256k1_pubkey* p_pubkeys[SECP256K1_MUSIG_MAX_KEYS];
+    bl_report_progress(progr_arg, n_signers + 1U, 0U);
+    for (size_t idx = 0U; idx < n_signers; ++idx) {
+      size_t key = key_store_find(p_st, &signers[idx]);
+      p_pubkeys[idx] = key_store_pubkey(verify_ctx, p_st, key);
+      if (!p_pubkeys[idx]) {
+        return blsig_err_verification_fail;
+      }
+      bl_report_progress(progr_arg, n_signers + 1U, idx + 1U);
+    }
+
+    // Aggregate keys and verify the signature
+    secp256k1_scratch_space* scratch =
+        secp256k1_schnorr_scratch_create_preallocated(
+            blsig_schnorr_scratch_buf, sizeof(blsig_schnorr_scratch_buf));
+    secp256k1_pubkey agg_pubkey;
+    const secp256k1_pubkey* p_agg_pubkey = &agg_pubkey;
+    const uint8_t* p_sig_bytes = p_sig->bytes;
+    const uint8_t* p_digest = digest;
+    if (1 == secp256k1_musig_pubkey_agg(verify_ctx, scratch, &agg_pubkey,
+                                        p_pubkeys, n_signers) &&
+        1 == secp256k1_schnorr_verify_batch(verify_ctx, scratch, &p_sig_bytes,
+                                            &p_digest, &p_agg_pubkey, 1U)) {
+      bl_report_progress(progr_arg, n_signers + 1U, n_signers + 1U);
+      return (int32_t)n_signers;
+    }
+    return blsig_err_verification_fail;
   }
   return blsig_err_bad_arg;
 }
 
+/**
+ * Checks size of the payload of a Signature section
+ *
+ * @param algorithm    signature verification algorithm
+ * @param sig_pl_size  size of the contents of Signature section in bytes
+ * @return             true if size is valid for the algorithm
+ */
+static bool check_payload_size(sig_algorithm_t algorithm, size_t sig_pl_size) {
+  if (sig_alg_musig == algorithm) {
+    return sig_pl_size > sizeof(signature_t) &&
+           sig_pl_size <= AGGREGATE_PL_MAX &&
+           0U == ((sig_pl_size - sizeof(signature_t)) % sizeof(fingerprint_t));
+  }
+  return sig_pl_size >= sizeof(signature_rec_t) &&
+         0U == (sig_pl_size % sizeof(signature_rec_t));
+}
+
+/**
+ * Sets up the state of streaming verification, without verification context
+ *
+ * Verification left incomplete is aborted. Arguments are the same as of
+ * blsig_stream_begin().
+ *
+ * @return  zero if successful, or a negative number in case of error (one of
+ *          blsig_error_t constants)
+ */
+static int32_t stream_setup(const char* algorithm, size_t sig_pl_size,
+                            const bl_pubkey_t** pubkey_set,
+                            const bl_pubkey_index_t* p_index,
+                            const uint8_t* message, size_t message_len,
+                            bl_cbarg_t progr_arg) {
+  // Abort verification left incomplete
+  destroy_verify_ctx(stream.verify_ctx);
+  stream.verify_ctx = NULL;
+  stream.result = blsig_err_bad_arg;
+
+  if (pubkey_set) {
+    if (bl_streq(algorithm, ALG_SECP256K1_SHA256)) {
+      stream.algorithm = sig_alg_ecdsa;
+    } else if (bl_streq(algorithm, ALG_SECP256K1_SCHNORR_SHA256)) {
+      stream.algorithm = sig_alg_schnorr;
+    } else if (bl_streq(algorithm, ALG_SECP256K1_MUSIG2_SHA256)) {
+      stream.algorithm = sig_alg_musig;
+    } else {
+      return stream.result = blsig_err_algo_not_supported;
+    }
+    if (message && message_len &&
+        check_payload_size(stream.algorithm, sig_pl_size) &&
+        message_digest(message, message_len, stream.digest) &&
+        build_key_store(pubkey_set, p_index)) {
+      stream.sig_failed = false;
+      stream.message = message;
+      stream.message_len = message_len;
+      stream.progr_arg = progr_arg;
+      stream.pl_size = sig_pl_size;
+      stream.pl_received = 0U;
+      stream.buf_len = 0U;
+      if (sig_alg_musig != stream.algorithm) {
+        bl_report_progress(progr_arg, sig_pl_size / sizeof(signature_rec_t),
+                           0U);
+      }
+      return stream.result = 0;
+    }
+  }
+  return stream.result;
+}
+
+/**
+ * Creates verification context of the stream after stream_setup()
+ *
+ * @return  zero if successful, or a negative number in case of error (one of
+ *          blsig_error_t constants)
+ */
+static int32_t stream_create_ctx(void) {
+  if (stream.result >= 0) {
+    stream.verify_ctx = create_verify_ctx();
+    if (!stream.verify_ctx) {
+      return stream.result = blsig_err_out_of_memory;
+    }
+    stream.batch.scratch = secp256k1_schnorr_scratch_create_preallocated(
+        blsig_schnorr_scratch_buf, sizeof(blsig_schnorr_scratch_buf));
+    stream.batch.n_items = 0U;
+  }
+  return stream.result;
+}
+
+int32_t blsig_stream_begin(const char* algorithm, size_t sig_pl_size,
+                           const bl_pubkey_t** pubkey_set,
+                           const bl_pubkey_index_t* p_index,
+                           const uint8_t* message, size_t message_len,
+                           bl_cbarg_t progr_arg) {
+  if (stream_setup(algorithm, sig_pl_size, pubkey_set, p_index, message,
+                   message_len, progr_arg) >= 0) {
+    (void)stream_create_ctx();
+  }
+  return stream.result;
+}
+
+bool blsig_stream_update(const uint8_t* data, size_t len) {
+  if (stream.verify_ctx && stream.result >= 0) {
+    if (data && len <= stream.pl_size - stream.pl_received - stream.buf_len) {
+      if (sig_alg_musig == stream.algorithm) {
+        // Payload is small, verified at once when complete
+        memcpy(&stream.buf[stream.buf_len], data, len);
+        stream.buf_len += len;
+      } else {
+        stream_process_records(&stream, data, len);
+      }
+    } else {
+      stream.result = blsig_err_bad_arg;
+    }
+  }
+  return stream.verify_ctx && stream.result >= 0;
+}
+
+int32_t blsig_stream_end(void) {
+  if (stream.verify_ctx) {
+    if (stream.result >= 0) {
+      if (sig_alg_musig == stream.algorithm) {
+        stream.result =
+            (stream.buf_len == stream.pl_size)
+                ? blsig_verify_aggregate(stream.verify_ctx, stream.buf,
+                                         stream.buf_len, &stream,
+                                         stream.message, stream.message_len,
+                                         stream.progr_arg)
+                : blsig_err_bad_arg;
+      } else if (stream.pl_received != stream.pl_size) {
+        stream.result = blsig_err_bad_arg;
+      } else if (stream.sig_failed ||
+                 !schnorr_batch_verify(stream.verify_ctx, &stream.batch)) {
+        // Verify remaining Schnorr signatures
+        stream.result = blsig_err_verification_fail;
+      }
+    }
+    destroy_verify_ctx(stream.verify_ctx);
+    stream.verify_ctx = NULL;
+  }
+  int32_t result = stream.result;
+  stream.result = blsig_err_bad_arg;
+  return result;
+}
+
+#if BLSIG_PARALLEL_WORKERS > 1
+/**
+ * Verifies a part of signature records in a worker thread
+ *
+ * The worker uses its own verification context and scratch space. Public keys
+ * are looked up in the store of the stream, which workers only read, so keys
+ * of all records are parsed before workers are started. Records with unknown
+ * keys are skipped as in sequential verification, and a known key which
+ * failed to parse makes verification fail.
+ *
+ * @param arg  pointer to job of the worker, verify_job_t
+ * @return     always NULL
+ */
+static void* verify_worker(void* arg) {
+  verify_job_t* p_job = (verify_job_t*)arg;
+  const sig_stream_t* p_st = p_job->p_st;
+  bool schnorr = sig_alg_schnorr == p_st->algorithm;
+  void* ctx_buf = malloc(secp256k1_verify_context_preallocated_size());
+  void* scratch_buf = schnorr ? malloc(BLSIG_SCHNORR_SCRATCH_SIZE) : NULL;
+  schnorr_batch_t* p_batch = schnorr ? malloc(sizeof(schnorr_batch_t)) : NULL;
+  secp256k1_context* verify_ctx =
+      ctx_buf ? secp256k1_verify_context_preallocated_create(ctx_buf) : NULL;
+
+  p_job->result = 0;
+  p_job->completed = false;
+  if (verify_ctx && (!schnorr || (scratch_buf && p_batch))) {
+    if (schnorr) {
+      p_batch->scratch = secp256k1_schnorr_scratch_create_preallocated(
+          scratch_buf, BLSIG_SCHNORR_SCRATCH_SIZE);
+      p_batch->n_items = 0U;
+    }
+    for (uint32_t idx = p_job->first;
+         idx < p_job->n_recs && p_job->result >= 0; idx += p_job->step) {
+      const signature_rec_t* p_rec = &p_job->sig_recs[idx];
+      size_t key = key_store_find(p_st, &p_rec->fingerprint);
+      if (key < p_st->n_keys) {
+        const secp256k1_pubkey* p_pubkey =
+            (key_parsed == p_st->keys[key].parse_state)
+                ? &p_st->keys[key].pubkey
+                : NULL;
+        if (schnorr ? schnorr_batch_add(verify_ctx, p_batch, &p_rec->signature,
+                                        p_st->digest, p_pubkey)
+                    : verify_ecdsa(verify_ctx, &p_rec->signature, p_st->digest,
+                                   p_pubkey)) {
+          ++p_job->result;
+        } else {
+          p_job->result = blsig_err_verification_fail;
+        }
+      }
+    }
+    if (schnorr && p_job->result >= 0 &&
+        !schnorr_batch_verify(verify_ctx, p_batch)) {
+      p_job->result = blsig_err_verification_fail;
+    }
+    p_job->completed = true;
+  }
+
+  if (verify_ctx) {
+    secp256k1_context_preallocated_destroy(verify_ctx);
+  }
+  free(p_batch);
+  free(scratch_buf);
+  free(ctx_buf);
+  return NULL;
+}
+
+/**
+ * Verifies signature records using a pool of worker threads
+ *
+ * Records are distributed over workers in round-robin order. Duplicating
+ * records must be rejected beforehand, so that the merged result does not
+ * depend on the order of verification: the number of valid signatures, or
+ * blsig_err_verification_fail if any signature made with a known key is
+ * invalid. The digest of the message is already calculated when verification
+ * begins, so that lazy initialization inside the hash functions does not
+ * happen in workers. Public keys marked as used by the check for duplicating
+ * records are parsed here, using the context of the stream.
+ *
+ * @param p_st      pointer to state of verification, receiving the result
+ * @param sig_recs  signature records
+ * @param n_recs    number of signature records
+ * @return          true if successful, false if workers could not be started
+ *                  and records should be verified sequentially
+ */
+static bool verify_records_parallel(sig_stream_t* p_st,
+                                    const signature_rec_t* sig_recs,
+                                    uint32_t n_recs) {
+  verify_job_t jobs[BLSIG_PARALLEL_WORKERS];
+  pthread_t threads[BLSIG_PARALLEL_WORKERS];
+  uint32_t n_workers = (n_recs < BLSIG_PARALLEL_WORKERS)
+                           ? n_recs
+                           : (uint32_t)BLSIG_PARALLEL_WORKERS;
+  if (n_workers < 2U) {
+    return false;
+  }
+  for (size_t key = 0U; key < p_st->n_keys; ++key) {
+    if (p_st->keys[key].used) {
+      (void)key_store_pubkey(p_st->verify_ctx, p_st, key);
+    }
+  }
+
+  uint32_t n_started = 0U;
+  while (n_started < n_workers) {
+    verify_job_t* p_job = &jobs[n_started];
+    p_job->p_st = p_st;
+    p_job->sig_recs = sig_recs;
+    p_job->n_recs = n_recs;
+    p_job->first = n_started;
+    p_job->step = n_workers;
+    if (0 != pthread_create(&threads[n_started], NULL, verify_worker, p_job)) {
+      break;
+    }
+    ++n_started;
+  }
+
+  bool completed = (n_started == n_workers);
+  int32_t result = 0;
+  for (uint32_t idx = 0U; idx < n_started; ++idx) {
+    pthread_join(threads[idx], NULL);
+    completed = completed && jobs[idx].completed;
+    result = (result < 0 || jobs[idx].result < 0)
+                 ? blsig_err_verification_fail
+                 : result + jobs[idx].result;
+  }
+  if (completed) {
+    p_st->result = result;
+    p_st->pl_received = p_st->pl_size;
+    bl_report_progress(p_st->progr_arg, n_recs, n_recs);
+  }
+  return completed;
+}
+#endif  // BLSIG_PARALLEL_WORKERS > 1
+
 int32_t blsig_verify_multisig(const char* algorithm, const uint8_t* sig_pl,
                               size_t sig_pl_size,
                               const bl_pubkey_t** pubkey_set,
+                              const bl_pubkey_index_t* p_index,
                               const uint8_t* message, size_t message_len,
                               bl_cbarg_t progr_arg) {
-  if (pubkey_set) {
-    if (bl_streq(algorithm, ALG_SECP256K1_SHA256)) {
-      secp256k1_context* verify_ctx = create_verify_ctx();
-      if (verify_ctx) {
-        int32_t result = blsig_verify_multisig_internal(
-            verify_ctx, sig_pl, sig_pl_size, pubkey_set, message, message_len,
-            progr_arg);
-        destroy_verify_ctx(verify_ctx);
-        return result;
+  if (stream_setup(algorithm, sig_pl_size, pubkey_set, p_index, message,
+                   message_len, progr_arg) >= 0 &&
+      stream_create_ctx() >= 0) {
+    if (!sig_pl) {
+      stream.result = blsig_err_bad_arg;
+    } else if (sig_alg_musig != stream.algorithm) {
+      // With all records at hand, look for duplicating records before
+      // verification, so that a duplication is reported even if it follows
+      // an invalid signature, as in streaming verification
+      uint32_t n_sig = sig_pl_size / sizeof(signature_rec_t);
+      if (!check_duplicating_signatures(
+                     (const signature_rec_t*)sig_pl, n_sig)) {
+        stream.result = blsig_err_duplicating_sig;
+      }
+#if BLSIG_PARALLEL_WORKERS > 1
+      if (stream.result >= 0 &&
+          verify_records_parallel(&stream, (const signature_rec_t*)sig_pl,
+                                  n_sig)) {
+        return blsig_stream_end();
+      }
+#endif
+      // Keys are marked as used once again by sequential verification
+      for (size_t key = 0U; key < stream.n_keys; ++key) {
+        stream.keys[key].used = false;
       }
-      return blsig_err_out_of_memory;
     }
-    return blsig_err_algo_not_supported;
+    (void)blsig_stream_update(sig_pl, sig_pl_size);
   }
-  return blsig_err_bad_arg;
+  return blsig_stream_end();
 }
 
 const char* blsig_error_text(int32_t err_code) {
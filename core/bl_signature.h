@@ -16,14 +16,44 @@
 
 /// Size of a secp256k1 uncompressed public key
 #define BL_PUBKEY_SIZE 65U
+/// Size of a public key fingerprint: first bytes of SHA-256 of the key
+#define BL_PUBKEY_FINGERPRINT_SIZE 16U
 /// Prefix of a secp256k1 uncompressed public key
 #define BL_PUBKEY_PREFIX 0x04U
 /// Prefix for an "end of list" record
 #define BL_PUBKEY_EOL_PREFIX 0x00U
 /// Terminating record of a public key list
 #define BL_PUBKEY_END_OF_LIST ((bl_pubkey_t){.bytes = {BL_PUBKEY_EOL_PREFIX}})
+#ifndef BL_ECMULT_WINDOW_SIZE
+/// Window size used by libsecp256k1 for multiplication of the generator
+#define BL_ECMULT_WINDOW_SIZE 4
+#endif
+#ifdef BL_ECMULT_STATIC_TABLES
 /// Size of the buffer to be used to store ECC context
-#define BLSIG_ECDSA_BUF_SIZE 480U
+#define BLSIG_ECDSA_BUF_SIZE 224U
+#else
+/// Size of the buffer to be used to store ECC context, including the table of
+/// 2^(window - 2) multiples of the generator, 64 bytes each
+#define BLSIG_ECDSA_BUF_SIZE (224U + (64U << (BL_ECMULT_WINDOW_SIZE - 2)))
+#endif
+/// Digital signature algorithm string: secp256k1-sha256
+#define ALG_SECP256K1_SHA256 "secp256k1-sha256"
+/// Digital signature algorithm string: secp256k1-schnorr-sha256 (BIP-340)
+#define ALG_SECP256K1_SCHNORR_SHA256 "secp256k1-schnorr-sha256"
+/// Digital signature algorithm string: secp256k1-musig2-sha256 (BIP-327)
+#define ALG_SECP256K1_MUSIG2_SHA256 "secp256k1-musig2-sha256"
+/// Size of scratch space for batch verification of Schnorr signatures
+#define BLSIG_SCHNORR_SCRATCH_SIZE 16384U
+#ifndef BLSIG_MAX_PUBKEYS
+/// Maximum number of distinct public keys in a key set passed to verification
+/// functions. May be redefined at build time.
+#define BLSIG_MAX_PUBKEYS 32U
+#endif
+#ifndef BLSIG_PARALLEL_WORKERS
+/// Number of threads verifying signature records in blsig_verify_multisig().
+/// Values above 1 are only supported by hosted builds with POSIX threads.
+#define BLSIG_PARALLEL_WORKERS 0U
+#endif
 
 /// Error codes returned by blsig_verify_multisig()
 typedef enum blsig_error_t {
@@ -45,13 +75,31 @@ typedef struct BL_ATTRS((packed)) bl_pubkey_t {
   uint8_t bytes[BL_PUBKEY_SIZE];
 } bl_pubkey_t;
 
+/// Entry of a public key fingerprint index
+typedef struct bl_pubkey_index_entry_t {
+  /// Fingerprint of the public key
+  uint8_t fingerprint[BL_PUBKEY_FINGERPRINT_SIZE];
+  /// Pointer to the public key, located in one of public key lists
+  const bl_pubkey_t* p_pubkey;
+} bl_pubkey_index_entry_t;
+
+/// Index of public key fingerprints, sorted in ascending order of fingerprints.
+/// A key present in several public key lists has an entry for each list, so
+/// the same fingerprint may appear several times in a row.
+typedef struct bl_pubkey_index_t {
+  /// Array of index entries
+  const bl_pubkey_index_entry_t* entries;
+  /// Number of index entries
+  size_t n_entries;
+} bl_pubkey_index_t;
+
 // The following types are private and defined only in implementation of
 // signature module and in unit tests.
 #ifdef BLSIG_DEFINE_PRIVATE_TYPES
 
 /// Public key fingerprint
 typedef struct BL_ATTRS((packed)) fingerprint_t {
-  uint8_t bytes[16];  ///< Fingerprint bytes
+  uint8_t bytes[BL_PUBKEY_FINGERPRINT_SIZE];  ///< Fingerprint bytes
 } fingerprint_t;
 
 /// Signature: 64-byte compact signature
@@ -94,9 +142,40 @@ extern "C" {
  * const bl_pubkey_t* pubkeys_main[] = { vendor_keys, maintainer_keys, NULL };
  * \endcode
  *
+ * Supported algorithms are "secp256k1-sha256" (ECDSA) and
+ * "secp256k1-schnorr-sha256" (BIP-340 Schnorr). Schnorr signatures are
+ * verified in batches, using one multi-scalar multiplication for several
+ * signatures. Both algorithms sign the same digest of the message and use the
+ * same public keys.
+ *
+ * With "secp256k1-musig2-sha256" algorithm the Signature section contains a
+ * single BIP-340 signature made jointly by several signers using MuSig2
+ * (BIP-327), followed by fingerprints of the signers in ascending order. The
+ * public keys of the signers are aggregated and the signature is verified
+ * once. All signers must be found in the key set, and the returned number of
+ * verified signatures is the number of signers.
+ *
+ * At the beginning of each call, keys of the key set are placed in a store
+ * sorted by fingerprint, holding up to BLSIG_MAX_PUBKEYS keys, and signature
+ * records are looked up in this store with a binary search. If an index of
+ * fingerprints is provided, the store is taken from the index. The index
+ * should be validated once with blsig_check_pubkey_index() before use. Without
+ * an index every key in the key set is hashed once. A key is parsed when a
+ * record made with it is verified, and the parsed key is kept in the store
+ * until the end of the call, so nothing is retained between calls.
+ *
  * Before the signature verification the function checks that there is no
- * duplicating records in the Signature section. If a duplication is detected,
- * the function fails returning blsig_err_duplicating_sig.
+ * duplicating records in the Signature section, that is no two records made
+ * with the same known key. If a duplication is detected, the function fails
+ * returning blsig_err_duplicating_sig, even if some signature is invalid.
+ * Records made with unknown keys are ignored.
+ *
+ * When built with BLSIG_PARALLEL_WORKERS above 1, signature records are
+ * distributed over worker threads, each having its own verification context,
+ * and the results are merged so that the returned value is the same as with
+ * sequential verification. Progress is then reported only at the beginning
+ * and at the end. Keys referenced by records are parsed before the workers
+ * start, and workers only read the store.
  *
  * In case this function fails for some reason it returns a negative number
  * equal to one of blsig_error_t constants. To convert error code into a text
@@ -106,6 +185,8 @@ extern "C" {
  * @param sig_pl       pointer to contents of Signature section (its payload)
  * @param sig_pl_size  size of the contents of Signature section in bytes
  * @param pubkey_set   NULL-terminated list of pointers to public key lists
+ * @param p_index      pointer to index of fingerprints covering all keys of
+ *                     the key set (may include other keys), or NULL
  * @param message      message used to generate signature
  * @param message_len  length of the message in bytes
  * @param progr_arg    argument passed to progress callback function
@@ -115,9 +196,78 @@ extern "C" {
 int32_t blsig_verify_multisig(const char* algorithm, const uint8_t* sig_pl,
                               size_t sig_pl_size,
                               const bl_pubkey_t** pubkey_set,
+                              const bl_pubkey_index_t* p_index,
                               const uint8_t* message, size_t message_len,
                               bl_cbarg_t progr_arg);
 
+/**
+ * Begins streaming verification of a Signature section
+ *
+ * Streaming verification is an alternative to blsig_verify_multisig() for
+ * a Signature section that is not loaded in memory. The payload is passed
+ * to blsig_stream_update() in chunks of any size, and the result is obtained
+ * with blsig_stream_end(), which must be called to complete verification in
+ * any case. Signature records are verified as they arrive, and known keys are
+ * marked as used in the store of public keys to detect duplicating records,
+ * so that the number of records is not limited. Only one verification may be
+ * in progress at a time, calling this function again aborts the previous one.
+ *
+ * The result is the same as of blsig_verify_multisig() for the same input.
+ * After a signature has failed verification, remaining records are still
+ * checked for duplication, and a duplication takes precedence over the
+ * verification failure. Records with unknown keys are ignored.
+ *
+ * @param algorithm    string, identifying signature algorithm
+ * @param sig_pl_size  size of the contents of Signature section in bytes
+ * @param pubkey_set   NULL-terminated list of pointers to public key lists,
+ *                     must remain valid until blsig_stream_end()
+ * @param p_index      pointer to index of fingerprints, or NULL, must remain
+ *                     valid until blsig_stream_end()
+ * @param message      message used to generate signature, must remain valid
+ *                     until blsig_stream_end()
+ * @param message_len  length of the message in bytes
+ * @param progr_arg    argument passed to progress callback function
+ * @return             0 if successful, or a negative number in case of error
+ *                     (one of blsig_error_t constants)
+ */
+int32_t blsig_stream_begin(const char* algorithm, size_t sig_pl_size,
+                           const bl_pubkey_t** pubkey_set,
+                           const bl_pubkey_index_t* p_index,
+                           const uint8_t* message, size_t message_len,
+                           bl_cbarg_t progr_arg);
+
+/**
+ * Passes a chunk of the payload of a Signature section to verification
+ *
+ * @param data  pointer to payload data
+ * @param len   length of data in bytes
+ * @return      true if successful, false if the section is already rejected
+ */
+bool blsig_stream_update(const uint8_t* data, size_t len);
+
+/**
+ * Completes streaming verification of a Signature section
+ *
+ * @return  number of verified signatures, or a negative number in case of
+ *          error (one of blsig_error_t constants)
+ */
+int32_t blsig_stream_end(void);
+
+/**
+ * Checks that an index of fingerprints matches a key set
+ *
+ * The index is valid if it is sorted by fingerprints, every entry holds a
+ * correct fingerprint of a key from the key set and every key of the key set
+ * has exactly one entry. Each key is hashed once, and entries are compared
+ * only with neighbours having the same fingerprint.
+ *
+ * @param pubkey_set  NULL-terminated list of pointers to public key lists
+ * @param p_index     pointer to index of fingerprints
+ * @return            true if the index matches the key set
+ */
+bool blsig_check_pubkey_index(const bl_pubkey_t** pubkey_set,
+                              const bl_pubkey_index_t* p_index);
+
 /**
  * Returns a text string corresponding to an error code
  *
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdarg.h>
 #ifdef BL_NO_FATFS
 // User provided configuration header for file system definitions
 #include "bl_syscalls_fs.h"
@@ -81,6 +82,67 @@ typedef enum bl_alert_status_t_ {
   bl_alert_nstatuses        ///< Number of alert status items (not a status)
 } bl_alert_status_t;
 
+/**
+ * Table of system calls of one Bootloader instance
+ *
+ * Used when the Bootloader is built with BL_SYSCALLS_VTABLE, allowing several
+ * instances (simulated devices) to run in one process. Each function has the
+ * same meaning as the system call of the same name declared below, receiving
+ * the argument of the context it belongs to as the first parameter. A NULL
+ * function makes the system call fail, fatal_error must never return.
+ */
+typedef struct bl_syscalls_t {
+  const char* (*platform_id)(void* arg);
+  bool (*init)(void* arg);
+  void (*deinit)(void* arg);
+  bool (*flash_map_get_items)(void* arg, int items, va_list ap);
+  bool (*flash_erase)(void* arg, bl_addr_t addr, size_t size);
+  bool (*flash_get_sector)(void* arg, bl_addr_t addr, bl_addr_t* p_sect_addr,
+                           size_t* p_sect_size);
+  bool (*flash_read)(void* arg, bl_addr_t addr, void* buf, size_t len);
+  bool (*flash_write)(void* arg, bl_addr_t addr, const void* buf, size_t len);
+  bool (*flash_crc32)(void* arg, uint32_t* p_crc, bl_addr_t addr, size_t len);
+  bool (*flash_write_protect)(void* arg, bl_addr_t addr, size_t size,
+                              bool enable);
+  bool (*flash_is_write_protected)(void* arg, bl_addr_t addr, size_t size);
+  bool (*flash_read_protect)(void* arg, int level);
+  int (*flash_get_read_protection_level)(void* arg);
+  uint32_t (*media_devices)(void* arg);
+  const char* (*media_name)(void* arg, uint32_t device_idx);
+  bool (*media_check)(void* arg, uint32_t device_idx);
+  bool (*media_mount)(void* arg, uint32_t device_idx);
+  void (*media_umount)(void* arg);
+  const char* (*ffind_first)(void* arg, bl_ffind_ctx_t* ctx, const char* path,
+                             const char* pattern);
+  const char* (*ffind_next)(void* arg, bl_ffind_ctx_t* ctx);
+  void (*ffind_close)(void* arg, bl_ffind_ctx_t* ctx);
+  bl_file_t (*fopen)(void* arg, bl_file_obj_t* p_file_obj,
+                     const char* filename, const char* mode);
+  size_t (*fread)(void* arg, void* ptr, size_t size, size_t count,
+                  bl_file_t file);
+  bl_foffset_t (*ftell)(void* arg, bl_file_t file);
+  int (*fseek)(void* arg, bl_file_t file, bl_foffset_t offset, int origin);
+  bl_fsize_t (*fsize)(void* arg, bl_file_t file);
+  int (*feof)(void* arg, bl_file_t file);
+  int (*fclose)(void* arg, bl_file_t file);
+  void (*fatal_error)(void* arg, const char* text);
+  bl_alert_status_t (*alert)(void* arg, blsys_alert_type_t type,
+                             const char* caption, const char* text,
+                             uint32_t time_ms, uint32_t flags);
+  void (*progress)(void* arg, const char* caption, const char* operation,
+                   uint32_t percent_x100);
+  uint32_t (*time_us)(void* arg);
+  bool (*nvrec_read)(void* arg, void* buf, size_t len);
+  bool (*nvrec_write)(void* arg, const void* buf, size_t len);
+  bool (*start_firmware)(void* arg, bl_addr_t start_addr, uint32_t argument);
+} bl_syscalls_t;
+
+/// Context of system calls: a table of functions and their argument
+typedef struct bl_sysctx_t {
+  const bl_syscalls_t* p_calls;  ///< Table of system calls
+  void* arg;                     ///< Argument passed to system calls
+} bl_sysctx_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -140,6 +202,23 @@ bool blsys_flash_map_get_items(int items, ...);
  */
 bool blsys_flash_erase(bl_addr_t addr, size_t size);
 
+/**
+ * Returns geometry of a flash memory sector containing given address
+ *
+ * A sector is the smallest unit of flash memory which can be erased. The
+ * Bootloader enumerates sectors of an area calling this function with the
+ * address following the previous sector. Platforms not implementing this
+ * function have all firmware areas erased and programmed as a whole.
+ *
+ * @param addr         address within flash memory
+ * @param p_sect_addr  pointer to variable receiving start address of the sector
+ * @param p_sect_size  pointer to variable receiving size of the sector
+ * @return             true if successful, false if the address is invalid or
+ *                     sector geometry is not available
+ */
+bool blsys_flash_get_sector(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                            size_t* p_sect_size);
+
 /**
  * Reads a block of data from flash memory
  *
@@ -153,6 +232,10 @@ bool blsys_flash_read(bl_addr_t addr, void* buf, size_t len);
 /**
  * Writes a block of data to flash memory
  *
+ * Implementation should verify written data, returning false if contents of
+ * flash memory differ from the source buffer. The Bootloader relies on this
+ * when hashing firmware as it is being written.
+ *
  * @param addr  destination address in flash memory
  * @param buf   buffer containing data to write
  * @param len   number of bytes to write
@@ -189,6 +272,16 @@ bool blsys_flash_crc32(uint32_t* p_crc, bl_addr_t addr, size_t len);
  */
 bool blsys_flash_write_protect(bl_addr_t addr, size_t size, bool enable);
 
+/**
+ * Checks if an area of flash memory is write-protected
+ *
+ * @param addr  starting address of the area
+ * @param size  size of the area
+ * @return      true if every sector of the area is write-protected, false if
+ *              not or if the state is not available
+ */
+bool blsys_flash_is_write_protected(bl_addr_t addr, size_t size);
+
 /**
  * Enables read protection for the whole chip
  *
@@ -388,6 +481,39 @@ bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
 void blsys_progress(const char* caption, const char* operation,
                     uint32_t percent_x100);
 
+/**
+ * Returns a free-running time counter in microseconds
+ *
+ * The counter is used to measure durations of short operations with unsigned
+ * subtraction, it may wrap around and does not need to start from zero. The
+ * counter must wrap at 2^32 us, so that any duration shorter than about 71
+ * minutes is measured correctly.
+ *
+ * @return  current value of the counter, or 0 if not supported
+ */
+uint32_t blsys_time_us(void);
+
+/**
+ * Reads a small record kept in non-volatile memory by the platform
+ *
+ * The record is stored outside of the flash memory sections managed by the
+ * Bootloader, and its contents are validated by the caller.
+ *
+ * @param buf  buffer receiving the record
+ * @param len  size of the record in bytes
+ * @return     true if a record of given size is read
+ */
+bool blsys_nvrec_read(void* buf, size_t len);
+
+/**
+ * Writes a small record to non-volatile memory of the platform
+ *
+ * @param buf  pointer to the record
+ * @param len  size of the record in bytes
+ * @return     true if successful, false if not supported
+ */
+bool blsys_nvrec_write(const void* buf, size_t len);
+
 /**
  * Starts the firmware from given address in the flash memory
  *
@@ -398,6 +524,21 @@ void blsys_progress(const char* caption, const char* operation,
  */
 bool blsys_start_firmware(bl_addr_t start_addr, uint32_t argument);
 
+#ifdef BL_SYSCALLS_VTABLE
+/**
+ * Binds a context of system calls to the calling thread
+ *
+ * All system calls made by the thread are forwarded to the table of the bound
+ * context, so that threads running different Bootloader instances do not
+ * interfere.
+ *
+ * @param p_ctx  pointer to the context, NULL to unbind; the context must stay
+ *               valid while it is bound
+ * @return       previously bound context, or NULL
+ */
+const bl_sysctx_t* blsys_bind(const bl_sysctx_t* p_ctx);
+#endif  // BL_SYSCALLS_VTABLE
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
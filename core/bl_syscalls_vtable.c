@@ -0,0 +1,246 @@
+/**
+ * @file       bl_syscalls_vtable.c
+ * @brief      System calls forwarded to a table bound to the calling thread
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifdef BL_SYSCALLS_VTABLE
+
+#include <stdlib.h>
+#include "bl_util.h"
+#include "bl_syscalls.h"
+
+/// Context of system calls bound to the calling thread
+static BL_THREAD_LOCAL const bl_sysctx_t* bound_ctx = NULL;
+
+/**
+ * Returns table of system calls bound to the calling thread
+ *
+ * @return  table of system calls, or NULL if not bound
+ */
+static inline const bl_syscalls_t* calls(void) {
+  return bound_ctx ? bound_ctx->p_calls : NULL;
+}
+
+/**
+ * Returns argument of the context bound to the calling thread
+ *
+ * @return  argument passed to system calls
+ */
+static inline void* arg(void) { return bound_ctx->arg; }
+
+const bl_sysctx_t* blsys_bind(const bl_sysctx_t* p_ctx) {
+  const bl_sysctx_t* p_prev = bound_ctx;
+  bound_ctx = p_ctx;
+  return p_prev;
+}
+
+const char* blsys_platform_id(void) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->platform_id) ? p->platform_id(arg()) : "unknown";
+}
+
+bool blsys_init(void) {
+  const bl_syscalls_t* p = calls();
+  return p && p->init && p->init(arg());
+}
+
+void blsys_deinit(void) {
+  const bl_syscalls_t* p = calls();
+  if (p && p->deinit) {
+    p->deinit(arg());
+  }
+}
+
+bool blsys_flash_map_get_items(int items, ...) {
+  const bl_syscalls_t* p = calls();
+  bool ok = false;
+  if (p && p->flash_map_get_items) {
+    va_list ap;
+    va_start(ap, items);
+    ok = p->flash_map_get_items(arg(), items, ap);
+    va_end(ap);
+  }
+  return ok;
+}
+
+bool blsys_flash_erase(bl_addr_t addr, size_t size) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_erase && p->flash_erase(arg(), addr, size);
+}
+
+bool blsys_flash_get_sector(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                            size_t* p_sect_size) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_get_sector &&
+         p->flash_get_sector(arg(), addr, p_sect_addr, p_sect_size);
+}
+
+bool blsys_flash_read(bl_addr_t addr, void* buf, size_t len) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_read && p->flash_read(arg(), addr, buf, len);
+}
+
+bool blsys_flash_write(bl_addr_t addr, const void* buf, size_t len) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_write && p->flash_write(arg(), addr, buf, len);
+}
+
+bool blsys_flash_crc32(uint32_t* p_crc, bl_addr_t addr, size_t len) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_crc32 && p->flash_crc32(arg(), p_crc, addr, len);
+}
+
+bool blsys_flash_write_protect(bl_addr_t addr, size_t size, bool enable) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_write_protect &&
+         p->flash_write_protect(arg(), addr, size, enable);
+}
+
+bool blsys_flash_is_write_protected(bl_addr_t addr, size_t size) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_is_write_protected &&
+         p->flash_is_write_protected(arg(), addr, size);
+}
+
+bool blsys_flash_read_protect(int level) {
+  const bl_syscalls_t* p = calls();
+  return p && p->flash_read_protect && p->flash_read_protect(arg(), level);
+}
+
+int blsys_flash_get_read_protection_level(void) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->flash_get_read_protection_level)
+             ? p->flash_get_read_protection_level(arg())
+             : -1;
+}
+
+uint32_t blsys_media_devices(void) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->media_devices) ? p->media_devices(arg()) : 0U;
+}
+
+const char* blsys_media_name(uint32_t device_idx) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->media_name) ? p->media_name(arg(), device_idx) : NULL;
+}
+
+bool blsys_media_check(uint32_t device_idx) {
+  const bl_syscalls_t* p = calls();
+  return p && p->media_check && p->media_check(arg(), device_idx);
+}
+
+bool blsys_media_mount(uint32_t device_idx) {
+  const bl_syscalls_t* p = calls();
+  return p && p->media_mount && p->media_mount(arg(), device_idx);
+}
+
+void blsys_media_umount(void) {
+  const bl_syscalls_t* p = calls();
+  if (p && p->media_umount) {
+    p->media_umount(arg());
+  }
+}
+
+const char* blsys_ffind_first(bl_ffind_ctx_t* ctx, const char* path,
+                              const char* pattern) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->ffind_first) ? p->ffind_first(arg(), ctx, path, pattern)
+                               : NULL;
+}
+
+const char* blsys_ffind_next(bl_ffind_ctx_t* ctx) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->ffind_next) ? p->ffind_next(arg(), ctx) : NULL;
+}
+
+void blsys_ffind_close(bl_ffind_ctx_t* ctx) {
+  const bl_syscalls_t* p = calls();
+  if (p && p->ffind_close) {
+    p->ffind_close(arg(), ctx);
+  }
+}
+
+bl_file_t blsys_fopen(bl_file_obj_t* p_file_obj, const char* filename,
+                      const char* mode) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->fopen) ? p->fopen(arg(), p_file_obj, filename, mode) : NULL;
+}
+
+size_t blsys_fread(void* ptr, size_t size, size_t count, bl_file_t file) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->fread) ? p->fread(arg(), ptr, size, count, file) : 0U;
+}
+
+bl_foffset_t blsys_ftell(bl_file_t file) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->ftell) ? p->ftell(arg(), file) : -1;
+}
+
+int blsys_fseek(bl_file_t file, bl_foffset_t offset, int origin) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->fseek) ? p->fseek(arg(), file, offset, origin) : -1;
+}
+
+bl_fsize_t blsys_fsize(bl_file_t file) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->fsize) ? p->fsize(arg(), file) : 0U;
+}
+
+int blsys_feof(bl_file_t file) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->feof) ? p->feof(arg(), file) : 1;
+}
+
+int blsys_fclose(bl_file_t file) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->fclose) ? p->fclose(arg(), file) : EOF;
+}
+
+void blsys_fatal_error(const char* text) {
+  const bl_syscalls_t* p = calls();
+  if (p && p->fatal_error) {
+    p->fatal_error(arg(), text);
+  }
+  abort();  // Reached only if the function returns, which it must not do
+}
+
+bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
+                              const char* text, uint32_t time_ms,
+                              uint32_t flags) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->alert) ? p->alert(arg(), type, caption, text, time_ms, flags)
+                         : bl_alert_terminated;
+}
+
+void blsys_progress(const char* caption, const char* operation,
+                    uint32_t percent_x100) {
+  const bl_syscalls_t* p = calls();
+  if (p && p->progress) {
+    p->progress(arg(), caption, operation, percent_x100);
+  }
+}
+
+uint32_t blsys_time_us(void) {
+  const bl_syscalls_t* p = calls();
+  return (p && p->time_us) ? p->time_us(arg()) : 0U;
+}
+
+bool blsys_nvrec_read(void* buf, size_t len) {
+  const bl_syscalls_t* p = calls();
+  return p && p->nvrec_read && p->nvrec_read(arg(), buf, len);
+}
+
+bool blsys_nvrec_write(const void* buf, size_t len) {
+  const bl_syscalls_t* p = calls();
+  return p && p->nvrec_write && p->nvrec_write(arg(), buf, len);
+}
+
+bool blsys_start_firmware(bl_addr_t start_addr, uint32_t argument) {
+  const bl_syscalls_t* p = calls();
+  return p && p->start_firmware &&
+         p->start_firmware(arg(), start_addr, argument);
+}
+
+#endif  // BL_SYSCALLS_VTABLE
@@ -62,6 +62,11 @@ WEAK bool blsys_flash_map_get_items(int items, ...) {
 
 WEAK bool blsys_flash_erase(bl_addr_t addr, size_t size) { return false; }
 
+WEAK bool blsys_flash_get_sector(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                                 size_t* p_sect_size) {
+  return false;
+}
+
 WEAK bool blsys_flash_read(bl_addr_t addr, void* buf, size_t len) {
   return false;
 }
@@ -94,6 +99,10 @@ WEAK bool blsys_flash_write_protect(bl_addr_t addr, size_t size, bool enable) {
   return true;
 }
 
+WEAK bool blsys_flash_is_write_protected(bl_addr_t addr, size_t size) {
+  return false;
+}
+
 WEAK bool blsys_flash_read_protect(int level) { return true; }
 
 WEAK int blsys_flash_get_read_protection_level(void) { return -1; };
@@ -284,3 +293,9 @@ WEAK bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
 
 WEAK void blsys_progress(const char* caption, const char* operation,
                          uint32_t percent_x100) {}
+
+WEAK uint32_t blsys_time_us(void) { return 0U; }
+
+WEAK bool blsys_nvrec_read(void* buf, size_t len) { return false; }
+
+WEAK bool blsys_nvrec_write(const void* buf, size_t len) { return false; }
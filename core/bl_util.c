@@ -27,7 +27,7 @@ typedef enum version_fmt_t {
 } version_fmt_t;
 
 /// Statically allocated contex
-static struct {
+static BL_THREAD_LOCAL struct {
   /// Callback function called to report progress of operations
   bl_cb_progress_t cb_progress;
   /// User-provided context for callback functions
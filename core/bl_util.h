@@ -33,6 +33,15 @@
 #define BL_STATIC_NO_TEST static
 #endif
 
+#ifdef BL_REENTRANT
+/// Makes a variable local to each thread, so that several Bootloader
+/// instances are able to run in parallel threads of one process
+#define BL_THREAD_LOCAL __thread
+#else
+/// Makes a variable local to each thread (empty macro: single instance)
+#define BL_THREAD_LOCAL
+#endif
+
 /// Maximum allowed value ov version number
 #define BL_VERSION_MAX 4199999999U
 /// Version is not available, guaranteed to be less than any valid version
@@ -14,6 +14,8 @@
 #include "bl_kats.h"
 #include "bl_signature.h"
 #include "bl_integrity_check.h"
+#include "bl_delta.h"
+#include "bl_bufreader.h"
 
 /// Pattern used to search for upgrade files
 #define UPGRADE_FILES "specter_upgrade*.bin"
@@ -42,8 +44,29 @@
 /// Size of statically allocated shared IO buffer
 #define IO_BUF_SIZE 4096U
 #endif
+#ifdef BL_READ_WINDOW_SIZE
+/// Size of read-ahead window for upgrade files
+#define READ_WINDOW_SIZE BL_READ_WINDOW_SIZE
+#else
+/// Size of read-ahead window for upgrade files, same as the IO buffer
+#define READ_WINDOW_SIZE 4096U
+#endif
+#ifdef BL_READ_ALIGN
+/// Alignment of reads from media, should be a multiple of media block size
+#define READ_ALIGN BL_READ_ALIGN
+#else
+/// Alignment of reads from media, should be a multiple of media block size
+#define READ_ALIGN 512U
+#endif
 /// Maximum number Payload sections
 #define MAX_PL_SECTIONS 2U
+#ifdef WRITE_PROTECTION
+/// Verification markers are valid only while sections are write-protected
+#define VMR_REQUIRE_WRP true
+#else
+/// Verification markers are created, but not trusted by cached checks
+#define VMR_REQUIRE_WRP false
+#endif
 
 /// Flash memory map items
 typedef struct flash_map_t {
@@ -60,10 +83,11 @@ typedef struct flash_map_t {
 typedef enum upgrading_stage_t {
   stage_read_file = 0,    ///< Reading upgrade file
   stage_verify_file,      ///< Verifying file integrity
+  stage_verify_file_sig,  ///< Verifying signatures (PREWRITE_SIG_CHECK)
   stage_unprotect_flash,  ///< Removing flash memory protection
   stage_erase_flash,      ///< Erasing flash memory
-  stage_write_flash,      ///< Writing flash memory
-  stage_calc_hash,        ///< Calculating hashes
+  stage_write_flash,      ///< Writing, verifying and hashing firmware
+  stage_verify_flash,     ///< Re-hashing flash memory (POSTWRITE_HASH_CHECK)
   stage_verify_sig,       ///< Verifying signatures
   stage_create_icr,       ///< Creating integrity check records
   stage_protect_flash,    ///< Applying flash memory protection
@@ -100,23 +124,52 @@ typedef struct progress_ctx_t {
   uint32_t boot_percent_x100;
 } progress_ctx_t;
 
+#ifdef PREWRITE_SIG_CHECK
+/// Input of file verification stage in total 100% completeness
+#define PERCENT_VERIFY_FILE 21U
+/// Input of signature verification stage preceding erase of flash memory
+#define PERCENT_VERIFY_FILE_SIG 2U
+/// Input of signature verification stage following flash memory writing
+#define PERCENT_VERIFY_SIG 0U
+#else
+/// Input of file verification stage in total 100% completeness
+#define PERCENT_VERIFY_FILE 21U
+/// Input of signature verification stage preceding erase of flash memory
+#define PERCENT_VERIFY_FILE_SIG 0U
+/// Input of signature verification stage following flash memory writing
+#define PERCENT_VERIFY_SIG 2U
+#endif
+#ifdef POSTWRITE_HASH_CHECK
+/// Input of flash memory re-hashing stage in total 100% completeness
+#define PERCENT_VERIFY_FLASH 5U
+#else
+/// Input of flash memory re-hashing stage in total 100% completeness
+#define PERCENT_VERIFY_FLASH 0U
+#endif
+/// Input of flash memory writing stage, taking what verification stages leave
+#define PERCENT_WRITE_FLASH                                                \
+  (70U - PERCENT_VERIFY_FILE - PERCENT_VERIFY_FILE_SIG - PERCENT_VERIFY_SIG - \
+   PERCENT_VERIFY_FLASH)
+
 /// Table with information about each upgrading stage
 // clang-format off
 static const upgrading_stage_info_t stage_info[n_upgrading_stages_] = {
     [stage_read_file] =
         {.name = "Reading upgrade file", .percent = 2U},
     [stage_verify_file] =
-        {.name = "Verifying file integrity", .percent = 21U},
+        {.name = "Verifying file integrity", .percent = PERCENT_VERIFY_FILE},
+    [stage_verify_file_sig] =
+        {.name = "Verifying signatures", .percent = PERCENT_VERIFY_FILE_SIG},
     [stage_unprotect_flash] =
         {.name = "Removing write protection", .percent = 1U},
     [stage_erase_flash] =
-        {.name = "Erasing flash memory", .percent = 30U},
+        {.name = "Erasing flash memory", .percent = 24U},
     [stage_write_flash] =
-        {.name = "Writing flash memory", .percent = 36},
-    [stage_calc_hash] =
-        {.name = "Verifying signatures", .percent = 5U},
+        {.name = "Writing flash memory", .percent = PERCENT_WRITE_FLASH},
+    [stage_verify_flash] =
+        {.name = "Verifying flash memory", .percent = PERCENT_VERIFY_FLASH},
     [stage_verify_sig] =
-        {.name = "Verifying signatures", .percent = 2U},
+        {.name = "Verifying signatures", .percent = PERCENT_VERIFY_SIG},
     [stage_create_icr] =
         {.name = "Finishing", .percent = 2U},
     [stage_protect_flash] =
@@ -149,11 +202,13 @@ const bl_pubkey_set_t bl_pubkey_set BL_ATTRS((weak)) = {
     .vendor_pubkeys_size = sizeof(empty_pubkey_list),
     .maintainer_pubkeys = empty_pubkey_list,
     .maintainer_pubkeys_size = sizeof(empty_pubkey_list),
+    .pubkey_index = NULL,
+    .pubkey_index_size = 0U,
     .bootloader_sig_threshold = 0,
     .main_fw_sig_threshold = 0};
 
 /// Statically allocated contex of the Bootloader's main task
-static struct {
+static BL_THREAD_LOCAL struct {
   /// Memory map of flash memory
   flash_map_t flash_map;
   /// Context of file searching functions
@@ -170,8 +225,24 @@ static struct {
   char format_buf[512];
   // IO buffer
   uint8_t io_buf[IO_BUF_SIZE];
+  /// Buffered reader of an opened upgrade file
+  bl_bufreader_t reader;
+  /// Read-ahead window of the buffered reader
+  uint8_t read_window[READ_WINDOW_SIZE];
+  /// Plan of update of the inactive copy of the Bootloader
+  bl_fplan_t boot_plan;
+  /// Plan of update of the Main Firmware area
+  bl_fplan_t main_plan;
+  /// Corrupted range of the installed Main Firmware, size is 0 if none
+  bl_icr_range_t main_corrupted;
+  /// Inactive copy of the Bootloader is to be restored from the active copy
+  bool restore_bl_copy;
   /// Hashes of of Payload sections
   bl_hash_t hash_buf[MAX_PL_SECTIONS];
+#if defined(PREWRITE_SIG_CHECK) || defined(POSTWRITE_HASH_CHECK)
+  /// Reference hashes of Payload sections used for cross-checking
+  bl_hash_t ref_hash_buf[MAX_PL_SECTIONS];
+#endif
 } bl_ctx;
 
 /**
@@ -227,9 +298,30 @@ static bool validate_pubkey_list(const bl_pubkey_t* pubkey_list,
   return false;
 }
 
+/**
+ * Returns fingerprint index of a public key set
+ *
+ * @param p_set    pointer to public key set structure
+ * @param p_index  pointer to structure receiving the index
+ * @return         p_index if the key set has a fingerprint index, or NULL
+ */
+static const bl_pubkey_index_t* get_pubkey_index(const bl_pubkey_set_t* p_set,
+                                                 bl_pubkey_index_t* p_index) {
+  if (p_set && p_set->pubkey_index && p_index) {
+    p_index->entries = p_set->pubkey_index;
+    p_index->n_entries =
+        p_set->pubkey_index_size / sizeof(bl_pubkey_index_entry_t);
+    return p_index;
+  }
+  return NULL;
+}
+
 /**
  * Validates a set of public keys
  *
+ * The fingerprint index, if any, is not checked here, see
+ * validate_pubkey_index().
+ *
  * @param p_set  pointer to public key set structure
  * @return       true if key set is valid
  */
@@ -251,6 +343,32 @@ static bool validate_pubkey_set(const bl_pubkey_set_t* p_set) {
   return false;
 }
 
+/**
+ * Validates fingerprint index of a set of public keys
+ *
+ * Every key is hashed, so the index is checked only when an upgrade file is
+ * processed rather than on each start. The index is also checked at build
+ * time with "tools/pubkey-index.py --check".
+ *
+ * @param p_set  pointer to public key set structure, already validated with
+ *               validate_pubkey_set()
+ * @return       true if the key set has no index or the index is valid
+ */
+static bool validate_pubkey_index(const bl_pubkey_set_t* p_set) {
+  if (p_set) {
+    if (!p_set->pubkey_index) {
+      return true;
+    }
+    const bl_pubkey_t* pubkeys_all[] = {p_set->vendor_pubkeys,
+                                        p_set->maintainer_pubkeys, NULL};
+    bl_pubkey_index_t index;
+    return 0U == p_set->pubkey_index_size % sizeof(bl_pubkey_index_entry_t) &&
+           blsig_check_pubkey_index(pubkeys_all,
+                                    get_pubkey_index(p_set, &index));
+  }
+  return false;
+}
+
 /**
  * Returns number of payload sections in an upgrade file
  *
@@ -471,6 +589,20 @@ static inline bl_addr_t get_inactive_bl_addr(bl_addr_t bl_addr) {
              : bl_ctx.flash_map.bootloader_copy1_base;
 }
 
+/**
+ * Returns address of an active Bootloader section
+ *
+ * @param bl_addr  address of currently executed Bootloader
+ * @return         address of active Bootloader copy, the one which is not
+ *                 returned by get_inactive_bl_addr()
+ */
+static inline bl_addr_t get_active_bl_addr(bl_addr_t bl_addr) {
+  return (get_inactive_bl_addr(bl_addr) ==
+          bl_ctx.flash_map.bootloader_copy1_base)
+             ? bl_ctx.flash_map.bootloader_copy2_base
+             : bl_ctx.flash_map.bootloader_copy1_base;
+}
+
 /**
  * Scans all media devices looking for a specific file
  *
@@ -511,8 +643,10 @@ static const char* find_file(const char* path, const char* pattern) {
  * Reads the metadata from an upgrade file
  *
  * This function reads section headers of Payload sections and the Signature
- * section entirely with its payload. This operation is expected to be fast
- * enough to not bother with updating the progress indicator.
+ * section. Payload of the Signature section is read in chunks only to check
+ * its CRC, and it is read once again when signatures are verified. This
+ * operation is expected to be fast enough to not bother with updating the
+ * progress indicator.
  *
  * @param p_md  pointer to structure receiving metadata from file
  * @param file  file handle of an upgrade file
@@ -522,38 +656,58 @@ BL_STATIC_NO_TEST bool read_metadata(file_metadata_t* p_md, bl_file_t file) {
   if (!p_md) {
     return false;
   }
-  bl_fsize_t rm_bytes = blsys_fsize(file);
+  bl_fsize_t rm_bytes = blbuf_fsize(file);
   sect_metadata_t sect;
   memset(p_md, 0, sizeof(file_metadata_t));
 
   while (rm_bytes >= sizeof(sect.header)) {
     // Read the header and obtain payload offset in the file
     memset(&sect, 0, sizeof(sect));
-    size_t hdr_len = blsys_fread(&sect.header, 1U, sizeof(sect.header), file);
-    sect.pl_file_offset = blsys_ftell(file);
+    size_t hdr_len = blbuf_fread(&sect.header, 1U, sizeof(sect.header), file);
+    sect.pl_file_offset = blbuf_ftell(file);
     sect.loaded = true;
     // Validate the header and the payload offset
     if (hdr_len != sizeof(sect.header) ||
-        !blsect_validate_header(&sect.header) ||
-        hdr_len + sect.header.pl_size > rm_bytes ||
-        sect.pl_file_offset < hdr_len) {
+        !blsect_validate_header(&sect.header)) {
       return false;
     }
+    uint32_t stored_size = blsect_stored_size(&sect.header);
+    if (hdr_len + stored_size > rm_bytes || sect.pl_file_offset < hdr_len) {
+      return false;
+    }
+    // Known answer tests scheduled with bl_kat_policy_overlapped are run
+    // between sections, a failure is detected by bl_kats_complete()
+    (void)bl_kats_step();
     if (blsect_is_signature(&sect.header)) {  // Handle Signature section
-      if (p_md->sig_section.loaded ||
-          sect.header.pl_size > MAX_SIGSECTION_SIZE) {
+      if (p_md->sig_section.loaded || blsect_is_compressed(&sect.header)) {
         return false;
       }
-      // Read and validate the payload of the Signature section
-      size_t pl_len =
-          blsys_fread(p_md->sig_payload, 1U, sect.header.pl_size, file);
-      if (pl_len != sect.header.pl_size ||
-          !blsect_validate_payload(&sect.header, p_md->sig_payload)) {
+      // Validate the payload of the Signature section
+      if (!blsect_validate_payload_from_file(&sect.header, file,
+                                             stage_read_file)) {
         return false;
       }
       p_md->sig_section = sect;
+    } else if (bl_streq(BL_DELTA_SECT_NAME, sect.header.name)) {
+      // Handle Delta section reading the header of target firmware
+      sect_metadata_t target = {.loaded = true};
+      if (p_md->main_section.loaded || blsect_is_compressed(&sect.header) ||
+          sect.header.pl_size <= sizeof(target.header) ||
+          blbuf_fread(&target.header, 1U, sizeof(target.header), file) !=
+              sizeof(target.header) ||
+          !blsect_validate_header(&target.header) ||
+          !bl_streq(NAME_MAIN, target.header.name)) {
+        return false;
+      }
+      target.pl_file_offset = blbuf_ftell(file);
+      if (0 != blbuf_fseek(file, sect.header.pl_size - sizeof(target.header),
+                           SEEK_CUR)) {
+        return false;
+      }
+      p_md->delta_section = sect;
+      p_md->main_section = target;
     } else {  // Handle Payload sections skipping payload
-      if (0 != blsys_fseek(file, sect.header.pl_size, SEEK_CUR)) {
+      if (0 != blbuf_fseek(file, stored_size, SEEK_CUR)) {
         return false;
       }
       if (bl_streq(NAME_BOOT, sect.header.name) && !p_md->boot_section.loaded) {
@@ -565,9 +719,12 @@ BL_STATIC_NO_TEST bool read_metadata(file_metadata_t* p_md, bl_file_t file) {
         return false;
       }
     }
-    rm_bytes -= hdr_len + sect.header.pl_size;  // Go to the next section
+    rm_bytes -= hdr_len + stored_size;  // Go to the next section
   }
+  // Delta section uses the inactive copy of the Bootloader as a scratch area,
+  // so it could not be combined with the Bootloader upgrade
   return (p_md->main_section.loaded || p_md->boot_section.loaded) &&
+         !(p_md->delta_section.loaded && p_md->boot_section.loaded) &&
          p_md->sig_section.loaded && !rm_bytes;
 }
 
@@ -597,6 +754,90 @@ static bool check_sect_compatibility(const bl_section_t* p_hdr,
   return false;
 }
 
+/**
+ * Returns layout of flash memory used to apply a patch from Delta section
+ *
+ * The first part of the Main Firmware area defines the size of a block, and
+ * the inactive copy of the Bootloader serves as a scratch area.
+ *
+ * @param bl_addr  address of currently executed Bootloader
+ * @return         layout structure
+ */
+static bl_delta_layout_t get_delta_layout(bl_addr_t bl_addr) {
+  bl_delta_layout_t layout = {
+      .fw_addr = bl_ctx.flash_map.firmware_base,
+      .fw_size = bl_ctx.flash_map.firmware_size,
+      .block_size = bl_ctx.flash_map.firmware_part1_size,
+      .scratch_addr = get_inactive_bl_addr(bl_addr),
+      .scratch_size = bl_ctx.flash_map.bootloader_size};
+  return layout;
+}
+
+/**
+ * Restores the inactive copy of the Bootloader from the active copy
+ *
+ * Used when the inactive copy is not valid, e.g. being left as a scratch area
+ * by an interrupted Delta upgrade, and the upgrade file has no Bootloader.
+ *
+ * @param bl_addr  address of currently executed Bootloader
+ * @return         true if successful
+ */
+static bool restore_inactive_bl_copy(bl_addr_t bl_addr) {
+  bl_delta_layout_t layout = get_delta_layout(bl_addr);
+  return bl_delta_restore_scratch(&layout, get_active_bl_addr(bl_addr)) &&
+         bl_icr_verify(get_inactive_bl_addr(bl_addr),
+                       bl_ctx.flash_map.bootloader_size, NULL);
+}
+
+/**
+ * Checks if a Delta section is compatible with the device
+ *
+ * @param p_md     pointer to upgrade file metadata
+ * @param bl_addr  address of currently executed Bootloader
+ * @return         true if the Delta section is compatible or not present
+ */
+static bool check_delta_compatibility(const file_metadata_t* p_md,
+                                      bl_addr_t bl_addr) {
+  if (p_md) {
+    if (!p_md->delta_section.loaded) {
+      return true;
+    }
+    bl_delta_layout_t layout = get_delta_layout(bl_addr);
+    bl_uint_t block_size = 0U;
+    bl_uint_t base_ver = BL_VERSION_NA;
+    return blsect_get_attr_uint(&p_md->delta_section.header,
+                                bl_attr_delta_block, &block_size) &&
+           blsect_get_attr_uint(&p_md->delta_section.header,
+                                bl_attr_base_version, &base_ver) &&
+           block_size == layout.block_size && base_ver != BL_VERSION_NA &&
+           base_ver <= BL_VERSION_MAX && bl_delta_check_layout(&layout) &&
+           p_md->main_section.header.pl_size <= bl_delta_max_size(&layout);
+  }
+  return false;
+}
+
+/**
+ * Checks if the installed Main Firmware is the base for a Delta section
+ *
+ * @param p_md  pointer to upgrade file metadata having a Delta section
+ * @return      true if the Main Firmware is valid and has the base version
+ */
+static bool check_delta_base(const file_metadata_t* p_md) {
+  if (p_md && p_md->delta_section.loaded) {
+    bl_uint_t base_ver = BL_VERSION_NA;
+    uint32_t curr_ver = BL_VERSION_NA;
+    if (blsect_get_attr_uint(&p_md->delta_section.header,
+                             bl_attr_base_version, &base_ver) &&
+        bl_icr_get_version(bl_ctx.flash_map.firmware_base,
+                           bl_ctx.flash_map.firmware_size, &curr_ver) &&
+        curr_ver == base_ver) {
+      return bl_icr_verify(bl_ctx.flash_map.firmware_base,
+                           bl_ctx.flash_map.firmware_size, NULL);
+    }
+  }
+  return false;
+}
+
 /**
  * Checks if an upgrade file is compatible with the device
  *
@@ -702,89 +943,271 @@ static const char* get_version_check_text(version_check_res_t res) {
   return unknown;
 }
 
+#ifdef PREWRITE_SIG_CHECK
 /**
- * Verifies one payload section of an upgrade file using CRC
+ * Verifies and hashes a firmware section reading it from an upgrade file,
+ * planning update of the area of flash memory receiving it in the same pass
+ *
+ * If sector geometry is not available, the plan is disabled and the section is
+ * only hashed.
  *
- * @param file       file handle of an open upgrade file (already open)
- * @param p_md       pointer to upgrade section metadata
+ * @param p_plan     pointer to plan structure, filled on return
+ * @param file       file handle of an upgrade file
+ * @param p_sect     pointer to section metadata
+ * @param area_addr  start address of the area
+ * @param area_size  size of the area
+ * @param p_result   pointer to variable receiving produced hash
  * @param progr_arg  argument passed to progress callback function
- * @return           true if payload section is valid
+ * @return           true if successful
  */
-static bool verify_payload_section(bl_file_t file, const sect_metadata_t* p_md,
-                                   bl_cbarg_t progr_arg) {
-  if (p_md && p_md->loaded) {
-    if (0 == blsys_fseek(file, p_md->pl_file_offset, SEEK_SET) &&
-        blsect_validate_payload_from_file(&p_md->header, file, progr_arg)) {
-      return true;
-    }
+static bool hash_and_plan_area(bl_fplan_t* p_plan, bl_file_t file,
+                               const sect_metadata_t* p_sect,
+                               bl_addr_t area_addr, bl_addr_t area_size,
+                               bl_hash_t* p_result, bl_cbarg_t progr_arg) {
+  if (0 != blbuf_fseek(file, p_sect->pl_file_offset, SEEK_SET)) {
+    return false;
   }
-  return false;
+  if (!bl_fplan_init(p_plan, area_addr, area_size)) {
+    // The whole area is erased and programmed
+    return blsect_hash_over_file(&p_sect->header, file, p_result, progr_arg);
+  }
+  return blsect_plan_and_hash_payload_from_file(
+      &p_sect->header, file, area_addr, p_plan, area_addr + area_size,
+      p_result, progr_arg);
 }
 
 /**
- * Verifies payload sections of an upgrade file using CRC
+ * Verifies and hashes payload sections reading them from an upgrade file
  *
- * @param file  file handle of an open upgrade file
- * @param p_md  pointer to upgrade file metadata
- * @return      true if all payload sections are valid
+ * Each sector of the flash memory is compared with data which it receives in
+ * the same pass, so that only sectors having different contents are erased
+ * and programmed afterwards. A Delta section is verified by applying its patch
+ * in "dry run" mode to the installed firmware.
+ *
+ * @param file          file handle of an open upgrade file
+ * @param p_md          pointer to upgrade file metadata
+ * @param bl_addr       address of currently executed Bootloader
+ * @param hash_buf      buffer, where produced hashes will be placed
+ * @param p_hash_items  pointer to variable holding capacity of the hash
+ *                      buffer, filled with actual number of hashes on return
+ * @return              true if all payload sections are valid
  */
-static bool verify_payload_sections(bl_file_t file,
-                                    const file_metadata_t* p_md) {
-  if (p_md) {
-    int n_valid = 0;
-    int n_sect = (p_md->boot_section.loaded ? 1 : 0) +
-                 (p_md->main_section.loaded ? 1 : 0);
+static bool hash_file_sections(bl_file_t file, const file_metadata_t* p_md,
+                               bl_addr_t bl_addr, bl_hash_t* hash_buf,
+                               size_t* p_hash_items) {
+  if (p_md && hash_buf && p_hash_items) {
+    bl_hash_t* p_item = hash_buf;      // Pointer to current hash item
+    size_t avl_items = *p_hash_items;  // Available items in buffer
 
-    if (p_md->boot_section.loaded &&
-        verify_payload_section(file, &p_md->boot_section,
-                               stage_verify_file | substage_boot)) {
-      ++n_valid;
+    if (p_md->boot_section.loaded) {
+      if (!avl_items ||
+          !hash_and_plan_area(&bl_ctx.boot_plan, file, &p_md->boot_section,
+                              get_inactive_bl_addr(bl_addr),
+                              bl_ctx.flash_map.bootloader_size, p_item++,
+                              stage_verify_file | substage_boot)) {
+        return false;
+      }
+      --avl_items;
     }
-    if (p_md->main_section.loaded &&
-        verify_payload_section(file, &p_md->main_section,
-                               stage_verify_file | substage_main)) {
-      ++n_valid;
+    if (p_md->main_section.loaded) {
+      if (!avl_items) {
+        return false;
+      }
+      if (p_md->delta_section.loaded) {
+        // Apply the patch in "dry run" mode reading the installed firmware
+        bl_delta_layout_t layout = get_delta_layout(bl_addr);
+        if (0 != blbuf_fseek(file, p_md->main_section.pl_file_offset,
+                             SEEK_SET) ||
+            !bl_delta_apply(&p_md->delta_section.header,
+                            &p_md->main_section.header, file, &layout, false,
+                            p_item++, stage_verify_file | substage_main)) {
+          return false;
+        }
+      } else if (!hash_and_plan_area(&bl_ctx.main_plan, file,
+                                     &p_md->main_section,
+                                     bl_ctx.flash_map.firmware_base,
+                                     bl_ctx.flash_map.firmware_size, p_item++,
+                                     stage_verify_file | substage_main)) {
+        return false;
+      }
     }
-    return n_valid && (n_valid == n_sect);
+    // Update number of items in hash buffer
+    *p_hash_items = p_item - hash_buf;
+    return true;
   }
   return false;
 }
+#endif  // PREWRITE_SIG_CHECK
 
 /**
- * Erases the Main Firmware area of the flash memory preserving the VCR
+ * Returns the latest version of the Main Firmware known to the device
  *
- * @return  true if successful
+ * @return  the latest version number of all sources: ICR & 2x VCR
  */
-static bool erase_main_firmware_area(void) {
+static uint32_t get_latest_main_version(void) {
   bl_addr_t fw_addr = bl_ctx.flash_map.firmware_base;
   bl_addr_t fw_size = bl_ctx.flash_map.firmware_size;
-  bl_addr_t part1_size = bl_ctx.flash_map.firmware_part1_size;
 
-  // Chose the latest version number of all sources: ICR & 2x VCR
   uint32_t icr_ver = BL_VERSION_NA;
   (void)bl_icr_get_version(fw_addr, fw_size, &icr_ver);
   uint32_t startvcr_ver = bl_vcr_get_version(fw_addr, fw_size, bl_vcr_starting);
   uint32_t endvcr_ver = bl_vcr_get_version(fw_addr, fw_size, bl_vcr_ending);
-  uint32_t latest_ver = bl_max3_u32(icr_ver, startvcr_ver, endvcr_ver);
+  return bl_max3_u32(icr_ver, startvcr_ver, endvcr_ver);
+}
+
+/**
+ * Prepares the Main Firmware area for patching preserving the VCR
+ *
+ * Unlike erase_main_firmware_area(), this function keeps the base firmware in
+ * all blocks except the first one, which is saved to the scratch area before
+ * being erased, and the last one holding records. The sequence of VCR creation
+ * is the same, so that a downgrade is not possible after power failure.
+ *
+ * @param p_layout  pointer to layout of flash memory, assumed to be valid
+ * @return          true if successful
+ */
+static bool prepare_delta_area(const bl_delta_layout_t* p_layout) {
+  bl_addr_t fw_addr = p_layout->fw_addr;
+  bl_addr_t fw_size = p_layout->fw_size;
+  bl_addr_t block_size = p_layout->block_size;
+  uint32_t latest_ver = get_latest_main_version();
+
+  // (1) Save the first block to the scratch area
+  bool ok = bl_delta_save_block(p_layout, 0U);
+  // (2) Erase the first block
+  ok = ok && blsys_flash_erase(fw_addr, block_size);
+  // (3) Create VCR at the beginning of the section
+  ok = ok && bl_vcr_create(fw_addr, fw_size, latest_ver, bl_vcr_starting);
+  // (4) Erase the last block removing the ICR
+  ok = ok && blsys_flash_erase(fw_addr + fw_size - block_size, block_size);
+  // (5) Create VCR at the end of the section
+  ok = ok && bl_vcr_create(fw_addr, fw_size, latest_ver, bl_vcr_ending);
+  // (6) Erase the first block
+  ok = ok && blsys_flash_erase(fw_addr, block_size);
+
+  return ok;
+}
+
+/**
+ * Erases the Main Firmware area of the flash memory preserving the VCR
+ *
+ * Only sectors to be rewritten are erased according to the plan, except the
+ * sector receiving the starting VCR which is always erased.
+ *
+ * @param p_plan  pointer to plan of update of the Main Firmware area
+ * @return        true if successful
+ */
+static bool erase_main_firmware_area(bl_fplan_t* p_plan) {
+  bl_addr_t fw_addr = bl_ctx.flash_map.firmware_base;
+  bl_addr_t fw_size = bl_ctx.flash_map.firmware_size;
+  bl_addr_t part1_size = bl_ctx.flash_map.firmware_part1_size;
+  uint32_t latest_ver = get_latest_main_version();
+  uint32_t startvcr_ver = bl_vcr_get_version(fw_addr, fw_size, bl_vcr_starting);
 
   bool ok = (fw_size > part1_size);
   // (1) Check if we have VCR at the beginning of the section
   if (BL_VERSION_NA == startvcr_ver) {  // No VCR at the beginning
     // (2) Erase part 1
-    ok = ok && blsys_flash_erase(fw_addr, part1_size);
+    bl_fplan_touch(p_plan, fw_addr, 1U);
+    ok = ok && bl_fplan_erase(p_plan, fw_addr, part1_size);
     // (3) Create VCR at the beginning of the section
     ok = ok && bl_vcr_create(fw_addr, fw_size, latest_ver, bl_vcr_starting);
+    bl_fplan_touch(p_plan, fw_addr, 1U);
   }
   // (4) Erase part 2
-  ok = ok && blsys_flash_erase(fw_addr + part1_size, fw_size - part1_size);
+  ok = ok && bl_fplan_erase(p_plan, fw_addr + part1_size,
+                            fw_size - part1_size);
   // (5) Create VCR at the end of the section
   ok = ok && bl_vcr_create(fw_addr, fw_size, latest_ver, bl_vcr_ending);
   // (6) Erase part 1
-  ok = ok && blsys_flash_erase(fw_addr, part1_size);
+  ok = ok && bl_fplan_erase(p_plan, fw_addr, part1_size);
 
   return ok;
 }
 
+#ifndef PREWRITE_SIG_CHECK
+/**
+ * Validates a firmware section reading it from an upgrade file
+ *
+ * With SKIP_UNCHANGED_SECTORS, update of the area of flash memory receiving
+ * the section is planned in the same pass. Otherwise, or if sector geometry is
+ * not available, the plan stays disabled and the payload is only validated.
+ *
+ * @param p_plan     pointer to plan structure, filled on return
+ * @param file       file handle of an upgrade file
+ * @param p_sect     pointer to section metadata
+ * @param area_addr  start address of the area
+ * @param area_size  size of the area
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+static bool validate_area(bl_fplan_t* p_plan, bl_file_t file,
+                          const sect_metadata_t* p_sect, bl_addr_t area_addr,
+                          bl_addr_t area_size, bl_cbarg_t progr_arg) {
+  if (0 != blbuf_fseek(file, p_sect->pl_file_offset, SEEK_SET)) {
+    return false;
+  }
+#ifdef SKIP_UNCHANGED_SECTORS
+  if (bl_fplan_init(p_plan, area_addr, area_size)) {
+    return blsect_plan_payload_from_file(&p_sect->header, file, area_addr,
+                                         p_plan, area_addr + area_size,
+                                         progr_arg);
+  }
+#else
+  (void)p_plan;
+  (void)area_addr;
+  (void)area_size;
+#endif  // SKIP_UNCHANGED_SECTORS
+  return blsect_validate_payload_from_file(&p_sect->header, file, progr_arg);
+}
+
+/**
+ * Validates payload sections reading them from an upgrade file
+ *
+ * Payload is validated with CRC, so that a corrupted file is rejected before
+ * the flash memory is modified. This costs an additional pass over the upgrade
+ * file, which is also used to compare sectors of the flash memory with data
+ * they receive if SKIP_UNCHANGED_SECTORS is enabled. A Delta section is
+ * validated by applying its patch in "dry run" mode to the installed firmware.
+ * With PREWRITE_SIG_CHECK this is done by hash_file_sections() instead.
+ *
+ * @param file     file handle of an upgrade file
+ * @param p_md     pointer to upgrade file metadata
+ * @param bl_addr  address of currently executed Bootloader
+ * @return         true if all payload sections are valid
+ */
+static bool validate_file_sections(bl_file_t file, const file_metadata_t* p_md,
+                                   bl_addr_t bl_addr) {
+  if (p_md) {
+    if (p_md->boot_section.loaded &&
+        !validate_area(&bl_ctx.boot_plan, file, &p_md->boot_section,
+                       get_inactive_bl_addr(bl_addr),
+                       bl_ctx.flash_map.bootloader_size,
+                       stage_verify_file | substage_boot)) {
+      return false;
+    }
+    if (p_md->main_section.loaded) {
+      if (p_md->delta_section.loaded) {
+        // Apply the patch in "dry run" mode reading the installed firmware
+        bl_delta_layout_t layout = get_delta_layout(bl_addr);
+        bl_hash_t unused_hash;
+        return 0 == blbuf_fseek(file, p_md->main_section.pl_file_offset,
+                                SEEK_SET) &&
+               bl_delta_apply(&p_md->delta_section.header,
+                              &p_md->main_section.header, file, &layout, false,
+                              &unused_hash, stage_verify_file | substage_main);
+      }
+      return validate_area(&bl_ctx.main_plan, file, &p_md->main_section,
+                           bl_ctx.flash_map.firmware_base,
+                           bl_ctx.flash_map.firmware_size,
+                           stage_verify_file | substage_main);
+    }
+    return true;
+  }
+  return false;
+}
+#endif  // PREWRITE_SIG_CHECK
+
 /**
  * Erases sections of the flash memory preparing for an upgrade
  *
@@ -796,15 +1219,18 @@ static bool erase_flash(const file_metadata_t* p_md, bl_addr_t bl_addr) {
   if (p_md) {
     if (p_md->boot_section.loaded) {
       bl_report_progress(stage_erase_flash | substage_boot, 1U, 0U);
-      if (!blsys_flash_erase(get_inactive_bl_addr(bl_addr),
-                             bl_ctx.flash_map.bootloader_size)) {
+      if (!bl_fplan_erase(&bl_ctx.boot_plan, get_inactive_bl_addr(bl_addr),
+                          bl_ctx.flash_map.bootloader_size)) {
         return false;
       }
       bl_report_progress(stage_erase_flash | substage_boot, 1U, 1U);
     }
     if (p_md->main_section.loaded) {
       bl_report_progress(stage_erase_flash | substage_main, 1U, 0U);
-      if (!erase_main_firmware_area()) {
+      bl_delta_layout_t layout = get_delta_layout(bl_addr);
+      if (p_md->delta_section.loaded ? !prepare_delta_area(&layout)
+                                     : !erase_main_firmware_area(
+                                           &bl_ctx.main_plan)) {
         return false;
       }
       bl_report_progress(stage_erase_flash | substage_main, 1U, 1U);
@@ -830,7 +1256,9 @@ static bool set_write_protection_state(const file_metadata_t* p_md,
     upgrading_stage_t stage =
         enable ? stage_protect_flash : stage_unprotect_flash;
 
-    if (p_md->boot_section.loaded) {
+    // Inactive copy of the Bootloader is also used as a scratch area by Delta
+    if (p_md->boot_section.loaded || p_md->delta_section.loaded ||
+        bl_ctx.restore_bl_copy) {
       bl_report_progress(stage | substage_boot, 1U, 0U);
       if (!blsys_flash_write_protect(get_inactive_bl_addr(bl_addr),
                                      bl_ctx.flash_map.bootloader_size,
@@ -855,40 +1283,27 @@ static bool set_write_protection_state(const file_metadata_t* p_md,
 /**
  * Copies one firmware section from an upgrade file to the flash memory
  *
+ * The payload is read from the file once, being validated with CRC, written to
+ * the flash memory and hashed in a single pass. Sectors kept intact by the plan
+ * are compared with the payload instead of being programmed.
+ *
  * @param flash_addr  destination address in flash memory
+ * @param p_plan      pointer to plan of update of the destination area
  * @param file        file handle of an upgrade file
  * @param p_md        pointer to upgrade file metadata
+ * @param p_hash      pointer to variable receiving hash of the section
  * @param progr_arg   argument passed to progress callback function
  * @return            true if successful
  */
-static bool copy_section(bl_addr_t flash_addr, bl_file_t file,
-                         const sect_metadata_t* p_md, bl_cbarg_t progr_arg) {
+static bool copy_section(bl_addr_t flash_addr, const bl_fplan_t* p_plan,
+                         bl_file_t file, const sect_metadata_t* p_md,
+                         bl_hash_t* p_hash, bl_cbarg_t progr_arg) {
   if (p_md && p_md->loaded) {
-    if (blsys_fseek(file, p_md->pl_file_offset, SEEK_SET) != 0) {
-      return false;
-    }
-    size_t rm_bytes = p_md->header.pl_size;
-    bl_addr_t curr_addr = flash_addr;
-
-    bl_report_progress(progr_arg, p_md->header.pl_size, 0U);
-    while (rm_bytes) {
-      if (blsys_feof(file)) {
-        return false;
-      }
-      size_t copy_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
-      size_t got_len = blsys_fread(bl_ctx.io_buf, 1U, copy_len, file);
-      if (got_len != copy_len) {
-        return false;
-      }
-      if (!blsys_flash_write(curr_addr, bl_ctx.io_buf, copy_len)) {
-        return false;
-      }
-      curr_addr += copy_len;
-      rm_bytes -= copy_len;
-      bl_report_progress(progr_arg, p_md->header.pl_size,
-                         p_md->header.pl_size - rm_bytes);
+    if (0 == blbuf_fseek(file, p_md->pl_file_offset, SEEK_SET) &&
+        blsect_copy_payload_from_file(&p_md->header, file, flash_addr, p_plan,
+                                      p_hash, progr_arg)) {
+      return true;
     }
-    return true;
   }
   return false;
 }
@@ -896,37 +1311,66 @@ static bool copy_section(bl_addr_t flash_addr, bl_file_t file,
 /**
  * Copies firmware sections from an upgrade file to the flash memory
  *
- * @param file     file handle of an upgrade file
- * @param p_md     pointer to upgrade file metadata
- * @param bl_addr  address of currently executed Bootloader
- * @return         true if successful
+ * Along with copying, this function verifies integrity of payload sections and
+ * calculates hashes needed to produce the signature message.
+ *
+ * @param file          file handle of an upgrade file
+ * @param p_md          pointer to upgrade file metadata
+ * @param bl_addr       address of currently executed Bootloader
+ * @param hash_buf      buffer, where produced hashes will be placed
+ * @param p_hash_items  pointer to variable holding capacity of the hash
+ *                      buffer, filled with actual number of hashes on return
+ * @return              true if successful
  */
 static bool copy_sections(bl_file_t file, const file_metadata_t* p_md,
-                          bl_addr_t bl_addr) {
-  if (p_md) {
+                          bl_addr_t bl_addr, bl_hash_t* hash_buf,
+                          size_t* p_hash_items) {
+  if (p_md && hash_buf && p_hash_items) {
+    bl_hash_t* p_item = hash_buf;      // Pointer to current hash item
+    size_t avl_items = *p_hash_items;  // Available items in buffer
+
     if (p_md->boot_section.loaded) {
-      if (!copy_section(get_inactive_bl_addr(bl_addr), file,
-                        &p_md->boot_section,
+      if (!avl_items ||
+          !copy_section(get_inactive_bl_addr(bl_addr), &bl_ctx.boot_plan,
+                        file, &p_md->boot_section, p_item++,
                         stage_write_flash | substage_boot)) {
         return false;
       }
+      --avl_items;
     }
     if (p_md->main_section.loaded) {
-      if (!copy_section(bl_ctx.flash_map.firmware_base, file,
-                        &p_md->main_section,
-                        stage_write_flash | substage_main)) {
+      if (!avl_items) {
+        return false;
+      }
+      if (p_md->delta_section.loaded) {
+        // Patch the installed firmware, then restore the scratch area
+        bl_delta_layout_t layout = get_delta_layout(bl_addr);
+        if (0 != blbuf_fseek(file, p_md->main_section.pl_file_offset,
+                             SEEK_SET) ||
+            !bl_delta_apply(&p_md->delta_section.header,
+                            &p_md->main_section.header, file, &layout, true,
+                            p_item++, stage_write_flash | substage_main) ||
+            !bl_delta_restore_scratch(&layout, get_active_bl_addr(bl_addr))) {
+          return false;
+        }
+      } else if (!copy_section(bl_ctx.flash_map.firmware_base,
+                               &bl_ctx.main_plan, file, &p_md->main_section,
+                               p_item++, stage_write_flash | substage_main)) {
         return false;
       }
     }
+    // Update number of items in hash buffer
+    *p_hash_items = p_item - hash_buf;
     return true;
   }
   return false;
 }
 
+#ifdef POSTWRITE_HASH_CHECK
 /**
- * Calculates hash message reading firmware sections from flash memory
+ * Calculates hashes of firmware sections reading them from flash memory
  *
- * @param hash_buf    buffer, where produced hashes will be placed
+ * @param hash_buf      buffer, where produced hashes will be placed
  * @param p_hash_items  pointer to variable holding capacity of the hash
  *                      buffer, filled with actual number of hashes on return
  * @param p_md          pointer to upgrade file metadata
@@ -944,7 +1388,7 @@ static bool hash_flash_sections(bl_hash_t* hash_buf, size_t* p_hash_items,
       if (!avl_items ||
           !blsect_hash_over_flash(&p_md->boot_section.header,
                                   get_inactive_bl_addr(bl_addr), p_item++,
-                                  stage_calc_hash | substage_boot)) {
+                                  stage_verify_flash | substage_boot)) {
         return false;
       }
       --avl_items;
@@ -953,7 +1397,7 @@ static bool hash_flash_sections(bl_hash_t* hash_buf, size_t* p_hash_items,
       if (!avl_items ||
           !blsect_hash_over_flash(&p_md->main_section.header,
                                   bl_ctx.flash_map.firmware_base, p_item++,
-                                  stage_calc_hash | substage_main)) {
+                                  stage_verify_flash | substage_main)) {
         return false;
       }
     }
@@ -963,6 +1407,7 @@ static bool hash_flash_sections(bl_hash_t* hash_buf, size_t* p_hash_items,
   }
   return false;
 }
+#endif  // POSTWRITE_HASH_CHECK
 
 /**
  * Performs verification of multiple signatures
@@ -983,21 +1428,27 @@ static bool hash_flash_sections(bl_hash_t* hash_buf, size_t* p_hash_items,
  * Multisig thresholds are configured independently for upgrade files containing
  * the Bootloader and for upgrade files having just the Main Firmware.
  *
+ * The payload of the Signature section is read from the file through the I/O
+ * buffer and passed to streaming verification, its CRC is checked in the same
+ * pass.
+ *
+ * @param file        file handle of an upgrade file
  * @param p_md        pointer to upgrade file metadata
  * @param p_keyset    set of public keys and multisig thresholds
  * @param hash_buf    buffer with hash structures of payload sections
  * @param hash_items  number of hash structures in buffer
+ * @param progr_arg   argument passed to progress callback function
  * @param p_result    pointer to variable receiving verification result
  * @return            true if the message passes multisig verification
  */
-static bool verify_multisig(const file_metadata_t* p_md,
+static bool verify_multisig(bl_file_t file, const file_metadata_t* p_md,
                             const bl_pubkey_set_t* p_keyset,
                             const bl_hash_t* hash_buf, size_t hash_items,
-                            int32_t* p_result) {
+                            bl_cbarg_t progr_arg, int32_t* p_result) {
   if (p_result) {
     *p_result = blsig_err_verification_fail;
   }
-  if (p_md && p_md->sig_section.loaded && p_keyset && hash_buf &&
+  if (file && p_md && p_md->sig_section.loaded && p_keyset && hash_buf &&
       count_payload_sections(p_md) == hash_items && p_result) {
     // Get algorithm identifier from the attributes of the Signature section
     char algorithm[BL_ATTR_STR_MAX] = "";
@@ -1007,15 +1458,35 @@ static bool verify_multisig(const file_metadata_t* p_md,
       const bl_pubkey_t* pubkeys_boot[] = {p_keyset->vendor_pubkeys, NULL};
       const bl_pubkey_t* pubkeys_main[] = {p_keyset->vendor_pubkeys,
                                            p_keyset->maintainer_pubkeys, NULL};
+      bl_pubkey_index_t index;
       // Make a Bech32 message for signature verification
       uint8_t msg[BL_SIG_MSG_MAX];
       size_t msg_size = sizeof(msg);
       if (blsect_make_signature_message(msg, &msg_size, hash_buf, hash_items)) {
-        // Perform signature verification
-        *p_result = blsig_verify_multisig(
-            algorithm, p_md->sig_payload, p_md->sig_section.header.pl_size,
-            p_md->boot_section.loaded ? pubkeys_boot : pubkeys_main, msg,
-            msg_size, stage_verify_sig);
+        // Perform signature verification reading signature records in chunks
+        const bl_section_t* p_hdr = &p_md->sig_section.header;
+        *p_result = blsig_stream_begin(
+            algorithm, p_hdr->pl_size,
+            p_md->boot_section.loaded ? pubkeys_boot : pubkeys_main,
+            get_pubkey_index(p_keyset, &index), msg, msg_size, progr_arg);
+        bool read_ok =
+            *p_result >= 0 &&
+            0 == blbuf_fseek(file, p_md->sig_section.pl_file_offset, SEEK_SET);
+        size_t rm_bytes = p_hdr->pl_size;
+        uint32_t crc = 0U;
+        while (read_ok && rm_bytes) {
+          size_t read_len = (rm_bytes < IO_BUF_SIZE) ? rm_bytes : IO_BUF_SIZE;
+          read_ok = read_len == blbuf_fread(bl_ctx.io_buf, 1U, read_len, file);
+          if (read_ok) {
+            crc = crc32_fast(bl_ctx.io_buf, read_len, crc);
+            read_ok = blsig_stream_update(bl_ctx.io_buf, read_len);
+            rm_bytes -= read_len;
+          }
+        }
+        *p_result = blsig_stream_end();
+        if (*p_result >= 0 && (rm_bytes || crc != p_hdr->pl_crc)) {
+          *p_result = blsig_err_verification_fail;
+        }
 
         if (*p_result >= 0) {  // Verification is successful
           // Compare number of valid signatures with the thresholds
@@ -1029,9 +1500,39 @@ static bool verify_multisig(const file_metadata_t* p_md,
   return false;
 }
 
+/**
+ * Verifies signatures of an upgrade file, notifying the user in case of failure
+ *
+ * @param file        file handle of an upgrade file
+ * @param p_md        pointer to upgrade file metadata
+ * @param hash_buf    buffer with hash structures of payload sections
+ * @param hash_items  number of hash structures in buffer
+ * @param progr_arg   argument passed to progress callback function
+ * @return            true if the upgrade file passes multisig verification
+ */
+static bool check_signatures(bl_file_t file, const file_metadata_t* p_md,
+                             const bl_hash_t* hash_buf, size_t hash_items,
+                             bl_cbarg_t progr_arg) {
+  int32_t verify_res = 0;
+  if (!verify_multisig(file, p_md, &bl_pubkey_set, hash_buf, hash_items,
+                       progr_arg, &verify_res)) {
+    const char* err_text = blsig_is_error(verify_res)
+                               ? blsig_error_text(verify_res)
+                               : "Not enough signatures";
+    (void)blsys_alert(bl_alert_error, "Signature Error", err_text, BL_FOREVER,
+                      0U);
+    return false;
+  }
+  return true;
+}
+
 /**
  * Creates integrity check records in flash memory
  *
+ * Each section is then verified once again reading it from flash memory and
+ * certified with a verification marker, allowing the CRC check to be skipped
+ * at boot time.
+ *
  * @param p_md     pointer to upgrade file metadata
  * @param bl_addr  address of currently executed Bootloader
  * @param p_map    map of flash memory of the device
@@ -1044,7 +1545,9 @@ static bool create_icrs(const file_metadata_t* p_md, bl_addr_t bl_addr,
       bl_report_progress(stage_create_icr | substage_boot, 1U, 0U);
       if (!bl_icr_create(get_inactive_bl_addr(bl_addr), p_map->bootloader_size,
                          p_md->boot_section.header.pl_size,
-                         p_md->boot_section.header.pl_ver)) {
+                         p_md->boot_section.header.pl_ver) ||
+          !bl_icr_certify(get_inactive_bl_addr(bl_addr),
+                          p_map->bootloader_size, VMR_REQUIRE_WRP)) {
         return false;
       }
       bl_report_progress(stage_create_icr | substage_boot, 1U, 1U);
@@ -1053,7 +1556,9 @@ static bool create_icrs(const file_metadata_t* p_md, bl_addr_t bl_addr,
       bl_report_progress(stage_create_icr | substage_main, 1U, 0U);
       if (!bl_icr_create(p_map->firmware_base, p_map->firmware_size,
                          p_md->main_section.header.pl_size,
-                         p_md->main_section.header.pl_ver)) {
+                         p_md->main_section.header.pl_ver) ||
+          !bl_icr_certify(p_map->firmware_base, p_map->firmware_size,
+                          VMR_REQUIRE_WRP)) {
         return false;
       }
       bl_report_progress(stage_create_icr | substage_main, 1U, 1U);
@@ -1096,6 +1601,30 @@ static int make_section_report(char* dst_buf, size_t dst_size,
   return -1;
 }
 
+/**
+ * Appends a text describing known answer tests and their durations
+ *
+ * @param dst_str   destination null-terminated string
+ * @param dst_size  size of the buffer storing provided string
+ * @return          true if successful
+ */
+static bool append_kat_report(char* dst_str, size_t dst_size) {
+  bool ok = bl_format_append(dst_str, dst_size, "Self-tests:");
+  if (bl_kat_skipped == bl_kat_get_state(bl_kat_sha256)) {
+    return ok && bl_format_append(dst_str, dst_size, " passed earlier\n");
+  }
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    // KATs run on demand are pending if not required by the upgrade file
+    if (bl_kat_pending != bl_kat_get_state((bl_kat_id_t)id)) {
+      unsigned long time_us = bl_kat_get_time_us((bl_kat_id_t)id);
+      ok = ok && bl_format_append(dst_str, dst_size, "%s %s %lu.%03lu ms",
+                                  id ? "," : "", bl_kat_name((bl_kat_id_t)id),
+                                  time_us / 1000UL, time_us % 1000UL);
+    }
+  }
+  return ok && bl_format_append(dst_str, dst_size, "\n");
+}
+
 /**
  * Appends a text describing read/write protection status to a report string
  *
@@ -1129,17 +1658,20 @@ static bool append_rw_protection_status(char* dst_str, size_t dst_size) {
 /**
  * Makes a report regarding successful upgrade
  *
- * @param dst_buf    destination buffer where report string is placed
- * @param dst_size   size of the destination buffer in bytes
- * @param file_name  name of an upgrade file used
- * @param p_md       pointer to upgrade file metadata
- * @param prev_ver   structure with previous versions
- * @return           true if successful
+ * @param dst_buf           destination buffer where report string is placed
+ * @param dst_size          size of the destination buffer in bytes
+ * @param file_name         name of an upgrade file used
+ * @param p_md              pointer to upgrade file metadata
+ * @param prev_ver          structure with previous versions
+ * @param p_main_corrupted  pointer to corrupted range of the previously
+ *                          installed Main Firmware, size is 0 if none
+ * @return                  true if successful
  */
 static bool make_upgrade_report(char* dst_buf, size_t dst_size,
                                 const char* file_name,
                                 const file_metadata_t* p_md,
-                                version_info_t prev_ver) {
+                                version_info_t prev_ver,
+                                const bl_icr_range_t* p_main_corrupted) {
   if (dst_buf && dst_size > 5U && file_name && p_md) {
     char* p_dst = dst_buf;
     size_t rm_size = dst_size;
@@ -1168,8 +1700,19 @@ static bool make_upgrade_report(char* dst_buf, size_t dst_size,
       return false;
     }
 
-    // Report status of read/write protection
-    return append_rw_protection_status(p_dst, rm_size);
+    // Report corrupted part of the Main Firmware replaced by the upgrade
+    if (p_main_corrupted && p_main_corrupted->size) {
+      unsigned long offset =
+          p_main_corrupted->addr - bl_ctx.flash_map.firmware_base;
+      if (!bl_format_append(p_dst, rm_size, "Repaired: 0x%lX-0x%lX\n", offset,
+                            offset + p_main_corrupted->size - 1U)) {
+        return false;
+      }
+    }
+
+    // Report known answer tests and status of read/write protection
+    return append_kat_report(p_dst, rm_size) &&
+           append_rw_protection_status(p_dst, rm_size);
   }
   return false;
 }
@@ -1193,7 +1736,8 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
   }
 
   // Check if the upgrade file is compatible with the device
-  if (!check_compatibility(&bl_ctx.file_metadata, &bl_ctx.flash_map)) {
+  if (!check_compatibility(&bl_ctx.file_metadata, &bl_ctx.flash_map) ||
+      !check_delta_compatibility(&bl_ctx.file_metadata, p_args->loaded_from)) {
     fatal_error("Upgrade file is incompatible with the device");
   }
 
@@ -1205,6 +1749,7 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
   version_info_t orig_ver = get_version_info(p_args->loaded_from);
   version_check_res_t version_check =
       check_versions(&bl_ctx.file_metadata, orig_ver, flags);
+  bool main_fw_corrupted = false;
   if (version_same == version_check) {
     // Same version: normally display notice and exit. But if the Main Firmware
     // is corrupted continue with upgrade (if it has needed payload).
@@ -1216,16 +1761,84 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
                         0U);
       return false;
     }
+    main_fw_corrupted = true;
   } else if (version_check != version_newer) {
     (void)blsys_alert(bl_alert_error, "Version Check Failed",
                       get_version_check_text(version_check), BL_FOREVER, 0U);
     return false;
   }
 
-  // Check integrity of payload sections in the upgrade file
-  if (!verify_payload_sections(file, &bl_ctx.file_metadata)) {
+  // Delta file is applicable only to the exact base version of the firmware
+  if (bl_ctx.file_metadata.delta_section.loaded &&
+      !check_delta_base(&bl_ctx.file_metadata)) {
+    (void)blsys_alert(bl_alert_error, "Version Check Failed",
+                      "Installed firmware is not the base of this delta file",
+                      BL_FOREVER, 0U);
+    return false;
+  }
+
+  // Complete known answer tests before any cryptographic function is used,
+  // including those run only for the signature algorithm of the file
+  char algorithm[BL_ATTR_STR_MAX] = "";
+  (void)blsect_get_attr_str(&bl_ctx.file_metadata.sig_section.header,
+                            bl_attr_algorithm, algorithm, sizeof(algorithm));
+  if (!bl_kats_complete() || !bl_kats_run_for_algorithm(algorithm)) {
+    fatal_error("Known answer test failed");
+  }
+  if (!validate_pubkey_index(&bl_pubkey_set)) {
+    fatal_error("Invalid public key set");
+  }
+
+  // Plans of flash memory update are disabled until built, so that by default
+  // the whole area is erased and programmed
+  (void)bl_fplan_init(&bl_ctx.boot_plan, 0U, 0U);
+  (void)bl_fplan_init(&bl_ctx.main_plan, 0U, 0U);
+
+#ifdef PREWRITE_SIG_CHECK
+  // Verify integrity and signatures reading payload from the upgrade file, so
+  // that a badly signed file is rejected before the flash memory is erased.
+  // Plans of flash memory update are built in the same pass.
+  size_t ref_items =
+      sizeof(bl_ctx.ref_hash_buf) / sizeof(bl_ctx.ref_hash_buf[0]);
+  if (!hash_file_sections(file, &bl_ctx.file_metadata, p_args->loaded_from,
+                          bl_ctx.ref_hash_buf, &ref_items)) {
+    fatal_error("Upgrade file is corrupted");
+  }
+  if (!check_signatures(file, &bl_ctx.file_metadata, bl_ctx.ref_hash_buf,
+                        ref_items, stage_verify_file_sig)) {
+    return false;
+  }
+#endif  // PREWRITE_SIG_CHECK
+
+  // Find corrupted part of the installed Main Firmware to be reported, only if
+  // it has failed the integrity check: this takes a pass over all its blocks
+  if (!main_fw_corrupted ||
+      !bl_icr_find_corruption(bl_ctx.flash_map.firmware_base,
+                              bl_ctx.flash_map.firmware_size,
+                              &bl_ctx.main_corrupted)) {
+    bl_ctx.main_corrupted.size = 0U;
+  }
+
+#ifndef PREWRITE_SIG_CHECK
+  // Verify integrity of payload reading it from the upgrade file, so that a
+  // corrupted file is rejected before the flash memory is erased. Plans of
+  // flash memory update are built in the same pass, if enabled.
+  if (!validate_file_sections(file, &bl_ctx.file_metadata,
+                              p_args->loaded_from)) {
     fatal_error("Upgrade file is corrupted");
   }
+#endif  // PREWRITE_SIG_CHECK
+
+  // An interrupted Delta upgrade leaves the inactive copy of the Bootloader
+  // erased or partially overwritten. Unless this upgrade rewrites it (or uses
+  // it as a scratch area itself), restore it to keep the Bootloader redundant.
+  bl_ctx.restore_bl_copy =
+      !bl_ctx.file_metadata.boot_section.loaded &&
+      !bl_ctx.file_metadata.delta_section.loaded &&
+      !bl_icr_verify(get_inactive_bl_addr(p_args->loaded_from),
+                     bl_ctx.flash_map.bootloader_size, NULL) &&
+      bl_icr_verify(get_active_bl_addr(p_args->loaded_from),
+                    bl_ctx.flash_map.bootloader_size, NULL);
 
   // Remove write protection from needed sections of the flash memory
   if (!set_write_protection_state(&bl_ctx.file_metadata, p_args->loaded_from,
@@ -1238,29 +1851,42 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
     fatal_error("Error while erasing the flash memory");
   }
 
-  // Copy firmware to the flash memory
-  if (!copy_sections(file, &bl_ctx.file_metadata, p_args->loaded_from)) {
-    fatal_error("Error copying firmware to the flash memory");
-  }
-
-  // Calculate signature message by hashing all Payload sections in flash memory
+  // Copy firmware to the flash memory, checking integrity of payload sections
+  // and hashing them in the same pass. If a section turns out to be corrupted,
+  // no integrity check record is created and the firmware is not started.
   size_t hash_items = sizeof(bl_ctx.hash_buf) / sizeof(bl_ctx.hash_buf[0]);
-  if (!hash_flash_sections(bl_ctx.hash_buf, &hash_items, &bl_ctx.file_metadata,
-                           p_args->loaded_from)) {
-    fatal_error("Error calculating hash of the firmware");
+  if (!copy_sections(file, &bl_ctx.file_metadata, p_args->loaded_from,
+                     bl_ctx.hash_buf, &hash_items)) {
+    fatal_error("Upgrade file is corrupted or flash memory write failed");
   }
 
+#ifdef PREWRITE_SIG_CHECK
+  // Ensure that programmed firmware is exactly what was verified before
+  if (hash_items != ref_items ||
+      !bl_memeq(bl_ctx.hash_buf, bl_ctx.ref_hash_buf,
+                hash_items * sizeof(bl_hash_t))) {
+    fatal_error("Upgrade file changed while being processed");
+  }
+#else
   // Verify multiple signatures
-  int32_t verify_res = 0;
-  if (!verify_multisig(&bl_ctx.file_metadata, &bl_pubkey_set, bl_ctx.hash_buf,
-                       hash_items, &verify_res)) {
-    const char* err_text = blsig_is_error(verify_res)
-                               ? blsig_error_text(verify_res)
-                               : "Not enough signatures";
-    (void)blsys_alert(bl_alert_error, "Signature Error", err_text, BL_FOREVER,
-                      0U);
+  if (!check_signatures(file, &bl_ctx.file_metadata, bl_ctx.hash_buf,
+                        hash_items, stage_verify_sig)) {
     return false;
   }
+#endif  // PREWRITE_SIG_CHECK
+
+#ifdef POSTWRITE_HASH_CHECK
+  // Paranoid check: hash firmware once again reading it from flash memory
+  size_t flash_items =
+      sizeof(bl_ctx.ref_hash_buf) / sizeof(bl_ctx.ref_hash_buf[0]);
+  if (!hash_flash_sections(bl_ctx.ref_hash_buf, &flash_items,
+                           &bl_ctx.file_metadata, p_args->loaded_from) ||
+      flash_items != hash_items ||
+      !bl_memeq(bl_ctx.hash_buf, bl_ctx.ref_hash_buf,
+                hash_items * sizeof(bl_hash_t))) {
+    fatal_error("Firmware verification in flash memory failed");
+  }
+#endif  // POSTWRITE_HASH_CHECK
 
   // Create integrity check records in flash memory
   if (!create_icrs(&bl_ctx.file_metadata, p_args->loaded_from,
@@ -1268,6 +1894,12 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
     fatal_error("Error creating integrity check records");
   }
 
+  // Restore the backup copy of the Bootloader after the firmware is complete
+  if (bl_ctx.restore_bl_copy &&
+      !restore_inactive_bl_copy(p_args->loaded_from)) {
+    fatal_error("Error restoring the backup copy of the Bootloader");
+  }
+
 #ifdef WRITE_PROTECTION
   // Restore write protection for updated sections of the flash memory
   if (!set_write_protection_state(&bl_ctx.file_metadata, p_args->loaded_from,
@@ -1278,7 +1910,8 @@ static bool do_upgrade_with_file(bl_file_t file, const bl_args_t* p_args,
 
   // Notify the user that upgrade is complete
   if (!make_upgrade_report(bl_ctx.format_buf, sizeof(bl_ctx.format_buf),
-                           bl_ctx.file_name, &bl_ctx.file_metadata, orig_ver)) {
+                           bl_ctx.file_name, &bl_ctx.file_metadata, orig_ver,
+                           &bl_ctx.main_corrupted)) {
     fatal_error("Error preparing upgrade report");
   }
   (void)blsys_alert(bl_alert_info, "Upgrade Complete", bl_ctx.format_buf,
@@ -1302,10 +1935,14 @@ static bool do_upgrade(const char* file_name, const bl_args_t* p_args,
   if (!file) {
     fatal_error("Cannot open '%s' for reading", file_name);
   }
+  // Without a reader attached the file is read directly, only slower
+  (void)blbuf_attach(&bl_ctx.reader, file, bl_ctx.read_window,
+                     sizeof(bl_ctx.read_window), READ_ALIGN);
 
   // Call internal function processin an open upgrade file
   bool result = do_upgrade_with_file(file, p_args, flags);
 
+  blbuf_detach(&bl_ctx.reader);
   blsys_fclose(file);
   return result;
 }
@@ -1444,7 +2081,8 @@ static bl_status_t bootloader_run_initialized(const bl_args_t* p_args,
   bl_status_t status = bl_status_normal_exit;
   const char* file_name = find_file(UPGRADE_PATH, UPGRADE_FILES);
   if (file_name) {
-    if (bl_run_kats()) {
+    uint32_t bl_version = get_version_info(p_args->loaded_from).bootloader_ver;
+    if (bl_kats_begin(BL_KAT_POLICY, bl_version)) {
       if (do_upgrade(file_name, p_args, flags)) {
         status = bl_status_upgrade_complete;
       }
@@ -1471,6 +2109,19 @@ bl_status_t bootloader_run(const bl_args_t* p_args, uint32_t flags) {
   return bl_status_err_platform;
 }
 
+#ifdef BL_SYSCALLS_VTABLE
+bl_status_t bootloader_run_ctx(const struct bl_sysctx_t* p_sysctx,
+                               const bl_args_t* p_args, uint32_t flags) {
+  if (p_sysctx && p_sysctx->p_calls) {
+    const bl_sysctx_t* p_prev = blsys_bind(p_sysctx);
+    bl_status_t status = bootloader_run(p_args, flags);
+    (void)blsys_bind(p_prev);
+    return status;
+  }
+  return bl_status_err_arg;
+}
+#endif  // BL_SYSCALLS_VTABLE
+
 const char* bootloader_status_text(bl_status_t status) {
   static const char* unknown = "unknown";
   int idx = (int)status;
@@ -62,6 +62,10 @@ typedef struct bl_pubkey_set_t {
   const bl_pubkey_t* maintainer_pubkeys;
   /// Size check value for a list of Maintainer public keys
   size_t maintainer_pubkeys_size;
+  /// Sorted fingerprint index of all Vendor and Maintainer keys, or NULL
+  const bl_pubkey_index_entry_t* pubkey_index;
+  /// Size check value for the fingerprint index
+  size_t pubkey_index_size;
   /// Signature threshold for an upgrade file containing the Bootloader
   int bootloader_sig_threshold;
   /// Signature threshold for an upgrade file containing the Main Firmware only
@@ -89,6 +93,27 @@ extern "C" {
  */
 bl_status_t bootloader_run(const bl_args_t* p_args, uint32_t flags);
 
+#ifdef BL_SYSCALLS_VTABLE
+// Context of system calls, defined in bl_syscalls.h
+struct bl_sysctx_t;
+
+/**
+ * Runs an instance of the Bootloader with given system calls
+ *
+ * The context of system calls is bound to the calling thread while the
+ * Bootloader runs. When built with BL_REENTRANT, state of the Bootloader core
+ * is local to each thread, so that instances are able to run in parallel
+ * threads.
+ *
+ * @param p_sysctx  pointer to context of system calls
+ * @param p_args    pointer to argument structure
+ * @param flags     flags, a combination of bits defined in bl_flags_t
+ * @return          exit status
+ */
+bl_status_t bootloader_run_ctx(const struct bl_sysctx_t* p_sysctx,
+                               const bl_args_t* p_args, uint32_t flags);
+#endif  // BL_SYSCALLS_VTABLE
+
 /**
  * Returns a text string corresponding to Bootloader's status
  *
@@ -118,9 +143,6 @@ static inline bool bootloader_has_error(bl_status_t status) {
 #include "bl_section.h"
 #include "bl_syscalls.h"
 
-/// Maximum size of signature section containing payload records
-#define MAX_SIGSECTION_SIZE (32U * 80U)
-
 /// Metadata of a single section
 typedef struct sect_metadata_t {
   /// Header
@@ -137,10 +159,12 @@ typedef struct file_metadata_t {
   sect_metadata_t main_section;
   /// Payload section with the Bootloader
   sect_metadata_t boot_section;
-  /// Signature section
+  /// Delta section patching the Main firmware. When loaded, main_section holds
+  /// the header of target firmware embedded in the Delta section, and its
+  /// payload offset points to the first operation of the patch.
+  sect_metadata_t delta_section;
+  /// Signature section, its payload is read when signatures are verified
   sect_metadata_t sig_section;
-  /// Payload of the Signature section
-  uint8_t sig_payload[MAX_SIGSECTION_SIZE];
 } file_metadata_t;
 
 /// Version information
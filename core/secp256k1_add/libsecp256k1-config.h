@@ -28,7 +28,13 @@
 #define USE_SCALAR_8X32 1
 
 #define ECMULT_GEN_PREC_BITS 4
+/* Window size for multiplication of the generator in verification, may be
+ * selected per platform by the build system */
+#ifdef BL_ECMULT_WINDOW_SIZE
+#define ECMULT_WINDOW_SIZE BL_ECMULT_WINDOW_SIZE
+#else
 #define ECMULT_WINDOW_SIZE 4
+#endif
 
 #define HAVE_STDINT_H 1
 #define HAVE_STDLIB_H 1
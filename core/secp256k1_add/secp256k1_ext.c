@@ -0,0 +1,358 @@
+/**
+ * @file       secp256k1_ext.c
+ * @brief      libsecp256k1 library with extensions used by the Bootloader
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * The library is built as a single translation unit, so its internal field,
+ * group and multi-scalar multiplication functions are accessible only from
+ * the same unit. This file compiles the library and adds BIP-340 Schnorr
+ * signature verification and MuSig2 key aggregation on top of these internal
+ * functions. It replaces "secp256k1.c" of the library in the list of compiled
+ * sources.
+ *
+ * With BL_ECMULT_STATIC_TABLES defined, verification contexts use a constant
+ * table of multiples of the generator from "ecmult_static_pre_g.h", generated
+ * at build time by tools/ecmult-table.py for the configured window size.
+ */
+
+#include "secp256k1.c"
+#include "secp256k1_schnorr_batch.h"
+#include "secp256k1_musig.h"
+#include "secp256k1_verify_ctx.h"
+
+#ifdef BL_ECMULT_STATIC_TABLES
+#include "ecmult_static_pre_g.h"
+
+#if ECMULT_STATIC_PRE_G_WINDOW != ECMULT_WINDOW_SIZE
+#error "Precomputed ecmult table is generated for another window size"
+#endif
+#ifdef USE_ENDOMORPHISM
+#error "Precomputed ecmult table does not support endomorphism"
+#endif
+#endif  // BL_ECMULT_STATIC_TABLES
+
+/// Tag of challenge hash used in BIP-340
+#define SCHNORR_TAG_CHALLENGE "BIP0340/challenge"
+/// Tag of hash used to derive multipliers for batch verification
+#define SCHNORR_TAG_BATCH "BL/batch"
+/// Tag of hash of the list of keys used in MuSig2 key aggregation
+#define MUSIG_TAG_KEYAGG_LIST "KeyAgg list"
+/// Tag of hash of key aggregation coefficient used in MuSig2
+#define MUSIG_TAG_KEYAGG_COEF "KeyAgg coefficient"
+/// Size of a compressed public key
+#define MUSIG_PUBKEY_SIZE 33U
+
+/// Data of a batch of signatures, provided to multi-scalar multiplication
+typedef struct {
+  /// Scalars: -a_i for R_i, and -a_i*e_i for P_i
+  secp256k1_scalar sc[2U * SECP256K1_SCHNORR_BATCH_MAX];
+  /// Points: R_i and P_i
+  secp256k1_ge pt[2U * SECP256K1_SCHNORR_BATCH_MAX];
+} schnorr_batch_t;
+
+/// Keys and their coefficients, provided to multi-scalar multiplication
+typedef struct {
+  /// Scalars: key aggregation coefficients a_i
+  secp256k1_scalar sc[SECP256K1_MUSIG_MAX_KEYS];
+  /// Points: public keys P_i
+  secp256k1_ge pt[SECP256K1_MUSIG_MAX_KEYS];
+} musig_keyagg_t;
+
+/**
+ * Initializes SHA-256 with a BIP-340 tag: SHA256(tag) || SHA256(tag)
+ *
+ * @param sha  SHA-256 object
+ * @param tag  tag string
+ */
+static void schnorr_sha256_tagged(secp256k1_sha256* sha, const char* tag) {
+  unsigned char tag_hash[32];
+  secp256k1_sha256_initialize(sha);
+  secp256k1_sha256_write(sha, (const unsigned char*)tag, strlen(tag));
+  secp256k1_sha256_finalize(sha, tag_hash);
+
+  secp256k1_sha256_initialize(sha);
+  secp256k1_sha256_write(sha, tag_hash, sizeof(tag_hash));
+  secp256k1_sha256_write(sha, tag_hash, sizeof(tag_hash));
+}
+
+/**
+ * Provides points and scalars to secp256k1_ecmult_multi_var()
+ *
+ * @param sc    receives scalar
+ * @param pt    receives point
+ * @param idx   index of the point
+ * @param data  pointer to schnorr_batch_t
+ * @return      always 1
+ */
+static int schnorr_batch_callback(secp256k1_scalar* sc, secp256k1_ge* pt,
+                                  size_t idx, void* data) {
+  const schnorr_batch_t* p_batch = (const schnorr_batch_t*)data;
+  *sc = p_batch->sc[idx];
+  *pt = p_batch->pt[idx];
+  return 1;
+}
+
+/**
+ * Verifies a group of signatures using one multi-scalar multiplication
+ *
+ * @param ctx      secp256k1 context object, initialized for verification
+ * @param scratch  scratch space, or NULL
+ * @param sigs64   array of pointers to 64-byte signatures
+ * @param msgs32   array of pointers to 32-byte messages
+ * @param pubkeys  array of pointers to parsed public keys
+ * @param n_sigs   number of signatures, up to SECP256K1_SCHNORR_BATCH_MAX
+ * @return         1 if all signatures are valid
+ */
+static int schnorr_verify_group(const secp256k1_context* ctx,
+                                secp256k1_scratch* scratch,
+                                const unsigned char* const* sigs64,
+                                const unsigned char* const* msgs32,
+                                const secp256k1_pubkey* const* pubkeys,
+                                size_t n_sigs) {
+  schnorr_batch_t batch;
+  secp256k1_scalar s[SECP256K1_SCHNORR_BATCH_MAX];
+  secp256k1_scalar e[SECP256K1_SCHNORR_BATCH_MAX];
+  secp256k1_sha256 seed_sha;
+  unsigned char seed[32];
+
+  // Parse signatures and keys, computing challenges and the seed
+  schnorr_sha256_tagged(&seed_sha, SCHNORR_TAG_BATCH);
+  for (size_t i = 0U; i < n_sigs; ++i) {
+    secp256k1_ge* p_r = &batch.pt[2U * i];
+    secp256k1_ge* p_p = &batch.pt[2U * i + 1U];
+    secp256k1_fe rx;
+    unsigned char px[32];
+    unsigned char buf[32];
+    int overflow = 0;
+
+    // R is the point with X = r and even Y, r < p; s < n
+    if (!secp256k1_fe_set_b32(&rx, &sigs64[i][0]) ||
+        !secp256k1_ge_set_xo_var(p_r, &rx, 0)) {
+      return 0;
+    }
+    secp256k1_scalar_set_b32(&s[i], &sigs64[i][32], &overflow);
+    if (overflow) {
+      return 0;
+    }
+
+    // P is the public key lifted to even Y
+    if (!secp256k1_pubkey_load(ctx, p_p, pubkeys[i])) {
+      return 0;
+    }
+    secp256k1_fe_normalize_var(&p_p->x);
+    secp256k1_fe_normalize_var(&p_p->y);
+    if (secp256k1_fe_is_odd(&p_p->y)) {
+      secp256k1_ge_neg(p_p, p_p);
+    }
+    secp256k1_fe_get_b32(px, &p_p->x);
+
+    // e = int(hash_challenge(r || px || m)) mod n
+    secp256k1_sha256 sha;
+    schnorr_sha256_tagged(&sha, SCHNORR_TAG_CHALLENGE);
+    secp256k1_sha256_write(&sha, &sigs64[i][0], 32U);
+    secp256k1_sha256_write(&sha, px, sizeof(px));
+    secp256k1_sha256_write(&sha, msgs32[i], SECP256K1_SCHNORR_MSG_SIZE);
+    secp256k1_sha256_finalize(&sha, buf);
+    secp256k1_scalar_set_b32(&e[i], buf, NULL);
+
+    secp256k1_sha256_write(&seed_sha, sigs64[i], SECP256K1_SCHNORR_SIG_SIZE);
+    secp256k1_sha256_write(&seed_sha, px, sizeof(px));
+    secp256k1_sha256_write(&seed_sha, msgs32[i], SECP256K1_SCHNORR_MSG_SIZE);
+  }
+  secp256k1_sha256_finalize(&seed_sha, seed);
+
+  // Compute scalars with multipliers a_1 = 1, a_i = hash(seed || i)
+  secp256k1_scalar g_sc;
+  secp256k1_scalar_set_int(&g_sc, 0);
+  for (size_t i = 0U; i < n_sigs; ++i) {
+    secp256k1_scalar a;
+    secp256k1_scalar tmp;
+    if (i == 0U) {
+      secp256k1_scalar_set_int(&a, 1);
+    } else {
+      unsigned char idx_le[4] = {(unsigned char)i, (unsigned char)(i >> 8),
+                                 (unsigned char)(i >> 16),
+                                 (unsigned char)(i >> 24)};
+      unsigned char buf[32];
+      secp256k1_sha256 sha;
+      secp256k1_sha256_initialize(&sha);
+      secp256k1_sha256_write(&sha, seed, sizeof(seed));
+      secp256k1_sha256_write(&sha, idx_le, sizeof(idx_le));
+      secp256k1_sha256_finalize(&sha, buf);
+      secp256k1_scalar_set_b32(&a, buf, NULL);
+    }
+    secp256k1_scalar_mul(&tmp, &a, &s[i]);
+    secp256k1_scalar_add(&g_sc, &g_sc, &tmp);
+    secp256k1_scalar_negate(&batch.sc[2U * i], &a);
+    secp256k1_scalar_mul(&tmp, &a, &e[i]);
+    secp256k1_scalar_negate(&batch.sc[2U * i + 1U], &tmp);
+  }
+
+  // Sum must be the point at infinity. If the scratch space is too small even
+  // for one point, the points are multiplied one by one without it.
+  secp256k1_gej result;
+  if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx,
+                                  scratch, &result, &g_sc,
+                                  schnorr_batch_callback, &batch,
+                                  2U * n_sigs) &&
+      !secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx,
+                                  NULL, &result, &g_sc,
+                                  schnorr_batch_callback, &batch,
+                                  2U * n_sigs)) {
+    return 0;
+  }
+  return secp256k1_gej_is_infinity(&result);
+}
+
+/**
+ * Provides public keys and coefficients to secp256k1_ecmult_multi_var()
+ *
+ * @param sc    receives scalar
+ * @param pt    receives point
+ * @param idx   index of the point
+ * @param data  pointer to musig_keyagg_t
+ * @return      always 1
+ */
+static int musig_keyagg_callback(secp256k1_scalar* sc, secp256k1_ge* pt,
+                                 size_t idx, void* data) {
+  const musig_keyagg_t* p_keyagg = (const musig_keyagg_t*)data;
+  *sc = p_keyagg->sc[idx];
+  *pt = p_keyagg->pt[idx];
+  return 1;
+}
+
+secp256k1_scratch_space* secp256k1_schnorr_scratch_create_preallocated(
+    void* prealloc, size_t size) {
+  size_t base_size = ROUND_TO_ALIGN(sizeof(secp256k1_scratch));
+  if (prealloc && size > base_size) {
+    secp256k1_scratch* ret = (secp256k1_scratch*)prealloc;
+    memset(ret, 0, sizeof(*ret));
+    memcpy(ret->magic, "scratch", 8);
+    ret->data = (unsigned char*)prealloc + base_size;
+    ret->max_size = size - base_size;
+    return ret;
+  }
+  return NULL;
+}
+
+int secp256k1_schnorr_verify_batch(const secp256k1_context* ctx,
+                                   secp256k1_scratch_space* scratch,
+                                   const unsigned char* const* sigs64,
+                                   const unsigned char* const* msgs32,
+                                   const secp256k1_pubkey* const* pubkeys,
+                                   size_t n_sigs) {
+  VERIFY_CHECK(ctx != NULL);
+  ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+  ARG_CHECK(n_sigs == 0 || (sigs64 != NULL && msgs32 != NULL &&
+                            pubkeys != NULL));
+
+  for (size_t base = 0U; base < n_sigs; base += SECP256K1_SCHNORR_BATCH_MAX) {
+    size_t n_group = n_sigs - base;
+    if (n_group > SECP256K1_SCHNORR_BATCH_MAX) {
+      n_group = SECP256K1_SCHNORR_BATCH_MAX;
+    }
+    if (!schnorr_verify_group(ctx, scratch, &sigs64[base], &msgs32[base],
+                              &pubkeys[base], n_group)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int secp256k1_musig_pubkey_agg(const secp256k1_context* ctx,
+                               secp256k1_scratch_space* scratch,
+                               secp256k1_pubkey* agg_pk,
+                               const secp256k1_pubkey* const* pubkeys,
+                               size_t n_pubkeys) {
+  musig_keyagg_t keyagg;
+  unsigned char ser[SECP256K1_MUSIG_MAX_KEYS][MUSIG_PUBKEY_SIZE];
+  unsigned char list_hash[32];
+  secp256k1_sha256 sha;
+  size_t second = n_pubkeys;
+
+  VERIFY_CHECK(ctx != NULL);
+  ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+  ARG_CHECK(agg_pk != NULL);
+  memset(agg_pk, 0, sizeof(*agg_pk));
+  ARG_CHECK(pubkeys != NULL);
+  ARG_CHECK(n_pubkeys > 0U && n_pubkeys <= SECP256K1_MUSIG_MAX_KEYS);
+
+  // Load keys, hashing them in compressed form: L = hash_keys(pk_1..pk_u)
+  schnorr_sha256_tagged(&sha, MUSIG_TAG_KEYAGG_LIST);
+  for (size_t i = 0U; i < n_pubkeys; ++i) {
+    size_t ser_len = MUSIG_PUBKEY_SIZE;
+    if (!secp256k1_pubkey_load(ctx, &keyagg.pt[i], pubkeys[i]) ||
+        !secp256k1_eckey_pubkey_serialize(&keyagg.pt[i], ser[i], &ser_len,
+                                          1)) {
+      return 0;
+    }
+    secp256k1_sha256_write(&sha, ser[i], MUSIG_PUBKEY_SIZE);
+    // The second distinct key gets coefficient 1
+    if (second == n_pubkeys && memcmp(ser[i], ser[0], MUSIG_PUBKEY_SIZE)) {
+      second = i;
+    }
+  }
+  secp256k1_sha256_finalize(&sha, list_hash);
+
+  // a_i = int(hash_agg(L || pk_i)) mod n
+  for (size_t i = 0U; i < n_pubkeys; ++i) {
+    if (second != n_pubkeys &&
+        0 == memcmp(ser[i], ser[second], MUSIG_PUBKEY_SIZE)) {
+      secp256k1_scalar_set_int(&keyagg.sc[i], 1);
+    } else {
+      unsigned char buf[32];
+      schnorr_sha256_tagged(&sha, MUSIG_TAG_KEYAGG_COEF);
+      secp256k1_sha256_write(&sha, list_hash, sizeof(list_hash));
+      secp256k1_sha256_write(&sha, ser[i], MUSIG_PUBKEY_SIZE);
+      secp256k1_sha256_finalize(&sha, buf);
+      secp256k1_scalar_set_b32(&keyagg.sc[i], buf, NULL);
+    }
+  }
+
+  // Q = a_1*P_1 + ... + a_u*P_u
+  secp256k1_scalar zero;
+  secp256k1_gej result;
+  secp256k1_ge result_ge;
+  secp256k1_scalar_set_int(&zero, 0);
+  if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx,
+                                  scratch, &result, &zero,
+                                  musig_keyagg_callback, &keyagg, n_pubkeys) &&
+      !secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx,
+                                  NULL, &result, &zero, musig_keyagg_callback,
+                                  &keyagg, n_pubkeys)) {
+    return 0;
+  }
+  if (secp256k1_gej_is_infinity(&result)) {
+    return 0;
+  }
+  secp256k1_ge_set_gej(&result_ge, &result);
+  secp256k1_pubkey_save(agg_pk, &result_ge);
+  return 1;
+}
+
+size_t secp256k1_verify_context_preallocated_size(void) {
+#ifdef BL_ECMULT_STATIC_TABLES
+  return secp256k1_context_preallocated_size(SECP256K1_CONTEXT_NONE);
+#else
+  return secp256k1_context_preallocated_size(SECP256K1_CONTEXT_VERIFY);
+#endif
+}
+
+secp256k1_context* secp256k1_verify_context_preallocated_create(
+    void* prealloc) {
+#ifdef BL_ECMULT_STATIC_TABLES
+  secp256k1_context* ctx =
+      secp256k1_context_preallocated_create(prealloc, SECP256K1_CONTEXT_NONE);
+  if (ctx) {
+    // The library only reads the table, and on destruction of the context it
+    // just resets the pointer, so constant data is safe to use here
+    ctx->ecmult_ctx.pre_g =
+        (secp256k1_ge_storage(*)[])secp256k1_ecmult_static_pre_g;
+  }
+  return ctx;
+#else
+  return secp256k1_context_preallocated_create(prealloc,
+                                               SECP256K1_CONTEXT_VERIFY);
+#endif
+}
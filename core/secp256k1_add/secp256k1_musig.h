@@ -0,0 +1,53 @@
+/**
+ * @file       secp256k1_musig.h
+ * @brief      MuSig2 key aggregation (BIP-327) for libsecp256k1
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef SECP256K1_MUSIG_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define SECP256K1_MUSIG_H_INCLUDED
+
+#include <stddef.h>
+#include "secp256k1.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum number of public keys aggregated into one key
+#define SECP256K1_MUSIG_MAX_KEYS 16U
+
+/**
+ * Aggregates public keys according to KeyAgg algorithm of BIP-327
+ *
+ * The aggregate key is the sum of a_i*P_i, where multipliers a_i are derived
+ * from the hash of all keys serialized in compressed form, in the given order.
+ * The sum is calculated with a single multi-scalar multiplication. Tweaking
+ * of the aggregate key is not supported.
+ *
+ * A BIP-340 Schnorr signature made by all signers using MuSig2 is verified as
+ * an ordinary signature with the aggregate key, for example with
+ * secp256k1_schnorr_verify_batch().
+ *
+ * @param ctx        secp256k1 context object, initialized for verification
+ * @param scratch    scratch space used for multi-scalar multiplication, or
+ *                   NULL to perform a separate multiplication for each key
+ * @param agg_pk     receives aggregate public key
+ * @param pubkeys    array of pointers to public keys
+ * @param n_pubkeys  number of public keys, from 1 to SECP256K1_MUSIG_MAX_KEYS
+ * @return           1 if successful, 0 if arguments are invalid or the sum is
+ *                   the point at infinity
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_musig_pubkey_agg(
+    const secp256k1_context* ctx, secp256k1_scratch_space* scratch,
+    secp256k1_pubkey* agg_pk, const secp256k1_pubkey* const* pubkeys,
+    size_t n_pubkeys) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(3)
+    SECP256K1_ARG_NONNULL(4);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SECP256K1_MUSIG_H_INCLUDED
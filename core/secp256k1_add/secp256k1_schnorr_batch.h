@@ -0,0 +1,79 @@
+/**
+ * @file       secp256k1_schnorr_batch.h
+ * @brief      BIP-340 Schnorr signature verification for libsecp256k1
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef SECP256K1_SCHNORR_BATCH_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define SECP256K1_SCHNORR_BATCH_H_INCLUDED
+
+#include <stddef.h>
+#include "secp256k1.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size of a BIP-340 Schnorr signature in bytes
+#define SECP256K1_SCHNORR_SIG_SIZE 64U
+/// Size of a message signed with BIP-340 Schnorr signature in bytes
+#define SECP256K1_SCHNORR_MSG_SIZE 32U
+/// Maximum number of signatures verified with one multi-scalar multiplication
+#define SECP256K1_SCHNORR_BATCH_MAX 8U
+
+/**
+ * Creates a scratch space inside a caller-provided buffer
+ *
+ * The scratch space is used by multi-scalar multiplication performed in batch
+ * verification. The scratch space object itself is placed at the beginning of
+ * the buffer, so nothing is allocated dynamically. The buffer must remain
+ * valid for the whole life time of the scratch space and does not need to be
+ * destroyed.
+ *
+ * @param prealloc  pointer to buffer, aligned at least to pointer size
+ * @param size      size of the buffer in bytes
+ * @return          pointer to scratch space object, or NULL if the buffer is
+ *                  too small
+ */
+SECP256K1_API secp256k1_scratch_space*
+secp256k1_schnorr_scratch_create_preallocated(void* prealloc, size_t size)
+    SECP256K1_ARG_NONNULL(1);
+
+/**
+ * Verifies a batch of BIP-340 Schnorr signatures
+ *
+ * All signatures are verified at once with a single multi-scalar
+ * multiplication, checking that (a_1*s_1 + ... + a_n*s_n)*G equals the sum
+ * of a_i*R_i + a_i*e_i*P_i, where a_i are pseudo-random multipliers derived
+ * from all inputs and a_1 is 1. A batch of one signature is equivalent to
+ * normal BIP-340 verification. Signatures are processed in groups of
+ * SECP256K1_SCHNORR_BATCH_MAX items.
+ *
+ * Public keys are regular secp256k1 public keys. Only X coordinate is used,
+ * as specified by BIP-340 for X-only public keys.
+ *
+ * @param ctx      secp256k1 context object, initialized for verification
+ * @param scratch  scratch space used for multi-scalar multiplication, or NULL
+ *                 to perform a separate multiplication for each point
+ * @param sigs64   array of pointers to 64-byte signatures
+ * @param msgs32   array of pointers to 32-byte messages
+ * @param pubkeys  array of pointers to parsed public keys
+ * @param n_sigs   number of signatures, messages and public keys
+ * @return         1 if all signatures are valid, 0 if any of signatures is
+ *                 invalid
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int
+secp256k1_schnorr_verify_batch(const secp256k1_context* ctx,
+                               secp256k1_scratch_space* scratch,
+                               const unsigned char* const* sigs64,
+                               const unsigned char* const* msgs32,
+                               const secp256k1_pubkey* const* pubkeys,
+                               size_t n_sigs) SECP256K1_ARG_NONNULL(1);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SECP256K1_SCHNORR_BATCH_H_INCLUDED
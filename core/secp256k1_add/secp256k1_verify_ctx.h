@@ -0,0 +1,49 @@
+/**
+ * @file       secp256k1_verify_ctx.h
+ * @brief      Verification context of libsecp256k1 with optional static
+ *             precomputed tables
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef SECP256K1_VERIFY_CTX_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define SECP256K1_VERIFY_CTX_H_INCLUDED
+
+#include <stddef.h>
+#include "secp256k1.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Returns size of memory needed for a verification context
+ *
+ * When the library is built with BL_ECMULT_STATIC_TABLES, the table of
+ * multiples of the generator is constant data generated at build time, and
+ * the context includes only a few pointers. Otherwise the table, having
+ * 2^(ECMULT_WINDOW_SIZE - 2) entries of 64 bytes, is a part of the context.
+ *
+ * @return  required size of memory in bytes
+ */
+SECP256K1_API size_t secp256k1_verify_context_preallocated_size(void);
+
+/**
+ * Creates a context object initialized for signature verification
+ *
+ * The context is destroyed with secp256k1_context_preallocated_destroy().
+ *
+ * @param prealloc  pointer to a memory block of at least
+ *                  secp256k1_verify_context_preallocated_size() bytes,
+ *                  aligned as for malloc()
+ * @return          newly created context object, or NULL on failure
+ */
+SECP256K1_API secp256k1_context* secp256k1_verify_context_preallocated_create(
+    void* prealloc) SECP256K1_ARG_NONNULL(1);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SECP256K1_VERIFY_CTX_H_INCLUDED
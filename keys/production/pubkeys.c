@@ -106,11 +106,51 @@ static const bl_pubkey_t maintainer_pubkey_list[] = {
                0xbaU, 0x7eU}},
     BL_PUBKEY_END_OF_LIST};
 
+// BEGIN PUBKEY INDEX
+// Fingerprint index of all public keys, sorted by fingerprint.
+// A key present in several lists has an entry for each list.
+// Generated by tools/pubkey-index.py, do not edit.
+static const bl_pubkey_index_entry_t pubkey_index[] = {
+    {.fingerprint = {0x33U, 0x79U, 0x31U, 0x41U, 0xD1U, 0x55U, 0x7BU, 0xC6U,
+                     0xB4U, 0x24U, 0x9EU, 0x0BU, 0xE8U, 0xEFU, 0x6BU, 0x46U},
+     .p_pubkey = &vendor_pubkey_list[1]},
+    {.fingerprint = {0x33U, 0x79U, 0x31U, 0x41U, 0xD1U, 0x55U, 0x7BU, 0xC6U,
+                     0xB4U, 0x24U, 0x9EU, 0x0BU, 0xE8U, 0xEFU, 0x6BU, 0x46U},
+     .p_pubkey = &maintainer_pubkey_list[1]},
+    {.fingerprint = {0x77U, 0x8CU, 0x17U, 0xA7U, 0xAEU, 0xB4U, 0xCBU, 0x01U,
+                     0x39U, 0x98U, 0xA2U, 0x3EU, 0xEBU, 0x57U, 0x53U, 0x61U},
+     .p_pubkey = &vendor_pubkey_list[2]},
+    {.fingerprint = {0x77U, 0x8CU, 0x17U, 0xA7U, 0xAEU, 0xB4U, 0xCBU, 0x01U,
+                     0x39U, 0x98U, 0xA2U, 0x3EU, 0xEBU, 0x57U, 0x53U, 0x61U},
+     .p_pubkey = &maintainer_pubkey_list[2]},
+    {.fingerprint = {0x7CU, 0x5DU, 0xE6U, 0xA7U, 0x1DU, 0x2AU, 0xBAU, 0xE5U,
+                     0x63U, 0x94U, 0x5EU, 0x05U, 0xD7U, 0x67U, 0x62U, 0x6AU},
+     .p_pubkey = &vendor_pubkey_list[4]},
+    {.fingerprint = {0x7CU, 0x5DU, 0xE6U, 0xA7U, 0x1DU, 0x2AU, 0xBAU, 0xE5U,
+                     0x63U, 0x94U, 0x5EU, 0x05U, 0xD7U, 0x67U, 0x62U, 0x6AU},
+     .p_pubkey = &maintainer_pubkey_list[4]},
+    {.fingerprint = {0xCFU, 0x02U, 0x39U, 0xE7U, 0x70U, 0x81U, 0x48U, 0xC0U,
+                     0xFEU, 0x2BU, 0xC1U, 0xFFU, 0x48U, 0x5DU, 0x95U, 0x0EU},
+     .p_pubkey = &vendor_pubkey_list[0]},
+    {.fingerprint = {0xCFU, 0x02U, 0x39U, 0xE7U, 0x70U, 0x81U, 0x48U, 0xC0U,
+                     0xFEU, 0x2BU, 0xC1U, 0xFFU, 0x48U, 0x5DU, 0x95U, 0x0EU},
+     .p_pubkey = &maintainer_pubkey_list[0]},
+    {.fingerprint = {0xD0U, 0x7BU, 0x34U, 0x02U, 0x98U, 0x7DU, 0x8DU, 0x72U,
+                     0x26U, 0x86U, 0x99U, 0x5FU, 0x98U, 0x49U, 0x74U, 0x01U},
+     .p_pubkey = &vendor_pubkey_list[3]},
+    {.fingerprint = {0xD0U, 0x7BU, 0x34U, 0x02U, 0x98U, 0x7DU, 0x8DU, 0x72U,
+                     0x26U, 0x86U, 0x99U, 0x5FU, 0x98U, 0x49U, 0x74U, 0x01U},
+     .p_pubkey = &maintainer_pubkey_list[3]},
+};
+// END PUBKEY INDEX
+
 // Production set of public keys and signature thresholds
 const bl_pubkey_set_t bl_pubkey_set = {
     .vendor_pubkeys = vendor_pubkey_list,
     .vendor_pubkeys_size = sizeof(vendor_pubkey_list),
     .maintainer_pubkeys = maintainer_pubkey_list,
     .maintainer_pubkeys_size = sizeof(maintainer_pubkey_list),
+    .pubkey_index = pubkey_index,
+    .pubkey_index_size = sizeof(pubkey_index),
     .bootloader_sig_threshold = 2,
     .main_fw_sig_threshold = 2};
@@ -153,11 +153,63 @@ static const bl_pubkey_t maintainer_pubkey_list[] = {
                0xCBU, 0xE2U}},
     BL_PUBKEY_END_OF_LIST};
 
+// BEGIN PUBKEY INDEX
+// Fingerprint index of all public keys, sorted by fingerprint.
+// A key present in several lists has an entry for each list.
+// Generated by tools/pubkey-index.py, do not edit.
+static const bl_pubkey_index_entry_t pubkey_index[] = {
+    {.fingerprint = {0x00U, 0xA6U, 0x2FU, 0x48U, 0x45U, 0x95U, 0xD7U, 0x61U,
+                     0xC1U, 0xC9U, 0x1CU, 0xE6U, 0xCAU, 0x8CU, 0xF6U, 0x57U},
+     .p_pubkey = &maintainer_pubkey_list[0]},
+    {.fingerprint = {0x1FU, 0x3EU, 0x97U, 0x94U, 0x8CU, 0x49U, 0xEAU, 0xDEU,
+                     0xE1U, 0xC9U, 0xECU, 0x6DU, 0x01U, 0xD5U, 0xEAU, 0x5FU},
+     .p_pubkey = &vendor_pubkey_list[7]},
+    {.fingerprint = {0x25U, 0x20U, 0xF6U, 0x4AU, 0x5DU, 0x60U, 0xD3U, 0x69U,
+                     0x51U, 0x31U, 0xA6U, 0x24U, 0x16U, 0x9FU, 0x95U, 0x9AU},
+     .p_pubkey = &vendor_pubkey_list[2]},
+    {.fingerprint = {0x3FU, 0x2AU, 0x2EU, 0x5FU, 0x66U, 0x21U, 0xD5U, 0xE3U,
+                     0x67U, 0xCAU, 0x5FU, 0xEEU, 0x48U, 0xB3U, 0x08U, 0x55U},
+     .p_pubkey = &maintainer_pubkey_list[4]},
+    {.fingerprint = {0x52U, 0x5DU, 0x97U, 0x29U, 0x8FU, 0xE6U, 0xDEU, 0x57U,
+                     0xDCU, 0x56U, 0x54U, 0x61U, 0xCCU, 0x83U, 0x96U, 0x95U},
+     .p_pubkey = &maintainer_pubkey_list[3]},
+    {.fingerprint = {0x56U, 0xF5U, 0x8BU, 0x50U, 0x45U, 0xA7U, 0xDDU, 0xB9U,
+                     0x6CU, 0x5EU, 0x28U, 0x99U, 0xD3U, 0x61U, 0xE2U, 0x34U},
+     .p_pubkey = &vendor_pubkey_list[3]},
+    {.fingerprint = {0x5DU, 0x49U, 0x19U, 0x9DU, 0x99U, 0xFDU, 0xF1U, 0x2BU,
+                     0xB2U, 0x45U, 0x24U, 0x96U, 0xFFU, 0x88U, 0x5CU, 0x9DU},
+     .p_pubkey = &vendor_pubkey_list[8]},
+    {.fingerprint = {0x64U, 0x62U, 0x5CU, 0x21U, 0x10U, 0x98U, 0xB0U, 0x96U,
+                     0xB4U, 0x71U, 0x89U, 0x41U, 0x5EU, 0x57U, 0x20U, 0x93U},
+     .p_pubkey = &vendor_pubkey_list[1]},
+    {.fingerprint = {0x8CU, 0x08U, 0x94U, 0x8DU, 0x85U, 0x6EU, 0x23U, 0xEEU,
+                     0xA0U, 0xDAU, 0x53U, 0x94U, 0xEBU, 0x00U, 0x6BU, 0x1CU},
+     .p_pubkey = &vendor_pubkey_list[4]},
+    {.fingerprint = {0xB2U, 0x55U, 0x4CU, 0xA3U, 0xC7U, 0xB5U, 0x1EU, 0x2BU,
+                     0x65U, 0xB4U, 0x01U, 0xE6U, 0x9CU, 0x86U, 0xADU, 0x35U},
+     .p_pubkey = &vendor_pubkey_list[5]},
+    {.fingerprint = {0xBBU, 0xBBU, 0x4EU, 0xF2U, 0xCAU, 0x06U, 0x94U, 0x23U,
+                     0x22U, 0x3BU, 0x63U, 0xD8U, 0xEEU, 0xBBU, 0x0EU, 0x6DU},
+     .p_pubkey = &vendor_pubkey_list[6]},
+    {.fingerprint = {0xBDU, 0xA0U, 0x96U, 0x74U, 0x44U, 0x54U, 0x6CU, 0x3CU,
+                     0x9BU, 0x3DU, 0x0EU, 0x69U, 0x3AU, 0x31U, 0x39U, 0xBDU},
+     .p_pubkey = &maintainer_pubkey_list[1]},
+    {.fingerprint = {0xBDU, 0xE5U, 0x28U, 0x6AU, 0x94U, 0x6BU, 0x24U, 0x03U,
+                     0x03U, 0xFEU, 0x1EU, 0x8BU, 0x04U, 0xC2U, 0xF2U, 0x8DU},
+     .p_pubkey = &maintainer_pubkey_list[2]},
+    {.fingerprint = {0xE5U, 0xCDU, 0x36U, 0x99U, 0x5BU, 0x54U, 0xF8U, 0x91U,
+                     0x98U, 0x24U, 0xE5U, 0x2FU, 0xE9U, 0x8CU, 0xF6U, 0x0EU},
+     .p_pubkey = &vendor_pubkey_list[0]},
+};
+// END PUBKEY INDEX
+
 // Test set of public keys and signature thresholds
 const bl_pubkey_set_t bl_pubkey_set = {
     .vendor_pubkeys = vendor_pubkey_list,
     .vendor_pubkeys_size = sizeof(vendor_pubkey_list),
     .maintainer_pubkeys = maintainer_pubkey_list,
     .maintainer_pubkeys_size = sizeof(maintainer_pubkey_list),
+    .pubkey_index = pubkey_index,
+    .pubkey_index_size = sizeof(pubkey_index),
     .bootloader_sig_threshold = 2,
     .main_fw_sig_threshold = 3};
@@ -15,6 +15,10 @@
  *   - Removed definition of prefetch macros (not used in remaining functions)
  *   - MaxSlice constant changed to MAX_SLICE define
  *   - Added compile optimisation attribute to core functions
+ *   - Added hardware accelerated kernels (PCLMULQDQ folding on x86-64, ARMv8
+ *     CRC32 instructions on AArch64) with run-time dispatch in crc32_fast()
+ *   - Added crc32_shift() and crc32_combine() based on polynomial arithmetic
+ *     in GF(2), as in zlib by Mark Adler
  *
  * GitHub repository of original implementation by Stephan Brumme:
  * https://github.com/stbrumme/crc32
@@ -332,8 +336,8 @@ static uint32_t ATTR_OPT crc32_16bytes(const void* data, size_t length,
 }
 #endif // CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
 
-// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
-uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
+// compute CRC32 using the table-driven algorithm selected at build time
+uint32_t crc32_table(const void* data, size_t length, uint32_t previousCrc32)
 {
 #ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
   return crc32_16bytes (data, length, previousCrc32);
@@ -348,6 +352,278 @@ uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 #endif
 }
 
+// hardware accelerated kernels, only for hosted builds requesting them
+#if defined(CRC32_USE_HW_ACCEL) && (defined(__GNUC__) || defined(__clang__))
+  #if defined(__x86_64__)
+    #define CRC32_HW_PCLMUL
+  #elif defined(__aarch64__) && defined(__linux__) && \
+        __BYTE_ORDER == __LITTLE_ENDIAN
+    #define CRC32_HW_ARMV8
+  #endif
+#endif
+
+#ifdef CRC32_HW_PCLMUL
+#include <immintrin.h>
+
+/// Target attribute enabling carry-less multiplication intrinsics
+#define ATTR_HW         __attribute__((target("pclmul,sse4.1")))
+
+/**
+ * compute CRC32 by folding 64-byte blocks with carry-less multiplication
+ *
+ * Algorithm from Intel's "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction" white paper, bit-reflected variant. Length must be
+ * at least 64 and a multiple of 16, CRC is passed and returned inverted.
+ */
+static uint32_t ATTR_OPT ATTR_HW crc32_pclmul_fold(const uint8_t* current,
+                                                   size_t length, uint32_t crc)
+{
+  // folding constants x^(n*32) mod P(x) and Barrett reduction constants
+  static const uint64_t k1k2[2] __attribute__((aligned(16))) =
+    { 0x0154442BD4ULL, 0x01C6E41596ULL };
+  static const uint64_t k3k4[2] __attribute__((aligned(16))) =
+    { 0x01751997D0ULL, 0x00CCAA009EULL };
+  static const uint64_t k5k0[2] __attribute__((aligned(16))) =
+    { 0x0163CD6124ULL, 0x0000000000ULL };
+  static const uint64_t poly[2] __attribute__((aligned(16))) =
+    { 0x01DB710641ULL, 0x01F7011641ULL };
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+  x1 = _mm_loadu_si128((const __m128i*)(current + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(current + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(current + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(current + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  x0 = _mm_load_si128((const __m128i*)k1k2);
+  current += 64;
+  length  -= 64;
+
+  // fold four 128-bit lanes in parallel
+  while (length >= 64)
+  {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    y5 = _mm_loadu_si128((const __m128i*)(current + 0x00));
+    y6 = _mm_loadu_si128((const __m128i*)(current + 0x10));
+    y7 = _mm_loadu_si128((const __m128i*)(current + 0x20));
+    y8 = _mm_loadu_si128((const __m128i*)(current + 0x30));
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+    current += 64;
+    length  -= 64;
+  }
+
+  // fold four lanes into one
+  x0 = _mm_load_si128((const __m128i*)k3k4);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // fold remaining 16-byte blocks
+  while (length >= 16)
+  {
+    x2 = _mm_loadu_si128((const __m128i*)current);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    current += 16;
+    length  -= 16;
+  }
+
+  // reduce 128 bits to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  x0 = _mm_load_si128((const __m128i*)poly);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+/// compute CRC32 (PCLMULQDQ folding, table-driven head and tail)
+static uint32_t crc32_hw(const void* data, size_t length,
+                         uint32_t previousCrc32)
+{
+  const uint8_t* current = (const uint8_t*) data;
+
+  if (length >= 64)
+  {
+    size_t chunk = length & ~(size_t)15U;
+    previousCrc32 = ~crc32_pclmul_fold(current, chunk, ~previousCrc32);
+    current += chunk;
+    length  -= chunk;
+  }
+  return crc32_table(current, length, previousCrc32);
+}
+
+/// checks if CPU supports instructions used by crc32_hw()
+static int crc32_hw_detect(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif // CRC32_HW_PCLMUL
+
+#ifdef CRC32_HW_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+
+#ifndef HWCAP_CRC32
+  #define HWCAP_CRC32     (1UL << 7)
+#endif
+
+#ifdef __clang__
+  /// Target attribute enabling ARMv8 CRC32 intrinsics
+  #define ATTR_HW         __attribute__((target("crc")))
+#else
+  /// Target attribute enabling ARMv8 CRC32 intrinsics
+  #define ATTR_HW         __attribute__((target("+crc")))
+#endif
+
+/// compute CRC32 (ARMv8 CRC32 instructions, 8 bytes at once)
+static uint32_t ATTR_OPT ATTR_HW crc32_hw(const void* data, size_t length,
+                                          uint32_t previousCrc32)
+{
+  uint32_t crc = ~previousCrc32; // same as previousCrc32 ^ 0xFFFFFFFF
+  const uint8_t* current = (const uint8_t*) data;
+
+  // align to 8 bytes
+  while (length != 0 && ((uintptr_t)current & 7U) != 0)
+  {
+    crc = __crc32b(crc, *current++);
+    length--;
+  }
+
+  const uint64_t* current64 = (const uint64_t*) current;
+  while (length >= 8)
+  {
+    crc = __crc32d(crc, *current64++);
+    length -= 8;
+  }
+
+  current = (const uint8_t*) current64;
+  while (length-- != 0)
+    crc = __crc32b(crc, *current++);
+
+  return ~crc; // same as crc ^ 0xFFFFFFFF
+}
+
+/// checks if CPU supports instructions used by crc32_hw()
+static int crc32_hw_detect(void)
+{
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif // CRC32_HW_ARMV8
+
+#if defined(CRC32_HW_PCLMUL) || defined(CRC32_HW_ARMV8)
+/// Pointer to CRC32 function selected at run time
+typedef uint32_t (*crc32_func_t)(const void*, size_t, uint32_t);
+
+/// Selected CRC32 implementation, NULL until the first call
+static crc32_func_t crc32_impl = NULL;
+
+/// selects CRC32 implementation depending on CPU features
+static crc32_func_t crc32_select(void)
+{
+  // Races are benign: every thread selects the same function
+  if (!crc32_impl)
+    crc32_impl = crc32_hw_detect() ? crc32_hw : crc32_table;
+  return crc32_impl;
+}
+#endif
+
+// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
+uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
+{
+#if defined(CRC32_HW_PCLMUL) || defined(CRC32_HW_ARMV8)
+  return crc32_select()(data, length, previousCrc32);
+#else
+  return crc32_table(data, length, previousCrc32);
+#endif
+}
+
+// tell if crc32_fast() uses a hardware accelerated kernel
+int crc32_hw_accelerated(void)
+{
+#if defined(CRC32_HW_PCLMUL) || defined(CRC32_HW_ARMV8)
+  return crc32_select() != crc32_table;
+#else
+  return 0;
+#endif
+}
+
+/// CRC32 polynomial, reflected
+#define CRC32_POLY_REFLECTED  0xEDB88320U
+/// x^8 (shift by one byte) in reflected representation
+#define CRC32_X8_REFLECTED    0x00800000U
+
+/// multiply two polynomials modulo CRC32 polynomial, both in reflected form
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+  uint32_t m = 1U << 31;
+  uint32_t p = 0U;
+  for (;;)
+  {
+    if (a & m)
+    {
+      p ^= b;
+      if ((a & (m - 1U)) == 0U)
+        break;
+    }
+    m >>= 1;
+    b = (b & 1U) ? (b >> 1) ^ CRC32_POLY_REFLECTED : b >> 1;
+  }
+  return p;
+}
+
+// multiply the CRC register by x^(8n) mod P, where n is the number of bytes
+uint32_t crc32_shift(uint32_t crc, size_t length)
+{
+  // x^(8 * 2^k) is squared on each step, multiplied in for each set bit
+  uint32_t x2k = CRC32_X8_REFLECTED;
+  while (length != 0U && crc != 0U)
+  {
+    if (length & 1U)
+      crc = crc32_multmodp(x2k, crc);
+    length >>= 1;
+    if (length != 0U)
+      x2k = crc32_multmodp(x2k, x2k);
+  }
+  return crc;
+}
+
+// combine CRC32 of two consecutive blocks
+uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
+{
+  return crc32_shift(crcA, lengthB) ^ crcB;
+}
+
 #ifndef NO_LUT
 /// look-up table, already declared above
 const uint32_t Crc32Lookup[MAX_SLICE][256] =
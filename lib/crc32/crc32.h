@@ -26,6 +26,56 @@ extern "C" {
  */
 uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32);
 
+/**
+ * Computes CRC32 using only the table-driven algorithm selected at build time
+ *
+ * Produces the same result as crc32_fast(), but never uses a hardware
+ * accelerated kernel. Intended as a reference for cross-checking.
+ *
+ * @param data           data block to process
+ * @param length         length of data block to brocess
+ * @param previousCrc32  previous CRC value or 0 for the first block
+ * @return uint32_t
+ */
+uint32_t crc32_table(const void* data, size_t length, uint32_t previousCrc32);
+
+/**
+ * Tells if crc32_fast() uses a hardware accelerated kernel on this CPU
+ *
+ * Hardware kernels are only compiled in when CRC32_USE_HW_ACCEL is defined
+ * and the target is x86-64 (PCLMULQDQ) or AArch64 Linux (ARMv8 CRC32).
+ *
+ * @return non-zero if a hardware accelerated kernel is used
+ */
+int crc32_hw_accelerated(void);
+
+/**
+ * Multiplies the CRC register by x^(8 * length) mod P
+ *
+ * P is the CRC polynomial, multiplication is in GF(2), taking O(log(length))
+ * time. Because of the inversion of the initial and final values, this is not
+ * the CRC of the block followed by zero bytes, but the linear part of
+ * crc32_combine(), allowing to merge CRCs of blocks in any order.
+ *
+ * @param crc     CRC32 of a data block
+ * @param length  number of bytes following the block
+ * @return uint32_t
+ */
+uint32_t crc32_shift(uint32_t crc, size_t length);
+
+/**
+ * Combines CRC32 of two consecutive data blocks
+ *
+ * Returns the same value as crc32_fast(dataB, lengthB, crcA), where crcA is
+ * CRC32 of the first block, without accessing data of the second block.
+ *
+ * @param crcA     CRC32 of the first block
+ * @param crcB     CRC32 of the second block
+ * @param lengthB  length of the second block
+ * @return uint32_t
+ */
+uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
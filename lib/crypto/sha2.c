@@ -698,7 +698,7 @@ void sha256_Init(SHA256_CTX* context) {
 	(h) = T1 + Sigma0_256(a) + Maj((a), (b), (c)); \
 	j++
 
-void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+static void sha256_Transform_c(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
 	sha2_word32	a, b, c, d, e, f, g, h, s0, s1;
 	sha2_word32	T1;
 	sha2_word32 W256[16];
@@ -755,7 +755,7 @@ void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+static void sha256_Transform_c(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
 	sha2_word32	a, b, c, d, e, f, g, h, s0, s1;
 	sha2_word32	T1, T2, W256[16];
 	int		j;
@@ -826,6 +826,225 @@ void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+/*** SHA-256 HARDWARE ACCELERATION ************************************/
+/*
+ * HARDWARE ACCELERATION NOTE:
+ * When SHA2_USE_HW_ACCEL is defined on a hosted GCC/Clang build, the
+ * SHA-256 transform is dispatched at run time to the x86 SHA extensions
+ * (SHA-NI) or the ARMv8 cryptography extensions (AArch64 Linux) if the
+ * CPU supports them. sha256_RawMulti() additionally hashes up to eight
+ * independent messages at once with AVX2 when no SHA instructions are
+ * available. Without SHA2_USE_HW_ACCEL only the portable C code is built.
+ */
+#if defined(SHA2_USE_HW_ACCEL) && (defined(__GNUC__) || defined(__clang__))
+#if defined(__x86_64__)
+#define SHA2_HW_SHANI
+#define SHA2_HW_AVX2
+#elif defined(__aarch64__) && defined(__linux__) && \
+      BYTE_ORDER == LITTLE_ENDIAN
+#define SHA2_HW_ARMV8
+#endif
+#endif
+
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+/*
+ * Processes whole blocks, updating state in place. If swap is non-zero
+ * data is a byte stream, otherwise an array of host-order words.
+ */
+typedef void (*sha256_blocks_func_t)(sha2_word32* state, const void* data,
+				     size_t blocks, int swap);
+
+/*
+ * With BL_REENTRANT the switch is per thread, so concurrent verifiers do not
+ * share mutable state; a setting applies only to the thread making it.
+ */
+#ifdef BL_REENTRANT
+#define SHA2_THREAD_LOCAL	__thread
+#else
+#define SHA2_THREAD_LOCAL
+#endif
+
+static SHA2_THREAD_LOCAL int sha256_hw_disabled = 0;
+static int sha256_hw_detected = -1;
+#endif
+
+#ifdef SHA2_HW_SHANI
+#include <immintrin.h>
+
+#define SHA2_ATTR_SHANI	__attribute__((target("sha,sse4.1,ssse3")))
+
+static void SHA2_ATTR_SHANI sha256_blocks_hw(sha2_word32* state,
+					     const void* data, size_t blocks,
+					     int swap) {
+	const __m128i	mask = swap ?
+		_mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL) :
+		_mm_set_epi64x(0x0f0e0d0c0b0a0908ULL, 0x0706050403020100ULL);
+	const sha2_byte	*p = (const sha2_byte*)data;
+	__m128i		state0, state1, abef_save, cdgh_save, tmp, msg[4];
+	int		i;
+
+	/* Rearrange state words into ABEF/CDGH order */
+	tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);
+	state1 = _mm_shuffle_epi32(state1, 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	while (blocks--) {
+		abef_save = state0;
+		cdgh_save = state1;
+		for (i = 0; i < 4; i++) {
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+				(const __m128i*)(p + 16 * i)), mask);
+		}
+		/* 16 groups of 4 rounds, expanding message 4 words ahead */
+		for (i = 0; i < 16; i++) {
+			tmp = _mm_add_epi32(msg[i & 3],
+				_mm_loadu_si128((const __m128i*)&K256[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+			tmp = _mm_shuffle_epi32(tmp, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, tmp);
+			if (i < 12) {
+				tmp = _mm_sha256msg1_epu32(msg[i & 3],
+							   msg[(i + 1) & 3]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(
+					msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+				msg[i & 3] = _mm_sha256msg2_epu32(tmp,
+							msg[(i + 3) & 3]);
+			}
+		}
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+		p += SHA256_BLOCK_LENGTH;
+	}
+
+	/* Restore state words into ABCD/EFGH order */
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i*)&state[0], state0);
+	_mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+static int sha256_hw_detect(void) {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.1") &&
+	       __builtin_cpu_supports("ssse3") &&
+	       __builtin_cpu_supports("sha");
+}
+
+static const char* sha256_hw_name = "sha-ni";
+#endif /* SHA2_HW_SHANI */
+
+#ifdef SHA2_HW_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2	(1UL << 6)
+#endif
+
+#ifdef __clang__
+#define SHA2_ATTR_ARMV8	__attribute__((target("crypto")))
+#else
+#define SHA2_ATTR_ARMV8	__attribute__((target("+crypto")))
+#endif
+
+static void SHA2_ATTR_ARMV8 sha256_blocks_hw(sha2_word32* state,
+					     const void* data, size_t blocks,
+					     int swap) {
+	const sha2_byte	*p = (const sha2_byte*)data;
+	uint32x4_t	state0, state1, abef_save, cdgh_save, tmp, tmp2, msg[4];
+	int		i;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+	while (blocks--) {
+		abef_save = state0;
+		cdgh_save = state1;
+		for (i = 0; i < 4; i++) {
+			msg[i] = vreinterpretq_u32_u8(vld1q_u8(p + 16 * i));
+			if (swap) {
+				msg[i] = vreinterpretq_u32_u8(vrev32q_u8(
+					vreinterpretq_u8_u32(msg[i])));
+			}
+		}
+		/* 16 groups of 4 rounds, expanding message 4 words ahead */
+		for (i = 0; i < 16; i++) {
+			tmp = vaddq_u32(msg[i & 3], vld1q_u32(&K256[4 * i]));
+			if (i < 12) {
+				msg[i & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(msg[i & 3],
+							msg[(i + 1) & 3]),
+					msg[(i + 2) & 3], msg[(i + 3) & 3]);
+			}
+			tmp2 = state0;
+			state0 = vsha256hq_u32(state0, state1, tmp);
+			state1 = vsha256h2q_u32(state1, tmp2, tmp);
+		}
+		state0 = vaddq_u32(state0, abef_save);
+		state1 = vaddq_u32(state1, cdgh_save);
+		p += SHA256_BLOCK_LENGTH;
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+static int sha256_hw_detect(void) {
+	return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+
+static const char* sha256_hw_name = "armv8-ce";
+#endif /* SHA2_HW_ARMV8 */
+
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+/* Returns hardware transform if it is available and enabled, NULL otherwise */
+static sha256_blocks_func_t sha256_hw_select(void) {
+	if (sha256_hw_detected < 0) {
+		/* Races are benign: every thread detects the same result */
+		sha256_hw_detected = sha256_hw_detect();
+	}
+	return (sha256_hw_detected && !sha256_hw_disabled) ?
+	       sha256_blocks_hw : (sha256_blocks_func_t)0;
+}
+#endif
+
+void sha256_Transform(const sha2_word32* state_in, const sha2_word32* data, sha2_word32* state_out) {
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+	sha256_blocks_func_t	blocks_func = sha256_hw_select();
+
+	if (blocks_func) {
+		sha2_word32	state[8];
+		MEMCPY_BCOPY(state, state_in, sizeof(state));
+		blocks_func(state, data, 1, 0);
+		MEMCPY_BCOPY(state_out, state, sizeof(state));
+		return;
+	}
+#endif
+	sha256_Transform_c(state_in, data, state_out);
+}
+
+const char* sha256_Backend(void) {
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+	if (sha256_hw_select()) {
+		return sha256_hw_name;
+	}
+#endif
+	return "generic";
+}
+
+void sha256_DisableHw(int disable) {
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+	sha256_hw_disabled = disable;
+#else
+	(void)disable;
+#endif
+}
+
 void sha256_Update(SHA256_CTX* context, const sha2_byte *data, size_t len) {
 	unsigned int	freespace, usedspace;
 
@@ -861,6 +1080,20 @@ void sha256_Update(SHA256_CTX* context, const sha2_byte *data, size_t len) {
 			return;
 		}
 	}
+#if defined(SHA2_HW_SHANI) || defined(SHA2_HW_ARMV8)
+	if (len >= SHA256_BLOCK_LENGTH) {
+		sha256_blocks_func_t	blocks_func = sha256_hw_select();
+
+		if (blocks_func) {
+			/* Process complete blocks directly from input data */
+			size_t blocks = len / SHA256_BLOCK_LENGTH;
+			blocks_func(context->state, data, blocks, 1);
+			context->bitcount += (sha2_word64)blocks * SHA256_BLOCK_LENGTH << 3;
+			len -= blocks * SHA256_BLOCK_LENGTH;
+			data += blocks * SHA256_BLOCK_LENGTH;
+		}
+	}
+#endif
 	while (len >= SHA256_BLOCK_LENGTH) {
 		/* Process as many complete blocks as we can */
 		MEMCPY_BCOPY(context->buffer, data, SHA256_BLOCK_LENGTH);
@@ -973,6 +1206,201 @@ char* sha256_Data(const sha2_byte* data, size_t len, char digest[SHA256_DIGEST_S
 	return sha256_End(&context, digest);
 }
 
+/*** SHA-256 MULTI-BUFFER: ********************************************/
+#ifdef SHA2_HW_AVX2
+#define SHA256_MB_LANES	8
+
+#define SHA2_ATTR_AVX2	__attribute__((target("avx2")))
+
+/* One lane of the multi-buffer hasher: a message and its read position */
+typedef struct _sha256_mb_lane {
+	const sha2_byte	*data;
+	size_t		len;
+	size_t		pos;
+	size_t		index;
+	int		stage;	/* 0: data, 1: length-only block, 2: done */
+} sha256_mb_lane;
+
+/*
+ * Fetches the next block of a lane as host-order words, applying padding.
+ * Returns non-zero if this was the last block of the message.
+ */
+static int sha256_mb_next_block(sha256_mb_lane* lane, sha2_word32 w[16]) {
+	sha2_byte	block[SHA256_BLOCK_LENGTH];
+	size_t		rem;
+	int		last = 0, j;
+
+	if (lane->stage == 0 && lane->len - lane->pos >= SHA256_BLOCK_LENGTH) {
+		MEMCPY_BCOPY(block, lane->data + lane->pos, SHA256_BLOCK_LENGTH);
+		lane->pos += SHA256_BLOCK_LENGTH;
+	} else {
+		memzero(block, SHA256_BLOCK_LENGTH);
+		if (lane->stage == 0) {
+			rem = lane->len - lane->pos;
+			MEMCPY_BCOPY(block, lane->data + lane->pos, rem);
+			block[rem] = 0x80;
+			lane->pos = lane->len;
+			lane->stage = (rem < SHA256_SHORT_BLOCK_LENGTH) ? 2 : 1;
+		} else {
+			lane->stage = 2;
+		}
+		if (lane->stage == 2) {
+			sha2_word64 bitcount = (sha2_word64)lane->len << 3;
+			for (j = 0; j < 8; j++) {
+				block[SHA256_BLOCK_LENGTH - 1 - j] =
+					(sha2_byte)(bitcount >> (8 * j));
+			}
+			last = 1;
+		}
+	}
+	for (j = 0; j < 16; j++) {
+		w[j] = ((sha2_word32)block[4 * j] << 24) |
+		       ((sha2_word32)block[4 * j + 1] << 16) |
+		       ((sha2_word32)block[4 * j + 2] << 8) |
+		       (sha2_word32)block[4 * j + 3];
+	}
+	memzero(block, SHA256_BLOCK_LENGTH);
+	return last;
+}
+
+#define MB_ROTR(x,n)	_mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+					_mm256_slli_epi32((x), 32 - (n)))
+#define MB_XOR3(x,y,z)	_mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+
+/* Transforms one block in each of eight lanes; words are lane-interleaved */
+static void SHA2_ATTR_AVX2 sha256_mb_transform(
+		sha2_word32 state[8][SHA256_MB_LANES],
+		const sha2_word32 data[16][SHA256_MB_LANES]) {
+	__m256i	s[8], v[8], w[16], t1, t2, s0, s1;
+	int	i, j;
+
+	for (i = 0; i < 8; i++) {
+		s[i] = v[i] = _mm256_loadu_si256((const __m256i*)state[i]);
+	}
+	for (j = 0; j < 64; j++) {
+		if (j < 16) {
+			w[j] = _mm256_loadu_si256((const __m256i*)data[j]);
+		} else {
+			s0 = w[(j + 1) & 0x0f];
+			s0 = MB_XOR3(MB_ROTR(s0, 7), MB_ROTR(s0, 18),
+				     _mm256_srli_epi32(s0, 3));
+			s1 = w[(j + 14) & 0x0f];
+			s1 = MB_XOR3(MB_ROTR(s1, 17), MB_ROTR(s1, 19),
+				     _mm256_srli_epi32(s1, 10));
+			w[j & 0x0f] = _mm256_add_epi32(
+				_mm256_add_epi32(w[j & 0x0f], w[(j + 9) & 0x0f]),
+				_mm256_add_epi32(s0, s1));
+		}
+		/* T1 = h + Sigma1(e) + Ch(e,f,g) + K[j] + W[j] */
+		t1 = _mm256_add_epi32(v[7], MB_XOR3(MB_ROTR(v[4], 6),
+			MB_ROTR(v[4], 11), MB_ROTR(v[4], 25)));
+		t1 = _mm256_add_epi32(t1, _mm256_xor_si256(
+			_mm256_and_si256(v[4], v[5]),
+			_mm256_andnot_si256(v[4], v[6])));
+		t1 = _mm256_add_epi32(t1, _mm256_add_epi32(w[j & 0x0f],
+			_mm256_set1_epi32((int)K256[j])));
+		/* T2 = Sigma0(a) + Maj(a,b,c) */
+		t2 = _mm256_add_epi32(MB_XOR3(MB_ROTR(v[0], 2),
+			MB_ROTR(v[0], 13), MB_ROTR(v[0], 22)),
+			MB_XOR3(_mm256_and_si256(v[0], v[1]),
+				_mm256_and_si256(v[0], v[2]),
+				_mm256_and_si256(v[1], v[2])));
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = _mm256_add_epi32(v[3], t1);
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = _mm256_add_epi32(t1, t2);
+	}
+	for (i = 0; i < 8; i++) {
+		_mm256_storeu_si256((__m256i*)state[i],
+				    _mm256_add_epi32(s[i], v[i]));
+	}
+}
+
+/* Hashes messages eight at a time, refilling lanes as messages complete */
+static void sha256_mb_avx2(const sha2_byte* const data[], const size_t len[],
+			   size_t count,
+			   sha2_byte digest[][SHA256_DIGEST_LENGTH]) {
+	sha2_word32	state[8][SHA256_MB_LANES];
+	sha2_word32	block[16][SHA256_MB_LANES];
+	sha2_word32	w[16];
+	sha256_mb_lane	lanes[SHA256_MB_LANES];
+	int		last[SHA256_MB_LANES];
+	size_t		next = 0, active = 0;
+	int		l, j;
+
+	memzero(block, sizeof(block));
+	for (l = 0; l < SHA256_MB_LANES; l++) {
+		lanes[l].stage = 2;
+	}
+	do {
+		/* Assign pending messages to idle lanes */
+		for (l = 0; l < SHA256_MB_LANES; l++) {
+			if (lanes[l].stage == 2 && next < count) {
+				lanes[l].data = data[next];
+				lanes[l].len = len[next];
+				lanes[l].pos = 0;
+				lanes[l].index = next++;
+				lanes[l].stage = 0;
+				for (j = 0; j < 8; j++) {
+					state[j][l] = sha256_initial_hash_value[j];
+				}
+				active++;
+			}
+		}
+		for (l = 0; l < SHA256_MB_LANES; l++) {
+			last[l] = 0;
+			if (lanes[l].stage != 2) {
+				last[l] = sha256_mb_next_block(&lanes[l], w);
+				for (j = 0; j < 16; j++) {
+					block[j][l] = w[j];
+				}
+			}
+		}
+		sha256_mb_transform(state,
+			(const sha2_word32 (*)[SHA256_MB_LANES])block);
+		for (l = 0; l < SHA256_MB_LANES; l++) {
+			if (last[l]) {
+				for (j = 0; j < 8; j++) {
+					sha2_word32 s = state[j][l];
+					sha2_byte* d = digest[lanes[l].index] + 4 * j;
+					d[0] = (sha2_byte)(s >> 24);
+					d[1] = (sha2_byte)(s >> 16);
+					d[2] = (sha2_byte)(s >> 8);
+					d[3] = (sha2_byte)s;
+				}
+				active--;
+			}
+		}
+	} while (active > 0 || next < count);
+
+	memzero(state, sizeof(state));
+	memzero(block, sizeof(block));
+	memzero(w, sizeof(w));
+}
+#endif /* SHA2_HW_AVX2 */
+
+void sha256_RawMulti(const sha2_byte* const data[], const size_t len[], size_t count, uint8_t digest[][SHA256_DIGEST_LENGTH]) {
+	size_t	i;
+
+#ifdef SHA2_HW_AVX2
+	/* SHA instructions outperform eight AVX2 lanes, prefer them if present */
+	if (count > 1 && !sha256_hw_select()) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			sha256_mb_avx2(data, len, count, digest);
+			return;
+		}
+	}
+#endif
+	for (i = 0; i < count; i++) {
+		sha256_Raw(data[i], len[i], digest[i]);
+	}
+}
+
 
 /*** SHA-512: *********************************************************/
 void sha512_Init(SHA512_CTX* context) {
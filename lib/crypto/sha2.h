@@ -105,6 +105,10 @@ void sha256_Final(SHA256_CTX*, uint8_t[SHA256_DIGEST_LENGTH]);
 char* sha256_End(SHA256_CTX*, char[SHA256_DIGEST_STRING_LENGTH]);
 void sha256_Raw(const uint8_t*, size_t, uint8_t[SHA256_DIGEST_LENGTH]);
 char* sha256_Data(const uint8_t*, size_t, char[SHA256_DIGEST_STRING_LENGTH]);
+void sha256_RawMulti(const uint8_t* const[], const size_t[], size_t, uint8_t[][SHA256_DIGEST_LENGTH]);
+const char* sha256_Backend(void);
+/* Disables hardware SHA-256; per calling thread if built with BL_REENTRANT */
+void sha256_DisableHw(int);
 
 void sha512_Transform(const uint64_t* state_in, const uint64_t* data, uint64_t* state_out);
 void sha512_Init(SHA512_CTX*);
@@ -386,6 +386,41 @@ void HAL_Delay(__IO uint32_t Delay) {
   }
 }
 
+uint32_t blsys_time_us(void) {
+  // Value of the cycle counter at previous call
+  static uint32_t last_cycles = 0U;
+  // Cycles not yet accounted in microseconds
+  static uint32_t rem_cycles = 0U;
+  // Accumulated time in microseconds
+  static uint32_t us_acc = 0U;
+  // Number of CPU cycles in one microsecond
+  static uint32_t cycles_per_us = 0U;
+
+  // Cycle counter of the DWT unit is enabled on first use
+  if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    last_cycles = 0U;
+    rem_cycles = 0U;
+  }
+  if (!cycles_per_us) {
+    cycles_per_us = SystemCoreClock / 1000000U;
+    if (!cycles_per_us) {
+      return 0U;
+    }
+  }
+  // Unsigned subtraction handles a wrap of the 32-bit counter, provided that
+  // calls are less than 2^32 cycles (23.8 s at 180 MHz) apart. The result
+  // wraps at 2^32 us as expected by callers.
+  uint32_t cycles = DWT->CYCCNT;
+  rem_cycles += cycles - last_cycles;
+  last_cycles = cycles;
+  us_acc += rem_cycles / cycles_per_us;
+  rem_cycles %= cycles_per_us;
+  return us_acc;
+}
+
 /**
  * Checks if area in flash memory falls in valid address range
  *
@@ -428,6 +463,18 @@ bool blsys_flash_erase(bl_addr_t addr, size_t size) {
   return false;
 }
 
+bool blsys_flash_get_sector(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                            size_t* p_sect_size) {
+  if (p_sect_addr && p_sect_size && check_flash_area(addr, 1U)) {
+    bl_addr_t sect_size = 0U;
+    if (flash_get_sector_info(addr, p_sect_addr, &sect_size) >= 0) {
+      *p_sect_size = (size_t)sect_size;
+      return true;
+    }
+  }
+  return false;
+}
+
 bool blsys_flash_read(bl_addr_t addr, void* buf, size_t len) {
   if (buf && len && check_flash_area(addr, len)) {
     memcpy(buf, (const void*)addr, len);
@@ -741,6 +788,14 @@ bool blsys_flash_write_protect(bl_addr_t addr, size_t size, bool enable) {
   return false;
 }
 
+bool blsys_flash_is_write_protected(bl_addr_t addr, size_t size) {
+  sec_bitmap_t sect_map = 0U;
+  sec_bitmap_t curr_state = 0U;
+  return flash_sector_bitmap(&sect_map, addr, size) &&
+         flash_get_write_protection_state(&curr_state) &&
+         (curr_state & sect_map) == sect_map;
+}
+
 bool blsys_flash_read_protect(int level_) {
   uint32_t new_rdp_level = OB_RDP_LEVEL_0;
   switch (level_) {
@@ -9,6 +9,7 @@
 #include "bl_util.h"
 #include "bl_integrity_check.h"
 #include "startup_mailbox.h"
+#include "stm32469i_discovery.h"
 #include "linker_vars.h"
 #include "bl_memmap.h"
 
@@ -24,6 +25,9 @@ typedef enum upy_reset_mode_t {
   upy_reset_mode_dfu = 4
 } upy_reset_mode_t;
 
+/// Number of polling cycles waiting for a random number from the RNG
+#define RNG_TIMEOUT_CYCLES 10000U
+
 /// Version in the format parced by upgrade-generator
 static const char version_tag[] BL_ATTRS((used)) =
     "<version:tag10>0100000199</version:tag10>";
@@ -52,6 +56,54 @@ static void fatal_error(const char* text) {
   blsys_fatal_error(text);
 }
 
+/**
+ * Checks if full integrity check is requested by holding the USER button
+ *
+ * Without CACHED_INTEGRITY_CHECK the Main Firmware is always fully verified.
+ *
+ * @return  true if full integrity check of the Main Firmware is required
+ */
+static bool full_check_requested(void) {
+#ifdef CACHED_INTEGRITY_CHECK
+  BSP_PB_Init(BUTTON_USER, BUTTON_MODE_GPIO);
+  return BSP_PB_GetState(BUTTON_USER) != 0U;
+#else
+  return true;
+#endif  // CACHED_INTEGRITY_CHECK
+}
+
+#ifdef CACHED_INTEGRITY_CHECK
+/**
+ * Returns a random number selecting a block for sampled verification
+ *
+ * The hardware random number generator is used, so that the verified block
+ * is not predictable from the time of start. The generator is clocked from
+ * the 48 MHz clock configured by blsys_init(). If it fails, the value of the
+ * SysTick counter is returned instead.
+ *
+ * @return  random number
+ */
+static uint32_t sample_seed(void) {
+  uint32_t seed = SysTick->VAL;
+  __HAL_RCC_RNG_CLK_ENABLE();
+  RNG->CR |= RNG_CR_RNGEN;
+  for (uint32_t cycle = 0U; cycle < RNG_TIMEOUT_CYCLES; ++cycle) {
+    uint32_t status = RNG->SR;
+    if (status & (RNG_SR_SECS | RNG_SR_CECS)) {
+      break;  // Seed or clock error, keep the SysTick value
+    }
+    if (status & RNG_SR_DRDY) {
+      seed = RNG->DR;
+      break;
+    }
+  }
+  // Leave the generator in reset state for the firmware
+  RNG->CR &= ~RNG_CR_RNGEN;
+  __HAL_RCC_RNG_CLK_DISABLE();
+  return seed;
+}
+#endif  // CACHED_INTEGRITY_CHECK
+
 /**
  * Program entry point
  *
@@ -81,10 +133,20 @@ int main(void) {
   }
 
   // Check integrity of the Main Firmware
-  if (!bl_icr_verify(LV_VALUE(_main_firmware_start),
-                     LV_VALUE(_main_firmware_size), NULL)) {
+  bool full_check = full_check_requested();
+  if (!bl_icr_verify_cached(LV_VALUE(_main_firmware_start),
+                            LV_VALUE(_main_firmware_size), NULL, full_check)) {
+    fatal_error("No valid firmware found");
+  }
+#ifdef CACHED_INTEGRITY_CHECK
+  // Even if the CRC check is skipped, one block is verified. Its number is
+  // random, so that all blocks are checked over time.
+  if (!full_check && !bl_icr_verify_sample(LV_VALUE(_main_firmware_start),
+                                           LV_VALUE(_main_firmware_size),
+                                           sample_seed(), 1U)) {
     fatal_error("No valid firmware found");
   }
+#endif  // CACHED_INTEGRITY_CHECK
 
   // Start the application, normally this call should not return
   (void)blsys_start_firmware(LV_VALUE(_main_firmware_start),
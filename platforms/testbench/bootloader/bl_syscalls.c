@@ -9,23 +9,52 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "crc32.h"
 #include "bl_util.h"
 #include "bl_syscalls.h"
+#include "cost_model.h"
+#include "power_loss.h"
+#include "device.h"
 
-/// Name of file where contents of emulated flash memory is written
+/// Name of file mapped to memory holding contents of emulated flash memory
 #define FLASH_EMU_FILE "flash_dump.bin"
+/// Name of file where the record kept in non-volatile memory is stored
+#define NVREC_EMU_FILE "nvrec.bin"
 /// Base address of emulated flash memory
-#define FLASH_EMU_BASE 0x08000000U
+#define FLASH_EMU_BASE DEVICE_FLASH_BASE
 /// Size of emulated flash memory, 2 megabytes
-#define FLASH_EMU_SIZE (2U * 1024U * 1024U)
+#define FLASH_EMU_SIZE DEVICE_FLASH_SIZE
+/// Number of sectors in emulated flash memory, matches flash_layout[]
+#define FLASH_EMU_N_SECTORS 24U
 /// Flags used with fnmatch() function to match file names
 #define FNMATCH_FLAGS (FNM_FILE_NAME | FNM_PERIOD)
 
-/// Flags for emulated flash memory
-typedef enum flash_emu_flags_t {
-  /// Byte is write protected
-  flash_emu_wr_protect = (1 << 0)
-} flash_emu_flags_t;
+/// Bitmap of sectors, each bit corresponds to the sector with the same index
+typedef uint32_t sec_bitmap_t;
+
+/// Flash memory layout entry
+typedef struct {
+  bl_addr_t base_address;  ///< Base address of the sector
+  size_t sector_size;      ///< Size of the sector
+  uint32_t sector_count;   ///< Number of sectors having the same size
+} flash_layout_t;
+
+/// Layout of emulated flash memory, mimics STM32F469 with two banks
+// clang-format off
+static const flash_layout_t flash_layout[] = {
+  { 0x08000000U, 0x04000U, 4U },
+  { 0x08010000U, 0x10000U, 1U },
+  { 0x08020000U, 0x20000U, 7U },
+  { 0x08100000U, 0x04000U, 4U },
+  { 0x08110000U, 0x10000U, 1U },
+  { 0x08120000U, 0x20000U, 7U }};
+// clang-format on
 
 /// Flash memory map
 // clang-format off
@@ -47,64 +76,119 @@ static const char* alert_type_str[bl_nalerts] = {
   [bl_alert_error]   = "ERROR" };
 // clang-format on
 
-/// Buffer in RAM used to emulate flash memory
-static uint8_t* flash_emu_buf = NULL;
-/// Buffer in RAM storing flags for emulated flash memory
-static uint8_t* flash_emu_flags = NULL;
-/// Printed characters of the progress message
-static int progress_n_chr = -1;
-static char* progress_prev_text = NULL;
+tb_device_t device_primary = {.primary = true, .progress_n_chr = -1};
 
-const char* blsys_platform_id(void) {
+static const char* tb_platform_id(void* arg) {
   // Mimics real hardware platform
   static const char* platform_id_ = "stm32f469disco";
   return platform_id_;
 }
 
-bool blsys_init(void) {
-  progress_n_chr = -1;
-  progress_prev_text = NULL;
-  flash_emu_buf = malloc(FLASH_EMU_SIZE);
-  flash_emu_flags = malloc(FLASH_EMU_SIZE);
-  if (!flash_emu_buf || !flash_emu_flags) {
-    blsys_fatal_error("Unable to allocate flash emulation buffer");
+/**
+ * Maps file holding contents of emulated flash memory
+ *
+ * If the file does not exist or has an unexpected size, it is (re)created
+ * with erased contents. Pages of the file are loaded on first access and
+ * changes are written back by the OS, so there is no need to dump the whole
+ * flash memory on exit.
+ *
+ * @param private  if true, changes are not written to the file
+ * @return         pointer to mapped memory, or NULL if failed
+ */
+static uint8_t* flash_emu_map(bool private) {
+  int fd = open(FLASH_EMU_FILE, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return NULL;
   }
+  struct stat st;
+  bool fresh = (fstat(fd, &st) != 0 || st.st_size != FLASH_EMU_SIZE);
+  if (fresh && ftruncate(fd, FLASH_EMU_SIZE) != 0) {
+    close(fd);
+    return NULL;
+  }
+  void* ptr = mmap(NULL, FLASH_EMU_SIZE, PROT_READ | PROT_WRITE,
+                   private ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+  close(fd);  // The mapping remains valid
+  if (ptr == MAP_FAILED) {
+    return NULL;
+  }
+  if (fresh) {
+    memset(ptr, 0xFF, FLASH_EMU_SIZE);
+  }
+  return (uint8_t*)ptr;
+}
 
-  // Enable write protection for each byte by default
-  memset(flash_emu_flags, (uint8_t)flash_emu_wr_protect, FLASH_EMU_SIZE);
-
-  size_t bytes_read = 0U;
-  FILE* in_file = fopen(FLASH_EMU_FILE, "rb");
-  if (in_file) {
-    bytes_read = fread(flash_emu_buf, 1U, FLASH_EMU_SIZE, in_file);
-    fclose(in_file);
+static bool tb_init(void* arg) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  p_dev->progress_n_chr = -1;
+  p_dev->progress_prev_text = NULL;
+  if (p_dev->primary) {
+    cost_model_init();
+  }
+  if (!p_dev->flash) {
+    p_dev->flash = flash_emu_map(false);
   }
-  if (bytes_read != FLASH_EMU_SIZE) {
-    memset(flash_emu_buf, 0xFF, FLASH_EMU_SIZE);
+  if (!p_dev->flash) {
+    blsys_fatal_error("Unable to map emulated flash memory to a file");
   }
+  // Enable write protection for each sector by default
+  p_dev->flash_wrp = (sec_bitmap_t)((1ULL << FLASH_EMU_N_SECTORS) - 1U);
   return true;
 }
 
-void blsys_deinit(void) {
-  if (progress_prev_text) {
-    free(progress_prev_text);
-    progress_prev_text = NULL;
+static void tb_deinit(void* arg) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->primary) {
+    cost_model_report();
+  }
+  if (p_dev->progress_prev_text) {
+    free(p_dev->progress_prev_text);
+    p_dev->progress_prev_text = NULL;
+  }
+  if (p_dev->flash && !p_dev->flash_pinned) {
+    bool ok = (0 == msync(p_dev->flash, FLASH_EMU_SIZE, MS_SYNC));
+    ok = (0 == munmap(p_dev->flash, FLASH_EMU_SIZE)) && ok;
+    p_dev->flash = NULL;
+    if (!ok) {
+      blsys_fatal_error("Unable to save emulated flash memory to a file");
+    }
+  }
+}
+
+bool testbench_flash_snapshot(void) {
+  if (!device_primary.flash) {
+    device_primary.flash = flash_emu_map(true);
+    device_primary.flash_pinned = (device_primary.flash != NULL);
   }
-  if (flash_emu_flags) {
-    free(flash_emu_flags);
-    flash_emu_flags = NULL;
+  return device_primary.flash_pinned;
+}
+
+bool device_open(tb_device_t* p_dev, const char* media_dir) {
+  if (p_dev) {
+    memset(p_dev, 0, sizeof(tb_device_t));
+    p_dev->media_dir = media_dir;
+    p_dev->quiet = true;
+    p_dev->progress_n_chr = -1;
+    p_dev->flash = flash_emu_map(true);
+    p_dev->flash_pinned = (p_dev->flash != NULL);
+    return p_dev->flash_pinned;
   }
-  if (flash_emu_buf) {
-    size_t written = 0U;
-    FILE* out_file = fopen(FLASH_EMU_FILE, "wb");
-    if (out_file) {
-      written = fwrite(flash_emu_buf, 1U, FLASH_EMU_SIZE, out_file);
-      fclose(out_file);
+  return false;
+}
+
+void device_close(tb_device_t* p_dev) {
+  if (p_dev) {
+    for (size_t idx = 0U; idx < DEVICE_MAX_FILES; ++idx) {
+      if (p_dev->files[idx]) {
+        fclose(p_dev->files[idx]);
+        p_dev->files[idx] = NULL;
+      }
     }
-    free(flash_emu_buf);
-    flash_emu_buf = NULL;
-    if (written != FLASH_EMU_SIZE) {
-      blsys_fatal_error("Unable to dump emulated flash memory to a file");
+    free(p_dev->progress_prev_text);
+    p_dev->progress_prev_text = NULL;
+    if (p_dev->flash) {
+      munmap(p_dev->flash, FLASH_EMU_SIZE);
+      p_dev->flash = NULL;
     }
   }
 }
@@ -124,93 +208,298 @@ static bool check_flash_area(bl_addr_t addr, size_t size) {
   return false;
 }
 
+/**
+ * Returns sector information
+ *
+ * @param addr         address within flash memory range
+ * @param p_sect_addr  pointer to variable receiving start address of the
+ *                     sector, ignored if NULL
+ * @param p_sect_size  pointer to variable receiving size of the sector,
+ *                     ignored if NULL
+ * @return             sector index, or -1 if address is incorrect
+ */
+static int flash_get_sector_info(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                                 size_t* p_sect_size) {
+  int sector_index = 0;
+  for (size_t i = 0U; i < sizeof(flash_layout) / sizeof(flash_layout[0]);
+       ++i) {
+    const flash_layout_t* p_item = &flash_layout[i];
+    size_t area_size = p_item->sector_size * p_item->sector_count;
+    if (addr >= p_item->base_address &&
+        addr - p_item->base_address < area_size) {
+      size_t offset = addr - p_item->base_address;
+      if (p_sect_addr) {
+        *p_sect_addr = addr - offset % p_item->sector_size;
+      }
+      if (p_sect_size) {
+        *p_sect_size = p_item->sector_size;
+      }
+      return sector_index + (int)(offset / p_item->sector_size);
+    }
+    sector_index += (int)p_item->sector_count;
+  }
+  return -1;
+}
+
+/**
+ * Returns bitmap of sectors overlapping with an area in flash memory
+ *
+ * @param addr      starting address
+ * @param size      area size
+ * @param aligned   if true, the area must begin and end at sector boundaries
+ * @param p_bitmap  pointer to variable receiving bitmap of sectors
+ * @return          true if successful
+ */
+static bool flash_sector_bitmap(bl_addr_t addr, size_t size, bool aligned,
+                                sec_bitmap_t* p_bitmap) {
+  if (!check_flash_area(addr, size)) {
+    return false;
+  }
+  sec_bitmap_t bitmap = 0U;
+  bl_addr_t curr_addr = addr;
+  bl_addr_t end_addr = addr + size;
+  while (curr_addr < end_addr) {
+    bl_addr_t sect_addr = 0U;
+    size_t sect_size = 0U;
+    int sector = flash_get_sector_info(curr_addr, &sect_addr, &sect_size);
+    if (sector < 0 || (aligned && (sect_addr != curr_addr ||
+                                   sect_size > end_addr - curr_addr))) {
+      return false;
+    }
+    bitmap |= (sec_bitmap_t)1U << sector;
+    curr_addr = sect_addr + sect_size;
+  }
+  *p_bitmap = bitmap;
+  return true;
+}
+
 /**
  * Checks if an area in flash memory is allowed for writing or erasing
  *
- * @param addr  starting address
- * @param size  area size
- * @return      true if successful
+ * @param p_dev  pointer to device
+ * @param addr   starting address
+ * @param size   area size
+ * @return       true if successful
+ */
+static bool is_write_allowed(const tb_device_t* p_dev, bl_addr_t addr,
+                             size_t size) {
+  sec_bitmap_t sectors = 0U;
+  return flash_sector_bitmap(addr, size, false, &sectors) &&
+         !(sectors & p_dev->flash_wrp);
+}
+
+uint8_t* device_flash_ptr(tb_device_t* p_dev, bl_addr_t addr, size_t size) {
+  if (p_dev && p_dev->flash && check_flash_area(addr, size)) {
+    return p_dev->flash + (addr - FLASH_EMU_BASE);
+  }
+  return NULL;
+}
+
+static bool tb_flash_map_get_items(void* arg, int items, va_list ap) {
+  for (int i = 0; i < items; ++i) {
+    bl_flash_map_item_t item_id = (bl_flash_map_item_t)va_arg(ap, int);
+    bl_addr_t* p_item = va_arg(ap, bl_addr_t*);
+    if ((int)item_id < 0 || (int)item_id >= bl_flash_map_nitems || !p_item) {
+      return false;
+    }
+    *p_item = bl_flash_map[item_id];
+  }
+  return true;
+}
+
+/**
+ * Checks if a memory block is in erased state of flash memory (all 0xFF)
+ *
+ * The block is compared by 64-bit words, accumulating them so that the
+ * compiler is able to vectorize the loop.
+ *
+ * @param ptr  pointer to memory block
+ * @param len  length of the block
+ * @return     true if all bytes are 0xFF
  */
-static bool is_write_allowed(bl_addr_t addr, size_t size) {
-  if (flash_emu_flags && check_flash_area(addr, size)) {
-    const uint8_t* p_flags = flash_emu_flags + (addr - FLASH_EMU_BASE);
-    for (size_t idx = 0; idx < size; ++idx, ++p_flags) {
-      if (*p_flags & flash_emu_wr_protect) {
-        return false;
+static bool is_erased(const uint8_t* ptr, size_t len) {
+  const size_t block_words = 32U;  // Words checked before an early exit
+  while (len && ((uintptr_t)ptr % sizeof(uint64_t))) {
+    if (*ptr++ != 0xFFU) {
+      return false;
+    }
+    --len;
+  }
+  const uint64_t* p_word = (const uint64_t*)ptr;
+  size_t n_words = len / sizeof(uint64_t);
+  while (n_words) {
+    size_t n_block = (n_words < block_words) ? n_words : block_words;
+    uint64_t acc = UINT64_MAX;
+    for (size_t idx = 0U; idx < n_block; ++idx) {
+      acc &= p_word[idx];
+    }
+    if (acc != UINT64_MAX) {
+      return false;
+    }
+    p_word += n_block;
+    n_words -= n_block;
+  }
+  ptr = (const uint8_t*)p_word;
+  for (size_t idx = 0U; idx < len % sizeof(uint64_t); ++idx) {
+    if (ptr[idx] != 0xFFU) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool tb_flash_erase(void* arg, bl_addr_t addr, size_t size) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  sec_bitmap_t sectors = 0U;
+  // Like the real hardware, only whole sectors are erased
+  if (p_dev->flash && size &&
+      flash_sector_bitmap(addr, size, true, &sectors) &&
+      !(sectors & p_dev->flash_wrp)) {
+    size_t offset = addr - FLASH_EMU_BASE;
+    if (p_dev->primary && power_loss_flash_op()) {
+      // Erasing of the first sector is interrupted halfway
+      size_t sect_size = 0U;
+      (void)flash_get_sector_info(addr, NULL, &sect_size);
+      memset(p_dev->flash + offset, 0xFF, sect_size / 2U);
+      power_loss_cut();
+    }
+    memset(p_dev->flash + offset, 0xFF, size);
+    for (bl_addr_t curr_addr = addr; curr_addr < addr + size;) {
+      size_t sect_size = 0U;
+      (void)flash_get_sector_info(curr_addr, NULL, &sect_size);
+      if (p_dev->primary) {
+        cost_flash_erase(sect_size);
       }
+      curr_addr += sect_size;
     }
     return true;
   }
   return false;
 }
 
-bool blsys_flash_erase(bl_addr_t addr, size_t size) {
-  if (flash_emu_buf && is_write_allowed(addr, size)) {
-    size_t offset = addr - FLASH_EMU_BASE;
-    memset(flash_emu_buf + offset, 0xFF, size);
-    return true;
+static bool tb_flash_get_sector(void* arg, bl_addr_t addr,
+                                bl_addr_t* p_sect_addr, size_t* p_sect_size) {
+  if (p_sect_addr && p_sect_size) {
+    return flash_get_sector_info(addr, p_sect_addr, p_sect_size) >= 0;
   }
   return false;
 }
 
-bool blsys_flash_read(bl_addr_t addr, void* buf, size_t len) {
-  if (flash_emu_buf && buf && check_flash_area(addr, len)) {
+static bool tb_flash_read(void* arg, bl_addr_t addr, void* buf, size_t len) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->flash && buf && check_flash_area(addr, len)) {
     size_t offset = addr - FLASH_EMU_BASE;
-    memcpy(buf, flash_emu_buf + offset, len);
+    memcpy(buf, p_dev->flash + offset, len);
     return true;
   }
   return false;
 }
 
-bool blsys_flash_write(bl_addr_t addr, const void* buf, size_t len) {
-  if (flash_emu_buf && buf && is_write_allowed(addr, len)) {
+static bool tb_flash_write(void* arg, bl_addr_t addr, const void* buf,
+                           size_t len) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->flash && buf && is_write_allowed(p_dev, addr, len)) {
     size_t offset = addr - FLASH_EMU_BASE;
-    // Check if flash area is erased
-    for(size_t idx = offset; idx < offset + len; ++idx) {
-      if(flash_emu_buf[idx] != 0xFFU) {
-        return false;
-      }
+    if (!is_erased(p_dev->flash + offset, len)) {
+      return false;
+    }
+    if (p_dev->primary && power_loss_flash_op()) {
+      // Only a half of words is programmed
+      memcpy(p_dev->flash + offset, buf, (len / 2U) & ~(size_t)3U);
+      power_loss_cut();
+    }
+    memcpy(p_dev->flash + offset, buf, len);
+    if (p_dev->primary) {
+      cost_flash_program(len);
     }
-    memcpy(flash_emu_buf + offset, buf, len);
     return true;
   }
   return false;
 }
 
-bool blsys_flash_write_protect(bl_addr_t addr, size_t size, bool enable) {
-  if (flash_emu_flags && check_flash_area(addr, size)) {
-    uint8_t* p_flags = flash_emu_flags + (addr - FLASH_EMU_BASE);
-    for (size_t idx = 0; idx < size; ++idx, ++p_flags) {
-      if (enable) {
-        *p_flags |= flash_emu_wr_protect;
-      } else {
-        *p_flags &= ~((uint8_t)flash_emu_wr_protect);
-      }
+static bool tb_flash_crc32(void* arg, uint32_t* p_crc, bl_addr_t addr,
+                           size_t len) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->flash && p_crc && len && check_flash_area(addr, len)) {
+    *p_crc = crc32_fast(p_dev->flash + (addr - FLASH_EMU_BASE), len, *p_crc);
+    return true;
+  }
+  return false;
+}
+
+static bool tb_flash_write_protect(void* arg, bl_addr_t addr, size_t size,
+                                   bool enable) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  sec_bitmap_t sectors = 0U;
+  if (size && flash_sector_bitmap(addr, size, true, &sectors)) {
+    if (enable) {
+      p_dev->flash_wrp |= sectors;
+    } else {
+      p_dev->flash_wrp &= ~sectors;
     }
     return true;
   }
   return false;
 }
 
-bool blsys_flash_read_protect(int level) { return true; }
+static bool tb_flash_is_write_protected(void* arg, bl_addr_t addr,
+                                        size_t size) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  sec_bitmap_t sectors = 0U;
+  if (size && flash_sector_bitmap(addr, size, false, &sectors)) {
+    return (sectors & p_dev->flash_wrp) == sectors;
+  }
+  return false;
+}
+
+static bool tb_flash_read_protect(void* arg, int level) { return true; }
+
+static int tb_flash_get_read_protection_level(void* arg) { return -1; }
 
-uint32_t blsys_media_devices(void) { return 1U; }
+static uint32_t tb_media_devices(void* arg) { return 1U; }
 
-bool blsys_media_check(uint32_t device_idx) {
+static const char* tb_media_name(void* arg, uint32_t device_idx) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  return p_dev->media_dir ? p_dev->media_dir : "working directory";
+}
+
+static bool tb_media_check(void* arg, uint32_t device_idx) {
   return (0U == device_idx) ? true : false;
 }
 
-bool blsys_media_mount(uint32_t device_idx) {
+static bool tb_media_mount(void* arg, uint32_t device_idx) {
   return (0U == device_idx) ? true : false;
 }
 
-void blsys_media_umount(void) {}
+static void tb_media_umount(void* arg) {}
+
+/**
+ * Makes path of a file or directory on the media of a device
+ *
+ * @param p_dev     pointer to device
+ * @param path      path on the media, "/" or "" for the root directory
+ * @param buf       buffer receiving the path in the host file system
+ * @param buf_size  size of the buffer
+ * @return          pointer to the path in the host file system, or NULL
+ */
+static const char* media_path(const tb_device_t* p_dev, const char* path,
+                              char* buf, size_t buf_size) {
+  const char* root = p_dev->media_dir ? p_dev->media_dir : ".";
+  while ('/' == *path) {
+    ++path;
+  }
+  int n_chr = snprintf(buf, buf_size, "%s/%s", root, path);
+  return (n_chr > 0 && (size_t)n_chr < buf_size) ? buf : NULL;
+}
 
-const char* blsys_ffind_first(bl_ffind_ctx_t* ctx, const char* path,
-                              const char* pattern) {
-  if (ctx && path && pattern) {
+static const char* tb_ffind_first(void* arg, bl_ffind_ctx_t* ctx,
+                                  const char* path, const char* pattern) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  char path_buf[PATH_MAX];
+  if (ctx && path && pattern &&
+      media_path(p_dev, path, path_buf, sizeof(path_buf))) {
     ctx->pattern = strdup(pattern);
-    ctx->dir = opendir(('\0' == *path || bl_streq(path, "/")) ? "./" : path);
+    ctx->dir = opendir(path_buf);
     if (ctx->pattern && ctx->dir) {
       struct dirent* ent;
       do {
@@ -226,7 +515,7 @@ const char* blsys_ffind_first(bl_ffind_ctx_t* ctx, const char* path,
   return NULL;
 }
 
-const char* blsys_ffind_next(bl_ffind_ctx_t* ctx) {
+static const char* tb_ffind_next(void* arg, bl_ffind_ctx_t* ctx) {
   if (ctx && ctx->pattern && ctx->dir) {
     struct dirent* ent;
     do {
@@ -241,7 +530,7 @@ const char* blsys_ffind_next(bl_ffind_ctx_t* ctx) {
   return NULL;
 }
 
-void blsys_ffind_close(bl_ffind_ctx_t* ctx) {
+static void tb_ffind_close(void* arg, bl_ffind_ctx_t* ctx) {
   if (ctx) {
     if (ctx->pattern) {
       free(ctx->pattern);
@@ -254,23 +543,63 @@ void blsys_ffind_close(bl_ffind_ctx_t* ctx) {
   }
 }
 
-bl_file_t blsys_fopen(bl_file_obj_t* p_file_obj, const char* filename,
-                      const char* mode) {
+/**
+ * Finds a slot in the table of files opened by the Bootloader
+ *
+ * @param p_dev  pointer to device
+ * @param file   file to find, NULL to find a free slot
+ * @return       pointer to the slot, or NULL if not found
+ */
+static FILE** find_file_slot(tb_device_t* p_dev, FILE* file) {
+  for (size_t idx = 0U; idx < DEVICE_MAX_FILES; ++idx) {
+    if (p_dev->files[idx] == file) {
+      return &p_dev->files[idx];
+    }
+  }
+  return NULL;
+}
+
+static bl_file_t tb_fopen(void* arg, bl_file_obj_t* p_file_obj,
+                          const char* filename, const char* mode) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  char path_buf[PATH_MAX];
+  FILE** p_slot = find_file_slot(p_dev, NULL);
   (void)p_file_obj;
-  return fopen(filename, mode);
+  if (p_dev->primary) {
+    cost_sd_seek();
+  }
+  if (p_slot && filename &&
+      media_path(p_dev, filename, path_buf, sizeof(path_buf))) {
+    *p_slot = fopen(path_buf, mode);
+    return *p_slot;
+  }
+  return NULL;
 }
 
-size_t blsys_fread(void* ptr, size_t size, size_t count, bl_file_t file) {
-  return fread(ptr, size, count, file);
+static size_t tb_fread(void* arg, void* ptr, size_t size, size_t count,
+                       bl_file_t file) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  size_t n_items = fread(ptr, size, count, file);
+  if (p_dev->primary) {
+    cost_sd_read(n_items * size);
+  }
+  return n_items;
 }
 
-bl_foffset_t blsys_ftell(bl_file_t file) { return (bl_foffset_t)ftell(file); }
+static bl_foffset_t tb_ftell(void* arg, bl_file_t file) {
+  return (bl_foffset_t)ftell(file);
+}
 
-int blsys_fseek(bl_file_t file, bl_foffset_t offset, int origin) {
+static int tb_fseek(void* arg, bl_file_t file, bl_foffset_t offset,
+                    int origin) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->primary) {
+    cost_sd_seek();
+  }
   return fseek(file, offset, origin);
 }
 
-bl_fsize_t blsys_fsize(bl_file_t file) {
+static bl_fsize_t tb_fsize(void* arg, bl_file_t file) {
   bl_fsize_t file_size = 0U;
 
   long curr_pos = ftell(file);
@@ -286,17 +615,26 @@ bl_fsize_t blsys_fsize(bl_file_t file) {
   return file_size;
 }
 
-int blsys_feof(bl_file_t file) { return feof(file); }
+static int tb_feof(void* arg, bl_file_t file) { return feof(file); }
 
-int blsys_fclose(bl_file_t file) { return fclose(file); }
+static int tb_fclose(void* arg, bl_file_t file) {
+  FILE** p_slot = find_file_slot((tb_device_t*)arg, file);
+  if (p_slot && file) {
+    *p_slot = NULL;
+  }
+  return fclose(file);
+}
 
-bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
-                              const char* text, uint32_t time_ms,
-                              uint32_t flags) {
+static bl_alert_status_t tb_alert(void* arg, blsys_alert_type_t type,
+                                  const char* caption, const char* text,
+                                  uint32_t time_ms, uint32_t flags) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
   bool arg_error = true;
   if ((int)type >= 0 && (int)type < bl_nalerts && caption && text) {
-    const char* alert = alert_type_str[type] ? alert_type_str[type] : "UNKNOWN";
     arg_error = false;
+  }
+  if (!arg_error && !p_dev->quiet) {
+    const char* alert = alert_type_str[type] ? alert_type_str[type] : "UNKNOWN";
     const size_t buf_size = strlen(caption) + strlen(text) + 100U;
     char* str_buf = malloc(buf_size);
     if (str_buf) {
@@ -304,20 +642,32 @@ bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
           snprintf(str_buf, buf_size, "(%s) %s: %s", alert, caption, text);
       if (n_chr > 0) {
         printf("\n%s", str_buf);
-        progress_n_chr = -1;
+        p_dev->progress_n_chr = -1;
       }
       free(str_buf);
     }
   }
 
   if (arg_error || bl_alert_error == type || (BL_FOREVER == time_ms)) {
-    blsys_deinit();
+    bool error = arg_error || bl_alert_error == type;
+    if (p_dev->p_halt) {
+      longjmp(*p_dev->p_halt, error ? device_halted_error : device_halted);
+    }
+    if (p_dev->primary) {
+      power_loss_halt(error);
+    }
+    tb_deinit(p_dev);
     printf("\nBootloader terminated");
     exit(-1);
   }
   return bl_alert_terminated;
 }
 
+static void tb_fatal_error(void* arg, const char* text) {
+  (void)tb_alert(arg, bl_alert_error, "Bootloader Error", text, BL_FOREVER,
+                 0U);
+}
+
 /**
  * Erases a number of characters from console using backspace
  *
@@ -337,9 +687,13 @@ static void console_erase(int n_chr) {
   }
 }
 
-void blsys_progress(const char* caption, const char* operation,
-                    uint32_t percent_x100) {
-  if (caption && operation) {
+static void tb_progress(void* arg, const char* caption, const char* operation,
+                        uint32_t percent_x100) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (p_dev->primary && caption && operation) {
+    cost_model_stage(operation);
+  }
+  if (caption && operation && !p_dev->quiet) {
     const size_t buf_size = strlen(caption) + strlen(operation) + 100U;
     char* str_buf = malloc(buf_size);
     if (str_buf) {
@@ -347,23 +701,116 @@ void blsys_progress(const char* caption, const char* operation,
                            (double)percent_x100 / 100.0, caption, operation);
       if (n_chr > 0) {
 #ifdef TESTBENCH_PROGRESS_NEWLINE
-        if (progress_prev_text) {
-          if (strcmp(progress_prev_text, str_buf) != 0) {
+        if (p_dev->progress_prev_text) {
+          if (strcmp(p_dev->progress_prev_text, str_buf) != 0) {
             printf("%s\n", str_buf);
-            free(progress_prev_text);
-            progress_prev_text = strdup(str_buf);
+            free(p_dev->progress_prev_text);
+            p_dev->progress_prev_text = strdup(str_buf);
           }
         } else {
           printf("\n%s\n", str_buf);
-          progress_prev_text = strdup(str_buf);
+          p_dev->progress_prev_text = strdup(str_buf);
         }
 #else   // TESTBENCH_PROGRESS_NEWLINE
-        console_erase(progress_n_chr);
-        printf(progress_n_chr > 0 ? "%s" : "\n%s", str_buf);
-        progress_n_chr = n_chr;
+        console_erase(p_dev->progress_n_chr);
+        printf(p_dev->progress_n_chr > 0 ? "%s" : "\n%s", str_buf);
+        p_dev->progress_n_chr = n_chr;
 #endif  // TESTBENCH_PROGRESS_NEWLINE
       }
       free(str_buf);
     }
   }
 }
+
+static uint32_t tb_time_us(void* arg) {
+#ifdef TESTBENCH_COST_MODEL
+  if (((tb_device_t*)arg)->primary) {
+    return (uint32_t)cost_model_time_us();
+  }
+#endif
+  struct timespec ts;
+  if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000U +
+                      (uint64_t)ts.tv_nsec / 1000U);
+  }
+  return 0U;
+}
+
+static bool tb_nvrec_read(void* arg, void* buf, size_t len) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (!p_dev->primary) {
+    if (buf && len && len == p_dev->nvrec_len) {
+      memcpy(buf, p_dev->nvrec, len);
+      return true;
+    }
+    return false;
+  }
+  bool ok = false;
+  FILE* in_file = fopen(NVREC_EMU_FILE, "rb");
+  if (in_file) {
+    ok = buf && fread(buf, 1U, len, in_file) == len && EOF == fgetc(in_file);
+    fclose(in_file);
+  }
+  return ok;
+}
+
+static bool tb_nvrec_write(void* arg, const void* buf, size_t len) {
+  tb_device_t* p_dev = (tb_device_t*)arg;
+  if (!p_dev->primary) {
+    if (buf && len && len <= sizeof(p_dev->nvrec)) {
+      memcpy(p_dev->nvrec, buf, len);
+      p_dev->nvrec_len = len;
+      return true;
+    }
+    return false;
+  }
+  bool ok = false;
+  FILE* out_file = fopen(NVREC_EMU_FILE, "wb");
+  if (out_file) {
+    ok = buf && fwrite(buf, 1U, len, out_file) == len;
+    ok = (0 == fclose(out_file)) && ok;
+  }
+  return ok;
+}
+
+static bool tb_start_firmware(void* arg, bl_addr_t start_addr,
+                              uint32_t argument) {
+  return false;
+}
+
+const bl_syscalls_t device_syscalls = {
+    .platform_id = tb_platform_id,
+    .init = tb_init,
+    .deinit = tb_deinit,
+    .flash_map_get_items = tb_flash_map_get_items,
+    .flash_erase = tb_flash_erase,
+    .flash_get_sector = tb_flash_get_sector,
+    .flash_read = tb_flash_read,
+    .flash_write = tb_flash_write,
+    .flash_crc32 = tb_flash_crc32,
+    .flash_write_protect = tb_flash_write_protect,
+    .flash_is_write_protected = tb_flash_is_write_protected,
+    .flash_read_protect = tb_flash_read_protect,
+    .flash_get_read_protection_level = tb_flash_get_read_protection_level,
+    .media_devices = tb_media_devices,
+    .media_name = tb_media_name,
+    .media_check = tb_media_check,
+    .media_mount = tb_media_mount,
+    .media_umount = tb_media_umount,
+    .ffind_first = tb_ffind_first,
+    .ffind_next = tb_ffind_next,
+    .ffind_close = tb_ffind_close,
+    .fopen = tb_fopen,
+    .fread = tb_fread,
+    .ftell = tb_ftell,
+    .fseek = tb_fseek,
+    .fsize = tb_fsize,
+    .feof = tb_feof,
+    .fclose = tb_fclose,
+    .fatal_error = tb_fatal_error,
+    .alert = tb_alert,
+    .progress = tb_progress,
+    .time_us = tb_time_us,
+    .nvrec_read = tb_nvrec_read,
+    .nvrec_write = tb_nvrec_write,
+    .start_firmware = tb_start_firmware};
@@ -0,0 +1,322 @@
+/**
+ * @file       cost_model.c
+ * @brief      Timing model of flash memory, SD card and hashing for testbench
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * Costs of CRC, SHA-256 and signature verification are charged by wrappers of
+ * library functions, installed with "-Wl,--wrap=..." linker options, so the
+ * model needs GNU ld or a compatible linker. Counters are updated atomically
+ * as signatures may be verified by several threads (PARALLEL_WORKERS). The
+ * device has a single core, so the costs of all threads are summed up.
+ */
+
+#ifdef TESTBENCH_COST_MODEL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32.h"
+#include "sha2.h"
+#include "secp256k1.h"
+#include "secp256k1_schnorr_batch.h"
+#include "bl_syscalls.h"
+#include "cost_model.h"
+
+/// Name of environment variable overriding parameters of the model
+#define COST_MODEL_ENV "TESTBENCH_COST_MODEL"
+/// Maximum number of distinct stages
+#define COST_MAX_STAGES 32U
+/// Name of the stage receiving costs before the first reported stage
+#define COST_INITIAL_STAGE "Start-up and checks"
+
+/// Parameters of the model
+typedef enum cost_param_id_t {
+  cost_cpu_mhz = 0,        ///< CPU clock, MHz
+  cost_erase_16k_us,       ///< Erase time of a 16 KB sector, us
+  cost_erase_64k_us,       ///< Erase time of a 64 KB sector, us
+  cost_erase_128k_us,      ///< Erase time of a 128 KB sector, us
+  cost_prog_word_us,       ///< Programming time of a 32-bit word, us
+  cost_sd_bytes_per_s,     ///< SD card read bandwidth, bytes per second
+  cost_sd_seek_us,         ///< SD card seek latency, us
+  cost_crc_cycles_per_b,   ///< CRC32 cost, CPU cycles per byte
+  cost_sha_cycles_per_b,   ///< SHA-256 cost, CPU cycles per byte
+  cost_ecdsa_us,           ///< Verification of an ECDSA signature, us
+  cost_schnorr_us,         ///< Verification of a Schnorr signature, us
+  cost_n_params_           ///< Number of parameters (not a parameter)
+} cost_param_id_t;
+
+/// Parameter of the model
+typedef struct cost_param_t {
+  const char* name;  ///< Name used in TESTBENCH_COST_MODEL variable
+  uint32_t value;    ///< Default value
+} cost_param_t;
+
+/// Default parameters, typical values for STM32F469 at 2.7-3.6 V and a
+/// 4-bit SDIO card
+// clang-format off
+static const cost_param_t default_params[cost_n_params_] = {
+  [cost_cpu_mhz]          = { "cpu_mhz",        180U },
+  [cost_erase_16k_us]     = { "erase_16k_us",   250000U },
+  [cost_erase_64k_us]     = { "erase_64k_us",   550000U },
+  [cost_erase_128k_us]    = { "erase_128k_us",  1000000U },
+  [cost_prog_word_us]     = { "prog_word_us",   16U },
+  [cost_sd_bytes_per_s]   = { "sd_bytes_per_s", 5000000U },
+  [cost_sd_seek_us]       = { "sd_seek_us",     1000U },
+  [cost_crc_cycles_per_b] = { "crc_cpb",        7U },
+  [cost_sha_cycles_per_b] = { "sha_cpb",        45U },
+  [cost_ecdsa_us]         = { "ecdsa_us",       15000U },
+  [cost_schnorr_us]       = { "schnorr_us",     15000U }};
+// clang-format on
+
+/// Operation counters printed in the report
+typedef enum cost_counter_id_t {
+  cost_cnt_erased_sectors = 0,  ///< Number of erased sectors
+  cost_cnt_programmed,          ///< Number of programmed bytes
+  cost_cnt_sd_read,             ///< Number of bytes read from SD card
+  cost_cnt_sd_seeks,            ///< Number of seeks on SD card
+  cost_cnt_crc,                 ///< Number of bytes processed by CRC32
+  cost_cnt_sha,                 ///< Number of bytes processed by SHA-256
+  cost_cnt_signatures,          ///< Number of verified signatures
+  cost_n_counters_              ///< Number of counters (not a counter)
+} cost_counter_id_t;
+
+/// State of the model
+static struct {
+  /// Parameters in use
+  uint32_t params[cost_n_params_];
+  /// Names of stages in order of appearance
+  const char* stage_name[COST_MAX_STAGES];
+  /// Time spent in each stage, ns
+  uint64_t stage_ns[COST_MAX_STAGES];
+  /// Number of known stages
+  uint32_t n_stages;
+  /// Index of the current stage
+  uint32_t curr_stage;
+  /// Virtual clock, ns
+  uint64_t clock_ns;
+  /// Operation counters
+  uint64_t counters[cost_n_counters_];
+} model;
+
+// Original library functions, resolved by the linker
+uint32_t __real_crc32_fast(const void* data, size_t length,
+                           uint32_t previousCrc32);
+void __real_sha256_Update(SHA256_CTX* context, const uint8_t* data,
+                          size_t len);
+int __real_secp256k1_ecdsa_verify(const secp256k1_context* ctx,
+                                  const secp256k1_ecdsa_signature* sig,
+                                  const unsigned char* msghash32,
+                                  const secp256k1_pubkey* pubkey);
+int __real_secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx, secp256k1_scratch_space* scratch,
+    const unsigned char* const* sigs64, const unsigned char* const* msgs32,
+    const secp256k1_pubkey* const* pubkeys, size_t n_sigs);
+
+/**
+ * Advances the virtual clock, adding time to the current stage
+ *
+ * @param ns  time in nanoseconds
+ */
+static void add_time(uint64_t ns) {
+  uint32_t stage = __atomic_load_n(&model.curr_stage, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&model.stage_ns[stage], ns, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&model.clock_ns, ns, __ATOMIC_RELAXED);
+}
+
+/**
+ * Advances the virtual clock by a number of CPU cycles
+ *
+ * @param cycles  number of cycles
+ */
+static void add_cycles(uint64_t cycles) {
+  add_time(cycles * 1000U / model.params[cost_cpu_mhz]);
+}
+
+/**
+ * Increments an operation counter
+ *
+ * @param id      counter
+ * @param amount  value added to the counter
+ */
+static inline void count(cost_counter_id_t id, uint64_t amount) {
+  __atomic_fetch_add(&model.counters[id], amount, __ATOMIC_RELAXED);
+}
+
+/**
+ * Sets a parameter from "name=value" string
+ *
+ * @param item  string with parameter name and value
+ * @return      true if successful
+ */
+static bool set_param(const char* item) {
+  const char* p_eq = strchr(item, '=');
+  if (p_eq) {
+    size_t name_len = (size_t)(p_eq - item);
+    for (int idx = 0; idx < (int)cost_n_params_; ++idx) {
+      const char* name = default_params[idx].name;
+      if (strlen(name) == name_len && 0 == strncmp(item, name, name_len)) {
+        char* p_end = NULL;
+        unsigned long value = strtoul(p_eq + 1, &p_end, 10);
+        if (p_end != p_eq + 1 && '\0' == *p_end && value <= UINT32_MAX &&
+            (value || idx != cost_cpu_mhz) &&
+            (value || idx != cost_sd_bytes_per_s)) {
+          model.params[idx] = (uint32_t)value;
+          return true;
+        }
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+void cost_model_init(void) {
+  memset(&model, 0, sizeof(model));
+  for (int idx = 0; idx < (int)cost_n_params_; ++idx) {
+    model.params[idx] = default_params[idx].value;
+  }
+  model.stage_name[0] = COST_INITIAL_STAGE;
+  model.n_stages = 1U;
+
+  const char* env = getenv(COST_MODEL_ENV);
+  if (env && *env) {
+    char* str = strdup(env);
+    bool ok = (str != NULL);
+    char* save_ptr = NULL;
+    for (char* item = ok ? strtok_r(str, ",", &save_ptr) : NULL; ok && item;
+         item = strtok_r(NULL, ",", &save_ptr)) {
+      ok = set_param(item);
+    }
+    free(str);
+    if (!ok) {
+      blsys_fatal_error("Invalid " COST_MODEL_ENV " parameters");
+    }
+  }
+}
+
+void cost_model_stage(const char* name) {
+  if (name) {
+    uint32_t idx = 0U;
+    while (idx < model.n_stages && strcmp(model.stage_name[idx], name) != 0) {
+      ++idx;
+    }
+    if (idx == model.n_stages) {
+      if (model.n_stages >= COST_MAX_STAGES) {
+        return;  // Accumulated to the current stage
+      }
+      model.stage_name[idx] = strdup(name);
+      if (!model.stage_name[idx]) {
+        return;
+      }
+      ++model.n_stages;
+    }
+    __atomic_store_n(&model.curr_stage, idx, __ATOMIC_RELAXED);
+  }
+}
+
+void cost_model_report(void) {
+  if (!model.clock_ns) {
+    return;  // Nothing happened, or already reported
+  }
+  double total_ms = (double)model.clock_ns / 1e6;
+  printf("\n\nEstimated time on the device:");
+  for (uint32_t idx = 0U; idx < model.n_stages; ++idx) {
+    if (model.stage_ns[idx]) {
+      double stage_ms = (double)model.stage_ns[idx] / 1e6;
+      printf("\n  %-40s %12.3f ms %6.2f%%", model.stage_name[idx], stage_ms,
+             total_ms > 0.0 ? stage_ms * 100.0 / total_ms : 0.0);
+    }
+  }
+  printf("\n  %-40s %12.3f ms", "Total", total_ms);
+  printf("\n  Erased %llu sectors, programmed %llu bytes, read %llu bytes "
+         "from SD card with %llu seeks",
+         (unsigned long long)model.counters[cost_cnt_erased_sectors],
+         (unsigned long long)model.counters[cost_cnt_programmed],
+         (unsigned long long)model.counters[cost_cnt_sd_read],
+         (unsigned long long)model.counters[cost_cnt_sd_seeks]);
+  printf("\n  CRC32 over %llu bytes, SHA-256 over %llu bytes, verified %llu "
+         "signatures",
+         (unsigned long long)model.counters[cost_cnt_crc],
+         (unsigned long long)model.counters[cost_cnt_sha],
+         (unsigned long long)model.counters[cost_cnt_signatures]);
+
+  for (uint32_t idx = 1U; idx < model.n_stages; ++idx) {
+    free((void*)model.stage_name[idx]);
+  }
+  uint32_t params[cost_n_params_];
+  memcpy(params, model.params, sizeof(params));
+  memset(&model, 0, sizeof(model));
+  memcpy(model.params, params, sizeof(params));
+  model.stage_name[0] = COST_INITIAL_STAGE;
+  model.n_stages = 1U;
+}
+
+uint64_t cost_model_time_us(void) {
+  return __atomic_load_n(&model.clock_ns, __ATOMIC_RELAXED) / 1000U;
+}
+
+void cost_flash_erase(size_t sect_size) {
+  uint64_t time_us;
+  if (sect_size <= 16U * 1024U) {
+    time_us = model.params[cost_erase_16k_us];
+  } else if (sect_size <= 64U * 1024U) {
+    time_us = model.params[cost_erase_64k_us];
+  } else {
+    time_us = (uint64_t)model.params[cost_erase_128k_us] * sect_size /
+              (128U * 1024U);
+  }
+  count(cost_cnt_erased_sectors, 1U);
+  add_time(time_us * 1000U);
+}
+
+void cost_flash_program(size_t len) {
+  uint64_t n_words = (len + sizeof(uint32_t) - 1U) / sizeof(uint32_t);
+  count(cost_cnt_programmed, len);
+  add_time(n_words * model.params[cost_prog_word_us] * 1000U);
+}
+
+void cost_sd_seek(void) {
+  count(cost_cnt_sd_seeks, 1U);
+  add_time((uint64_t)model.params[cost_sd_seek_us] * 1000U);
+}
+
+void cost_sd_read(size_t len) {
+  count(cost_cnt_sd_read, len);
+  add_time((uint64_t)len * 1000000000U / model.params[cost_sd_bytes_per_s]);
+}
+
+uint32_t __wrap_crc32_fast(const void* data, size_t length,
+                           uint32_t previousCrc32) {
+  count(cost_cnt_crc, length);
+  add_cycles((uint64_t)length * model.params[cost_crc_cycles_per_b]);
+  return __real_crc32_fast(data, length, previousCrc32);
+}
+
+void __wrap_sha256_Update(SHA256_CTX* context, const uint8_t* data,
+                          size_t len) {
+  count(cost_cnt_sha, len);
+  add_cycles((uint64_t)len * model.params[cost_sha_cycles_per_b]);
+  __real_sha256_Update(context, data, len);
+}
+
+int __wrap_secp256k1_ecdsa_verify(const secp256k1_context* ctx,
+                                  const secp256k1_ecdsa_signature* sig,
+                                  const unsigned char* msghash32,
+                                  const secp256k1_pubkey* pubkey) {
+  count(cost_cnt_signatures, 1U);
+  add_time((uint64_t)model.params[cost_ecdsa_us] * 1000U);
+  return __real_secp256k1_ecdsa_verify(ctx, sig, msghash32, pubkey);
+}
+
+int __wrap_secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx, secp256k1_scratch_space* scratch,
+    const unsigned char* const* sigs64, const unsigned char* const* msgs32,
+    const secp256k1_pubkey* const* pubkeys, size_t n_sigs) {
+  count(cost_cnt_signatures, n_sigs);
+  add_time((uint64_t)n_sigs * model.params[cost_schnorr_us] * 1000U);
+  return __real_secp256k1_schnorr_verify_batch(ctx, scratch, sigs64, msgs32,
+                                               pubkeys, n_sigs);
+}
+
+#endif  // TESTBENCH_COST_MODEL
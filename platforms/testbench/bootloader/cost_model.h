@@ -0,0 +1,88 @@
+/**
+ * @file       cost_model.h
+ * @brief      Timing model of flash memory, SD card and hashing for testbench
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * When the testbench is built with COST_MODEL=1, each emulated operation
+ * advances a virtual clock by the time it would take on the device, and the
+ * time is accumulated per upgrading stage reported through blsys_progress().
+ * Without it, all functions declared here are no-ops.
+ */
+
+#ifndef COST_MODEL_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define COST_MODEL_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef TESTBENCH_COST_MODEL
+
+/**
+ * Resets the virtual clock and reads parameters of the model
+ *
+ * Default parameters may be overridden with TESTBENCH_COST_MODEL environment
+ * variable holding a comma-separated list of "name=value" pairs.
+ */
+void cost_model_init(void);
+
+/**
+ * Prints time spent in each stage since cost_model_init()
+ */
+void cost_model_report(void);
+
+/**
+ * Switches the stage receiving following costs
+ *
+ * @param name  name of the stage
+ */
+void cost_model_stage(const char* name);
+
+/**
+ * Returns time on the virtual clock
+ *
+ * @return  time in microseconds
+ */
+uint64_t cost_model_time_us(void);
+
+/**
+ * Adds the cost of erasing a sector of flash memory
+ *
+ * @param sect_size  size of the sector
+ */
+void cost_flash_erase(size_t sect_size);
+
+/**
+ * Adds the cost of programming flash memory
+ *
+ * @param len  number of programmed bytes
+ */
+void cost_flash_program(size_t len);
+
+/**
+ * Adds the cost of positioning in a file on SD card (open or seek)
+ */
+void cost_sd_seek(void);
+
+/**
+ * Adds the cost of reading from SD card
+ *
+ * @param len  number of bytes read
+ */
+void cost_sd_read(size_t len);
+
+#else  // TESTBENCH_COST_MODEL
+
+static inline void cost_model_init(void) {}
+static inline void cost_model_report(void) {}
+static inline void cost_model_stage(const char* name) { (void)name; }
+static inline uint64_t cost_model_time_us(void) { return 0U; }
+static inline void cost_flash_erase(size_t sect_size) { (void)sect_size; }
+static inline void cost_flash_program(size_t len) { (void)len; }
+static inline void cost_sd_seek(void) {}
+static inline void cost_sd_read(size_t len) { (void)len; }
+
+#endif  // TESTBENCH_COST_MODEL
+
+#endif  // COST_MODEL_H_INCLUDED
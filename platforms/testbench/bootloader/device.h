@@ -0,0 +1,101 @@
+/**
+ * @file       device.h
+ * @brief      Emulated devices of testbench
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * Each device has its own emulated flash memory, media directory and
+ * non-volatile record. System calls of the Bootloader are implemented by
+ * device_syscalls[], taking a pointer to the device as the argument, so that
+ * several devices are able to run in parallel threads of one process.
+ */
+
+#ifndef DEVICE_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define DEVICE_H_INCLUDED
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "bl_syscalls.h"
+
+/// Base address of emulated flash memory
+#define DEVICE_FLASH_BASE 0x08000000U
+/// Size of emulated flash memory, 2 megabytes
+#define DEVICE_FLASH_SIZE (2U * 1024U * 1024U)
+/// Maximum number of files opened simultaneously by the Bootloader
+#define DEVICE_MAX_FILES 4U
+/// Maximum size of the record kept in non-volatile memory
+#define DEVICE_NVREC_MAX 256U
+
+/// Values passed to longjmp() when a device is halted
+typedef enum device_halt_t {
+  device_halted = 1,    ///< Halted normally, e.g. after an upgrade
+  device_halted_error   ///< Halted because of an error
+} device_halt_t;
+
+/// Emulated device
+typedef struct tb_device_t {
+  /// Emulated flash memory, a mapping of the flash memory file
+  uint8_t* flash;
+  /// Flag indicating that the mapping is private and kept until closed
+  bool flash_pinned;
+  /// Bitmap of write protected sectors
+  uint32_t flash_wrp;
+  /// Directory emulating the media, NULL for the working directory
+  const char* media_dir;
+  /// Flag indicating that console output is suppressed
+  bool quiet;
+  /// Flag indicating the device of single-device mode, using the power-loss
+  /// and cost model hooks and keeping the non-volatile record in a file
+  bool primary;
+  /// Context restored when the device is halted, NULL to exit the process
+  jmp_buf* p_halt;
+  /// Files opened by the Bootloader, closed with the device if it is halted
+  FILE* files[DEVICE_MAX_FILES];
+  /// Record kept in non-volatile memory, if not primary
+  uint8_t nvrec[DEVICE_NVREC_MAX];
+  /// Size of the record, 0 if none
+  size_t nvrec_len;
+  /// Printed characters of the progress message
+  int progress_n_chr;
+  /// Text of the last progress message
+  char* progress_prev_text;
+} tb_device_t;
+
+/// System calls of emulated devices, taking a pointer to tb_device_t
+extern const bl_syscalls_t device_syscalls;
+
+/// Device of single-device mode, its flash memory is mapped on start-up
+extern tb_device_t device_primary;
+
+/**
+ * Opens a device with a private copy of the flash memory file
+ *
+ * The mapping is copy-on-write: changes made by the device are never written
+ * to the file, and only modified pages take memory.
+ *
+ * @param p_dev      pointer to device, initialized by this function
+ * @param media_dir  directory emulating the media, NULL for the working
+ *                   directory; must stay valid while the device is used
+ * @return           true if successful
+ */
+bool device_open(tb_device_t* p_dev, const char* media_dir);
+
+/**
+ * Closes a device, releasing resources left if it was halted
+ *
+ * @param p_dev  pointer to device
+ */
+void device_close(tb_device_t* p_dev);
+
+/**
+ * Returns pointer to an area of emulated flash memory of a device
+ *
+ * @param p_dev  pointer to device
+ * @param addr   starting address
+ * @param size   area size
+ * @return       pointer to memory, or NULL if the area is out of range
+ */
+uint8_t* device_flash_ptr(tb_device_t* p_dev, bl_addr_t addr, size_t size);
+
+#endif  // DEVICE_H_INCLUDED
@@ -0,0 +1,289 @@
+/**
+ * @file       fleet.c
+ * @brief      Fleet of emulated devices upgraded in parallel
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "crc32.h"
+#include "sha2.h"
+#include "bl_integrity_check.h"
+#include "bl_syscalls.h"
+#include "device.h"
+#include "fleet.h"
+
+/// Initial states of devices
+typedef enum fleet_state_t {
+  state_intact = 0,            ///< Image of flash memory file as is
+  state_blank,                 ///< Flash memory is erased
+  state_no_firmware,           ///< Main Firmware area is erased
+  state_corrupted_firmware,    ///< A byte of the Main Firmware is changed
+  state_corrupted_bootloader,  ///< A byte of a Bootloader copy is changed
+  n_fleet_states_              ///< Number of initial states (not a state)
+} fleet_state_t;
+
+/// Outcomes of an upgrade
+typedef enum fleet_outcome_t {
+  outcome_valid = 0,  ///< Main Firmware is valid after the Bootloader exits
+  outcome_rejected,   ///< Bootloader reported an error
+  outcome_failed,     ///< Main Firmware is not valid, no error reported
+  n_fleet_outcomes_   ///< Number of outcomes (not an outcome)
+} fleet_outcome_t;
+
+/// Names of initial states
+// clang-format off
+static const char* state_name[n_fleet_states_] = {
+  [state_intact]               = "intact",
+  [state_blank]                = "blank",
+  [state_no_firmware]          = "no firmware",
+  [state_corrupted_firmware]   = "corrupted firmware",
+  [state_corrupted_bootloader] = "corrupted Bootloader" };
+// clang-format on
+
+/// Fleet shared by worker threads
+typedef struct fleet_t {
+  /// Arguments passed to bootloader_run()
+  const bl_args_t* p_args;
+  /// Flags passed to bootloader_run()
+  uint32_t flags;
+  /// Number of devices
+  uint32_t n_devices;
+  /// Media directories used in turn
+  const char* const* media_dirs;
+  /// Number of media directories
+  uint32_t n_media;
+  /// Index of the next device to upgrade, incremented atomically
+  uint32_t next_device;
+  /// Counters of outcomes for each initial state, incremented atomically
+  uint32_t outcomes[n_fleet_states_][n_fleet_outcomes_];
+  /// Number of devices which could not be opened, incremented atomically
+  uint32_t n_not_opened;
+} fleet_t;
+
+/**
+ * Returns a pseudo-random number, reproducible for each device
+ *
+ * @param p_seed  pointer to the state of the generator, must not be 0
+ * @return        next pseudo-random number
+ */
+static uint32_t xorshift32(uint32_t* p_seed) {
+  uint32_t x = *p_seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *p_seed = x;
+  return x;
+}
+
+/**
+ * Changes a pseudo-random byte in an area of flash memory
+ *
+ * @param p_dev   pointer to device
+ * @param addr    starting address of the area
+ * @param size    size of the area
+ * @param p_seed  pointer to the state of pseudo-random generator
+ * @return        true if successful
+ */
+static bool corrupt_byte(tb_device_t* p_dev, bl_addr_t addr, size_t size,
+                         uint32_t* p_seed) {
+  uint8_t* p_area = device_flash_ptr(p_dev, addr, size);
+  if (p_area && size) {
+    size_t offset = xorshift32(p_seed) % size;
+    p_area[offset] ^= (uint8_t)(1U + xorshift32(p_seed) % 255U);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Brings a device to its initial state
+ *
+ * @param p_dev  pointer to device
+ * @param state  initial state
+ * @param seed   seed of pseudo-random generator, must not be 0
+ * @return       true if successful
+ */
+static bool apply_state(tb_device_t* p_dev, fleet_state_t state,
+                        uint32_t seed) {
+  bl_addr_t fw_base = 0U;
+  bl_addr_t fw_size = 0U;
+  bl_addr_t bl_base[2] = {0U};
+  bl_addr_t bl_size = 0U;
+  if (!blsys_flash_map_get_items(
+          5, bl_flash_firmware_base, &fw_base, bl_flash_firmware_size,
+          &fw_size, bl_flash_bootloader_copy1_base, &bl_base[0],
+          bl_flash_bootloader_copy2_base, &bl_base[1],
+          bl_flash_bootloader_size, &bl_size)) {
+    return false;
+  }
+
+  uint8_t* p_mem = NULL;
+  switch (state) {
+    case state_intact:
+      return true;
+    case state_blank:
+      p_mem = device_flash_ptr(p_dev, DEVICE_FLASH_BASE, DEVICE_FLASH_SIZE);
+      if (p_mem) {
+        memset(p_mem, 0xFF, DEVICE_FLASH_SIZE);
+      }
+      return p_mem != NULL;
+    case state_no_firmware:
+      p_mem = device_flash_ptr(p_dev, fw_base, fw_size);
+      if (p_mem) {
+        memset(p_mem, 0xFF, fw_size);
+      }
+      return p_mem != NULL;
+    case state_corrupted_firmware:
+      return corrupt_byte(p_dev, fw_base, fw_size, &seed);
+    case state_corrupted_bootloader:
+      return corrupt_byte(p_dev, bl_base[xorshift32(&seed) & 1U], bl_size,
+                          &seed);
+    default:
+      return false;
+  }
+}
+
+/**
+ * Checks integrity of the Main Firmware
+ *
+ * @return  true if the Main Firmware is valid
+ */
+static bool check_firmware(void) {
+  bl_addr_t fw_base = 0U;
+  bl_addr_t fw_size = 0U;
+  return blsys_flash_map_get_items(2, bl_flash_firmware_base, &fw_base,
+                                   bl_flash_firmware_size, &fw_size) &&
+         bl_icr_verify(fw_base, fw_size, NULL);
+}
+
+/**
+ * Upgrades one device in the calling thread
+ *
+ * @param p_fleet     pointer to the fleet
+ * @param device_idx  index of the device
+ */
+static void upgrade_device(fleet_t* p_fleet, uint32_t device_idx) {
+  const char* media_dir =
+      p_fleet->n_media ? p_fleet->media_dirs[device_idx % p_fleet->n_media]
+                       : NULL;
+  fleet_state_t state = (fleet_state_t)(device_idx % n_fleet_states_);
+  tb_device_t dev;
+  if (!device_open(&dev, media_dir)) {
+    __atomic_fetch_add(&p_fleet->n_not_opened, 1U, __ATOMIC_RELAXED);
+    return;
+  }
+  bl_sysctx_t sysctx = {.p_calls = &device_syscalls, .arg = &dev};
+  (void)blsys_bind(&sysctx);
+
+  volatile fleet_outcome_t outcome = outcome_failed;
+  if (apply_state(&dev, state, 2654435761U * (device_idx + 1U))) {
+    jmp_buf halt;
+    dev.p_halt = &halt;
+    int halted = setjmp(halt);
+    if (0 == halted) {
+      bl_args_t args = *p_fleet->p_args;
+      bl_status_t status = bootloader_run_ctx(&sysctx, &args, p_fleet->flags);
+      halted = bootloader_has_error(status) ? device_halted_error : 0;
+    }
+    // The device may be halted inside bootloader_run_ctx(), leaving the
+    // context bound, or not: bind it again to check the firmware
+    (void)blsys_bind(&sysctx);
+    dev.p_halt = NULL;
+    if (device_halted_error == halted) {
+      outcome = outcome_rejected;
+    } else {
+      outcome = check_firmware() ? outcome_valid : outcome_failed;
+    }
+  }
+  (void)blsys_bind(NULL);
+  device_close(&dev);
+  __atomic_fetch_add(&p_fleet->outcomes[state][outcome], 1U, __ATOMIC_RELAXED);
+}
+
+/**
+ * Worker thread upgrading devices until none is left
+ *
+ * @param arg  pointer to the fleet, fleet_t
+ * @return     always NULL
+ */
+static void* fleet_worker(void* arg) {
+  fleet_t* p_fleet = (fleet_t*)arg;
+  uint32_t idx;
+  while ((idx = __atomic_fetch_add(&p_fleet->next_device, 1U,
+                                   __ATOMIC_RELAXED)) < p_fleet->n_devices) {
+    upgrade_device(p_fleet, idx);
+  }
+  return NULL;
+}
+
+bool fleet_run(const bl_args_t* p_args, uint32_t flags, uint32_t n_devices,
+               uint32_t n_threads, const char* const* media_dirs,
+               uint32_t n_media) {
+  if (!p_args || !n_devices || (n_media && !media_dirs)) {
+    return false;
+  }
+  if (!n_threads) {
+    long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    n_threads = (n_cpu > 0) ? (uint32_t)n_cpu : 1U;
+  }
+  n_threads = (n_threads < n_devices) ? n_threads : n_devices;
+  fleet_t* p_fleet = calloc(1U, sizeof(fleet_t));
+  pthread_t* threads = calloc(n_threads, sizeof(pthread_t));
+  if (!p_fleet || !threads) {
+    free(p_fleet);
+    free(threads);
+    return false;
+  }
+  p_fleet->p_args = p_args;
+  p_fleet->flags = flags;
+  p_fleet->n_devices = n_devices;
+  p_fleet->media_dirs = media_dirs;
+  p_fleet->n_media = n_media;
+
+  // Hash functions select their implementation on first use, let it happen
+  // before workers start
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  (void)crc32_fast(digest, sizeof(digest), 0U);
+  sha256_Raw(digest, sizeof(digest), digest);
+
+  struct timespec t_start, t_end;
+  clock_gettime(CLOCK_MONOTONIC, &t_start);
+  uint32_t n_started = 0U;
+  while (n_started < n_threads && 0 == pthread_create(&threads[n_started], NULL,
+                                                      fleet_worker, p_fleet)) {
+    ++n_started;
+  }
+  if (!n_started) {
+    fleet_worker(p_fleet);  // Upgrade devices in the calling thread
+  }
+  for (uint32_t idx = 0U; idx < n_started; ++idx) {
+    pthread_join(threads[idx], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+  double elapsed = (double)(t_end.tv_sec - t_start.tv_sec) +
+                   (double)(t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+  printf("\nFleet: %u devices upgraded by %u threads in %.2f s", n_devices,
+         n_started ? n_started : 1U, elapsed);
+  uint32_t n_failed = p_fleet->n_not_opened;
+  for (int state = 0; state < n_fleet_states_; ++state) {
+    const uint32_t* p_cnt = p_fleet->outcomes[state];
+    printf("\n  %-22s valid: %u, rejected: %u, failed: %u", state_name[state],
+           p_cnt[outcome_valid], p_cnt[outcome_rejected],
+           p_cnt[outcome_failed]);
+    n_failed += p_cnt[outcome_failed];
+  }
+  if (p_fleet->n_not_opened) {
+    printf("\n  %u devices could not be opened", p_fleet->n_not_opened);
+  }
+  free(threads);
+  free(p_fleet);
+  return !n_failed;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file       fleet.h
+ * @brief      Fleet of emulated devices upgraded in parallel
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * Each device of the fleet starts with a private copy-on-write image of the
+ * flash memory file, altered according to one of the initial states (intact,
+ * blank, missing or corrupted firmware, corrupted Bootloader copy), assigned
+ * in turn. Devices are upgraded on a pool of threads, each running the
+ * Bootloader core with its own thread-local state, and the Main Firmware of
+ * every device is checked after the upgrade.
+ */
+
+#ifndef FLEET_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define FLEET_H_INCLUDED
+
+#include <stdbool.h>
+#include "bootloader.h"
+
+/**
+ * Upgrades a fleet of emulated devices
+ *
+ * A summary is printed for each initial state. A device fails if the
+ * Bootloader reports success but the Main Firmware is not valid afterwards;
+ * upgrades rejected with an error are counted, but are not failures.
+ *
+ * @param p_args      arguments passed to bootloader_run()
+ * @param flags       flags passed to bootloader_run()
+ * @param n_devices   number of devices
+ * @param n_threads   number of threads, 0 for one per available CPU
+ * @param media_dirs  directories used as media of devices in turn, NULL for
+ *                    the working directory
+ * @param n_media     number of media directories
+ * @return            true if no device fails
+ */
+bool fleet_run(const bl_args_t* p_args, uint32_t flags, uint32_t n_devices,
+               uint32_t n_threads, const char* const* media_dirs,
+               uint32_t n_media);
+
+#endif  // FLEET_H_INCLUDED
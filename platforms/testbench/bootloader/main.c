@@ -1,18 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bootloader.h"
+#include "power_loss.h"
+#include "device.h"
+#include "fleet.h"
 
 int main(int argc, char* argv[]) {
   printf("\nBootloader host test bench");
 
+  // System calls are made to the device of single-device mode by default
+  bl_sysctx_t sysctx = {.p_calls = &device_syscalls, .arg = &device_primary};
+  (void)blsys_bind(&sysctx);
+
   bl_addr_t bl_addr = 0U;
   if (!blsys_flash_map_get_items(1, bl_flash_bootloader_copy1_base, &bl_addr)) {
     blsys_fatal_error("Cannot get Bootloader address");
   }
 
-  printf("\nStarting Bootloader");
   bl_args_t args = {.loaded_from = bl_addr};
-  bl_status_t status = bootloader_run(
-      &args, bl_flag_no_args_crc_check | bl_flag_allow_rc_versions);
+  uint32_t flags = bl_flag_no_args_crc_check | bl_flag_allow_rc_versions;
+  if (argc > 1 && 0 == strcmp(argv[1], "--power-loss")) {
+    bool ok = power_loss_test(&args, flags);
+    printf("\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (argc > 2 && 0 == strcmp(argv[1], "--fleet")) {
+    uint32_t n_devices = (uint32_t)strtoul(argv[2], NULL, 0);
+    uint32_t n_threads = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 0U;
+    uint32_t n_media = (argc > 4) ? (uint32_t)(argc - 4) : 0U;
+    bool ok = fleet_run(&args, flags, n_devices, n_threads,
+                        (const char* const*)&argv[4], n_media);
+    printf("\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  printf("\nStarting Bootloader");
+  bl_status_t status = bootloader_run(&args, flags);
   printf("\nBootloader exited with status: %s", bootloader_status_text(status));
 }
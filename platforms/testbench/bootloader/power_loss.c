@@ -0,0 +1,313 @@
+/**
+ * @file       power_loss.c
+ * @brief      Power-loss injection harness for testbench
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "bl_integrity_check.h"
+#include "bl_syscalls.h"
+#include "power_loss.h"
+
+/// Results of a replay, used as exit codes of replaying processes
+typedef enum replay_result_t {
+  replay_ok = 0,           ///< Device stays recoverable
+  replay_not_cut,          ///< Upgrade finished before interrupted operation
+  replay_no_bootloader,    ///< No valid copy of the Bootloader after power loss
+  replay_upgrade_error,    ///< Bootloader returned an error
+  replay_no_firmware,      ///< Main Firmware is not valid after the upgrade
+  replay_terminated,       ///< Process terminated, e.g. by a fatal error
+  n_replay_results_        ///< Number of results (not a result)
+} replay_result_t;
+
+/// Descriptions of replay results
+// clang-format off
+static const char* replay_result_text[n_replay_results_] = {
+  [replay_ok]            = "recoverable",
+  [replay_not_cut]       = "upgrade finished before the operation",
+  [replay_no_bootloader] = "no valid Bootloader",
+  [replay_upgrade_error] = "Bootloader returned an error",
+  [replay_no_firmware]   = "no valid Main Firmware",
+  [replay_terminated]    = "Bootloader terminated" };
+// clang-format on
+
+/// Data shared between the harness and replaying processes
+typedef struct shared_t {
+  /// Number of flash memory operations in the reference upgrade
+  uint32_t n_ops;
+  /// Flag indicating that a valid Bootloader is present before the upgrade
+  bool had_bootloader;
+} shared_t;
+
+/// State of the current process
+static struct {
+  /// Number of flash memory operations counted so far
+  uint32_t n_ops;
+  /// Index of interrupted operation starting from 1, 0 if not interrupted
+  uint32_t cut_at;
+  /// Flag indicating that the Bootloader is run by the harness
+  bool active;
+  /// Context restored on power loss or when the Bootloader halts
+  jmp_buf stop;
+} pl;
+
+/// Ways the Bootloader stops, values passed to longjmp()
+typedef enum run_result_t {
+  run_returned = 0,  ///< Bootloader returned
+  run_power_off,     ///< Power is lost
+  run_halted,        ///< Bootloader halted the device
+  run_halted_error   ///< Bootloader halted the device because of an error
+} run_result_t;
+
+bool power_loss_flash_op(void) {
+  ++pl.n_ops;
+  return pl.cut_at && pl.n_ops == pl.cut_at;
+}
+
+void power_loss_cut(void) { longjmp(pl.stop, run_power_off); }
+
+void power_loss_halt(bool error) {
+  if (pl.active) {
+    longjmp(pl.stop, error ? run_halted_error : run_halted);
+  }
+}
+
+/**
+ * Runs the Bootloader until it returns, halts or power is lost
+ *
+ * @param p_args  arguments passed to bootloader_run()
+ * @param flags   flags passed to bootloader_run()
+ * @return        the way the Bootloader stopped, run_halted_error if it
+ *                returned an error
+ */
+static run_result_t run_bootloader(bl_args_t* p_args, uint32_t flags) {
+  volatile run_result_t result = (run_result_t)setjmp(pl.stop);
+  if (run_returned == result) {
+    pl.active = true;
+    bl_status_t status = bootloader_run(p_args, flags);
+    result = bootloader_has_error(status) ? run_halted_error : run_returned;
+  }
+  pl.active = false;
+  return result;
+}
+
+/**
+ * Selects a copy of the Bootloader like the Start-up code does
+ *
+ * @param p_bl_addr  pointer to variable receiving address of the selected
+ *                   copy, unchanged if there is no valid copy
+ * @return           true if a valid copy is found
+ */
+static bool select_bootloader(bl_addr_t* p_bl_addr) {
+  bl_addr_t bl_addr[2] = {0U};
+  bl_addr_t bl_size = 0U;
+  if (!blsys_flash_map_get_items(3, bl_flash_bootloader_copy1_base,
+                                 &bl_addr[0], bl_flash_bootloader_copy2_base,
+                                 &bl_addr[1], bl_flash_bootloader_size,
+                                 &bl_size)) {
+    return false;
+  }
+
+  // Find a copy with the latest version
+  uint32_t version[2];
+  int selected = -1;
+  for (int idx = 0; idx < 2; ++idx) {
+    version[idx] = BL_VERSION_NA;
+    if (bl_icr_get_version(bl_addr[idx], bl_size, &version[idx]) &&
+        (-1 == selected || version[idx] > version[selected])) {
+      selected = idx;
+    }
+  }
+  if (selected < 0) {
+    return false;
+  }
+
+  // Verify selected copy, or find a replacement with the same version
+  for (int n = 0; n < 2; ++n) {
+    int idx = n ? 1 - selected : selected;
+    if (version[idx] == version[selected] &&
+        bl_icr_verify(bl_addr[idx], bl_size, NULL)) {
+      *p_bl_addr = bl_addr[idx];
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Checks integrity of the Main Firmware
+ *
+ * @return  true if the Main Firmware is valid
+ */
+static bool check_firmware(void) {
+  bl_addr_t fw_base = 0U;
+  bl_addr_t fw_size = 0U;
+  return blsys_flash_map_get_items(2, bl_flash_firmware_base, &fw_base,
+                                   bl_flash_firmware_size, &fw_size) &&
+         bl_icr_verify(fw_base, fw_size, NULL);
+}
+
+/**
+ * Runs the upgrade, interrupting it and rebooting the device if requested
+ *
+ * @param p_args    arguments passed to bootloader_run()
+ * @param flags     flags passed to bootloader_run()
+ * @param cut_at    index of interrupted operation starting from 1, or 0 to run
+ *                  the reference upgrade
+ * @param p_shared  pointer to data shared with the harness
+ * @return          result of the replay
+ */
+static replay_result_t replay(const bl_args_t* p_args, uint32_t flags,
+                              uint32_t cut_at, shared_t* p_shared) {
+  bl_args_t args = *p_args;
+  bl_addr_t bl_addr = args.loaded_from;
+  pl.n_ops = 0U;
+  pl.cut_at = cut_at;
+
+  if (cut_at) {
+    if (run_bootloader(&args, flags) != run_power_off) {
+      return replay_not_cut;
+    }
+    // Power is lost: state of system calls is dropped, flash memory remains
+    blsys_deinit();
+    pl.cut_at = 0U;
+    if (!select_bootloader(&bl_addr) && p_shared->had_bootloader) {
+      return replay_no_bootloader;
+    }
+  } else {
+    p_shared->had_bootloader = select_bootloader(&bl_addr);
+  }
+  args.loaded_from = (uint32_t)bl_addr;
+
+  run_result_t result = run_bootloader(&args, flags);
+  if (!cut_at) {
+    p_shared->n_ops = pl.n_ops;
+  }
+  if (run_halted_error == result) {
+    return replay_upgrade_error;
+  }
+  return check_firmware() ? replay_ok : replay_no_firmware;
+}
+
+/**
+ * Starts a replay in a new process
+ *
+ * @param p_args    arguments passed to bootloader_run()
+ * @param flags     flags passed to bootloader_run()
+ * @param cut_at    index of interrupted operation, 0 for the reference run
+ * @param p_shared  pointer to data shared with the harness
+ * @param quiet     if true, output of the replay is suppressed
+ * @return          process ID, or -1 if failed
+ */
+static pid_t start_replay(const bl_args_t* p_args, uint32_t flags,
+                          uint32_t cut_at, shared_t* p_shared, bool quiet) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (0 == pid) {
+    if (quiet) {
+      int fd = open("/dev/null", O_WRONLY);
+      if (fd >= 0) {
+        (void)dup2(fd, STDOUT_FILENO);
+        close(fd);
+      }
+    }
+    replay_result_t result = replay(p_args, flags, cut_at, p_shared);
+    fflush(stdout);
+    _exit((int)result);
+  }
+  return pid;
+}
+
+/**
+ * Decodes result of a replay from status of its process
+ *
+ * @param status  status returned by waitpid()
+ * @return        result of the replay
+ */
+static replay_result_t replay_result(int status) {
+  if (WIFEXITED(status) && WEXITSTATUS(status) < replay_terminated) {
+    return (replay_result_t)WEXITSTATUS(status);
+  }
+  return replay_terminated;
+}
+
+bool power_loss_test(const bl_args_t* p_args, uint32_t flags) {
+  if (!p_args || !testbench_flash_snapshot()) {
+    fprintf(stderr, "\nPower-loss test: unable to map flash memory");
+    return false;
+  }
+  shared_t* p_shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == p_shared) {
+    return false;
+  }
+
+  // Reference upgrade counting flash memory operations
+  int status = 0;
+  pid_t pid = start_replay(p_args, flags, 0U, p_shared, true);
+  replay_result_t result = replay_terminated;
+  if (pid > 0 && waitpid(pid, &status, 0) == pid) {
+    result = replay_result(status);
+  }
+  if (result != replay_ok) {
+    fprintf(stderr, "\nPower-loss test: reference upgrade failed: %s",
+            replay_result_text[result]);
+    munmap(p_shared, sizeof(shared_t));
+    return false;
+  }
+  uint32_t n_ops = p_shared->n_ops;
+  printf("\nPower-loss test: %u flash memory operations%s", n_ops,
+         p_shared->had_bootloader ? "" : ", no valid Bootloader initially");
+
+  // Replays, one per available CPU
+  long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t max_jobs = (n_cpu > 0) ? (uint32_t)n_cpu : 1U;
+  pid_t* job_pid = calloc(max_jobs, sizeof(pid_t));
+  uint32_t* job_cut = calloc(max_jobs, sizeof(uint32_t));
+  uint32_t n_failed = 0U;
+  bool ok = job_pid && job_cut;
+  uint32_t next_cut = 1U;
+  uint32_t n_running = 0U;
+  while (ok && (next_cut <= n_ops || n_running)) {
+    for (uint32_t idx = 0U; idx < max_jobs && next_cut <= n_ops; ++idx) {
+      if (!job_pid[idx]) {
+        job_pid[idx] = start_replay(p_args, flags, next_cut, p_shared, true);
+        job_cut[idx] = next_cut++;
+        ok = ok && job_pid[idx] > 0;
+        ++n_running;
+      }
+    }
+    pid = wait(&status);
+    ok = ok && pid > 0;
+    for (uint32_t idx = 0U; ok && idx < max_jobs; ++idx) {
+      if (job_pid[idx] == pid) {
+        result = replay_result(status);
+        if (result != replay_ok) {
+          fprintf(stderr, "\nPower loss at operation %u: %s", job_cut[idx],
+                  replay_result_text[result]);
+          ++n_failed;
+        }
+        job_pid[idx] = 0;
+        --n_running;
+      }
+    }
+  }
+  free(job_pid);
+  free(job_cut);
+  munmap(p_shared, sizeof(shared_t));
+
+  if (!ok) {
+    fprintf(stderr, "\nPower-loss test: unable to run replays");
+    return false;
+  }
+  printf("\nPower-loss test: %u of %u interruption points recoverable",
+         n_ops - n_failed, n_ops);
+  return !n_failed;
+}
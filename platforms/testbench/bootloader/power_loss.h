@@ -0,0 +1,72 @@
+/**
+ * @file       power_loss.h
+ * @brief      Power-loss injection harness for testbench
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ *
+ * The harness runs an upgrade once to count flash memory operations (erasing
+ * and programming), then replays it cutting power at each operation in turn.
+ * After each cut, the device is "rebooted": a valid copy of the Bootloader
+ * must be found as the Start-up code does, the Bootloader must finish the
+ * upgrade, and the Main Firmware must pass the integrity check. Each replay
+ * runs in a forked process sharing a private (copy-on-write) mapping of the
+ * initial flash memory image, so only pages modified by the replay are copied.
+ */
+
+#ifndef POWER_LOSS_H_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define POWER_LOSS_H_INCLUDED
+
+#include <stdbool.h>
+#include "bootloader.h"
+
+/**
+ * Runs an upgrade with power loss injected at every flash memory operation
+ *
+ * Output of replays is suppressed, failed interruption points are reported to
+ * stderr.
+ *
+ * @param p_args  arguments passed to bootloader_run()
+ * @param flags   flags passed to bootloader_run()
+ * @return        true if the device stays recoverable at every point
+ */
+bool power_loss_test(const bl_args_t* p_args, uint32_t flags);
+
+/**
+ * Counts a flash memory operation, telling if power is lost during it
+ *
+ * Called by emulated flash memory before an erase or program operation, once
+ * the operation is validated.
+ *
+ * @return  true if the operation needs to be interrupted with
+ *          power_loss_cut() after applying a part of it
+ */
+bool power_loss_flash_op(void);
+
+/**
+ * Simulates loss of power, never returns
+ */
+void power_loss_cut(void) __attribute__((noreturn));
+
+/**
+ * Notifies the harness that the Bootloader halts the device
+ *
+ * Called by blsys_alert() before terminating. Within a replay control is
+ * returned to the harness, otherwise the function returns.
+ *
+ * @param error  true if halted because of an error
+ */
+void power_loss_halt(bool error);
+
+/**
+ * Maps emulated flash memory privately, keeping it until the process exits
+ *
+ * Changes are never written to the file, and the mapping survives
+ * blsys_deinit(), so that it is shared copy-on-write with forked processes.
+ * Implemented by emulated flash memory.
+ *
+ * @return  true if successful
+ */
+bool testbench_flash_snapshot(void);
+
+#endif  // POWER_LOSS_H_INCLUDED
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
 #include "bl_util.h"
 #include "bl_syscalls.h"
 
@@ -41,6 +42,16 @@ const bl_addr_t flash_emu_base = 0x08000000U;
 uint8_t* flash_emu_buf = NULL;
 /// Size of currently allocated flash emulation buffer
 size_t flash_emu_size = 0U;
+/// Size of emulated flash memory sectors, 0 if geometry is not available
+size_t flash_emu_sector_size = 0U;
+/// Total number of bytes erased in emulated flash memory
+size_t flash_emu_erased_size = 0U;
+/// Emulated state of write protection of the whole flash memory
+bool flash_emu_write_protected = false;
+/// Buffer emulating a record kept in non-volatile memory
+uint8_t nvrec_emu_buf[64];
+/// Size of the emulated record, 0 if no record is stored
+size_t nvrec_emu_len = 0U;
 
 bool blsys_init(void) {
   flash_emu_buf = (uint8_t*)malloc(flash_emu_size);
@@ -76,6 +87,19 @@ bool blsys_flash_erase(bl_addr_t addr, size_t size) {
   if (flash_emu_buf && check_flash_area(addr, size)) {
     size_t offset = addr - flash_emu_base;
     memset(flash_emu_buf + offset, 0xFFU, size);
+    flash_emu_erased_size += size;
+    return true;
+  }
+  return false;
+}
+
+bool blsys_flash_get_sector(bl_addr_t addr, bl_addr_t* p_sect_addr,
+                            size_t* p_sect_size) {
+  if (flash_emu_sector_size && p_sect_addr && p_sect_size &&
+      check_flash_area(addr, 1U)) {
+    size_t offset = addr - flash_emu_base;
+    *p_sect_addr = addr - offset % flash_emu_sector_size;
+    *p_sect_size = flash_emu_sector_size;
     return true;
   }
   return false;
@@ -105,6 +129,10 @@ bool blsys_flash_write(bl_addr_t addr, const void* buf, size_t len) {
   return false;
 }
 
+bool blsys_flash_is_write_protected(bl_addr_t addr, size_t size) {
+  return flash_emu_write_protected && check_flash_area(addr, size);
+}
+
 uint32_t blsys_media_devices(void) { return 1U; }
 
 bool blsys_media_check(uint32_t device_idx) {
@@ -209,3 +237,29 @@ bl_alert_status_t blsys_alert(blsys_alert_type_t type, const char* caption,
 
 void blsys_progress(const char* caption, const char* operation,
                     uint32_t percent_x100) {}
+
+uint32_t blsys_time_us(void) {
+  struct timespec ts;
+  if (0 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000U +
+                      (uint64_t)ts.tv_nsec / 1000U);
+  }
+  return 0U;
+}
+
+bool blsys_nvrec_read(void* buf, size_t len) {
+  if (buf && len && len == nvrec_emu_len) {
+    memcpy(buf, nvrec_emu_buf, len);
+    return true;
+  }
+  return false;
+}
+
+bool blsys_nvrec_write(const void* buf, size_t len) {
+  if (buf && len && len <= sizeof(nvrec_emu_buf)) {
+    memcpy(nvrec_emu_buf, buf, len);
+    nvrec_emu_len = len;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file       lzss_encoder.hpp
+ * @brief      Utility function producing LZSS-compressed data for tests
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#ifndef LZSS_ENCODER_HPP_INCLUDED
+/// Avoids multiple inclusion of the same file
+#define LZSS_ENCODER_HPP_INCLUDED
+
+#include <vector>
+#include "bl_lzss.h"
+
+/**
+ * Compresses data using greedy search over the whole window
+ *
+ * This encoder is slow and intended only for testing the decoder.
+ *
+ * @param data  input data
+ * @param size  size of input data
+ * @return      compressed data
+ */
+static inline std::vector<uint8_t> lzss_encode(const uint8_t* data,
+                                               size_t size) {
+  std::vector<uint8_t> out;
+  size_t flags_pos = 0U;
+  unsigned n_items = 8U;
+  size_t pos = 0U;
+
+  while (pos < size) {
+    if (8U == n_items) {  // Start a new group
+      flags_pos = out.size();
+      out.push_back(0U);
+      n_items = 0U;
+    }
+    // Find the longest match within the window
+    size_t best_len = 0U;
+    size_t best_offset = 0U;
+    size_t max_len = size - pos;
+    max_len = (max_len < BL_LZSS_MAX_MATCH) ? max_len : BL_LZSS_MAX_MATCH;
+    for (size_t offset = 1U; offset <= BL_LZSS_WINDOW_SIZE && offset <= pos;
+         ++offset) {
+      size_t len = 0U;
+      while (len < max_len && data[pos - offset + len] == data[pos + len]) {
+        ++len;
+      }
+      if (len > best_len) {
+        best_len = len;
+        best_offset = offset;
+      }
+    }
+    if (best_len >= BL_LZSS_MIN_MATCH) {
+      uint16_t token = (uint16_t)((best_offset - 1U) |
+                                  ((best_len - BL_LZSS_MIN_MATCH)
+                                   << BL_LZSS_OFFSET_BITS));
+      out.push_back((uint8_t)(token & 0xFFU));
+      out.push_back((uint8_t)(token >> 8));
+      pos += best_len;
+    } else {
+      out[flags_pos] |= (uint8_t)(1U << n_items);
+      out.push_back(data[pos++]);
+    }
+    ++n_items;
+  }
+  return out;
+}
+
+#endif  // LZSS_ENCODER_HPP_INCLUDED
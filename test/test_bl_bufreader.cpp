@@ -0,0 +1,191 @@
+/**
+ * @file       test_bl_bufreader.cpp
+ * @brief      Unit tests for buffered read-ahead layer
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <vector>
+#include <cstring>
+#include "catch2/catch.hpp"
+#include "bl_bufreader.h"
+
+/// Size of test file
+#define FILE_SIZE 10000U
+/// Size of window buffer
+#define WINDOW_SIZE 2048U
+/// Alignment of reads from media
+#define ALIGN 512U
+
+/// File wrapper around a buffer with pseudo-random data
+class DataFile {
+ public:
+  inline DataFile(size_t size = FILE_SIZE) : data(size) {
+    uint32_t seed = 12345U;
+    for (auto& byte : data) {
+      seed = seed * 1103515245U + 12345U;
+      byte = (uint8_t)(seed >> 24);
+    }
+    fd = fmemopen((void*)data.data(), data.size(), "r");
+    if (!fd) {
+      REQUIRE(false);  // Abort test
+    }
+  }
+
+  inline ~DataFile() {
+    if (fd) {
+      fclose(fd);
+    }
+  }
+
+  inline operator bl_file_t() const { return (bl_file_t)fd; }
+
+  /// Checks that a buffer matches data of the file at given offset
+  inline bool matches(const uint8_t* buf, size_t offset, size_t len) const {
+    return offset + len <= data.size() &&
+           0 == memcmp(buf, data.data() + offset, len);
+  }
+
+ private:
+  std::vector<uint8_t> data;
+  FILE* fd;
+};
+
+TEST_CASE("Buffered reader") {
+  DataFile file;
+  std::vector<uint8_t> window(WINDOW_SIZE);
+  std::vector<uint8_t> buf(FILE_SIZE);
+  bl_bufreader_t rd;
+  REQUIRE(blbuf_attach(&rd, file, window.data(), WINDOW_SIZE, ALIGN));
+
+  SECTION("small sequential reads") {
+    size_t pos = 0U;
+    while (pos + 100U <= FILE_SIZE) {
+      REQUIRE(blbuf_fread(buf.data(), 1U, 100U, file) == 100U);
+      REQUIRE(file.matches(buf.data(), pos, 100U));
+      pos += 100U;
+      REQUIRE(blbuf_ftell(file) == (bl_foffset_t)pos);
+    }
+    REQUIRE(rd.n_misses == 5U);  // One per window
+    REQUIRE(rd.n_hits == FILE_SIZE / 100U - 5U);
+    REQUIRE(rd.media_bytes == FILE_SIZE);
+  }
+
+  SECTION("seek and read") {
+    REQUIRE(0 == blbuf_fseek(file, 1000, SEEK_SET));
+    REQUIRE(blbuf_ftell(file) == 1000);
+    REQUIRE(blbuf_fread(buf.data(), 10U, 1U, file) == 1U);
+    REQUIRE(file.matches(buf.data(), 1000U, 10U));
+    // Window starts at the preceding aligned position
+    REQUIRE(rd.win_pos == 512);
+    REQUIRE(rd.media_bytes == WINDOW_SIZE);
+
+    REQUIRE(0 == blbuf_fseek(file, -500, SEEK_CUR));
+    REQUIRE(blbuf_ftell(file) == 510);
+    REQUIRE(blbuf_fread(buf.data(), 1U, 20U, file) == 20U);
+    REQUIRE(file.matches(buf.data(), 510U, 20U));
+    REQUIRE(rd.win_pos == 0);
+    REQUIRE(rd.n_misses == 2U);
+
+    REQUIRE(0 == blbuf_fseek(file, 600, SEEK_SET));
+    REQUIRE(blbuf_fread(buf.data(), 1U, 20U, file) == 20U);
+    REQUIRE(file.matches(buf.data(), 600U, 20U));
+    REQUIRE(rd.n_hits == 1U);
+    REQUIRE(rd.n_media_reads == 2U);
+
+    REQUIRE(0 != blbuf_fseek(file, -1, SEEK_SET));
+    REQUIRE(0 != blbuf_fseek(file, 0, 12345));
+    REQUIRE(blbuf_ftell(file) == 620);
+  }
+
+  SECTION("read spanning windows") {
+    REQUIRE(0 == blbuf_fseek(file, 3000, SEEK_SET));
+    REQUIRE(blbuf_fread(buf.data(), 1U, 1800U, file) == 1800U);
+    REQUIRE(file.matches(buf.data(), 3000U, 1800U));
+    REQUIRE(rd.n_misses == 1U);
+    REQUIRE(rd.n_media_reads == 2U);
+  }
+
+  SECTION("large read goes to destination directly") {
+    REQUIRE(0 == blbuf_fseek(file, 100, SEEK_SET));
+    REQUIRE(blbuf_fread(buf.data(), 1U, 7000U, file) == 7000U);
+    REQUIRE(file.matches(buf.data(), 100U, 7000U));
+    // Window [0, 2048), direct [2048, 6656), window [6656, 8704)
+    REQUIRE(rd.n_media_reads == 3U);
+    REQUIRE(rd.media_bytes == 2U * WINDOW_SIZE + 4608U);
+    REQUIRE(rd.win_pos == 6656);
+    REQUIRE(blbuf_ftell(file) == 7100);
+  }
+
+  SECTION("end of file") {
+    REQUIRE(!blbuf_feof(file));
+    REQUIRE(0 == blbuf_fseek(file, FILE_SIZE - 10, SEEK_SET));
+    REQUIRE(!blbuf_feof(file));
+    REQUIRE(blbuf_fread(buf.data(), 1U, 100U, file) == 10U);
+    REQUIRE(file.matches(buf.data(), FILE_SIZE - 10U, 10U));
+    REQUIRE(blbuf_feof(file));
+    REQUIRE(rd.end_pos == FILE_SIZE);
+    size_t n_reads = rd.n_media_reads;
+    REQUIRE(blbuf_fread(buf.data(), 1U, 1U, file) == 0U);
+    REQUIRE(rd.n_media_reads == n_reads);  // End is known
+    REQUIRE(0 == blbuf_fseek(file, 0, SEEK_SET));
+    REQUIRE(!blbuf_feof(file));
+  }
+
+  SECTION("items are counted as whole") {
+    REQUIRE(0 == blbuf_fseek(file, FILE_SIZE - 10, SEEK_SET));
+    REQUIRE(blbuf_fread(buf.data(), 4U, 3U, file) == 2U);
+    REQUIRE(blbuf_fread(buf.data(), 0U, 3U, file) == 0U);
+    REQUIRE(blbuf_fread(NULL, 1U, 3U, file) == 0U);
+  }
+
+  SECTION("detach restores file position") {
+    REQUIRE(0 == blbuf_fseek(file, 3000, SEEK_SET));
+    REQUIRE(blbuf_fread(buf.data(), 1U, 10U, file) == 10U);
+    blbuf_detach(&rd);
+    REQUIRE(blsys_ftell(file) == 3010);
+    REQUIRE(blbuf_ftell(file) == 3010);
+    REQUIRE(blbuf_fread(buf.data(), 1U, 10U, file) == 10U);
+    REQUIRE(file.matches(buf.data(), 3010U, 10U));
+    REQUIRE(rd.n_misses == 1U);  // Counters are not changed after detach
+  }
+
+  blbuf_detach(&rd);
+}
+
+TEST_CASE("Buffered reader passthrough") {
+  DataFile file;
+  DataFile other;
+  std::vector<uint8_t> window(WINDOW_SIZE);
+  uint8_t buf[16];
+  bl_bufreader_t rd;
+
+  SECTION("invalid arguments") {
+    REQUIRE(!blbuf_attach(NULL, file, window.data(), WINDOW_SIZE, ALIGN));
+    REQUIRE(!blbuf_attach(&rd, NULL, window.data(), WINDOW_SIZE, ALIGN));
+    REQUIRE(!blbuf_attach(&rd, file, NULL, WINDOW_SIZE, ALIGN));
+    REQUIRE(!blbuf_attach(&rd, file, window.data(), 0U, ALIGN));
+    REQUIRE(!blbuf_attach(&rd, file, window.data(), WINDOW_SIZE, 0U));
+    REQUIRE(!blbuf_attach(&rd, file, window.data(), 1000U, ALIGN));
+  }
+
+  SECTION("file without reader") {
+    REQUIRE(blbuf_attach(&rd, file, window.data(), WINDOW_SIZE, ALIGN));
+    REQUIRE(0 == blbuf_fseek(other, 200, SEEK_SET));
+    REQUIRE(blsys_ftell(other) == 200);
+    REQUIRE(blbuf_fread(buf, 1U, sizeof(buf), other) == sizeof(buf));
+    REQUIRE(other.matches(buf, 200U, sizeof(buf)));
+    REQUIRE(blbuf_ftell(other) == 216);
+    REQUIRE(0 == rd.n_media_reads);
+    blbuf_detach(&rd);
+  }
+
+  SECTION("attach takes current position") {
+    REQUIRE(0 == blsys_fseek(file, 700, SEEK_SET));
+    REQUIRE(blbuf_attach(&rd, file, window.data(), WINDOW_SIZE, ALIGN));
+    REQUIRE(blbuf_ftell(file) == 700);
+    REQUIRE(blbuf_fread(buf, 1U, sizeof(buf), file) == sizeof(buf));
+    REQUIRE(file.matches(buf, 700U, sizeof(buf)));
+    blbuf_detach(&rd);
+  }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file       test_bl_crc_chunks.cpp
+ * @brief      Unit tests for CRC of data processed by independent chunks
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <vector>
+#include <algorithm>
+#include "catch2/catch.hpp"
+#include "crc32.h"
+#include "bl_crc_chunks.h"
+
+/**
+ * Generates pseudo-random test data
+ *
+ * @param size  size of data
+ * @return      generated data
+ */
+static std::vector<uint8_t> make_data(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t seed = 54321U;
+  for (size_t i = 0U; i < size; ++i) {
+    seed = seed * 1103515245U + 12345U;
+    data[i] = (uint8_t)(seed >> 24);
+  }
+  return data;
+}
+
+TEST_CASE("CRC of chunks") {
+  const uint32_t size = 10000U;
+  std::vector<uint8_t> data = make_data(size);
+  uint32_t ref_crc = crc32_fast(data.data(), size, 0U);
+  bl_crc_chunks_t acc;
+  uint32_t crc = 0U;
+
+  SECTION("whole block as a single chunk") {
+    bl_crc_chunks_init(&acc, size);
+    REQUIRE(bl_crc_chunks_update(&acc, 0U, data.data(), size));
+    REQUIRE(bl_crc_chunks_final(&acc, &crc));
+    REQUIRE(ref_crc == crc);
+  }
+
+  SECTION("chunks in reverse and shuffled order") {
+    static const uint32_t chunk_sizes[] = {1U, 7U, 512U, 1000U, 4096U};
+    for (uint32_t chunk_size : chunk_sizes) {
+      std::vector<uint32_t> offsets;
+      for (uint32_t offset = 0U; offset < size; offset += chunk_size) {
+        offsets.push_back(offset);
+      }
+      std::reverse(offsets.begin(), offsets.end());
+      std::rotate(offsets.begin(), offsets.begin() + offsets.size() / 3U,
+                  offsets.end());
+
+      bl_crc_chunks_init(&acc, size);
+      bool added = true;
+      for (uint32_t offset : offsets) {
+        uint32_t len = std::min(chunk_size, size - offset);
+        added = bl_crc_chunks_update(&acc, offset, &data[offset], len) && added;
+      }
+      REQUIRE(added);
+      REQUIRE(bl_crc_chunks_final(&acc, &crc));
+      REQUIRE(ref_crc == crc);
+    }
+  }
+
+  SECTION("accumulators of several workers merged") {
+    const uint32_t chunk_size = 333U;
+    const uint32_t n_workers = 3U;
+    bl_crc_chunks_t worker_acc[n_workers];
+    for (uint32_t idx = 0U; idx < n_workers; ++idx) {
+      bl_crc_chunks_init(&worker_acc[idx], size);
+    }
+    uint32_t chunk_idx = 0U;
+    for (uint32_t offset = 0U; offset < size; offset += chunk_size) {
+      uint32_t len = std::min(chunk_size, size - offset);
+      REQUIRE(bl_crc_chunks_update(&worker_acc[chunk_idx++ % n_workers],
+                                   offset, &data[offset], len));
+    }
+    bl_crc_chunks_init(&acc, size);
+    for (uint32_t idx = n_workers; idx > 0U; --idx) {
+      REQUIRE_FALSE(bl_crc_chunks_final(&acc, &crc));
+      REQUIRE(bl_crc_chunks_merge(&acc, &worker_acc[idx - 1U]));
+    }
+    REQUIRE(bl_crc_chunks_final(&acc, &crc));
+    REQUIRE(ref_crc == crc);
+  }
+
+  SECTION("empty block and empty chunks") {
+    bl_crc_chunks_init(&acc, 0U);
+    REQUIRE(bl_crc_chunks_update(&acc, 0U, NULL, 0U));
+    REQUIRE(bl_crc_chunks_final(&acc, &crc));
+    REQUIRE(0U == crc);
+  }
+
+  SECTION("invalid") {
+    bl_crc_chunks_init(&acc, size);
+    REQUIRE_FALSE(bl_crc_chunks_update(&acc, 1U, data.data(), size));
+    REQUIRE_FALSE(bl_crc_chunks_update(&acc, size + 1U, data.data(), 0U));
+    REQUIRE_FALSE(bl_crc_chunks_update(&acc, 0U, NULL, 1U));
+    REQUIRE_FALSE(bl_crc_chunks_update(NULL, 0U, data.data(), 1U));
+    REQUIRE(bl_crc_chunks_update(&acc, 0U, data.data(), size - 1U));
+    REQUIRE_FALSE(bl_crc_chunks_final(&acc, &crc));
+    REQUIRE_FALSE(bl_crc_chunks_final(NULL, &crc));
+    // More bytes than the block has
+    REQUIRE_FALSE(bl_crc_chunks_update(&acc, 0U, data.data(), 2U));
+
+    bl_crc_chunks_t other;
+    bl_crc_chunks_init(&other, size - 1U);
+    REQUIRE_FALSE(bl_crc_chunks_merge(&acc, &other));
+    bl_crc_chunks_init(&other, size);
+    REQUIRE(bl_crc_chunks_update(&other, 0U, data.data(), 2U));
+    REQUIRE_FALSE(bl_crc_chunks_merge(&acc, &other));
+    REQUIRE_FALSE(bl_crc_chunks_merge(&acc, NULL));
+  }
+}
@@ -0,0 +1,405 @@
+/**
+ * @file       test_bl_delta.cpp
+ * @brief      Unit tests for Delta sections patching the Main Firmware
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <vector>
+#include "catch2/catch.hpp"
+#include "crc32.h"
+#include "progress_monitor.hpp"
+#include "flash_buf.hpp"
+#include "bl_delta.h"
+
+/// Size of a block used in tests
+#define BLOCK_SIZE 256U
+/// Number of blocks in the firmware area
+#define N_BLOCKS 4U
+/// Size of the firmware area
+#define FW_SIZE (BLOCK_SIZE * N_BLOCKS)
+/// Size of the base firmware
+#define BASE_SIZE 700U
+/// Value filling the scratch area initially
+#define SCRATCH_FILL 0xA5U
+
+/// Layout of emulated flash memory: firmware area followed by scratch area
+static const bl_delta_layout_t ref_layout = {
+    .fw_addr = flash_emu_base,
+    .fw_size = FW_SIZE,
+    .block_size = BLOCK_SIZE,
+    .scratch_addr = flash_emu_base + FW_SIZE,
+    .scratch_size = BLOCK_SIZE};
+
+/// Header of the target firmware, size and CRC are filled by PatchBuilder
+// clang-format off
+static const bl_section_t ref_target_header = {
+  .magic = BL_SECT_MAGIC,
+  .struct_rev = BL_SECT_STRUCT_REV,
+  .name = {'m','a','i','n', 0},
+  .pl_ver = 102213405U, // "1.22.134-rc5"
+  .pl_size = 0U,
+  .pl_crc = 0U,
+  .attr_list = { 0 },
+  .struct_crc = 0U
+};
+
+/// Header of the Delta section, size and CRC are filled by PatchBuilder
+static const bl_section_t ref_delta_header = {
+  .magic = BL_SECT_MAGIC,
+  .struct_rev = BL_SECT_STRUCT_REV,
+  .name = {'d','e','l','t','a', 0},
+  .pl_ver = 0U,
+  .pl_size = 0U,
+  .pl_crc = 0U,
+  .attr_list = { 0 },
+  .struct_crc = 0U
+};
+// clang-format on
+
+/**
+ * Returns a byte of the base firmware
+ *
+ * @param offset  offset within the base firmware
+ * @return        value of the byte
+ */
+static inline uint8_t base_byte(uint32_t offset) {
+  return (uint8_t)((offset * 7U + (offset >> 8)) & 0xFFU);
+}
+
+/// Builds a patch along with the expected target firmware
+class PatchBuilder {
+ public:
+  inline PatchBuilder() {
+    target_hdr = ref_target_header;
+    delta_hdr = ref_delta_header;
+  }
+
+  inline PatchBuilder& copy(uint32_t src_offset, uint32_t len) {
+    ops.push_back(bl_delta_op_copy);
+    put_u32(src_offset);
+    put_u32(len);
+    for (uint32_t i = 0U; i < len; ++i) {
+      target.push_back(base_byte(src_offset + i));
+    }
+    return *this;
+  }
+
+  inline PatchBuilder& insert(uint32_t len) {
+    ops.push_back(bl_delta_op_insert);
+    put_u32(len);
+    for (uint32_t i = 0U; i < len; ++i) {
+      uint8_t byte = (uint8_t)(0x5AU ^ target.size());
+      ops.push_back(byte);
+      target.push_back(byte);
+    }
+    return *this;
+  }
+
+  /// Finalizes headers, calculating sizes and CRCs
+  inline PatchBuilder& finalize() {
+    target_hdr.pl_size = target.size();
+    target_hdr.pl_crc = crc32_fast(target.data(), target.size(), 0U);
+    target_hdr.struct_crc =
+        crc32_fast(&target_hdr, offsetof(bl_section_t, struct_crc), 0U);
+    delta_hdr.pl_size = sizeof(bl_section_t) + ops.size();
+    uint32_t crc = crc32_fast(&target_hdr, sizeof(target_hdr), 0U);
+    delta_hdr.pl_crc = crc32_fast(ops.data(), ops.size(), crc);
+    delta_hdr.struct_crc =
+        crc32_fast(&delta_hdr, offsetof(bl_section_t, struct_crc), 0U);
+    return *this;
+  }
+
+  /// Header of the target firmware
+  bl_section_t target_hdr;
+  /// Header of the Delta section
+  bl_section_t delta_hdr;
+  /// Sequence of operations
+  std::vector<uint8_t> ops;
+  /// Expected target firmware
+  std::vector<uint8_t> target;
+
+ private:
+  inline void put_u32(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      ops.push_back((uint8_t)(value >> (i * 8)));
+    }
+  }
+};
+
+/// File wrapper around a sequence of operations
+class PatchFile {
+ public:
+  inline PatchFile(const std::vector<uint8_t>& ops, size_t size = SIZE_MAX)
+      : fd(fmemopen((void*)ops.data(), (size < ops.size()) ? size : ops.size(),
+                    "r")) {
+    if (!fd) {
+      REQUIRE(false);  // Abort test
+    }
+  }
+
+  inline ~PatchFile() {
+    if (fd) {
+      fclose(fd);
+    }
+  }
+
+  inline operator bl_file_t() const { return (bl_file_t)fd; }
+
+ private:
+  FILE* fd;
+};
+
+/// Emulated flash memory holding the base firmware and the scratch area
+class BaseFlash : public FlashBuf {
+ public:
+  inline BaseFlash() : FlashBuf(NULL, FW_SIZE + BLOCK_SIZE) {
+    for (uint32_t i = 0U; i < BASE_SIZE; ++i) {
+      (*this)[i] = base_byte(i);
+    }
+    memset((uint8_t*)(*this) + FW_SIZE, SCRATCH_FILL, BLOCK_SIZE);
+  }
+};
+
+/**
+ * Returns a patch exercising all kinds of references allowed in a patch
+ *
+ * @return  patch builder with finalized patch
+ */
+static PatchBuilder make_ref_patch() {
+  PatchBuilder patch;
+  patch.copy(300U, 200U)  // From the following blocks
+      .insert(16U)
+      .copy(0U, 40U)     // From the current block saved in scratch area
+      .copy(256U, 300U)  // Crossing the boundary of blocks
+      .insert(44U)
+      .finalize();
+  return patch;
+}
+
+/**
+ * Applies a patch in write mode, preparing the first block before
+ *
+ * @param patch      finalized patch
+ * @param file       file containing the patch
+ * @param p_hash     pointer to variable receiving hash
+ * @param progr_arg  argument passed to progress callback function
+ * @return           true if successful
+ */
+static bool apply_patch(const PatchBuilder& patch, bl_file_t file,
+                        bl_hash_t* p_hash, bl_cbarg_t progr_arg = 0U) {
+  REQUIRE(bl_delta_save_block(&ref_layout, 0U));
+  REQUIRE(blsys_flash_erase(ref_layout.fw_addr, BLOCK_SIZE));
+  return bl_delta_apply(&patch.delta_hdr, &patch.target_hdr, file, &ref_layout,
+                        true, p_hash, progr_arg);
+}
+
+TEST_CASE("Check layout of Delta area") {
+  SECTION("valid") {
+    REQUIRE(bl_delta_check_layout(&ref_layout));
+    REQUIRE(FW_SIZE - BLOCK_SIZE == bl_delta_max_size(&ref_layout));
+  }
+
+  SECTION("invalid, firmware area is not a multiple of blocks") {
+    bl_delta_layout_t layout = ref_layout;
+    layout.fw_size += 1U;
+    REQUIRE_FALSE(bl_delta_check_layout(&layout));
+  }
+
+  SECTION("invalid, single block") {
+    bl_delta_layout_t layout = ref_layout;
+    layout.fw_size = BLOCK_SIZE;
+    REQUIRE_FALSE(bl_delta_check_layout(&layout));
+  }
+
+  SECTION("invalid, scratch area is too small") {
+    bl_delta_layout_t layout = ref_layout;
+    layout.scratch_size = BLOCK_SIZE - 1U;
+    REQUIRE_FALSE(bl_delta_check_layout(&layout));
+  }
+
+  SECTION("invalid, scratch area overlaps firmware area") {
+    bl_delta_layout_t layout = ref_layout;
+    layout.scratch_addr -= 1U;
+    REQUIRE_FALSE(bl_delta_check_layout(&layout));
+  }
+
+  SECTION("invalid arguments") {
+    bl_delta_layout_t layout = ref_layout;
+    layout.block_size = 0U;
+    REQUIRE_FALSE(bl_delta_check_layout(&layout));
+    REQUIRE_FALSE(bl_delta_check_layout(NULL));
+  }
+}
+
+TEST_CASE("Apply patch") {
+  SECTION("valid, dry run does not modify flash memory") {
+    auto patch = make_ref_patch();
+    BaseFlash flash;
+    uint8_t* p_flash = flash;
+    std::vector<uint8_t> flash_copy(p_flash, p_flash + flash.size());
+    bl_hash_t hash;
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                           PatchFile(patch.ops), &ref_layout, false, &hash,
+                           12345U));
+    REQUIRE(0 == memcmp(flash, flash_copy.data(), flash_copy.size()));
+    REQUIRE(monitor.is_complete());
+
+    // Compare with the hash of the target firmware placed in flash memory
+    bl_hash_t ref_hash;
+    memcpy(flash, patch.target.data(), patch.target.size());
+    REQUIRE(blsect_hash_over_flash(&patch.target_hdr, flash_emu_base,
+                                   &ref_hash, 0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+  }
+
+  SECTION("valid, write mode produces target firmware") {
+    auto patch = make_ref_patch();
+    BaseFlash flash;
+    bl_hash_t hash;
+    bl_hash_t dry_hash;
+
+    REQUIRE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                           PatchFile(patch.ops), &ref_layout, false, &dry_hash,
+                           0U));
+    REQUIRE(apply_patch(patch, PatchFile(patch.ops), &hash));
+    REQUIRE(0 == memcmp(flash, patch.target.data(), patch.target.size()));
+    REQUIRE(0 == memcmp(&hash, &dry_hash, sizeof(hash)));
+    REQUIRE(patch.target_hdr.pl_ver == hash.pl_ver);
+    REQUIRE(0 == strcmp(hash.sect_name, "main"));
+  }
+
+  SECTION("valid, target fills all blocks except the last one") {
+    PatchBuilder patch;
+    patch.copy(BASE_SIZE - 100U, 100U)
+        .insert(BLOCK_SIZE - 100U)
+        .copy(BLOCK_SIZE, BASE_SIZE - BLOCK_SIZE)
+        .insert(FW_SIZE - BLOCK_SIZE - BASE_SIZE)
+        .finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE(apply_patch(patch, PatchFile(patch.ops), &hash));
+    REQUIRE(0 == memcmp(flash, patch.target.data(), patch.target.size()));
+  }
+
+  SECTION("valid, scratch area is restored") {
+    BaseFlash flash;
+    REQUIRE(bl_delta_save_block(&ref_layout, 1U));
+    REQUIRE(0 == memcmp(flash + FW_SIZE, flash + BLOCK_SIZE, BLOCK_SIZE));
+    REQUIRE(bl_delta_restore_scratch(&ref_layout, flash_emu_base));
+    REQUIRE(0 == memcmp(flash + FW_SIZE, flash, BLOCK_SIZE));
+  }
+
+  SECTION("invalid, reference to already overwritten block") {
+    PatchBuilder patch;
+    patch.insert(BLOCK_SIZE).copy(BLOCK_SIZE - 1U, 10U).finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, reference to the last block") {
+    PatchBuilder patch;
+    patch.copy(FW_SIZE - BLOCK_SIZE - 10U, 11U).finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, target overlaps the last block") {
+    PatchBuilder patch;
+    patch.insert(FW_SIZE - BLOCK_SIZE + 1U).finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, corrupted patch") {
+    auto patch = make_ref_patch();
+    patch.ops[BL_DELTA_COPY_HDR_SIZE + BL_DELTA_INSERT_HDR_SIZE] ^= 1U;
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, base firmware differs") {
+    auto patch = make_ref_patch();
+    BaseFlash flash;
+    flash[BLOCK_SIZE] ^= 1U;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, unknown operation") {
+    auto patch = make_ref_patch();
+    patch.ops[0] = 0U;
+    patch.finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid, truncated file") {
+    auto patch = make_ref_patch();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops, patch.ops.size() - 1U),
+                                 &ref_layout, false, &hash, 0U));
+  }
+
+  SECTION("invalid, trailing data in patch") {
+    auto patch = make_ref_patch();
+    patch.ops.push_back(bl_delta_op_insert);
+    patch.finalize();
+    BaseFlash flash;
+    bl_hash_t hash;
+
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false,
+                                 &hash, 0U));
+  }
+
+  SECTION("invalid arguments") {
+    auto patch = make_ref_patch();
+    BaseFlash flash;
+    bl_hash_t hash;
+    bl_delta_layout_t layout = ref_layout;
+    layout.block_size = 0U;
+
+    REQUIRE_FALSE(bl_delta_apply(NULL, &patch.target_hdr, PatchFile(patch.ops),
+                                 &ref_layout, false, &hash, 0U));
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, NULL, PatchFile(patch.ops),
+                                 &ref_layout, false, &hash, 0U));
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr, NULL,
+                                 &ref_layout, false, &hash, 0U));
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &layout, false, &hash,
+                                 0U));
+    REQUIRE_FALSE(bl_delta_apply(&patch.delta_hdr, &patch.target_hdr,
+                                 PatchFile(patch.ops), &ref_layout, false, NULL,
+                                 0U));
+  }
+}
@@ -0,0 +1,333 @@
+/**
+ * @file       test_bl_flash_plan.cpp
+ * @brief      Unit tests for differential flashing
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <vector>
+#include "catch2/catch.hpp"
+#include "crc32.h"
+#include "progress_monitor.hpp"
+#include "flash_buf.hpp"
+#include "bl_section.h"
+#include "bl_flash_plan.h"
+
+/// Size of a sector used in tests
+#define SECTOR_SIZE 256U
+/// Number of sectors in the area
+#define N_SECTORS 4U
+/// Size of the area
+#define AREA_SIZE (SECTOR_SIZE * N_SECTORS)
+/// Size of the payload
+#define PL_SIZE 700U
+
+// External variables
+extern "C" size_t flash_emu_sector_size;
+extern "C" size_t flash_emu_erased_size;
+
+/**
+ * Returns a byte of the old contents of flash memory
+ *
+ * @param offset  offset within the area
+ * @return        value of the byte
+ */
+static inline uint8_t old_byte(uint32_t offset) {
+  return (uint8_t)((offset * 13U + 1U) & 0xFFU);
+}
+
+/// Emulated flash memory with sector geometry, holding the old contents
+class SectorFlash : public FlashBuf {
+ public:
+  inline SectorFlash(size_t sector_size = SECTOR_SIZE)
+      : FlashBuf(NULL, AREA_SIZE) {
+    flash_emu_sector_size = sector_size;
+    flash_emu_erased_size = 0U;
+    for (uint32_t i = 0U; i < PL_SIZE; ++i) {
+      (*this)[i] = old_byte(i);
+    }
+  }
+
+  inline ~SectorFlash() { flash_emu_sector_size = 0U; }
+};
+
+/// Payload section along with a file containing it
+class PayloadData {
+ public:
+  inline PayloadData() : data(PL_SIZE) {
+    for (uint32_t i = 0U; i < PL_SIZE; ++i) {
+      data[i] = old_byte(i);
+    }
+  }
+
+  inline const bl_section_t* header() {
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BL_SECT_MAGIC;
+    hdr.struct_rev = BL_SECT_STRUCT_REV;
+    strcpy(hdr.name, "main");
+    hdr.pl_ver = 102213405U;  // "1.22.134-rc5"
+    hdr.pl_size = data.size();
+    hdr.pl_crc = crc32_fast(data.data(), data.size(), 0U);
+    return &hdr;
+  }
+
+  inline bl_file_t file() {
+    if (fd) {
+      fclose(fd);
+    }
+    fd = fmemopen((void*)data.data(), data.size(), "r");
+    if (!fd) {
+      REQUIRE(false);  // Abort test
+    }
+    return (bl_file_t)fd;
+  }
+
+  inline ~PayloadData() {
+    if (fd) {
+      fclose(fd);
+    }
+  }
+
+  std::vector<uint8_t> data;
+
+ private:
+  bl_section_t hdr;
+  FILE* fd = NULL;
+};
+
+/**
+ * Plans update of the area and erases it
+ *
+ * @param p_plan  pointer to plan structure
+ * @param pl      payload data
+ * @return        true if successful
+ */
+static bool plan_and_erase(bl_fplan_t* p_plan, PayloadData& pl) {
+  REQUIRE(bl_fplan_init(p_plan, flash_emu_base, AREA_SIZE));
+  return blsect_plan_payload_from_file(pl.header(), pl.file(), flash_emu_base,
+                                       p_plan, flash_emu_base + AREA_SIZE,
+                                       0U) &&
+         bl_fplan_erase(p_plan, flash_emu_base, AREA_SIZE);
+}
+
+TEST_CASE("Initialize flash plan") {
+  bl_fplan_t plan;
+
+  SECTION("valid") {
+    SectorFlash flash;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(plan.enabled);
+    REQUIRE(N_SECTORS == plan.n_sectors);
+    REQUIRE(flash_emu_base + SECTOR_SIZE == plan.sect_addr[1]);
+    REQUIRE(flash_emu_base + AREA_SIZE == plan.sect_addr[N_SECTORS]);
+    REQUIRE(0U == bl_fplan_count_rewritten(&plan));
+  }
+
+  SECTION("disabled, geometry not available") {
+    SectorFlash flash(0U);
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(plan.enabled);
+  }
+
+  SECTION("disabled, area is not aligned to sectors") {
+    SectorFlash flash;
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base + 1U, SECTOR_SIZE));
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base, SECTOR_SIZE + 1U));
+  }
+
+  SECTION("disabled, too many sectors") {
+    SectorFlash flash(AREA_SIZE / (2U * FLASH_PLAN_MAX_SECTORS));
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+  }
+
+  SECTION("invalid arguments") {
+    SectorFlash flash;
+    REQUIRE_FALSE(bl_fplan_init(NULL, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base, 0U));
+  }
+}
+
+TEST_CASE("Update flash memory by plan") {
+  bl_fplan_t plan;
+  bl_hash_t hash;
+
+  SECTION("valid, same contents is neither erased nor programmed") {
+    SectorFlash flash;
+    PayloadData pl;
+    ProgressMonitor monitor(12345U);
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(blsect_plan_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan,
+                                          flash_emu_base + AREA_SIZE, 12345U));
+    REQUIRE(monitor.is_complete());
+    REQUIRE(0U == bl_fplan_count_rewritten(&plan));
+    REQUIRE(bl_fplan_erase(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(0U == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+  }
+
+  SECTION("valid, only changed sector is rewritten") {
+    SectorFlash flash;
+    PayloadData pl;
+    pl.data[SECTOR_SIZE + 10U] ^= 0x5AU;
+    REQUIRE(plan_and_erase(&plan, pl));
+    REQUIRE(1U == bl_fplan_count_rewritten(&plan));
+    REQUIRE(SECTOR_SIZE == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl.data.data(), PL_SIZE));
+
+    // Hash is the same as for firmware programmed as a whole
+    bl_hash_t ref_hash;
+    REQUIRE(blsect_hash_over_flash(pl.header(), flash_emu_base, &ref_hash,
+                                   0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+  }
+
+  SECTION("valid, plan is built while hashing the file") {
+    SectorFlash flash;
+    PayloadData pl;
+    pl.data[SECTOR_SIZE + 10U] ^= 0x5AU;
+    ProgressMonitor monitor(12345U);
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(blsect_plan_and_hash_payload_from_file(
+        pl.header(), pl.file(), flash_emu_base, &plan,
+        flash_emu_base + AREA_SIZE, &hash, 12345U));
+    REQUIRE(monitor.is_complete());
+    REQUIRE(1U == bl_fplan_count_rewritten(&plan));
+
+    // Hash is the same as of the file hashed alone
+    bl_hash_t ref_hash;
+    REQUIRE(blsect_hash_over_file(pl.header(), pl.file(), &ref_hash, 0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+
+    REQUIRE(bl_fplan_erase(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(SECTOR_SIZE == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl.data.data(), PL_SIZE));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+
+    // Corrupted payload is rejected
+    bl_section_t hdr = *pl.header();
+    pl.data[0] ^= 0x01U;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(blsect_plan_and_hash_payload_from_file(
+        &hdr, pl.file(), flash_emu_base, &plan, flash_emu_base + AREA_SIZE,
+        &hash, 0U));
+  }
+
+  SECTION("valid, erased sector is programmed without erase") {
+    SectorFlash flash;
+    memset(flash, 0xFF, SECTOR_SIZE);
+    PayloadData pl;
+    REQUIRE(plan_and_erase(&plan, pl));
+    REQUIRE(1U == bl_fplan_count_rewritten(&plan));
+    REQUIRE(0U == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl.data.data(), PL_SIZE));
+  }
+
+  SECTION("valid, data following the payload is erased") {
+    SectorFlash flash;
+    flash[AREA_SIZE - 1U] = 0x00U;
+    PayloadData pl;
+    REQUIRE(plan_and_erase(&plan, pl));
+    REQUIRE(1U == bl_fplan_count_rewritten(&plan));
+    REQUIRE(SECTOR_SIZE == flash_emu_erased_size);
+    REQUIRE(0xFFU == flash[AREA_SIZE - 1U]);
+  }
+
+  SECTION("valid, touched sector is erased and programmed") {
+    SectorFlash flash;
+    PayloadData pl;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(blsect_plan_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan,
+                                          flash_emu_base + AREA_SIZE, 0U));
+    bl_fplan_touch(&plan, flash_emu_base + SECTOR_SIZE - 1U, 2U);
+    REQUIRE(2U == bl_fplan_count_rewritten(&plan));
+    REQUIRE(bl_fplan_erase(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(2U * SECTOR_SIZE == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl.data.data(), PL_SIZE));
+  }
+
+  SECTION("valid, disabled plan erases and programs the whole area") {
+    SectorFlash flash(0U);
+    PayloadData pl;
+    REQUIRE_FALSE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(bl_fplan_compare(&plan, flash_emu_base, NULL, AREA_SIZE));
+    REQUIRE(bl_fplan_erase(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE(AREA_SIZE == flash_emu_erased_size);
+    REQUIRE(blsect_copy_payload_from_file(pl.header(), pl.file(),
+                                          flash_emu_base, &plan, &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl.data.data(), PL_SIZE));
+  }
+
+  SECTION("invalid, kept sector differs from data being written") {
+    SectorFlash flash;
+    PayloadData pl;
+    REQUIRE(plan_and_erase(&plan, pl));
+    // The file is changed after the plan is made
+    pl.data[10U] ^= 0x5AU;
+    REQUIRE_FALSE(blsect_copy_payload_from_file(
+        pl.header(), pl.file(), flash_emu_base, &plan, &hash, 0U));
+  }
+
+  SECTION("invalid, corrupted payload") {
+    SectorFlash flash;
+    PayloadData pl;
+    const bl_section_t hdr = *pl.header();
+    pl.data[10U] ^= 0x5AU;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(blsect_plan_payload_from_file(&hdr, pl.file(),
+                                                flash_emu_base, &plan,
+                                                flash_emu_base + AREA_SIZE,
+                                                0U));
+  }
+
+  SECTION("invalid, payload does not fit the area") {
+    SectorFlash flash;
+    PayloadData pl;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(blsect_plan_payload_from_file(pl.header(), pl.file(),
+                                                flash_emu_base, &plan,
+                                                flash_emu_base + PL_SIZE - 1U,
+                                                0U));
+  }
+
+  SECTION("invalid, erased range is not aligned to sectors") {
+    SectorFlash flash;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(bl_fplan_erase(&plan, flash_emu_base + 1U, SECTOR_SIZE));
+    REQUIRE_FALSE(bl_fplan_erase(&plan, flash_emu_base, SECTOR_SIZE + 1U));
+    REQUIRE_FALSE(bl_fplan_erase(&plan, flash_emu_base, 0U));
+  }
+
+  SECTION("invalid arguments") {
+    SectorFlash flash;
+    PayloadData pl;
+    REQUIRE(bl_fplan_init(&plan, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(blsect_plan_payload_from_file(NULL, pl.file(),
+                                                flash_emu_base, &plan,
+                                                flash_emu_base + AREA_SIZE,
+                                                0U));
+    REQUIRE_FALSE(blsect_plan_payload_from_file(pl.header(), NULL,
+                                                flash_emu_base, &plan,
+                                                flash_emu_base + AREA_SIZE,
+                                                0U));
+    REQUIRE_FALSE(blsect_plan_payload_from_file(pl.header(), pl.file(),
+                                                flash_emu_base, NULL,
+                                                flash_emu_base + AREA_SIZE,
+                                                0U));
+    REQUIRE_FALSE(bl_fplan_compare(NULL, flash_emu_base, NULL, 1U));
+    REQUIRE_FALSE(bl_fplan_compare(&plan, flash_emu_base + AREA_SIZE, NULL,
+                                   1U));
+    REQUIRE_FALSE(bl_fplan_erase(NULL, flash_emu_base, AREA_SIZE));
+    REQUIRE_FALSE(bl_fplan_write(&plan, flash_emu_base, NULL, 1U));
+  }
+}
@@ -6,6 +6,7 @@
  */
 
 #define BL_ICR_DEFINE_PRIVATE_TYPES
+#include <vector>
 #include "catch2/catch.hpp"
 #include "crc32.h"
 #include "flash_buf.hpp"
@@ -20,8 +21,14 @@ bool icr_struct_create_main(bl_integrity_check_rec_t* p_icr,
 bool icr_verify_main(const bl_integrity_check_rec_t* p_icr,
                      bl_addr_t main_addr);
 bool vcr_validate(const bl_version_check_rec_t* p_vcr);
+bool vmr_validate(const bl_verified_marker_rec_t* p_vmr, uint32_t icr_crc);
+bool bct_validate(const bl_block_crc_table_t* p_bct,
+                  const bl_integrity_check_rec_t* p_icr);
 }
 
+// External variables
+extern "C" bool flash_emu_write_protected;
+
 /// Reference payload
 static const uint8_t ref_payload[] = {
     0x18, 0x54, 0x29, 0xd4, 0x05, 0xdb, 0x13, 0xc8, 0x78, 0x27,
@@ -107,6 +114,208 @@ TEST_CASE("Integrity check record") {
                               ref_version));
 }
 
+TEST_CASE("Block CRC table") {
+  const uint32_t pl_size = 100000U;  // 25 blocks of 4 KB
+  const uint32_t block_size = 4096U;
+  std::vector<uint8_t> payload(pl_size);
+  for (uint32_t i = 0U; i < pl_size; ++i) {
+    payload[i] = (uint8_t)(i * 7U + (i >> 8));
+  }
+  FlashBuf flash(payload.data(), pl_size, BL_FW_SECT_OVERHEAD);
+  REQUIRE(bl_icr_create(flash.base(), flash.size(), pl_size, ref_version));
+
+  bl_integrity_check_rec_t icr;
+  bl_block_crc_table_t bct;
+  memcpy(&icr, &flash[flash.size() - BL_ICR_OFFSET_FROM_END], sizeof(icr));
+  memcpy(&bct, &flash[flash.size() - BL_BCT_OFFSET_FROM_END], sizeof(bct));
+  REQUIRE(bct_validate(&bct, &icr));
+  REQUIRE(bct.block_size == block_size);
+  REQUIRE(bct.n_blocks == 25U);
+  REQUIRE(bct.block_crc[24] ==
+          crc32_fast(&payload[24U * block_size], pl_size % block_size, 0U));
+
+  bl_icr_range_t range = {0U, 0U};
+  SECTION("valid") {
+    REQUIRE(bl_icr_verify(flash.base(), flash.size(), NULL));
+    REQUIRE(bl_icr_verify_sample(flash.base(), flash.size(), 123U, 1U));
+    REQUIRE(bl_icr_verify_sample(flash.base(), flash.size(), 0U, 100U));
+    REQUIRE_FALSE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+  }
+
+  SECTION("corrupted blocks") {
+    flash[5U * block_size + 10U] ^= 1U;
+    flash[7U * block_size] ^= 1U;
+    REQUIRE_FALSE(bl_icr_verify(flash.base(), flash.size(), NULL));
+    REQUIRE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+    REQUIRE(range.addr == flash.base() + 5U * block_size);
+    REQUIRE(range.size == 3U * block_size);
+    // Sampling finds only corrupted blocks it verifies
+    REQUIRE(bl_icr_verify_sample(flash.base(), flash.size(), 8U, 20U));
+    REQUIRE_FALSE(bl_icr_verify_sample(flash.base(), flash.size(), 5U, 1U));
+    REQUIRE_FALSE(bl_icr_verify_sample(flash.base(), flash.size(), 25U + 7U,
+                                       1U));
+    REQUIRE_FALSE(bl_icr_verify_sample(flash.base(), flash.size(), 20U, 11U));
+  }
+
+  SECTION("corrupted last block") {
+    flash[pl_size - 1U] ^= 1U;
+    REQUIRE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+    REQUIRE(range.addr == flash.base() + 24U * block_size);
+    REQUIRE(range.size == pl_size % block_size);
+  }
+
+  SECTION("no table") {
+    memset(&flash[flash.size() - BL_BCT_OFFSET_FROM_END], 0xFF, BL_BCT_SIZE);
+    REQUIRE(bl_icr_verify(flash.base(), flash.size(), NULL));
+    REQUIRE(bl_icr_verify_sample(flash.base(), flash.size(), 0U, 1U));
+    REQUIRE_FALSE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+    // Without the table the whole payload is reported
+    flash[5U * block_size] ^= 1U;
+    REQUIRE_FALSE(bl_icr_verify(flash.base(), flash.size(), NULL));
+    REQUIRE_FALSE(bl_icr_verify_sample(flash.base(), flash.size(), 0U, 1U));
+    REQUIRE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+    REQUIRE(range.addr == flash.base());
+    REQUIRE(range.size == pl_size);
+  }
+
+  SECTION("table not matching payload CRC") {
+    // A block is modified and its CRC is updated in the table, so that the
+    // table is consistent but does not match CRC of the whole payload
+    flash[3U * block_size + 1U] ^= 1U;
+    bct.block_crc[3] = crc32_fast(&flash[3U * block_size], block_size, 0U);
+    bct.struct_crc = crc32_fast(&bct, BCT_CRC_CHECKED_SIZE, 0U);
+    REQUIRE_FALSE(bct_validate(&bct, &icr));
+    memcpy(&flash[flash.size() - BL_BCT_OFFSET_FROM_END], &bct, sizeof(bct));
+    REQUIRE_FALSE(bl_icr_verify(flash.base(), flash.size(), NULL));
+    REQUIRE(bl_icr_find_corruption(flash.base(), flash.size(), &range));
+    REQUIRE(range.addr == flash.base());
+    REQUIRE(range.size == pl_size);
+  }
+
+  SECTION("table of another record") {
+    bct.icr_crc ^= 1U;
+    bct.struct_crc = crc32_fast(&bct, BCT_CRC_CHECKED_SIZE, 0U);
+    REQUIRE_FALSE(bct_validate(&bct, &icr));
+  }
+
+  SECTION("invalid geometry") {
+    bct.block_size = block_size / 2U;
+    bct.struct_crc = crc32_fast(&bct, BCT_CRC_CHECKED_SIZE, 0U);
+    REQUIRE_FALSE(bct_validate(&bct, &icr));
+    bct.block_size = block_size + 1U;
+    bct.struct_crc = crc32_fast(&bct, BCT_CRC_CHECKED_SIZE, 0U);
+    REQUIRE_FALSE(bct_validate(&bct, &icr));
+  }
+
+  SECTION("wrong arguments") {
+    REQUIRE_FALSE(bl_icr_find_corruption(flash.base(), flash.size(), NULL));
+    REQUIRE_FALSE(bl_icr_find_corruption(flash.base(), 0U, &range));
+    REQUIRE_FALSE(bl_icr_verify_sample(flash.base(), 0U, 0U, 1U));
+  }
+}
+
+TEST_CASE("Cached integrity check") {
+  FlashBuf flash(ref_payload, sizeof(ref_payload), BL_FW_SECT_OVERHEAD);
+  REQUIRE(bl_icr_create(flash.base(), flash.size(), sizeof(ref_payload),
+                        ref_version));
+  flash_emu_write_protected = false;
+
+  SECTION("no marker") {
+    uint32_t version = 0U;
+    REQUIRE(bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    REQUIRE(version == ref_version);
+    flash[0] ^= 1U;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    REQUIRE(version == BL_VERSION_NA);
+    REQUIRE_FALSE(bl_icr_certify(flash.base(), flash.size(), false));
+    REQUIRE_FALSE(bl_icr_verify(flash.base(), flash.size(), NULL));
+  }
+
+  SECTION("marker without write protection") {
+    REQUIRE(bl_icr_certify(flash.base(), flash.size(), false));
+    flash[0] ^= 1U;
+    // Marker without the flag is never trusted, so the payload is checked
+    uint32_t version = 0U;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    REQUIRE(version == BL_VERSION_NA);
+    // Even if the section happens to be write-protected
+    flash_emu_write_protected = true;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    flash_emu_write_protected = false;
+    flash[0] ^= 1U;
+    REQUIRE(bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    REQUIRE(version == ref_version);
+  }
+
+  SECTION("marker requiring write protection") {
+    REQUIRE(bl_icr_certify(flash.base(), flash.size(), true));
+    flash[0] ^= 1U;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), NULL, false));
+    flash_emu_write_protected = true;
+    REQUIRE(bl_icr_verify_cached(flash.base(), flash.size(), NULL, false));
+    REQUIRE_FALSE(bl_icr_verify_cached(flash.base(), flash.size(), NULL, true));
+    flash_emu_write_protected = false;
+  }
+
+  SECTION("marker of another record") {
+    REQUIRE(bl_icr_certify(flash.base(), flash.size(), true));
+    flash_emu_write_protected = true;
+    flash[0] ^= 1U;
+    // Replace the integrity check record keeping the marker
+    memset(&flash[flash.size() - BL_BCT_OFFSET_FROM_END], 0xFF, BL_BCT_SIZE);
+    memset(&flash[flash.size() - BL_ICR_OFFSET_FROM_END], 0xFF, BL_ICR_SIZE);
+    REQUIRE(bl_icr_create(flash.base(), flash.size(), sizeof(ref_payload),
+                          ref_version + 1U));
+    uint32_t version = 0U;
+    REQUIRE(bl_icr_verify_cached(flash.base(), flash.size(), &version, false));
+    REQUIRE(version == ref_version + 1U);
+    // Marker is not accepted, so the payload is checked
+    flash[0] ^= 1U;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), NULL, false));
+    flash_emu_write_protected = false;
+  }
+
+  SECTION("corrupted marker") {
+    REQUIRE(bl_icr_certify(flash.base(), flash.size(), true));
+    flash_emu_write_protected = true;
+    flash[flash.size() - BL_VMR_OFFSET_FROM_END] ^= 1U;
+    flash[0] ^= 1U;
+    REQUIRE_FALSE(
+        bl_icr_verify_cached(flash.base(), flash.size(), NULL, false));
+    flash_emu_write_protected = false;
+  }
+
+  SECTION("wrong arguments") {
+    REQUIRE_FALSE(bl_icr_verify_cached(flash.base(), 0U, NULL, false));
+    REQUIRE_FALSE(bl_icr_certify(flash.base(), 0U, false));
+  }
+}
+
+TEST_CASE("Verification marker record: validation") {
+  bl_verified_marker_rec_t vmr = {
+      .magic = BL_VMR_MAGIC,
+      .struct_rev = BL_VMR_STRUCT_REV,
+      .icr_crc = 0x12345678U,
+  };
+  vmr.struct_crc = crc32_fast(&vmr, VMR_CRC_CHECKED_SIZE, 0U);
+
+  REQUIRE(vmr_validate(&vmr, 0x12345678U));
+  REQUIRE_FALSE(vmr_validate(&vmr, 0x12345679U));
+  REQUIRE_FALSE(vmr_validate(NULL, 0x12345678U));
+  vmr.flags ^= BL_VMR_FLAG_REQUIRE_WRP;
+  REQUIRE_FALSE(vmr_validate(&vmr, 0x12345678U));
+  vmr.struct_crc = crc32_fast(&vmr, VMR_CRC_CHECKED_SIZE, 0U);
+  REQUIRE(vmr_validate(&vmr, 0x12345678U));
+  vmr.struct_rev = BL_VMR_STRUCT_REV + 1U;
+  vmr.struct_crc = crc32_fast(&vmr, VMR_CRC_CHECKED_SIZE, 0U);
+  REQUIRE_FALSE(vmr_validate(&vmr, 0x12345678U));
+}
+
 TEST_CASE("Firmware sector size validation") {
   // Valid
   REQUIRE(bl_icr_check_sect_size(1U + BL_FW_SECT_OVERHEAD, 1U));
@@ -6,6 +6,7 @@
  */
 
 #define BL_ICR_DEFINE_PRIVATE_TYPES
+#include <string>
 #include "catch2/catch.hpp"
 #include "crc32.h"
 #include "flash_buf.hpp"
@@ -17,6 +18,8 @@ extern "C" {
 bool buf_equal(const uint8_t* bufa, const uint8_t* bufb, size_t len);
 bool do_sha256_kat(void);
 bool do_ecdsa_secp256k1_kat(void);
+bool do_schnorr_secp256k1_kat(void);
+bool do_musig_secp256k1_kat(void);
 }
 
 TEST_CASE("Bootloader KATs") {
@@ -47,6 +50,133 @@ TEST_CASE("Bootloader KATs") {
   SECTION("known answer tests") {
     REQUIRE(do_sha256_kat());
     REQUIRE(do_ecdsa_secp256k1_kat());
+    REQUIRE(do_schnorr_secp256k1_kat());
+    REQUIRE(do_musig_secp256k1_kat());
     REQUIRE(bl_run_kats());
   }
 }
+
+// Emulated record in non-volatile memory, defined in bl_syscalls_test.c
+extern "C" {
+extern uint8_t nvrec_emu_buf[64];
+extern size_t nvrec_emu_len;
+}
+
+/// KATs scheduled for every upgrade
+static const bl_kat_id_t scheduled_kats[] = {bl_kat_sha256, bl_kat_secp256k1};
+/// KATs run on demand
+static const bl_kat_id_t on_demand_kats[] = {bl_kat_schnorr, bl_kat_musig};
+
+/**
+ * Checks that all scheduled KATs are in the same state, and that KATs run on
+ * demand are not run
+ *
+ * @param state  expected state
+ * @return       true if all KATs are in the expected state
+ */
+static bool all_kats_in_state(bl_kat_state_t state) {
+  for (bl_kat_id_t id : scheduled_kats) {
+    if (bl_kat_get_state(id) != state) {
+      return false;
+    }
+  }
+  for (bl_kat_id_t id : on_demand_kats) {
+    if (bl_kat_get_state(id) != bl_kat_pending) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("KAT scheduler") {
+  const uint32_t version = 102030405U;
+  nvrec_emu_len = 0U;
+
+  SECTION("always") {
+    REQUIRE(bl_kats_begin(bl_kat_policy_always, version));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(bl_kat_get_time_us(bl_kat_secp256k1) > 0U);
+    REQUIRE(bl_kats_begin(bl_kat_policy_always, version));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(0U == nvrec_emu_len);
+  }
+
+  SECTION("once per version") {
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(32U == nvrec_emu_len);
+
+    // Same version: KATs are skipped
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version));
+    REQUIRE(all_kats_in_state(bl_kat_skipped));
+    REQUIRE(0U == bl_kat_get_time_us(bl_kat_secp256k1));
+    REQUIRE(bl_kats_complete());
+
+    // Another version: KATs are run and the record is updated
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version + 1U));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version + 1U));
+    REQUIRE(all_kats_in_state(bl_kat_skipped));
+
+    // Corrupted record
+    for (size_t idx = 0U; idx < nvrec_emu_len; ++idx) {
+      nvrec_emu_buf[idx] ^= 0x20U;
+      REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version + 1U));
+      REQUIRE(all_kats_in_state(bl_kat_passed));
+      REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version + 1U));
+      REQUIRE(all_kats_in_state(bl_kat_skipped));
+    }
+
+    // Version is not available: KATs are always run
+    nvrec_emu_len = 0U;
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, BL_VERSION_NA));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(0U == nvrec_emu_len);
+  }
+
+  SECTION("overlapped") {
+    REQUIRE(bl_kats_begin(bl_kat_policy_overlapped, version));
+    REQUIRE(all_kats_in_state(bl_kat_pending));
+    REQUIRE(bl_kats_step());
+    REQUIRE(bl_kat_passed == bl_kat_get_state(bl_kat_sha256));
+    REQUIRE(bl_kat_pending == bl_kat_get_state(bl_kat_secp256k1));
+    REQUIRE(bl_kats_complete());
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(bl_kats_step());
+    REQUIRE(0U == nvrec_emu_len);
+  }
+
+  SECTION("on demand") {
+    REQUIRE(bl_kats_begin(bl_kat_policy_always, version));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+    REQUIRE(bl_kats_run_for_algorithm("secp256k1-sha256"));
+    REQUIRE(bl_kats_run_for_algorithm("unknown"));
+    REQUIRE(bl_kats_run_for_algorithm(NULL));
+    REQUIRE(all_kats_in_state(bl_kat_passed));
+
+    REQUIRE(bl_kats_run_for_algorithm("secp256k1-schnorr-sha256"));
+    REQUIRE(bl_kat_passed == bl_kat_get_state(bl_kat_schnorr));
+    REQUIRE(bl_kat_pending == bl_kat_get_state(bl_kat_musig));
+    REQUIRE(bl_kats_run_for_algorithm("secp256k1-musig2-sha256"));
+    REQUIRE(bl_kat_passed == bl_kat_get_state(bl_kat_musig));
+
+    // Skipped by the record are only the scheduled KATs
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version));
+    REQUIRE(bl_kats_begin(bl_kat_policy_once_per_version, version));
+    REQUIRE(all_kats_in_state(bl_kat_skipped));
+    REQUIRE(bl_kats_run_for_algorithm("secp256k1-schnorr-sha256"));
+    REQUIRE(bl_kat_passed == bl_kat_get_state(bl_kat_schnorr));
+  }
+
+  SECTION("names") {
+    REQUIRE(std::string("SHA-256") == bl_kat_name(bl_kat_sha256));
+    REQUIRE(std::string("secp256k1") == bl_kat_name(bl_kat_secp256k1));
+    REQUIRE(std::string("unknown") == bl_kat_name(bl_n_kats_));
+    REQUIRE(bl_kat_failed == bl_kat_get_state(bl_n_kats_));
+  }
+
+  REQUIRE(bl_run_kats());
+  for (int id = 0; id < bl_n_kats_; ++id) {
+    REQUIRE(bl_kat_passed == bl_kat_get_state((bl_kat_id_t)id));
+  }
+}
@@ -0,0 +1,123 @@
+/**
+ * @file       test_bl_lzss.cpp
+ * @brief      Unit tests for streaming LZSS decoder
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <memory>
+#include "catch2/catch.hpp"
+#include "lzss_encoder.hpp"
+#include "bl_lzss.h"
+
+/**
+ * Generates test data having both repeating and random-looking parts
+ *
+ * @param size  size of data
+ * @return      generated data
+ */
+static std::vector<uint8_t> make_data(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t seed = 12345U;
+  for (size_t i = 0U; i < size; ++i) {
+    seed = seed * 1103515245U + 12345U;
+    bool repeat = (i / 64U) % 2U && i >= 100U;
+    data[i] = repeat ? data[i - 100U] : (uint8_t)(seed >> 24);
+  }
+  return data;
+}
+
+/**
+ * Decodes data feeding the decoder with chunks of given sizes
+ *
+ * @param in        compressed data
+ * @param out_size  expected size of decoded data
+ * @param in_chunk  maximum size of input chunk
+ * @param out_chunk maximum size of output chunk
+ * @param p_out     pointer to vector receiving decoded data
+ * @return          true if successful
+ */
+static bool decode(const std::vector<uint8_t>& in, size_t out_size,
+                   size_t in_chunk, size_t out_chunk,
+                   std::vector<uint8_t>* p_out) {
+  auto p_state = std::make_unique<bl_lzss_t>();
+  bl_lzss_init(p_state.get());
+  p_out->assign(out_size, 0U);
+  size_t in_pos = 0U;
+  size_t out_pos = 0U;
+  while (out_pos < out_size) {
+    size_t in_len = in.size() - in_pos;
+    in_len = (in_len < in_chunk) ? in_len : in_chunk;
+    size_t out_len = out_size - out_pos;
+    out_len = (out_len < out_chunk) ? out_len : out_chunk;
+    if (!bl_lzss_decode(p_state.get(), in.data() + in_pos, &in_len,
+                        p_out->data() + out_pos, &out_len)) {
+      return false;
+    }
+    if (!in_len && !out_len) {
+      return false;  // No progress
+    }
+    in_pos += in_len;
+    out_pos += out_len;
+  }
+  return in_pos == in.size() && bl_lzss_is_idle(p_state.get());
+}
+
+TEST_CASE("Decode LZSS stream") {
+  SECTION("valid, literals and matches") {
+    // Group: 'a' 'b' 'c' (literals), match {offset 3, length 6}
+    const std::vector<uint8_t> in = {0x07U, 'a', 'b', 'c', 0x02U, 0x18U};
+    std::vector<uint8_t> out;
+    REQUIRE(decode(in, 9U, SIZE_MAX, SIZE_MAX, &out));
+    REQUIRE(std::vector<uint8_t>({'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b',
+                                  'c'}) == out);
+  }
+
+  SECTION("valid, run of a single byte") {
+    // Literal 'x', then match {offset 1, length BL_LZSS_MAX_MATCH}
+    const std::vector<uint8_t> in = {0x01U, 'x', 0x00U, 0xF8U};
+    std::vector<uint8_t> out;
+    REQUIRE(decode(in, 1U + BL_LZSS_MAX_MATCH, SIZE_MAX, SIZE_MAX, &out));
+    REQUIRE(std::vector<uint8_t>(1U + BL_LZSS_MAX_MATCH, 'x') == out);
+  }
+
+  SECTION("valid, encoded data in various chunks") {
+    auto data = make_data(3U * BL_LZSS_WINDOW_SIZE + 17U);
+    auto in = lzss_encode(data.data(), data.size());
+    REQUIRE(in.size() < data.size());
+    const size_t chunks[] = {1U, 2U, 3U, 7U, 512U, SIZE_MAX};
+    for (size_t in_chunk : chunks) {
+      for (size_t out_chunk : chunks) {
+        std::vector<uint8_t> out;
+        REQUIRE(decode(in, data.size(), in_chunk, out_chunk, &out));
+        REQUIRE(data == out);
+      }
+    }
+  }
+
+  SECTION("invalid, reference before the beginning of stream") {
+    const std::vector<uint8_t> in = {0x01U, 'a', 0x01U, 0x00U};
+    std::vector<uint8_t> out;
+    REQUIRE_FALSE(decode(in, 4U, SIZE_MAX, SIZE_MAX, &out));
+  }
+
+  SECTION("invalid, stream ends within a match token") {
+    const std::vector<uint8_t> in = {0x01U, 'a', 0x00U};
+    std::vector<uint8_t> out;
+    REQUIRE_FALSE(decode(in, 4U, SIZE_MAX, SIZE_MAX, &out));
+  }
+
+  SECTION("invalid arguments") {
+    bl_lzss_t state;
+    bl_lzss_init(&state);
+    uint8_t in[1] = {0U};
+    uint8_t out[1];
+    size_t in_len = sizeof(in);
+    size_t out_len = sizeof(out);
+    REQUIRE_FALSE(bl_lzss_decode(NULL, in, &in_len, out, &out_len));
+    REQUIRE_FALSE(bl_lzss_decode(&state, NULL, &in_len, out, &out_len));
+    REQUIRE_FALSE(bl_lzss_decode(&state, in, NULL, out, &out_len));
+    REQUIRE_FALSE(bl_lzss_decode(&state, in, &in_len, NULL, &out_len));
+    REQUIRE_FALSE(bl_lzss_decode(&state, in, &in_len, out, NULL));
+  }
+}
@@ -9,6 +9,7 @@
 #include "crc32.h"
 #include "progress_monitor.hpp"
 #include "flash_buf.hpp"
+#include "lzss_encoder.hpp"
 #include "bl_section.h"
 
 /// Digital signature algorithm string: secp256k1-sha256
@@ -163,6 +164,27 @@ static bl_section_t* correct_crc_with_pl(bl_section_t* p_hdr,
   return correct_crc(p_hdr);
 }
 
+/**
+ * Makes a header of compressed section from a header of uncompressed one
+ *
+ * Attributes of the source header are replaced with compression attributes.
+ *
+ * @param p_hdr        pointer to section header with valid payload CRC
+ * @param stored_size  size of compressed payload
+ * @return             header of compressed section with corrected CRC
+ */
+static bl_section_t make_compressed_header(const bl_section_t* p_hdr,
+                                           uint32_t stored_size) {
+  bl_section_t hdr = *p_hdr;
+  const uint8_t attr_list[] = {
+      bl_attr_compression, 4U, 'l', 'z', 's', 's', bl_attr_stored_size, 4U,
+      (uint8_t)stored_size, (uint8_t)(stored_size >> 8),
+      (uint8_t)(stored_size >> 16), (uint8_t)(stored_size >> 24)};
+  memset(hdr.attr_list, 0, sizeof(hdr.attr_list));
+  memcpy(hdr.attr_list, attr_list, sizeof(attr_list));
+  return *correct_crc(&hdr);
+}
+
 /**
  * Puts string into buffer, filling the rest with null characters
  *
@@ -312,6 +334,15 @@ TEST_CASE("Validate header") {
       hdr.attr_list[0] = 0xFE;
       REQUIRE(blsect_validate_header(correct_crc(&hdr)));
     }
+
+    SECTION("compressed payload") {
+      bl_section_t hdr = make_compressed_header(&ref_header, 10U);
+      REQUIRE(blsect_validate_header(&hdr));
+      REQUIRE(blsect_is_compressed(&hdr));
+      REQUIRE(10U == blsect_stored_size(&hdr));
+      REQUIRE_FALSE(blsect_is_compressed(&ref_header));
+      REQUIRE(ref_header.pl_size == blsect_stored_size(&ref_header));
+    }
   }
 
   SECTION("invalid") {
@@ -377,6 +408,25 @@ TEST_CASE("Validate header") {
       hdr.struct_crc ^= 1U;
       REQUIRE_FALSE(blsect_validate_header(&hdr));
     }
+
+    SECTION("unsupported compression algorithm") {
+      bl_section_t hdr = make_compressed_header(&ref_header, 10U);
+      hdr.attr_list[2] = 'x';
+      REQUIRE_FALSE(blsect_validate_header(correct_crc(&hdr)));
+    }
+
+    SECTION("compressed payload without stored size") {
+      bl_section_t hdr = make_compressed_header(&ref_header, 10U);
+      memset(&hdr.attr_list[6], 0, 6U);
+      REQUIRE_FALSE(blsect_validate_header(correct_crc(&hdr)));
+    }
+
+    SECTION("wrong stored size") {
+      bl_section_t hdr = make_compressed_header(&ref_header, 0U);
+      REQUIRE_FALSE(blsect_validate_header(&hdr));
+      hdr = make_compressed_header(&ref_header, BL_PAYLOAD_SIZE_MAX + 1U);
+      REQUIRE_FALSE(blsect_validate_header(&hdr));
+    }
   }
 }
 
@@ -745,6 +795,229 @@ TEST_CASE("Calculate hash over flash") {
   }
 }
 
+TEST_CASE("Calculate hash over file") {
+  SECTION("valid, reference section") {
+    bl_hash_t hash;
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(blsect_hash_over_file(&ref_header, PayloadFile(), &hash, 12345U));
+    REQUIRE(0 == memcmp(&hash.digest, &ref_section_hash, sizeof(hash.digest)));
+    REQUIRE(streq(hash.sect_name, ref_header.name));
+    REQUIRE(ref_header.pl_ver == hash.pl_ver);
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("invalid, corrupted payload") {
+    uint8_t pl_buf[sizeof(ref_payload)];
+    memcpy(pl_buf, ref_payload, sizeof(pl_buf));
+    pl_buf[0] ^= 1U;
+
+    bl_hash_t hash;
+    REQUIRE_FALSE(blsect_hash_over_file(
+        &ref_header, PayloadFile(pl_buf, sizeof(pl_buf)), &hash, 0U));
+  }
+
+  SECTION("invalid, truncated file") {
+    bl_hash_t hash;
+    REQUIRE_FALSE(blsect_hash_over_file(
+        &ref_header, PayloadFile(ref_payload, sizeof(ref_payload) - 1U), &hash,
+        0U));
+  }
+
+  SECTION("invalid arguments") {
+    bl_hash_t hash;
+    REQUIRE_FALSE(blsect_hash_over_file(NULL, PayloadFile(), &hash, 0U));
+    REQUIRE_FALSE(blsect_hash_over_file(&ref_header, NULL, &hash, 0U));
+    REQUIRE_FALSE(blsect_hash_over_file(&ref_header, PayloadFile(), NULL, 0U));
+  }
+}
+
+TEST_CASE("Calculate CRC and hash in a single pass") {
+  SECTION("valid, reference section over flash") {
+    bl_hash_t hash;
+    uint32_t crc = 0U;
+    FlashBuf flash(ref_payload, sizeof(ref_payload));
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(blsect_crc_and_hash_over_flash(&ref_header, flash_emu_base, &crc,
+                                           &hash, 12345U));
+    REQUIRE(ref_header.pl_crc == crc);
+    REQUIRE(0 == memcmp(&hash.digest, &ref_section_hash, sizeof(hash.digest)));
+    REQUIRE(streq(hash.sect_name, ref_header.name));
+    REQUIRE(ref_header.pl_ver == hash.pl_ver);
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("valid, reference section over file") {
+    bl_hash_t hash;
+    uint32_t crc = 0U;
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(blsect_crc_and_hash_over_file(&ref_header, PayloadFile(), &crc,
+                                          &hash, 12345U));
+    REQUIRE(ref_header.pl_crc == crc);
+    REQUIRE(0 == memcmp(&hash.digest, &ref_section_hash, sizeof(hash.digest)));
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("valid, large payload matches separate passes") {
+    const size_t pl_size = 5U * 4096U + 777U;
+    auto pl_buf = std::make_unique<uint8_t[]>(pl_size);
+    for (size_t i = 0; i < pl_size; ++i) {
+      pl_buf[i] = (uint8_t)(i * 31U + (i >> 9));
+    }
+    bl_section_t hdr = ref_header;
+    hdr.pl_size = pl_size;
+    (void)correct_crc_with_pl(&hdr, pl_buf.get(), pl_size);
+    FlashBuf flash(pl_buf.get(), pl_size);
+
+    bl_hash_t ref_hash;
+    REQUIRE(blsect_hash_over_flash(&hdr, flash_emu_base, &ref_hash, 0U));
+    bl_hash_t hash;
+    uint32_t crc = 0U;
+    REQUIRE(blsect_crc_and_hash_over_flash(&hdr, flash_emu_base, &crc, &hash,
+                                           0U));
+    REQUIRE(hdr.pl_crc == crc);
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+
+    crc = 0U;
+    memset(&hash, 0, sizeof(hash));
+    REQUIRE(blsect_crc_and_hash_over_file(
+        &hdr, PayloadFile(pl_buf.get(), pl_size), &crc, &hash, 0U));
+    REQUIRE(hdr.pl_crc == crc);
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+  }
+
+  SECTION("corrupted payload, CRC returned to caller") {
+    uint8_t pl_buf[sizeof(ref_payload)];
+    memcpy(pl_buf, ref_payload, sizeof(pl_buf));
+    pl_buf[0] ^= 1U;
+    FlashBuf flash(pl_buf, sizeof(pl_buf));
+
+    bl_hash_t hash;
+    uint32_t crc = 0U;
+    REQUIRE(blsect_crc_and_hash_over_flash(&ref_header, flash_emu_base, &crc,
+                                           &hash, 0U));
+    REQUIRE(ref_header.pl_crc != crc);
+    REQUIRE(crc == crc32_fast(pl_buf, sizeof(pl_buf), 0U));
+    REQUIRE(0 != memcmp(&hash.digest, &ref_section_hash, sizeof(hash.digest)));
+
+    uint32_t file_crc = 0U;
+    REQUIRE(blsect_crc_and_hash_over_file(
+        &ref_header, PayloadFile(pl_buf, sizeof(pl_buf)), &file_crc, &hash,
+        0U));
+    REQUIRE(crc == file_crc);
+  }
+
+  SECTION("invalid, truncated file") {
+    bl_hash_t hash;
+    uint32_t crc;
+    REQUIRE_FALSE(blsect_crc_and_hash_over_file(
+        &ref_header, PayloadFile(ref_payload, sizeof(ref_payload) - 1U), &crc,
+        &hash, 0U));
+  }
+
+  SECTION("invalid arguments") {
+    bl_hash_t hash;
+    uint32_t crc;
+    FlashBuf flash(ref_payload, sizeof(ref_payload));
+    REQUIRE_FALSE(
+        blsect_crc_and_hash_over_flash(NULL, flash_emu_base, &crc, &hash, 0U));
+    REQUIRE_FALSE(blsect_crc_and_hash_over_flash(&ref_header, flash_emu_base,
+                                                 NULL, &hash, 0U));
+    REQUIRE_FALSE(blsect_crc_and_hash_over_flash(&ref_header, flash_emu_base,
+                                                 &crc, NULL, 0U));
+    REQUIRE_FALSE(
+        blsect_crc_and_hash_over_file(NULL, PayloadFile(), &crc, &hash, 0U));
+    REQUIRE_FALSE(
+        blsect_crc_and_hash_over_file(&ref_header, NULL, &crc, &hash, 0U));
+    REQUIRE_FALSE(blsect_crc_and_hash_over_file(&ref_header, PayloadFile(),
+                                                NULL, &hash, 0U));
+  }
+}
+
+TEST_CASE("Copy payload from file") {
+  SECTION("valid, reference section") {
+    bl_hash_t hash;
+    FlashBuf flash(NULL, sizeof(ref_payload));
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(blsect_copy_payload_from_file(&ref_header, PayloadFile(),
+                                          flash_emu_base, NULL, &hash, 12345U));
+    REQUIRE(0 == memcmp(flash, ref_payload, sizeof(ref_payload)));
+    REQUIRE(0 == memcmp(&hash.digest, &ref_section_hash, sizeof(hash.digest)));
+    REQUIRE(streq(hash.sect_name, ref_header.name));
+    REQUIRE(ref_header.pl_ver == hash.pl_ver);
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("valid, long payload matches hash over flash") {
+    // Generate payload buffer
+    const size_t pl_size = BL_PAYLOAD_SIZE_MAX - 3U;
+    auto pl_buf = std::make_unique<uint8_t[]>(pl_size);
+    for (size_t i = 0; i < pl_size; ++i) {
+      pl_buf[i] = (uint8_t)(i & 0xFFU);
+    }
+
+    // Create header and virtual file
+    bl_section_t hdr = ref_header;
+    hdr.pl_size = pl_size;
+    (void)correct_crc_with_pl(&hdr, pl_buf.get(), pl_size);
+    auto file = PayloadFile(pl_buf.get(), pl_size);
+
+    bl_hash_t hash;
+    bl_hash_t ref_hash;
+    FlashBuf flash(NULL, pl_size);
+    REQUIRE(blsect_copy_payload_from_file(&hdr, file, flash_emu_base, NULL,
+                                          &hash, 0U));
+    REQUIRE(0 == memcmp(flash, pl_buf.get(), pl_size));
+    REQUIRE(blsect_hash_over_flash(&hdr, flash_emu_base, &ref_hash, 0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+  }
+
+  SECTION("invalid, corrupted payload") {
+    uint8_t pl_buf[sizeof(ref_payload)];
+    memcpy(pl_buf, ref_payload, sizeof(pl_buf));
+    pl_buf[sizeof(pl_buf) / 2U] ^= 1U;
+
+    bl_hash_t hash;
+    FlashBuf flash(NULL, sizeof(ref_payload));
+    REQUIRE_FALSE(blsect_copy_payload_from_file(
+        &ref_header, PayloadFile(pl_buf, sizeof(pl_buf)), flash_emu_base,
+        NULL, &hash, 0U));
+  }
+
+  SECTION("invalid, truncated file") {
+    bl_hash_t hash;
+    FlashBuf flash(NULL, sizeof(ref_payload));
+    REQUIRE_FALSE(blsect_copy_payload_from_file(
+        &ref_header, PayloadFile(ref_payload, sizeof(ref_payload) - 1U),
+        flash_emu_base, NULL, &hash, 0U));
+  }
+
+  SECTION("invalid, flash not erased") {
+    bl_hash_t hash;
+    FlashBuf flash(NULL, sizeof(ref_payload));
+    flash[sizeof(ref_payload) - 1U] = 0x00U;
+    REQUIRE_FALSE(blsect_copy_payload_from_file(
+        &ref_header, PayloadFile(), flash_emu_base, NULL, &hash, 0U));
+  }
+
+  SECTION("invalid arguments") {
+    bl_hash_t hash;
+    FlashBuf flash(NULL, sizeof(ref_payload));
+    REQUIRE_FALSE(blsect_copy_payload_from_file(NULL, PayloadFile(),
+                                                flash_emu_base, NULL, &hash,
+                                                0U));
+    REQUIRE_FALSE(blsect_copy_payload_from_file(&ref_header, NULL,
+                                                flash_emu_base, NULL, &hash,
+                                                0U));
+    REQUIRE_FALSE(blsect_copy_payload_from_file(&ref_header, PayloadFile(),
+                                                flash_emu_base, NULL, NULL,
+                                                0U));
+  }
+}
+
 TEST_CASE("Bytes to 5-bit characters") {
   SECTION("valid, uneven") {
     uint8_t data[] = {0xABU, 0xC1U};
@@ -843,3 +1116,73 @@ TEST_CASE("Make signature message") {
     REQUIRE_FALSE(blsect_make_signature_message(m, &sz, hashes, hash_items));
   }
 }
+
+TEST_CASE("Copy compressed payload from file") {
+  // Generate compressible payload
+  const size_t pl_size = 3U * 4096U + 123U;
+  auto pl_buf = std::make_unique<uint8_t[]>(pl_size);
+  for (size_t i = 0; i < pl_size; ++i) {
+    pl_buf[i] = (uint8_t)((i / 16U) * 7U);
+  }
+  bl_section_t plain_hdr = ref_header;
+  plain_hdr.pl_size = pl_size;
+  (void)correct_crc_with_pl(&plain_hdr, pl_buf.get(), pl_size);
+  auto stored = lzss_encode(pl_buf.get(), pl_size);
+  REQUIRE(stored.size() < pl_size / 4U);
+
+  SECTION("valid, produces the same firmware as uncompressed") {
+    bl_section_t hdr = make_compressed_header(&plain_hdr, stored.size());
+    REQUIRE(blsect_validate_header(&hdr));
+    bl_hash_t hash;
+    bl_hash_t ref_hash;
+    FlashBuf flash(NULL, pl_size);
+    ProgressMonitor monitor(12345U);
+
+    REQUIRE(blsect_copy_payload_from_file(
+        &hdr, PayloadFile(stored.data(), stored.size()), flash_emu_base, NULL,
+        &hash, 12345U));
+    REQUIRE(0 == memcmp(flash, pl_buf.get(), pl_size));
+    REQUIRE(monitor.is_complete());
+    REQUIRE(blsect_hash_over_flash(&hdr, flash_emu_base, &ref_hash, 0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+  }
+
+  SECTION("valid, hash and validation over file") {
+    bl_section_t hdr = make_compressed_header(&plain_hdr, stored.size());
+    bl_hash_t hash;
+    bl_hash_t ref_hash;
+    FlashBuf flash(pl_buf.get(), pl_size);
+
+    REQUIRE(blsect_hash_over_file(
+        &hdr, PayloadFile(stored.data(), stored.size()), &hash, 0U));
+    REQUIRE(blsect_hash_over_flash(&hdr, flash_emu_base, &ref_hash, 0U));
+    REQUIRE(0 == memcmp(&hash, &ref_hash, sizeof(hash)));
+    REQUIRE(blsect_validate_payload_from_file(
+        &hdr, PayloadFile(stored.data(), stored.size()), 0U));
+  }
+
+  SECTION("invalid, corrupted compressed data") {
+    bl_section_t hdr = make_compressed_header(&plain_hdr, stored.size());
+    stored[stored.size() / 2U] ^= 0x55U;
+    bl_hash_t hash;
+    FlashBuf flash(NULL, pl_size);
+    REQUIRE_FALSE(blsect_copy_payload_from_file(
+        &hdr, PayloadFile(stored.data(), stored.size()), flash_emu_base, NULL,
+        &hash, 0U));
+  }
+
+  SECTION("invalid, trailing data after compressed stream") {
+    stored.push_back(0x00U);
+    bl_section_t hdr = make_compressed_header(&plain_hdr, stored.size());
+    bl_hash_t hash;
+    REQUIRE_FALSE(blsect_hash_over_file(
+        &hdr, PayloadFile(stored.data(), stored.size()), &hash, 0U));
+  }
+
+  SECTION("invalid, truncated compressed stream") {
+    bl_section_t hdr = make_compressed_header(&plain_hdr, stored.size());
+    bl_hash_t hash;
+    REQUIRE_FALSE(blsect_hash_over_file(
+        &hdr, PayloadFile(stored.data(), stored.size() - 1U), &hash, 0U));
+  }
+}
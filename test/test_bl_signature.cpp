@@ -7,6 +7,8 @@
 
 #define BLSIG_DEFINE_PRIVATE_TYPES
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <vector>
 #include <string.h>
 #include "catch2/catch.hpp"
@@ -31,8 +33,8 @@ extern "C" {
 bool check_duplicating_signatures(const signature_rec_t* sig_recs,
                                   uint32_t n_sig);
 void pubkey_fingerprint(fingerprint_t* p_result, const bl_pubkey_t* p_pubkey);
-const bl_pubkey_t* find_pubkey(const bl_pubkey_t** p_pubkeys,
-                               const fingerprint_t* p_fingerprint);
+bool build_key_store(const bl_pubkey_t** pubkey_set,
+                     const bl_pubkey_index_t* p_index);
 bool verify_signature(secp256k1_context* verify_ctx, const signature_t* p_sig,
                       const uint8_t* message, size_t message_len,
                       const bl_pubkey_t* p_pubkey);
@@ -138,6 +140,63 @@ static const signature_rec_t ref_multisig_sigrecs[REF_N_SIGS] = {
                    0x84U, 0x78U, 0x50U, 0xB3U, 0x9BU, 0x4CU, 0xF1U, 0xE5U}},
 };
 
+// The reference contents of Signature section with BIP-340 Schnorr signatures
+// of the reference message made with the same keys
+static const signature_rec_t ref_schnorr_sigrecs[REF_N_SIGS] = {
+    {.fingerprint = {0xE5U, 0xCDU, 0x36U, 0x99U, 0x5BU, 0x54U, 0xF8U, 0x91U,
+                     0x98U, 0x24U, 0xE5U, 0x2FU, 0xE9U, 0x8CU, 0xF6U, 0x0EU},
+     .signature = {0x39U, 0x8DU, 0x32U, 0xCDU, 0x1DU, 0x0CU, 0x91U, 0xF5U,
+                   0x44U, 0x0EU, 0xEBU, 0xBCU, 0xB6U, 0xDFU, 0xB5U, 0x03U,
+                   0x95U, 0x1CU, 0xF6U, 0xDCU, 0xDAU, 0xAAU, 0xFCU, 0x39U,
+                   0xBEU, 0x43U, 0xD6U, 0xD8U, 0x7DU, 0x17U, 0x77U, 0xB0U,
+                   0xB4U, 0x92U, 0x0BU, 0x8CU, 0x1DU, 0x78U, 0x26U, 0x81U,
+                   0x34U, 0xBDU, 0xB8U, 0x88U, 0xBBU, 0xE2U, 0x2BU, 0xABU,
+                   0xBFU, 0x4EU, 0x7DU, 0x8EU, 0xFCU, 0xA8U, 0x40U, 0x82U,
+                   0x12U, 0x03U, 0x52U, 0x67U, 0x55U, 0x78U, 0xB1U, 0xC1U}},
+    {.fingerprint = {0x64U, 0x62U, 0x5CU, 0x21U, 0x10U, 0x98U, 0xB0U, 0x96U,
+                     0xB4U, 0x71U, 0x89U, 0x41U, 0x5EU, 0x57U, 0x20U, 0x93U},
+     .signature = {0x5CU, 0xCDU, 0xE0U, 0x55U, 0x16U, 0x1EU, 0xB9U, 0x5EU,
+                   0xF0U, 0x92U, 0xC9U, 0x3DU, 0x2CU, 0xCFU, 0xA7U, 0x18U,
+                   0x43U, 0x90U, 0x10U, 0x56U, 0x79U, 0xB4U, 0x36U, 0xF7U,
+                   0xA6U, 0xDAU, 0xA9U, 0x6DU, 0x1DU, 0xC2U, 0x52U, 0x12U,
+                   0xBBU, 0x10U, 0xEEU, 0xCBU, 0x9EU, 0x7EU, 0xC3U, 0x1BU,
+                   0xDDU, 0xEFU, 0xA1U, 0xF1U, 0x2FU, 0x8FU, 0x74U, 0x05U,
+                   0x4BU, 0xD5U, 0x88U, 0xCBU, 0x0EU, 0x35U, 0xC8U, 0x22U,
+                   0x29U, 0x42U, 0xB5U, 0x70U, 0x3EU, 0x6EU, 0xC0U, 0x5CU}},
+    {.fingerprint = {0x25U, 0x20U, 0xF6U, 0x4AU, 0x5DU, 0x60U, 0xD3U, 0x69U,
+                     0x51U, 0x31U, 0xA6U, 0x24U, 0x16U, 0x9FU, 0x95U, 0x9AU},
+     .signature = {0x35U, 0x48U, 0x29U, 0xEEU, 0x77U, 0x4FU, 0x2CU, 0xF8U,
+                   0xCBU, 0xBCU, 0xECU, 0xD0U, 0x54U, 0x36U, 0x9DU, 0xACU,
+                   0xDDU, 0x1FU, 0x9EU, 0x4EU, 0xF6U, 0xE7U, 0x7CU, 0xD4U,
+                   0x8EU, 0x21U, 0xD7U, 0xB7U, 0x1BU, 0x11U, 0xC2U, 0xF1U,
+                   0x3DU, 0xB4U, 0x72U, 0xB5U, 0x82U, 0x97U, 0x9AU, 0x01U,
+                   0xF2U, 0x67U, 0xEBU, 0xC6U, 0xEDU, 0x9DU, 0xE0U, 0x69U,
+                   0x44U, 0x44U, 0x89U, 0x52U, 0x95U, 0x05U, 0xFFU, 0x1BU,
+                   0x3EU, 0x24U, 0xF9U, 0x48U, 0x27U, 0xB1U, 0x41U, 0x2AU}},
+};
+
+// The reference contents of Signature section with MuSig2 aggregated signature
+// of the reference message made jointly with the same keys: the signature
+// followed by fingerprints of the signers in ascending order
+static const struct BL_ATTRS((packed)) ref_musig_section_t {
+  signature_t signature;              ///< Aggregated signature
+  fingerprint_t signers[REF_N_SIGS];  ///< Fingerprints of signers
+} ref_musig_section = {
+    .signature = {0xE1U, 0xEDU, 0xA4U, 0xA4U, 0xACU, 0x0AU, 0x9EU, 0x2EU,
+                  0x09U, 0xABU, 0x92U, 0x11U, 0x21U, 0xBAU, 0xF7U, 0x6FU,
+                  0xCDU, 0x67U, 0x64U, 0x9DU, 0x53U, 0xA4U, 0x90U, 0x73U,
+                  0x49U, 0x4FU, 0xC2U, 0xADU, 0xC4U, 0x6FU, 0x30U, 0xA8U,
+                  0x25U, 0xEEU, 0xBAU, 0x47U, 0x54U, 0x09U, 0x4BU, 0x6BU,
+                  0x46U, 0x34U, 0x22U, 0xFCU, 0x2EU, 0x4EU, 0xBFU, 0x18U,
+                  0x8FU, 0x87U, 0xA1U, 0x5DU, 0x6DU, 0x1FU, 0x47U, 0x1EU,
+                  0x40U, 0xCFU, 0x4BU, 0x75U, 0xD1U, 0x78U, 0xF1U, 0x84U},
+    .signers = {{0x25U, 0x20U, 0xF6U, 0x4AU, 0x5DU, 0x60U, 0xD3U, 0x69U, 0x51U,
+                 0x31U, 0xA6U, 0x24U, 0x16U, 0x9FU, 0x95U, 0x9AU},
+                {0x64U, 0x62U, 0x5CU, 0x21U, 0x10U, 0x98U, 0xB0U, 0x96U, 0xB4U,
+                 0x71U, 0x89U, 0x41U, 0x5EU, 0x57U, 0x20U, 0x93U},
+                {0xE5U, 0xCDU, 0x36U, 0x99U, 0x5BU, 0x54U, 0xF8U, 0x91U, 0x98U,
+                 0x24U, 0xE5U, 0x2FU, 0xE9U, 0x8CU, 0xF6U, 0x0EU}}};
+
 /// A wrapper around a secp256k1 context object initialized for verification
 class VerifyContext {
  public:
@@ -167,48 +226,139 @@ static inline bool memeq(const uint8_t* mema, const uint8_t* memb, size_t len) {
   return false;
 }
 
+/**
+ * Makes a list of distinct public keys terminated with "end of list" record
+ *
+ * Keys are not valid curve points, they are only hashed into fingerprints.
+ *
+ * @param n_keys  number of keys
+ * @param fill    value of bytes of the first key, incremented for each key
+ * @return        vector of public keys
+ */
+static std::vector<bl_pubkey_t> make_keys(int n_keys, int fill = 1) {
+  std::vector<bl_pubkey_t> keys(n_keys + 1);
+  for (int i = 0; i < n_keys; ++i) {
+    memset(keys[i].bytes, fill + i, sizeof(keys[i].bytes));
+  }
+  keys[n_keys] = BL_PUBKEY_END_OF_LIST;
+  return keys;
+}
+
+/**
+ * Makes a signature record with the fingerprint of a public key
+ *
+ * @param key  public key
+ * @return     signature record with a dummy signature
+ */
+static signature_rec_t make_rec(const bl_pubkey_t& key) {
+  signature_rec_t rec;
+  memset(&rec, 0x5A, sizeof(rec));
+  pubkey_fingerprint(&rec.fingerprint, &key);
+  return rec;
+}
+
+/**
+ * Checks signature records for duplication with a freshly built key store
+ *
+ * @param pubkey_set  NULL-terminated list of pointers to public key lists
+ * @param recs        signature records
+ * @return            true if there is no duplicating signatures
+ */
+static bool check_dups(const bl_pubkey_t** pubkey_set,
+                       const std::vector<signature_rec_t>& recs) {
+  REQUIRE(build_key_store(pubkey_set, NULL));
+  return check_duplicating_signatures(recs.data(), recs.size());
+}
+
 TEST_CASE("Check duplicating signatures") {
-  const int n_recs = 17U;
-  const int last_fp_byte = FP_SIZE - 1;
-  auto recs = std::make_unique<signature_rec_t[]>(n_recs);
-  for (int i = 0; i < n_recs; ++i) {
-    memset(recs[i].fingerprint.bytes, 0, FP_SIZE);
-    recs[i].fingerprint.bytes[0] = i + 1U;
+  const int n_keys = 17;
+  auto keys = make_keys(n_keys);
+  const bl_pubkey_t* key_set[] = {keys.data(), NULL};
+  auto recs = std::vector<signature_rec_t>();
+  for (int i = 0; i < n_keys; ++i) {
+    recs.push_back(make_rec(keys[i]));
   }
 
   // Valid
-  REQUIRE(check_duplicating_signatures(recs.get(), n_recs));
+  REQUIRE(check_dups(key_set, recs));
 
   // Invalid parameters
-  REQUIRE_FALSE(check_duplicating_signatures(NULL, n_recs));
-  REQUIRE_FALSE(check_duplicating_signatures(recs.get(), 0U));
-
-  // Duplicating fingerprint, trivial example
-  recs[n_recs - 1].fingerprint.bytes[0] = recs[0].fingerprint.bytes[0];
-  REQUIRE_FALSE(check_duplicating_signatures(recs.get(), n_recs));
-  recs[n_recs - 1].fingerprint.bytes[last_fp_byte] = 1U;
-  REQUIRE(check_duplicating_signatures(recs.get(), n_recs));
-
-  // Exhaustive check of all possible combinations having a single duplication
-  for (int byte_idx = 0; byte_idx < FP_SIZE; ++byte_idx) {
-    for (int i = 0; i < n_recs; ++i) {
-      memset(recs[i].fingerprint.bytes, 0, FP_SIZE);
-      recs[i].fingerprint.bytes[byte_idx] = i + 1U;
-    }
-    for (int i = 0; i < n_recs; ++i) {
-      for (int j = 0; j < n_recs; ++j) {
-        if (j != i) {
-          fingerprint_t tmp;
-          memcpy(tmp.bytes, recs[i].fingerprint.bytes, FP_SIZE);
-          REQUIRE(check_duplicating_signatures(recs.get(), n_recs));
-          memcpy(recs[i].fingerprint.bytes, recs[j].fingerprint.bytes, FP_SIZE);
-          REQUIRE_FALSE(check_duplicating_signatures(recs.get(), n_recs));
-          memcpy(recs[i].fingerprint.bytes, tmp.bytes, FP_SIZE);
-          REQUIRE(check_duplicating_signatures(recs.get(), n_recs));
-        }
+  REQUIRE(build_key_store(key_set, NULL));
+  REQUIRE_FALSE(check_duplicating_signatures(NULL, recs.size()));
+  REQUIRE_FALSE(check_duplicating_signatures(recs.data(), 0U));
+
+  // All combinations having a single duplication
+  for (int i = 0; i < n_keys; ++i) {
+    for (int j = 0; j < n_keys; ++j) {
+      if (j != i) {
+        auto dup_recs = recs;
+        dup_recs[i].fingerprint = dup_recs[j].fingerprint;
+        REQUIRE_FALSE(check_dups(key_set, dup_recs));
       }
     }
   }
+
+  // Records made with unknown keys are ignored, even if duplicating
+  auto unknown = make_keys(2, 0x80);
+  recs.push_back(make_rec(unknown[0]));
+  recs.push_back(make_rec(unknown[1]));
+  recs.push_back(make_rec(unknown[0]));
+  REQUIRE(check_dups(key_set, recs));
+  recs.push_back(make_rec(keys[n_keys / 2]));
+  REQUIRE_FALSE(check_dups(key_set, recs));
+}
+
+/**
+ * Makes signature records with unique pseudo-random fingerprints
+ *
+ * Fingerprints share a common prefix, so that comparisons go through most of
+ * their bytes.
+ *
+ * @param n_recs  number of records
+ * @param seed    seed of pseudo-random generator
+ * @return        vector of signature records
+ */
+static std::vector<signature_rec_t> make_unique_recs(uint32_t n_recs,
+                                                     uint32_t seed) {
+  std::vector<signature_rec_t> recs(n_recs);
+  uint32_t state = seed;
+  for (uint32_t i = 0U; i < n_recs; ++i) {
+    memset(&recs[i], 0xA5, sizeof(recs[i]));
+    state = state * 1664525U + 1013904223U;
+    memcpy(&recs[i].fingerprint.bytes[FP_SIZE - 8U], &state, sizeof(state));
+    memcpy(&recs[i].fingerprint.bytes[FP_SIZE - 4U], &i, sizeof(i));
+  }
+  return recs;
+}
+
+TEST_CASE("Check duplicating signatures in a large section") {
+  const uint32_t n_recs = 512U;
+  auto keys = make_keys(BLSIG_MAX_PUBKEYS);
+  const bl_pubkey_t* key_set[] = {keys.data(), NULL};
+  // Records with unknown keys, one record for each known key in between
+  auto recs = make_unique_recs(n_recs, 12345U);
+  const uint32_t step = n_recs / BLSIG_MAX_PUBKEYS;
+  for (uint32_t i = 0U; i < BLSIG_MAX_PUBKEYS; ++i) {
+    recs[i * step + step / 2U] = make_rec(keys[i]);
+  }
+  REQUIRE(check_dups(key_set, recs));
+
+  // Duplicate in different positions, including first and last records
+  const uint32_t pairs[][2] = {{0U, step / 2U},
+                               {n_recs - 1U, n_recs - step / 2U},
+                               {n_recs / 2U, step / 2U},
+                               {1U, n_recs - step / 2U}};
+  for (const auto& pair : pairs) {
+    auto dup_recs = recs;
+    dup_recs[pair[0]].fingerprint = dup_recs[pair[1]].fingerprint;
+    REQUIRE_FALSE(check_dups(key_set, dup_recs));
+  }
+
+  // Records are not modified by the check
+  auto copy = recs;
+  REQUIRE(check_dups(key_set, recs));
+  REQUIRE(0 == memcmp(copy.data(), recs.data(),
+                      n_recs * sizeof(signature_rec_t)));
 }
 
 TEST_CASE("Public key fingerprint") {
@@ -221,25 +371,156 @@ TEST_CASE("Public key fingerprint") {
   REQUIRE_FALSE(memeq(fp.bytes, ref_pubkey_fp_bytes, FP_SIZE));
 }
 
-TEST_CASE("Find public key by fingerprint") {
-  const int n_keys = 23U;
+TEST_CASE("Build public key store") {
+  const int n_keys = 23;
+  auto keys = make_keys(n_keys);
+  const bl_pubkey_t* key_set[] = {keys.data(), NULL};
+
+  // Every key is found in the store: a second record with the key duplicates
+  for (int i = 0; i < n_keys; ++i) {
+    REQUIRE_FALSE(check_dups(key_set, {make_rec(keys[i]), make_rec(keys[i])}));
+  }
+  auto unknown = make_keys(1, 0xEE);
+  REQUIRE(check_dups(key_set, {make_rec(unknown[0]), make_rec(unknown[0])}));
+
+  // Limited number of distinct keys, a key repeated in another list is stored
+  // once
+  auto many_keys = make_keys(BLSIG_MAX_PUBKEYS);
+  auto more_keys = make_keys(1, 0xF0);
+  std::vector<bl_pubkey_t> repeated = {many_keys[0], BL_PUBKEY_END_OF_LIST};
+  const bl_pubkey_t* full_set[] = {many_keys.data(), repeated.data(), NULL};
+  const bl_pubkey_t* over_set[] = {many_keys.data(), more_keys.data(), NULL};
+  REQUIRE(build_key_store(full_set, NULL));
+  REQUIRE_FALSE(build_key_store(over_set, NULL));
+
+  // Invalid arguments
+  REQUIRE_FALSE(build_key_store(NULL, NULL));
+  bl_pubkey_index_t bad_index = {NULL, 1U};
+  REQUIRE_FALSE(build_key_store(key_set, &bad_index));
+}
+
+/**
+ * Creates a sorted index of fingerprints for all keys of a key set
+ *
+ * @param pubkey_set  NULL-terminated list of pointers to public key lists
+ * @return            index entries sorted by fingerprint
+ */
+static std::vector<bl_pubkey_index_entry_t> make_index(
+    const bl_pubkey_t** pubkey_set) {
+  std::vector<bl_pubkey_index_entry_t> entries;
+  for (const bl_pubkey_t** p_list = pubkey_set; *p_list; ++p_list) {
+    for (const bl_pubkey_t* p_key = *p_list; !bl_pubkey_is_end_record(p_key);
+         ++p_key) {
+      fingerprint_t fp;
+      pubkey_fingerprint(&fp, p_key);
+      bl_pubkey_index_entry_t entry;
+      memcpy(entry.fingerprint, fp.bytes, FP_SIZE);
+      entry.p_pubkey = p_key;
+      entries.push_back(entry);
+    }
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const bl_pubkey_index_entry_t& a,
+                      const bl_pubkey_index_entry_t& b) {
+                     return memcmp(a.fingerprint, b.fingerprint, FP_SIZE) < 0;
+                   });
+  return entries;
+}
+
+TEST_CASE("Build public key store using fingerprint index") {
+  const int n_keys = 23;
+  auto keys = make_keys(n_keys);
+  // Second list repeats one of the keys of the first list
+  bl_pubkey_t keys2[] = {keys[5], BL_PUBKEY_END_OF_LIST};
+  const bl_pubkey_t* all_set[] = {keys.data(), keys2, NULL};
+  const bl_pubkey_t* second_set[] = {keys2, NULL};
+  auto entries = make_index(all_set);
+  bl_pubkey_index_t index = {entries.data(), entries.size()};
+
+  for (int i = 0; i < n_keys; ++i) {
+    REQUIRE(build_key_store(all_set, &index));
+    auto recs = std::vector<signature_rec_t>({make_rec(keys[i])});
+    REQUIRE(check_duplicating_signatures(recs.data(), recs.size()));
+    REQUIRE_FALSE(check_duplicating_signatures(recs.data(), recs.size()));
+  }
+
+  // Only keys from the given key set are stored
+  auto recs = std::vector<signature_rec_t>({make_rec(keys[5]),
+                                            make_rec(keys[6]),
+                                            make_rec(keys[6])});
+  REQUIRE(build_key_store(second_set, &index));
+  REQUIRE(check_duplicating_signatures(recs.data(), recs.size()));
+  recs.push_back(make_rec(keys2[0]));
+  REQUIRE(build_key_store(second_set, &index));
+  REQUIRE_FALSE(check_duplicating_signatures(recs.data(), recs.size()));
+}
+
+TEST_CASE("Check fingerprint index") {
+  const int n_keys = 11U;
   auto keys = std::make_unique<bl_pubkey_t[]>(n_keys + 1U);
   for (int i = 0; i < n_keys; ++i) {
     memset(keys[i].bytes, i + 1U, sizeof(keys[i].bytes));
   }
   keys[n_keys] = BL_PUBKEY_END_OF_LIST;
-  const bl_pubkey_t* key_set[] = {keys.get(), NULL};
+  bl_pubkey_t keys2[] = {keys[0], BL_PUBKEY_END_OF_LIST};
+  const bl_pubkey_t* key_set[] = {keys.get(), keys2, NULL};
+  const auto ref_entries = make_index(key_set);
 
-  for (int i = 0; i < n_keys; ++i) {
-    fingerprint_t fp;
-    pubkey_fingerprint(&fp, &keys[i]);
-    const bl_pubkey_t* p_found_key = find_pubkey(key_set, &fp);
-    REQUIRE(p_found_key == &keys[i]);
+  SECTION("valid") {
+    bl_pubkey_index_t index = {ref_entries.data(), ref_entries.size()};
+    REQUIRE(blsig_check_pubkey_index(key_set, &index));
+    const bl_pubkey_t* empty_set[] = {NULL};
+    bl_pubkey_index_t empty_index = {NULL, 0U};
+    REQUIRE(blsig_check_pubkey_index(empty_set, &empty_index));
   }
 
-  fingerprint_t fp;
-  memset(fp.bytes, 0xEE, sizeof(fp.bytes));
-  REQUIRE(NULL == find_pubkey(key_set, &fp));
+  SECTION("invalid arguments") {
+    bl_pubkey_index_t index = {ref_entries.data(), ref_entries.size()};
+    REQUIRE_FALSE(blsig_check_pubkey_index(NULL, &index));
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, NULL));
+    index.entries = NULL;
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
+
+  SECTION("missing entry") {
+    bl_pubkey_index_t index = {ref_entries.data(), ref_entries.size() - 1U};
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
+
+  SECTION("not sorted") {
+    auto entries = ref_entries;
+    std::swap(entries[3], entries[4]);
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
+
+  SECTION("wrong fingerprint") {
+    auto entries = ref_entries;
+    entries[5].fingerprint[FP_SIZE - 1U] ^= 1U;
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
+
+  SECTION("duplicating entry") {
+    auto entries = ref_entries;
+    for (size_t i = 0U; i + 1U < entries.size(); ++i) {
+      if (0 == memcmp(entries[i].fingerprint, entries[i + 1U].fingerprint,
+                      FP_SIZE)) {
+        // Same key in two lists: both entries point to the same record
+        entries[i + 1U].p_pubkey = entries[i].p_pubkey;
+      }
+    }
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
+
+  SECTION("key outside of key set") {
+    auto entries = ref_entries;
+    bl_pubkey_t foreign_key = *entries[2].p_pubkey;
+    entries[2].p_pubkey = &foreign_key;
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE_FALSE(blsig_check_pubkey_index(key_set, &index));
+  }
 }
 
 TEST_CASE("Verify signature") {
@@ -281,12 +562,23 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, ref_message_str,
-        REF_MESSAGE_LEN, 12345U);
+        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 12345U);
     REQUIRE(REF_N_SIGS == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
 
+  SECTION("valid, using fingerprint index") {
+    auto entries = make_index(ref_multisig_pubkeys);
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE(blsig_check_pubkey_index(ref_multisig_pubkeys, &index));
+    int32_t valid_sigs = blsig_verify_multisig(
+        "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
+        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, &index,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(REF_N_SIGS == valid_sigs);
+  }
+
   SECTION("valid, 2 public key lists") {
     REQUIRE(REF_N_PUBKEYS >= 3);
     auto list1 = std::vector<bl_pubkey_t>(
@@ -299,8 +591,8 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        12345U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 12345U);
     REQUIRE(3 == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
@@ -319,8 +611,8 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        12345U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 12345U);
     REQUIRE(3 == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
@@ -336,8 +628,8 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        12345U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 12345U);
     REQUIRE(3 == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
@@ -355,8 +647,8 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        12345U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 12345U);
     REQUIRE(3 == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
@@ -369,8 +661,8 @@ TEST_CASE("Verify multiple signatures") {
     ProgressMonitor monitor(12345U);
     int32_t valid_sigs = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        12345U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 12345U);
     REQUIRE(0 == valid_sigs);
     REQUIRE(monitor.is_complete());
   }
@@ -379,8 +671,8 @@ TEST_CASE("Verify multiple signatures") {
     const bl_pubkey_t* pubkeys[] = {NULL};
     int32_t result = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), pubkeys, ref_message_str, REF_MESSAGE_LEN,
-        0U);
+        sizeof(ref_multisig_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 0U);
     REQUIRE(0 == result);
   }
 
@@ -388,33 +680,35 @@ TEST_CASE("Verify multiple signatures") {
     REQUIRE(blsig_err_bad_arg ==
             blsig_verify_multisig(
                 "secp256k1-sha256", NULL, sizeof(ref_multisig_sigrecs),
-                ref_multisig_pubkeys, ref_message_str, REF_MESSAGE_LEN, 0U));
+                ref_multisig_pubkeys, NULL, ref_message_str, REF_MESSAGE_LEN,
+                0U));
     REQUIRE(blsig_err_bad_arg ==
             blsig_verify_multisig(
                 "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs, 0U,
-                ref_multisig_pubkeys, ref_message_str, REF_MESSAGE_LEN, 0U));
+                ref_multisig_pubkeys, NULL, ref_message_str, REF_MESSAGE_LEN,
+                0U));
     REQUIRE(blsig_err_bad_arg ==
             blsig_verify_multisig("secp256k1-sha256",
                                   (const uint8_t*)ref_multisig_sigrecs,
-                                  sizeof(ref_multisig_sigrecs), NULL,
+                                  sizeof(ref_multisig_sigrecs), NULL, NULL,
                                   ref_message_str, REF_MESSAGE_LEN, 0U));
     REQUIRE(blsig_err_bad_arg ==
             blsig_verify_multisig(
                 "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-                sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL,
+                sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL, NULL,
                 REF_MESSAGE_LEN, 0U));
     REQUIRE(blsig_err_bad_arg ==
             blsig_verify_multisig(
                 "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
-                sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys,
+                sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL,
                 ref_message_str, 0U, 0U));
   }
 
   SECTION("unsupported algorithm") {
     int32_t result = blsig_verify_multisig(
         "secp256k1-sha2566", (const uint8_t*)ref_multisig_sigrecs,
-        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, ref_message_str,
-        REF_MESSAGE_LEN, 0U);
+        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
     REQUIRE(blsig_err_algo_not_supported == result);
   }
 
@@ -428,16 +722,16 @@ TEST_CASE("Verify multiple signatures") {
     recs.push_back(recs[0]);
     result = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)recs.data(),
-        recs.size() * sizeof(recs[0]), ref_multisig_pubkeys, ref_message_str,
-        REF_MESSAGE_LEN, 0U);
+        recs.size() * sizeof(recs[0]), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
     REQUIRE(blsig_err_duplicating_sig == result);
 
     // Try again without the last record, it should pass
     recs.pop_back();
     result = blsig_verify_multisig(
         "secp256k1-sha256", (const uint8_t*)recs.data(),
-        recs.size() * sizeof(recs[0]), ref_multisig_pubkeys, ref_message_str,
-        REF_MESSAGE_LEN, 0U);
+        recs.size() * sizeof(recs[0]), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
     REQUIRE(REF_N_SIGS == result);
   }
 
@@ -450,10 +744,63 @@ TEST_CASE("Verify multiple signatures") {
     REQUIRE(blsig_err_verification_fail ==
             blsig_verify_multisig(
                 "secp256k1-sha256", (const uint8_t*)recs.data(),
-                recs.size() * sizeof(recs[0]), ref_multisig_pubkeys,
+                recs.size() * sizeof(recs[0]), ref_multisig_pubkeys, NULL,
+                ref_message_str, REF_MESSAGE_LEN, 0U));
+  }
+
+  SECTION("public key modified between calls") {
+    // Parsed keys are not kept between calls, so a key modified in place is
+    // parsed again even if its fingerprint is taken from an unchanged index
+    auto list = std::vector<bl_pubkey_t>(
+        ref_multisig_pubkey_list, ref_multisig_pubkey_list + REF_N_PUBKEYS);
+    list.push_back(BL_PUBKEY_END_OF_LIST);
+    const bl_pubkey_t* pubkeys[] = {list.data(), NULL};
+    auto entries = make_index(pubkeys);
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    REQUIRE(REF_N_SIGS ==
+            blsig_verify_multisig(
+                "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
+                sizeof(ref_multisig_sigrecs), pubkeys, &index,
+                ref_message_str, REF_MESSAGE_LEN, 0U));
+    list[0].bytes[1] ^= 1U;
+    REQUIRE(blsig_err_verification_fail ==
+            blsig_verify_multisig(
+                "secp256k1-sha256", (const uint8_t*)ref_multisig_sigrecs,
+                sizeof(ref_multisig_sigrecs), pubkeys, &index,
                 ref_message_str, REF_MESSAGE_LEN, 0U));
   }
 
+  SECTION("invalid public key in key set") {
+    // X coordinate above the field size, the key fails to parse
+    bl_pubkey_t bad_key;
+    memset(bad_key.bytes, 0xFF, sizeof(bad_key.bytes));
+    bad_key.bytes[0] = 0x04U;
+    auto list = std::vector<bl_pubkey_t>(
+        ref_multisig_pubkey_list, ref_multisig_pubkey_list + REF_N_PUBKEYS);
+    list.push_back(bad_key);
+    list.push_back(BL_PUBKEY_END_OF_LIST);
+    const bl_pubkey_t* pubkeys[] = {list.data(), NULL};
+
+    // Keys are parsed only when used, an unused invalid key does no harm
+    auto recs = std::vector<signature_rec_t>(ref_multisig_sigrecs,
+                                             ref_multisig_sigrecs + REF_N_SIGS);
+    REQUIRE(REF_N_SIGS ==
+            blsig_verify_multisig(
+                "secp256k1-sha256", (const uint8_t*)recs.data(),
+                recs.size() * sizeof(recs[0]), pubkeys, NULL, ref_message_str,
+                REF_MESSAGE_LEN, 0U));
+
+    // A record made with the invalid key fails verification
+    signature_rec_t bad_rec = recs[0];
+    pubkey_fingerprint(&bad_rec.fingerprint, &bad_key);
+    recs.push_back(bad_rec);
+    REQUIRE(blsig_err_verification_fail ==
+            blsig_verify_multisig(
+                "secp256k1-sha256", (const uint8_t*)recs.data(),
+                recs.size() * sizeof(recs[0]), pubkeys, NULL, ref_message_str,
+                REF_MESSAGE_LEN, 0U));
+  }
+
   SECTION("additional inert signatures") {
     // Create a list of Signature records with additional inert records
     auto recs = std::vector<signature_rec_t>();
@@ -468,10 +815,341 @@ TEST_CASE("Verify multiple signatures") {
     REQUIRE(REF_N_SIGS == blsig_verify_multisig(
                               "secp256k1-sha256", (const uint8_t*)recs.data(),
                               recs.size() * sizeof(recs[0]),
-                              ref_multisig_pubkeys, ref_message_str,
+                              ref_multisig_pubkeys, NULL, ref_message_str,
                               REF_MESSAGE_LEN, 0U));
   }
 }
+/**
+ * Verifies a Signature section passing its payload in chunks
+ *
+ * @param algorithm   string, identifying signature algorithm
+ * @param payload     payload of the Signature section
+ * @param size        size of payload in bytes
+ * @param chunk_size  size of chunks passed to blsig_stream_update()
+ * @param progr_arg   argument passed to progress callback function
+ * @return            result returned by blsig_stream_end()
+ */
+static int32_t verify_stream(const char* algorithm, const void* payload,
+                             size_t size, size_t chunk_size,
+                             bl_cbarg_t progr_arg = 0U) {
+  int32_t res =
+      blsig_stream_begin(algorithm, size, ref_multisig_pubkeys, NULL,
+                         ref_message_str, REF_MESSAGE_LEN, progr_arg);
+  if (res >= 0) {
+    const uint8_t* p_data = (const uint8_t*)payload;
+    for (size_t offset = 0U; offset < size; offset += chunk_size) {
+      size_t len = std::min(chunk_size, size - offset);
+      if (!blsig_stream_update(p_data + offset, len)) {
+        break;
+      }
+    }
+  }
+  return blsig_stream_end();
+}
+
+TEST_CASE("Verify multiple signatures in stream") {
+  SECTION("valid, different chunk sizes") {
+    const size_t chunk_sizes[] = {1U, 7U, sizeof(signature_rec_t),
+                                  sizeof(signature_rec_t) + 1U,
+                                  sizeof(ref_multisig_sigrecs)};
+    for (size_t chunk_size : chunk_sizes) {
+      ProgressMonitor monitor(12345U);
+      REQUIRE(REF_N_SIGS == verify_stream("secp256k1-sha256",
+                                          ref_multisig_sigrecs,
+                                          sizeof(ref_multisig_sigrecs),
+                                          chunk_size, 12345U));
+      REQUIRE(monitor.is_complete());
+      REQUIRE(REF_N_SIGS == verify_stream("secp256k1-schnorr-sha256",
+                                          ref_schnorr_sigrecs,
+                                          sizeof(ref_schnorr_sigrecs),
+                                          chunk_size));
+    }
+  }
+
+  SECTION("number of records is not limited") {
+    auto recs = make_unique_recs(1000U, 54321U);
+    for (uint32_t i = 0U; i < REF_N_SIGS; ++i) {
+      recs[100U * i + 50U] = ref_multisig_sigrecs[i];
+    }
+    REQUIRE(REF_N_SIGS == verify_stream("secp256k1-sha256", recs.data(),
+                                        recs.size() * sizeof(recs[0]), 333U));
+  }
+
+  SECTION("duplicating record with unknown key is ignored") {
+    auto recs = make_unique_recs(3U, 54321U);
+    recs.push_back(recs[1]);
+    REQUIRE(0 == verify_stream("secp256k1-sha256", recs.data(),
+                               recs.size() * sizeof(recs[0]), 50U));
+  }
+
+  SECTION("duplicating signature with known key") {
+    auto recs = std::vector<signature_rec_t>(ref_multisig_sigrecs,
+                                             ref_multisig_sigrecs + REF_N_SIGS);
+    recs.push_back(recs[0]);
+    REQUIRE(blsig_err_duplicating_sig ==
+            verify_stream("secp256k1-sha256", recs.data(),
+                          recs.size() * sizeof(recs[0]), 50U));
+  }
+
+  SECTION("duplicating signature after invalid signature") {
+    auto recs = std::vector<signature_rec_t>(ref_multisig_sigrecs,
+                                             ref_multisig_sigrecs + REF_N_SIGS);
+    recs[0].signature.bytes[5] ^= 1U;
+    recs.push_back(recs[1]);
+    const size_t size = recs.size() * sizeof(recs[0]);
+    REQUIRE(blsig_err_duplicating_sig ==
+            verify_stream("secp256k1-sha256", recs.data(), size, 50U));
+    REQUIRE(blsig_err_duplicating_sig ==
+            blsig_verify_multisig("secp256k1-sha256",
+                                  (const uint8_t*)recs.data(), size,
+                                  ref_multisig_pubkeys, NULL, ref_message_str,
+                                  REF_MESSAGE_LEN, 0U));
+  }
+
+  SECTION("size mismatch") {
+    const size_t size = sizeof(ref_multisig_sigrecs);
+    // Not a multiple of record size
+    REQUIRE(blsig_err_bad_arg ==
+            blsig_stream_begin("secp256k1-sha256", size - 1U,
+                               ref_multisig_pubkeys, NULL, ref_message_str,
+                               REF_MESSAGE_LEN, 0U));
+    REQUIRE(blsig_err_bad_arg == blsig_stream_end());
+
+    // Incomplete payload
+    REQUIRE(0 == blsig_stream_begin("secp256k1-sha256", size,
+                                    ref_multisig_pubkeys, NULL,
+                                    ref_message_str, REF_MESSAGE_LEN, 0U));
+    REQUIRE(blsig_stream_update((const uint8_t*)ref_multisig_sigrecs, 1U));
+    REQUIRE(blsig_err_bad_arg == blsig_stream_end());
+
+    // Excessive payload
+    auto recs = make_unique_recs(2U, 1U);
+    REQUIRE(0 == blsig_stream_begin("secp256k1-sha256", sizeof(recs[0]),
+                                    ref_multisig_pubkeys, NULL,
+                                    ref_message_str, REF_MESSAGE_LEN, 0U));
+    REQUIRE_FALSE(blsig_stream_update((const uint8_t*)recs.data(),
+                                      2U * sizeof(recs[0])));
+    REQUIRE(blsig_err_bad_arg == blsig_stream_end());
+  }
+
+  SECTION("verification not in progress") {
+    auto recs = make_unique_recs(1U, 1U);
+    REQUIRE(0 == verify_stream("secp256k1-sha256", recs.data(),
+                               sizeof(recs[0]), sizeof(recs[0])));
+    REQUIRE_FALSE(
+        blsig_stream_update((const uint8_t*)recs.data(), sizeof(recs[0])));
+    REQUIRE(blsig_err_bad_arg == blsig_stream_end());
+  }
+}
+
+TEST_CASE("Verify multiple signatures, same result as sequential") {
+  // With BLSIG_PARALLEL_WORKERS above 1 blsig_verify_multisig() verifies
+  // records in parallel, streaming verification is always sequential
+  struct {
+    const char* algorithm;
+    const signature_rec_t* sigrecs;
+  } cases[] = {{"secp256k1-sha256", ref_multisig_sigrecs},
+               {"secp256k1-schnorr-sha256", ref_schnorr_sigrecs}};
+  for (const auto& c : cases) {
+    // Valid signatures mixed with records having unknown keys
+    auto recs = make_unique_recs(2U * REF_N_SIGS + 3U, 777U);
+    for (int i = 0; i < REF_N_SIGS; ++i) {
+      recs[2U * i + 1U] = c.sigrecs[i];
+    }
+    const size_t size = recs.size() * sizeof(recs[0]);
+    int32_t expected = verify_stream(c.algorithm, recs.data(), size, size);
+    REQUIRE(expected == blsig_verify_multisig(
+                            c.algorithm, (const uint8_t*)recs.data(), size,
+                            ref_multisig_pubkeys, NULL, ref_message_str,
+                            REF_MESSAGE_LEN, 0U));
+
+    // Corrupted signature in every position, alone and followed by a
+    // duplicating record
+    for (size_t idx = 0U; idx < recs.size(); ++idx) {
+      auto bad_recs = recs;
+      bad_recs[idx].signature.bytes[5] ^= 1U;
+      expected = verify_stream(c.algorithm, bad_recs.data(), size, size);
+      REQUIRE(expected == blsig_verify_multisig(
+                              c.algorithm, (const uint8_t*)bad_recs.data(),
+                              size, ref_multisig_pubkeys, NULL,
+                              ref_message_str, REF_MESSAGE_LEN, 0U));
+      bad_recs.push_back(c.sigrecs[REF_N_SIGS - 1]);
+      const size_t dup_size = bad_recs.size() * sizeof(bad_recs[0]);
+      REQUIRE(blsig_err_duplicating_sig ==
+              verify_stream(c.algorithm, bad_recs.data(), dup_size, dup_size));
+      REQUIRE(blsig_err_duplicating_sig ==
+              blsig_verify_multisig(
+                  c.algorithm, (const uint8_t*)bad_recs.data(), dup_size,
+                  ref_multisig_pubkeys, NULL, ref_message_str,
+                  REF_MESSAGE_LEN, 0U));
+    }
+  }
+}
+
+TEST_CASE("Verify multiple Schnorr signatures") {
+  SECTION("valid") {
+    ProgressMonitor monitor(12345U);
+    int32_t valid_sigs = blsig_verify_multisig(
+        "secp256k1-schnorr-sha256", (const uint8_t*)ref_schnorr_sigrecs,
+        sizeof(ref_schnorr_sigrecs), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 12345U);
+    REQUIRE(REF_N_SIGS == valid_sigs);
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("valid, using fingerprint index") {
+    auto entries = make_index(ref_multisig_pubkeys);
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    int32_t valid_sigs = blsig_verify_multisig(
+        "secp256k1-schnorr-sha256", (const uint8_t*)ref_schnorr_sigrecs,
+        sizeof(ref_schnorr_sigrecs), ref_multisig_pubkeys, &index,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(REF_N_SIGS == valid_sigs);
+  }
+
+  SECTION("valid, some keys are unknown") {
+    auto list = std::vector<bl_pubkey_t>(
+        {ref_multisig_pubkey_list[1], BL_PUBKEY_END_OF_LIST});
+    const bl_pubkey_t* pubkeys[] = {list.data(), NULL};
+    int32_t valid_sigs = blsig_verify_multisig(
+        "secp256k1-schnorr-sha256", (const uint8_t*)ref_schnorr_sigrecs,
+        sizeof(ref_schnorr_sigrecs), pubkeys, NULL, ref_message_str,
+        REF_MESSAGE_LEN, 0U);
+    REQUIRE(1 == valid_sigs);
+  }
+
+  SECTION("signatures made with another algorithm") {
+    int32_t res = blsig_verify_multisig(
+        "secp256k1-schnorr-sha256", (const uint8_t*)ref_multisig_sigrecs,
+        sizeof(ref_multisig_sigrecs), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+    res = blsig_verify_multisig(
+        "secp256k1-sha256", (const uint8_t*)ref_schnorr_sigrecs,
+        sizeof(ref_schnorr_sigrecs), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+  }
+
+  SECTION("one of signatures is corrupted") {
+    for (size_t rec = 0U; rec < REF_N_SIGS; ++rec) {
+      for (size_t byte : {0U, 31U, 32U, 63U}) {
+        auto sigrecs = std::vector<signature_rec_t>(
+            ref_schnorr_sigrecs, ref_schnorr_sigrecs + REF_N_SIGS);
+        sigrecs[rec].signature.bytes[byte] ^= 1U;
+        int32_t res = blsig_verify_multisig(
+            "secp256k1-schnorr-sha256", (const uint8_t*)sigrecs.data(),
+            sigrecs.size() * sizeof(signature_rec_t), ref_multisig_pubkeys,
+            NULL, ref_message_str, REF_MESSAGE_LEN, 0U);
+        REQUIRE(blsig_err_verification_fail == res);
+      }
+    }
+  }
+
+  SECTION("wrong message") {
+    auto msg = std::vector<uint8_t>(ref_message_str,
+                                    ref_message_str + REF_MESSAGE_LEN);
+    msg[0] ^= 1U;
+    int32_t res = blsig_verify_multisig(
+        "secp256k1-schnorr-sha256", (const uint8_t*)ref_schnorr_sigrecs,
+        sizeof(ref_schnorr_sigrecs), ref_multisig_pubkeys, NULL, msg.data(),
+        msg.size(), 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+  }
+}
+
+TEST_CASE("Verify MuSig2 aggregated signature") {
+  const char* algorithm = "secp256k1-musig2-sha256";
+  auto section = std::vector<uint8_t>(
+      (const uint8_t*)&ref_musig_section,
+      (const uint8_t*)&ref_musig_section + sizeof(ref_musig_section));
+  const size_t sig_size = sizeof(signature_t);
+  const size_t fp_size = sizeof(fingerprint_t);
+
+  SECTION("valid") {
+    ProgressMonitor monitor(12345U);
+    int32_t valid_sigs = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 12345U);
+    REQUIRE(REF_N_SIGS == valid_sigs);
+    REQUIRE(monitor.is_complete());
+  }
+
+  SECTION("valid, using fingerprint index") {
+    auto entries = make_index(ref_multisig_pubkeys);
+    bl_pubkey_index_t index = {entries.data(), entries.size()};
+    int32_t valid_sigs = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys,
+        &index, ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(REF_N_SIGS == valid_sigs);
+  }
+
+  SECTION("one of signers is unknown") {
+    auto list = std::vector<bl_pubkey_t>({ref_multisig_pubkey_list[0],
+                                          ref_multisig_pubkey_list[1],
+                                          BL_PUBKEY_END_OF_LIST});
+    const bl_pubkey_t* pubkeys[] = {list.data(), NULL};
+    int32_t res = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+  }
+
+  SECTION("one of signers is removed") {
+    section.resize(section.size() - fp_size);
+    int32_t res = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+  }
+
+  SECTION("duplicating signer") {
+    memcpy(&section[sig_size + fp_size], &section[sig_size], fp_size);
+    int32_t res = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_duplicating_sig == res);
+  }
+
+  SECTION("signers are not sorted") {
+    std::swap_ranges(&section[sig_size], &section[sig_size + fp_size],
+                     &section[sig_size + fp_size]);
+    int32_t res = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys, NULL,
+        ref_message_str, REF_MESSAGE_LEN, 0U);
+    REQUIRE(blsig_err_bad_arg == res);
+  }
+
+  SECTION("invalid size of section") {
+    for (size_t size : {sig_size, sig_size + fp_size - 1U, fp_size * 4U}) {
+      int32_t res = blsig_verify_multisig(
+          algorithm, section.data(), size, ref_multisig_pubkeys, NULL,
+          ref_message_str, REF_MESSAGE_LEN, 0U);
+      REQUIRE(blsig_err_bad_arg == res);
+    }
+  }
+
+  SECTION("signature is corrupted") {
+    for (size_t byte : {0U, 31U, 32U, 63U}) {
+      auto corrupted = section;
+      corrupted[byte] ^= 1U;
+      int32_t res = blsig_verify_multisig(
+          algorithm, corrupted.data(), corrupted.size(), ref_multisig_pubkeys,
+          NULL, ref_message_str, REF_MESSAGE_LEN, 0U);
+      REQUIRE(blsig_err_verification_fail == res);
+    }
+  }
+
+  SECTION("wrong message") {
+    auto msg = std::vector<uint8_t>(ref_message_str,
+                                    ref_message_str + REF_MESSAGE_LEN);
+    msg[0] ^= 1U;
+    int32_t res = blsig_verify_multisig(
+        algorithm, section.data(), section.size(), ref_multisig_pubkeys, NULL,
+        msg.data(), msg.size(), 0U);
+    REQUIRE(blsig_err_verification_fail == res);
+  }
+}
 
 TEST_CASE("Signatures: error text") {
   auto errors = std::vector<const char*>();
@@ -507,3 +1185,124 @@ TEST_CASE("Signatures: error text") {
   auto i_dup = std::adjacent_find(errors.begin(), errors.end());
   REQUIRE(i_dup == errors.end());
 }
+
+/**
+ * Measures average execution time of a function
+ *
+ * @param n_iter  number of iterations
+ * @param func    measured function
+ * @return        average time of one call in microseconds
+ */
+template <typename F>
+static double measure_us(int n_iter, F func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_iter; ++i) {
+    func();
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / n_iter;
+}
+
+// Hidden test case, run with: test_runner "[benchmark]". To compare window
+// sizes, build unit tests with different ECMULT_WINDOW_SIZE and ECMULT_STATIC.
+TEST_CASE("Benchmark signature verification", "[.][benchmark]") {
+  const int n_iter = 100;
+  auto msg =
+      std::vector<uint8_t>(ref_message_str, ref_message_str + REF_MESSAGE_LEN);
+  signature_t sig;
+  memcpy(sig.bytes, ref_signature, sizeof(sig.bytes));
+
+  double ctx_us = measure_us(n_iter, [] {
+    VerifyContext ctx;
+    REQUIRE(static_cast<secp256k1_context*>(ctx) != NULL);
+  });
+  auto ctx = VerifyContext();
+  double ecdsa_us = measure_us(n_iter, [&] {
+    REQUIRE(verify_signature(ctx, &sig, msg.data(), msg.size(), &ref_pubkey));
+  });
+  double multisig_us = measure_us(n_iter, [] {
+    REQUIRE(REF_N_SIGS == blsig_verify_multisig(
+                              "secp256k1-sha256",
+                              (const uint8_t*)ref_multisig_sigrecs,
+                              sizeof(ref_multisig_sigrecs),
+                              ref_multisig_pubkeys, NULL, ref_message_str,
+                              REF_MESSAGE_LEN, 12345U));
+  });
+  double schnorr_us = measure_us(n_iter, [] {
+    REQUIRE(REF_N_SIGS == blsig_verify_multisig(
+                              "secp256k1-schnorr-sha256",
+                              (const uint8_t*)ref_schnorr_sigrecs,
+                              sizeof(ref_schnorr_sigrecs),
+                              ref_multisig_pubkeys, NULL, ref_message_str,
+                              REF_MESSAGE_LEN, 12345U));
+  });
+
+#ifdef BL_ECMULT_STATIC_TABLES
+  const char* table_location = "static";
+#else
+  const char* table_location = "context";
+#endif
+  std::printf(
+      "ecmult window %d, %u-byte table in %s, context buffer %u bytes\n"
+      "  create context:          %10.1f us\n"
+      "  verify ECDSA:            %10.1f us\n"
+      "  verify 3 ECDSA records:  %10.1f us\n"
+      "  verify 3 Schnorr (batch):%10.1f us\n",
+      BL_ECMULT_WINDOW_SIZE, 64U << (BL_ECMULT_WINDOW_SIZE - 2),
+      table_location, (unsigned)BLSIG_ECDSA_BUF_SIZE, ctx_us, ecdsa_us,
+      multisig_us, schnorr_us);
+}
+
+/**
+ * Reference implementation of duplicate check comparing all pairs of records
+ *
+ * @param sig_recs  buffer containing signature records
+ * @param n_sig     number of signature records
+ * @return          true if there is no duplicating signatures
+ */
+static bool check_duplicating_signatures_pairwise(
+    const signature_rec_t* sig_recs, uint32_t n_sig) {
+  for (uint32_t ref = 0U; ref + 1U < n_sig; ++ref) {
+    for (uint32_t check = ref + 1U; check < n_sig; ++check) {
+      if (memeq(sig_recs[ref].fingerprint.bytes,
+                sig_recs[check].fingerprint.bytes, FP_SIZE)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Hidden test case, run with: test_runner "[benchmark]". The key store holds
+// BLSIG_MAX_PUBKEYS keys, each used by one of the records.
+TEST_CASE("Benchmark duplicate signature check", "[.][benchmark]") {
+  const uint32_t sizes[] = {32U, 128U, 512U};
+  const int n_iter = 200;
+  auto keys = make_keys(BLSIG_MAX_PUBKEYS);
+  const bl_pubkey_t* key_set[] = {keys.data(), NULL};
+  auto entries = make_index(key_set);
+  bl_pubkey_index_t index = {entries.data(), entries.size()};
+
+  std::printf("duplicate check, BLSIG_MAX_PUBKEYS %u\n",
+              (unsigned)BLSIG_MAX_PUBKEYS);
+  for (uint32_t n_recs : sizes) {
+    auto recs = make_unique_recs(n_recs, n_recs);
+    for (uint32_t i = 0U; i < BLSIG_MAX_PUBKEYS && i < n_recs; ++i) {
+      recs[i * (n_recs / BLSIG_MAX_PUBKEYS)] = make_rec(keys[i]);
+    }
+    bool store_ok = true;
+    bool pairwise_ok = true;
+    double store_us = measure_us(n_iter, [&] {
+      store_ok &= build_key_store(key_set, &index) &&
+                  check_duplicating_signatures(recs.data(), n_recs);
+    });
+    double pairwise_us = measure_us(n_iter, [&] {
+      pairwise_ok &= check_duplicating_signatures_pairwise(recs.data(), n_recs);
+    });
+    REQUIRE(store_ok);
+    REQUIRE(pairwise_ok);
+    std::printf("  %4u records: key store %8.2f us, pairwise %8.2f us\n",
+                (unsigned)n_recs, store_us, pairwise_us);
+  }
+}
@@ -0,0 +1,88 @@
+/**
+ * @file       test_crc32.cpp
+ * @brief      Unit tests for CRC32 implementation
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <vector>
+#include "catch2/catch.hpp"
+extern "C" {
+#include "crc32.h"
+}
+
+/**
+ * Generates pseudo-random test data
+ *
+ * @param size  size of data
+ * @return      generated data
+ */
+static std::vector<uint8_t> make_data(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t seed = 12345U;
+  for (size_t i = 0U; i < size; ++i) {
+    seed = seed * 1103515245U + 12345U;
+    data[i] = (uint8_t)(seed >> 24);
+  }
+  return data;
+}
+
+TEST_CASE("CRC32: check value") {
+  static const char check[] = "123456789";
+  REQUIRE(crc32_fast(check, sizeof(check) - 1U, 0U) == 0xCBF43926U);
+  REQUIRE(crc32_table(check, sizeof(check) - 1U, 0U) == 0xCBF43926U);
+  REQUIRE(crc32_fast(check, 0U, 0U) == 0U);
+}
+
+TEST_CASE("CRC32: hardware kernel matches table-driven algorithm") {
+  INFO("Hardware accelerated: " << crc32_hw_accelerated());
+  std::vector<uint8_t> data = make_data(4096U + 64U);
+
+  // All alignments and lengths around folding block boundaries
+  for (size_t offset = 0U; offset < 16U; ++offset) {
+    for (size_t len = 0U; len <= 600U; ++len) {
+      const uint8_t* p = data.data() + offset;
+      REQUIRE(crc32_fast(p, len, 0U) == crc32_table(p, len, 0U));
+    }
+  }
+
+  // Large block, calculated at once and in uneven chunks
+  uint32_t ref = crc32_table(data.data(), data.size(), 0U);
+  REQUIRE(crc32_fast(data.data(), data.size(), 0U) == ref);
+  static const size_t chunks[] = {1U, 63U, 64U, 65U, 127U, 200U, 1000U};
+  for (size_t chunk : chunks) {
+    uint32_t crc = 0U;
+    for (size_t pos = 0U; pos < data.size(); pos += chunk) {
+      size_t len = std::min(chunk, data.size() - pos);
+      crc = crc32_fast(data.data() + pos, len, crc);
+    }
+    REQUIRE(crc == ref);
+  }
+}
+
+TEST_CASE("CRC32: combine and shift") {
+  std::vector<uint8_t> data = make_data(3000U);
+  uint32_t ref = crc32_table(data.data(), data.size(), 0U);
+
+  // Split at every position near the beginning and the end, and a few others
+  for (size_t pos = 0U; pos <= data.size(); ++pos) {
+    if (pos > 40U && pos < data.size() - 40U && pos % 97U) {
+      continue;
+    }
+    size_t len_b = data.size() - pos;
+    uint32_t crc_a = crc32_fast(data.data(), pos, 0U);
+    uint32_t crc_b = crc32_fast(data.data() + pos, len_b, 0U);
+    REQUIRE(crc32_combine(crc_a, crc_b, len_b) == ref);
+  }
+
+  // Shift is the same as appending zero bytes
+  std::vector<uint8_t> zeros(1025U, 0U);
+  for (size_t len : {0U, 1U, 2U, 3U, 255U, 256U, 1000U, 1025U}) {
+    uint32_t crc_a = crc32_fast(data.data(), 100U, 0U);
+    uint32_t ref_z = crc32_fast(zeros.data(), len, crc_a);
+    uint32_t crc_z = crc32_fast(zeros.data(), len, 0U);
+    REQUIRE(crc32_combine(crc_a, crc_z, len) == ref_z);
+  }
+  REQUIRE(crc32_shift(0U, 12345U) == 0U);
+  REQUIRE(crc32_shift(0x12345678U, 0U) == 0x12345678U);
+}
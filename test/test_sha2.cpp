@@ -0,0 +1,162 @@
+/**
+ * @file       test_sha2.cpp
+ * @brief      Unit tests for SHA-256 backends and multi-buffer hashing
+ * @author     Mike Tolkachev <contact@miketolkachev.dev>
+ * @copyright  Copyright 2020 Crypto Advance GmbH. All rights reserved.
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch2/catch.hpp"
+extern "C" {
+#include "sha2.h"
+}
+
+/// Digest as a vector of bytes
+typedef std::vector<uint8_t> digest_t;
+
+/**
+ * Generates pseudo-random test data
+ *
+ * @param size  size of data
+ * @param seed  initial value of generator
+ * @return      generated data
+ */
+static std::vector<uint8_t> make_data(size_t size, uint32_t seed = 12345U) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0U; i < size; ++i) {
+    seed = seed * 1103515245U + 12345U;
+    data[i] = (uint8_t)(seed >> 24);
+  }
+  return data;
+}
+
+/**
+ * Hashes data feeding it to sha256_Update() in chunks of given size
+ *
+ * @param data   data to hash
+ * @param chunk  maximum size of chunk
+ * @return       resulting digest
+ */
+static digest_t hash_chunked(const std::vector<uint8_t>& data, size_t chunk) {
+  SHA256_CTX ctx;
+  sha256_Init(&ctx);
+  for (size_t pos = 0U; pos < data.size(); pos += chunk) {
+    sha256_Update(&ctx, data.data() + pos,
+                  std::min(chunk, data.size() - pos));
+  }
+  digest_t digest(SHA256_DIGEST_LENGTH);
+  sha256_Final(&ctx, digest.data());
+  return digest;
+}
+
+/**
+ * Returns SHA-256 digest of a string as a hex string
+ *
+ * @param msg  message
+ * @return     digest as hex string
+ */
+static std::string hash_hex(const std::string& msg) {
+  char hex[SHA256_DIGEST_STRING_LENGTH];
+  sha256_Data((const uint8_t*)msg.data(), msg.size(), hex);
+  return std::string(hex);
+}
+
+TEST_CASE("SHA-256: test vectors") {
+  INFO("Backend: " << sha256_Backend());
+  for (int disable : {1, 0}) {
+    sha256_DisableHw(disable);
+    REQUIRE(hash_hex("") == "e3b0c44298fc1c149afbf4c8996fb924"
+                            "27ae41e4649b934ca495991b7852b855");
+    REQUIRE(hash_hex("abc") == "ba7816bf8f01cfea414140de5dae2223"
+                               "b00361a396177a9cb410ff61f20015ad");
+    REQUIRE(hash_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+            == "248d6a61d20638b8e5c026930c3e6039"
+               "a33ce45964ff2167f6ecedd419db06c1");
+    REQUIRE(hash_hex(std::string(1000000U, 'a')) ==
+            "cdc76e5c9914fb9281a1c7e284d73e67"
+            "f1809a48a497200e046d39ccc7112cd0");
+  }
+}
+
+TEST_CASE("SHA-256: accelerated backend matches portable code") {
+  INFO("Backend: " << sha256_Backend());
+  static const size_t chunks[] = {1U, 7U, 63U, 64U, 65U, 200U, 4096U};
+  for (size_t len = 0U; len <= 300U; len += 13U) {
+    std::vector<uint8_t> data = make_data(len);
+    sha256_DisableHw(1);
+    digest_t ref = hash_chunked(data, 64U);
+    sha256_DisableHw(0);
+    for (size_t chunk : chunks) {
+      REQUIRE(hash_chunked(data, chunk) == ref);
+    }
+  }
+
+  // Transform on host-order words, as used by callers managing padding
+  uint32_t block[16];
+  std::vector<uint8_t> data = make_data(sizeof(block));
+  memcpy(block, data.data(), sizeof(block));
+  uint32_t ref[8], out[8];
+  sha256_DisableHw(1);
+  sha256_Transform(sha256_initial_hash_value, block, ref);
+  sha256_DisableHw(0);
+  sha256_Transform(sha256_initial_hash_value, block, out);
+  REQUIRE(memcmp(ref, out, sizeof(ref)) == 0);
+}
+
+TEST_CASE("SHA-256: multi-buffer hashing") {
+  const size_t n_msgs = 21U;
+  std::vector<std::vector<uint8_t>> msgs;
+  std::vector<const uint8_t*> ptrs;
+  std::vector<size_t> lens;
+  for (size_t i = 0U; i < n_msgs; ++i) {
+    // Lengths around padding boundaries and a few multi-block messages
+    msgs.push_back(make_data(i * 29U % 150U + (i % 5U ? 0U : 1000U),
+                             (uint32_t)i));
+  }
+  for (const auto& msg : msgs) {
+    ptrs.push_back(msg.data());
+    lens.push_back(msg.size());
+  }
+
+  std::vector<digest_t> ref;
+  for (const auto& msg : msgs) {
+    ref.push_back(hash_chunked(msg, msg.size() + 1U));
+  }
+
+  // Without SHA instructions the AVX2 lanes are used if available
+  for (int disable : {1, 0}) {
+    sha256_DisableHw(disable);
+    for (size_t count : {0U, 1U, 8U, 9U, 21U}) {
+      std::vector<uint8_t> out(count * SHA256_DIGEST_LENGTH + 1U, 0xA5U);
+      sha256_RawMulti(ptrs.data(), lens.data(), count,
+                      (uint8_t(*)[SHA256_DIGEST_LENGTH])out.data());
+      for (size_t i = 0U; i < count; ++i) {
+        digest_t digest(out.begin() + i * SHA256_DIGEST_LENGTH,
+                        out.begin() + (i + 1U) * SHA256_DIGEST_LENGTH);
+        REQUIRE(digest == ref[i]);
+      }
+      REQUIRE(out.back() == 0xA5U);
+    }
+  }
+
+  // Equal lengths: all lanes complete together and must be refilled
+  std::vector<uint8_t> data = make_data(65U * 9U);
+  std::vector<const uint8_t*> eq_ptrs;
+  std::vector<size_t> eq_lens(9U, 65U);
+  for (size_t i = 0U; i < 9U; ++i) {
+    eq_ptrs.push_back(data.data() + i * 65U);
+  }
+  std::vector<uint8_t> out(9U * SHA256_DIGEST_LENGTH);
+  sha256_DisableHw(1);
+  sha256_RawMulti(eq_ptrs.data(), eq_lens.data(), 9U,
+                  (uint8_t(*)[SHA256_DIGEST_LENGTH])out.data());
+  for (size_t i = 0U; i < 9U; ++i) {
+    std::vector<uint8_t> msg(eq_ptrs[i], eq_ptrs[i] + 65U);
+    digest_t digest(out.begin() + i * SHA256_DIGEST_LENGTH,
+                    out.begin() + (i + 1U) * SHA256_DIGEST_LENGTH);
+    REQUIRE(digest == hash_chunked(msg, 64U));
+  }
+  sha256_DisableHw(0);
+}
@@ -0,0 +1,123 @@
+"""Schnorr signatures for secp256k1 as specified in BIP-340.
+
+This is a straightforward implementation following the reference code of
+BIP-340. It is not constant-time and intended only for signing upgrade files
+on a host machine and for generation of test vectors.
+"""
+
+import hashlib
+
+# Field size
+P = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F
+# Group order
+N = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141
+# Generator point
+G = (0x79BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798,
+     0x483ADA7726A3C4655DA4FBFC0E1108A8FD17B448A68554199C47D08FFB10D4B8)
+
+
+def tagged_hash(tag, msg):
+    """Returns tagged hash: SHA256(SHA256(tag) || SHA256(tag) || msg)."""
+    tag_hash = hashlib.sha256(tag.encode()).digest()
+    return hashlib.sha256(tag_hash + tag_hash + msg).digest()
+
+
+def point_add(p1, p2):
+    """Adds two points, None represents point at infinity."""
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    if p1[0] == p2[0] and p1[1] != p2[1]:
+        return None
+    if p1 == p2:
+        lam = (3 * p1[0] * p1[0] * pow(2 * p1[1], P - 2, P)) % P
+    else:
+        lam = ((p2[1] - p1[1]) * pow(p2[0] - p1[0], P - 2, P)) % P
+    x3 = (lam * lam - p1[0] - p2[0]) % P
+    return (x3, (lam * (p1[0] - x3) - p1[1]) % P)
+
+
+def point_mul(point, n):
+    """Multiplies a point by a scalar, None represents point at infinity."""
+    result = None
+    for i in range(256):
+        if (n >> i) & 1:
+            result = point_add(result, point)
+        point = point_add(point, point)
+    return result
+
+
+def _bytes_from_int(x):
+    return x.to_bytes(32, byteorder='big')
+
+
+def _int_from_bytes(b):
+    return int.from_bytes(b, byteorder='big')
+
+
+def _has_even_y(point):
+    return point[1] % 2 == 0
+
+
+def lift_x(x):
+    """Returns a point with given X coordinate and even Y, or None."""
+    if x >= P:
+        return None
+    y_sq = (pow(x, 3, P) + 7) % P
+    y = pow(y_sq, (P + 1) // 4, P)
+    if pow(y, 2, P) != y_sq:
+        return None
+    return (x, y if y & 1 == 0 else P - y)
+
+
+def pubkey_xonly(seckey):
+    """Returns 32-byte X-only public key derived from a private key."""
+    d = _int_from_bytes(seckey)
+    if not (1 <= d <= N - 1):
+        raise ValueError("Private key is out of range")
+    return _bytes_from_int(point_mul(G, d)[0])
+
+
+def sign(msg, seckey, aux_rand=bytes(32)):
+    """Signs a 32-byte message returning a 64-byte signature."""
+    if len(msg) != 32:
+        raise ValueError("Message should be 32 bytes long")
+    if len(aux_rand) != 32:
+        raise ValueError("Auxiliary random data should be 32 bytes long")
+    d0 = _int_from_bytes(seckey)
+    if not (1 <= d0 <= N - 1):
+        raise ValueError("Private key is out of range")
+    pub = point_mul(G, d0)
+    d = d0 if _has_even_y(pub) else N - d0
+    t = _bytes_from_int(d ^ _int_from_bytes(tagged_hash("BIP0340/aux",
+                                                       aux_rand)))
+    k0 = _int_from_bytes(tagged_hash("BIP0340/nonce", t +
+                                     _bytes_from_int(pub[0]) + msg)) % N
+    if k0 == 0:
+        raise RuntimeError("Failure, probability of this is negligible")
+    r = point_mul(G, k0)
+    k = k0 if _has_even_y(r) else N - k0
+    e = _int_from_bytes(tagged_hash("BIP0340/challenge", _bytes_from_int(
+        r[0]) + _bytes_from_int(pub[0]) + msg)) % N
+    sig = _bytes_from_int(r[0]) + _bytes_from_int((k + e * d) % N)
+    if not verify(sig, msg, _bytes_from_int(pub[0])):
+        raise RuntimeError("Created signature does not pass verification")
+    return sig
+
+
+def verify(sig, msg, pubkey):
+    """Verifies a 64-byte signature of a 32-byte message using 32-byte X-only
+    public key."""
+    if len(msg) != 32 or len(pubkey) != 32 or len(sig) != 64:
+        return False
+    pub = lift_x(_int_from_bytes(pubkey))
+    r = _int_from_bytes(sig[0:32])
+    s = _int_from_bytes(sig[32:64])
+    if pub is None or r >= P or s >= N:
+        return False
+    e = _int_from_bytes(tagged_hash("BIP0340/challenge", sig[0:32] + pubkey +
+                                    msg)) % N
+    point_r = point_add(point_mul(G, s), point_mul(pub, N - e))
+    return (point_r is not None and _has_even_y(point_r) and
+            point_r[0] == r)
@@ -0,0 +1,48 @@
+import pytest
+from .bip340 import *
+
+# Test vectors from BIP-340: (seckey, pubkey, aux_rand, message, signature)
+vectors = [
+    ('0000000000000000000000000000000000000000000000000000000000000003',
+     'F9308A019258C31049344F85F89D5229B531C845836F99B08601F113BCE036F9',
+     '0000000000000000000000000000000000000000000000000000000000000000',
+     '0000000000000000000000000000000000000000000000000000000000000000',
+     'E907831F80848D1069A5371B402410364BDF1C5F8307B0084C55F1CE2DCA8215'
+     '25F66A4A85EA8B71E482A74F382D2CE5EBEEE8FDB2172F477DF4900D310536C0'),
+    ('B7E151628AED2A6ABF7158809CF4F3C762E7160F38B4DA56A784D9045190CFEF',
+     'DFF1D77F2A671C5F36183726DB2341BE58FEAE1DA2DECED843240F7B502BA659',
+     '0000000000000000000000000000000000000000000000000000000000000001',
+     '243F6A8885A308D313198A2E03707344A4093822299F31D0082EFA98EC4E6C89',
+     '6896BD60EEAE296DB48A229FF71DFE071BDE413E6D43F917DC8DCF8C78DE3341'
+     '8906D11AC976ABCCB20B091292BFF4EA897EFCB639EA871CFA95F6DE339E4B0A'),
+]
+
+
+def test_vectors():
+    for seckey, pubkey, aux_rand, msg, sig in vectors:
+        seckey, pubkey, aux_rand, msg, sig = map(
+            bytes.fromhex, (seckey, pubkey, aux_rand, msg, sig))
+        assert pubkey_xonly(seckey) == pubkey
+        assert sign(msg, seckey, aux_rand) == sig
+        assert verify(sig, msg, pubkey)
+
+
+def test_verify_invalid():
+    _, pubkey, _, msg, sig = map(bytes.fromhex, vectors[1])
+    wrong_msg = msg[:-1] + bytes([msg[-1] ^ 1])
+    assert not verify(sig, wrong_msg, pubkey)
+    for idx in (0, 31, 32, 63):
+        wrong_sig = bytearray(sig)
+        wrong_sig[idx] ^= 1
+        assert not verify(bytes(wrong_sig), msg, pubkey)
+    # r is not a valid X coordinate, s is not less than the group order
+    assert not verify(P.to_bytes(32, 'big') + sig[32:], msg, pubkey)
+    assert not verify(sig[:32] + N.to_bytes(32, 'big'), msg, pubkey)
+    assert not verify(sig, msg, pubkey[:-1])
+
+
+def test_sign_invalid():
+    with pytest.raises(ValueError):
+        sign(bytes(32), bytes(32))
+    with pytest.raises(ValueError):
+        sign(bytes(31), (1).to_bytes(32, 'big'))
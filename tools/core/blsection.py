@@ -8,6 +8,8 @@ import zlib
 import sys
 from .signature import *
 from .signature import _sha256
+from .delta import make_delta, apply_delta
+from . import lzss
 from bech32.segwit_addr import bech32_encode
 from bitstring import ConstBitStream
 
@@ -27,7 +29,9 @@ _supported_revisions = [1]
 # Maximum allowed size of payload (16 megabytes)
 MAX_PAYLOAD_SIZE = 16 * 1024 * 1024
 # Supported digital signature algorithms
-_supported_algorithms = [DSA_SECP256K1_SHA256]
+_supported_algorithms = DSA_ALGORITHMS + DSA_AGGREGATE_ALGORITHMS
+# Supported compression algorithms
+_supported_compression = [lzss.ALGORITHM]
 
 # Minimum allowed value ov version number
 VERSION_MIN = 1
@@ -48,6 +52,10 @@ _attributes = {
     'bl_attr_base_addr': (2, int, "0x{:x}"),
     'bl_attr_entry_point': (3, int, "0x{:x}"),
     'bl_attr_platform': (4, str, "'{}'"),
+    'bl_attr_base_version': (5, int, "{}"),
+    'bl_attr_delta_block': (6, int, "0x{:x}"),
+    'bl_attr_compression': (7, str, "'{}'"),
+    'bl_attr_stored_size': (8, int, "{}"),
 }
 # Reverse lookup by attribute code
 _attribute_names = {v[0]: k for k, v in _attributes.items()}
@@ -404,6 +412,10 @@ class Section(ABC):
         self._header.calc_crc()
         return self._header.serialize() + payload
 
+    def serialize_image(self):
+        """Serializes section with uncompressed payload, as it is hashed"""
+        return self.serialize()
+
     # Returns (section, new_offset)
     @staticmethod
     def deserialize(source, offset_=0):
@@ -419,17 +431,24 @@ class Section(ABC):
         header.validate()
 
         # Deserialize and check the payload
-        if len(source) - offset < header.pl_size:
+        attributes = header.get_attributes()
+        compression = attributes.get('bl_attr_compression', None)
+        stored_size = attributes.get('bl_attr_stored_size', header.pl_size)
+        if len(source) - offset < stored_size:
             raise ValueError("Buffer doesn't have enough bytes for payload")
-        payload = source[offset: offset + header.pl_size]
-        offset += header.pl_size
+        payload = source[offset: offset + stored_size]
+        offset += stored_size
+        if compression is not None:
+            if compression not in _supported_compression:
+                raise ValueError("Compression algorithm not supported")
+            payload = lzss.decompress(payload, header.pl_size)
         if len(payload) != header.pl_size:
             raise ValueError("Payload has wrong size")
         if zlib.crc32(payload) != header.pl_crc:
             raise ValueError("Incorrect payload CRC")
 
         # Identify section type by name and crete a new object
-        classes = {b'sign': SignatureSection}
+        classes = {b'sign': SignatureSection, b'delta': DeltaSection}
         cls = classes.get(header.name, PayloadSection)
         sect = cls(header=header, payload=payload)
         return (sect, offset)
@@ -438,12 +457,31 @@ class Section(ABC):
 class PayloadSection(Section):
     """Payload section storing firmware"""
 
-    def __init__(self, name="", payload=None, attributes=None, header=None):
+    def __init__(self, name="", payload=None, attributes=None, header=None,
+                 compression=None):
         """Constructs a new PayloadSection"""
         super().__init__(name=name, header=header)
         self.payload = payload
         if attributes is not None:
             self._header.set_attributes(attributes)
+        if compression is not None:
+            self.compression = compression
+
+    @property
+    def compression(self):
+        return self.attributes.get('bl_attr_compression', None)
+
+    @compression.setter
+    def compression(self, value):
+        attributes = self.attributes
+        attributes.pop('bl_attr_compression', None)
+        attributes.pop('bl_attr_stored_size', None)
+        if value is not None:
+            if value not in _supported_compression:
+                raise ValueError("Compression algorithm not supported")
+            attributes['bl_attr_compression'] = value
+            attributes['bl_attr_stored_size'] = 0  # Set on serialization
+        self._header.set_attributes(attributes)
 
     @property
     def payload(self):
@@ -473,9 +511,34 @@ class PayloadSection(Section):
     def _serialize_payload(self):
         return self.__payload
 
+    def serialize(self):
+        """Serializes section into bytes, compressing payload if needed.
+        Payload size and CRC are always defined over uncompressed payload.
+        """
+        if self.compression is None:
+            return super().serialize()
+        stored = lzss.compress(self.__payload)
+        attributes = self.attributes
+        attributes['bl_attr_stored_size'] = len(stored)
+        self._header.set_attributes(attributes)
+        self._header.pl_size = len(self.__payload)
+        self._header.pl_crc = zlib.crc32(self.__payload)
+        self._header.calc_crc()
+        return self._header.serialize() + stored
+
+    def serialize_image(self):
+        """Serializes section with uncompressed payload, as it is hashed"""
+        data = self.serialize()
+        return data[:sizeof(_bl_section_t)] + self.__payload
+
 
 class SignatureSection(Section):
-    """Signature section storing signature records"""
+    """Signature section storing signature records.
+
+    With an aggregate algorithm the section stores a single signature made
+    jointly by several signers, followed by fingerprints of the signers in
+    ascending order, instead of signature records.
+    """
 
     def __init__(self, dsa_algorithm='secp256k1-sha256', header=None,
                  payload=None):
@@ -483,6 +546,8 @@ class SignatureSection(Section):
         name = None if header else 'sign'
         super().__init__(name=name, header=header)
         self.__signatures = {}  # Public dict { fingerprint : signature }
+        self.__aggregate_signature = None
+        self.__signers = []
         if header is None:
             self._init_new(dsa_algorithm)
         else:
@@ -502,6 +567,9 @@ class SignatureSection(Section):
         # Check payload
         if not isinstance(payload, _byteslike):
             raise TypeError("Payload must be bytes-like")
+        if self.is_aggregate:
+            self._init_aggregate(payload)
+            return
         if len(payload) % sizeof(_bl_signature_rec_t) != 0:
             raise TypeError("Payload size must be multiple of record size")
 
@@ -512,6 +580,46 @@ class SignatureSection(Section):
             self.__signatures[bytes(rec.fingerprint)] = bytes(rec.signature)
             offset += sizeof(_bl_signature_rec_t)
 
+    def _init_aggregate(self, payload):
+        if not len(payload):
+            return  # Not signed yet
+        if (len(payload) <= SIGNATURE_LEN or
+                (len(payload) - SIGNATURE_LEN) % FINGERPRINT_LEN != 0):
+            raise TypeError("Invalid size of aggregate signature payload")
+        self.__aggregate_signature = bytes(payload[:SIGNATURE_LEN])
+        self.__signers = [bytes(payload[i:i + FINGERPRINT_LEN]) for i in
+                          range(SIGNATURE_LEN, len(payload), FINGERPRINT_LEN)]
+
+    @property
+    def dsa_algorithm(self):
+        return self.attributes['bl_attr_algorithm']
+
+    @property
+    def is_aggregate(self):
+        return self.dsa_algorithm in DSA_AGGREGATE_ALGORITHMS
+
+    @property
+    def aggregate_signature(self):
+        return self.__aggregate_signature
+
+    @property
+    def signers(self):
+        return self.__signers
+
+    def set_aggregate(self, signature, signers):
+        """Sets aggregate signature and fingerprints of all signers."""
+        if not self.is_aggregate:
+            raise ValueError("Algorithm does not use aggregate signatures")
+        self._validate_signature(signature)
+        if not len(signers):
+            raise ValueError("List of signers is empty")
+        for fp in signers:
+            self._validate_fingerprint(fp)
+        if len(set(signers)) != len(signers):
+            raise ValueError("Duplicating signers")
+        self.__aggregate_signature = bytes(signature)
+        self.__signers = sorted(bytes(fp) for fp in signers)
+
     @property
     def signatures(self):
         return self.__signatures
@@ -525,7 +633,9 @@ class SignatureSection(Section):
         if not isinstance(other, SignatureSection):
             return False if isinstance(other, Section) else NotImplemented
         return (self._header == other._header and
-                self.__signatures == other.__signatures)
+                self.__signatures == other.__signatures and
+                self.__aggregate_signature == other.__aggregate_signature and
+                self.__signers == other.__signers)
 
     @staticmethod
     def _validate_fingerprint(fingerprint):
@@ -553,6 +663,12 @@ class SignatureSection(Section):
 
     def _serialize_payload(self):
         payload_bytes = b''
+        if self.is_aggregate:
+            if self.__signatures:
+                raise ValueError("Signature records with aggregate algorithm")
+            if self.__aggregate_signature is None:
+                return payload_bytes
+            return self.__aggregate_signature + b''.join(self.__signers)
         self._validate_signatures(self.__signatures)
         for fp, sig in self.__signatures.items():
             rec = _bl_signature_rec_t()
@@ -561,6 +677,84 @@ class SignatureSection(Section):
         return payload_bytes
 
 
+class DeltaSection(Section):
+    """Delta section storing a patch for the Main Firmware.
+
+    The payload consists of the header of target Payload section followed by
+    the patch transforming installed base firmware into the target firmware.
+    The signature message is the same as for the target Payload section, so
+    signatures of a full upgrade file remain valid for the Delta section.
+    """
+
+    def __init__(self, target=None, base=None, block_size=None, header=None,
+                 payload=None):
+        """Constructs a new DeltaSection from target Payload section and base
+        firmware, or deserializes it from existing header and payload.
+        """
+        name = None if header else 'delta'
+        super().__init__(name=name, header=header)
+        if header is None:
+            self._init_new(target, base, block_size)
+        else:
+            self._init_from_header(payload)
+
+    def _init_new(self, target, base, block_size):
+        if not isinstance(target, PayloadSection) or target.name != 'main':
+            raise TypeError("Target should be the Main Firmware section")
+        if not isinstance(base, _byteslike):
+            raise TypeError("Base firmware must be bytes-like")
+        base_version = find_payload_version(base)
+        if base_version == VERSION_NA:
+            raise ValueError("Base firmware has no version")
+        target_bytes = target.serialize_image()
+        self.target_header = _bl_section_t.from_buffer_copy(target_bytes)
+        self.patch = make_delta(base, target_bytes[sizeof(_bl_section_t):],
+                                block_size)
+        self._header.pl_ver = target.version
+        self._header.set_attributes({'bl_attr_base_version': base_version,
+                                     'bl_attr_delta_block': block_size})
+
+    def _init_from_header(self, payload):
+        if not isinstance(payload, _byteslike):
+            raise TypeError("Payload must be bytes-like")
+        if len(payload) <= sizeof(_bl_section_t):
+            raise ValueError("Payload is too short")
+        self.target_header = _bl_section_t.from_buffer_copy(payload)
+        self.target_header.validate()
+        if self.target_header.get_name() != 'main':
+            raise ValueError("Target should be the Main Firmware section")
+        self.patch = payload[sizeof(_bl_section_t):]
+
+    @property
+    def base_version(self):
+        return self.attributes.get('bl_attr_base_version', VERSION_NA)
+
+    @property
+    def block_size(self):
+        return self.attributes.get('bl_attr_delta_block', None)
+
+    def apply(self, base):
+        """Applies the patch to base firmware, returning target section"""
+        if find_payload_version(base) != self.base_version:
+            raise ValueError("Base firmware has wrong version")
+        payload = apply_delta(base, self.patch, self.block_size)
+        if (len(payload) != self.target_header.pl_size or
+                zlib.crc32(payload) != self.target_header.pl_crc):
+            raise ValueError("Patch produces incorrect firmware")
+        header = _bl_section_t.from_buffer_copy(bytes(self.target_header))
+        return PayloadSection(header=header, payload=payload)
+
+    def __eq__(self, other):
+        if not isinstance(other, DeltaSection):
+            return False if isinstance(other, Section) else NotImplemented
+        return (self._header == other._header and
+                self.target_header == other.target_header and
+                self.patch == other.patch)
+
+    def _serialize_payload(self):
+        return self.target_header.serialize() + self.patch
+
+
 def make_signature_message(sections):
     """Creates a bytes message with names, versions and hashes of all payload
     sections. Used as input to signature algorithm.
@@ -575,7 +769,7 @@ def make_signature_message(sections):
             hrp += _brief_section_name[sect.name] + sect.version_sig_str + "-"
         except KeyError:
             raise ValueError("Unsupported payload section")
-        hash_input += _sha256(sect.serialize())
+        hash_input += _sha256(sect.serialize_image())
 
     data = _bytes_to_5bit(_sha256(hash_input))
 
@@ -190,6 +190,70 @@ class TestPayloadSection:
             Section.deserialize(data, 0)
 
 
+    def test_compression(self):
+        payload = (b'Something useless<version:tag10>0102213405</version:tag10>'
+                   + b'Compressible data' * 100)
+        a = PayloadSection("main", payload, compression='lzss')
+        plain = PayloadSection("main", payload)
+        data = a.serialize()
+        assert len(data) < len(plain.serialize())
+        assert a.attributes['bl_attr_stored_size'] == len(data) - 256
+        b, offset = Section.deserialize(data, 0)
+        assert offset == len(data)
+        assert b == a
+        assert b.compression == 'lzss'
+        assert b.payload == payload
+        assert b.serialize_image()[sizeof(_bl_section_t):] == payload
+        with pytest.raises(ValueError):
+            PayloadSection("main", payload, compression='zip')
+
+    def test_compression_corrupted_payload(self):
+        a = PayloadSection("main", b'abcdefgh' * 50, compression='lzss')
+        data = bytearray(a.serialize())
+        data[sizeof(_bl_section_t) + 3] ^= 1
+        with pytest.raises(ValueError):
+            Section.deserialize(data, 0)
+
+
+class TestDeltaSection:
+    base = (b'Main firmware, base version' * 100 +
+            b'<version:tag10>0102213405</version:tag10>' +
+            b'Some code which is not changed' * 100)
+    target = (b'Main firmware, new version' * 100 +
+              b'<version:tag10>0102300099</version:tag10>' +
+              b'Some code which is not changed' * 100)
+
+    def test_creation(self):
+        target = PayloadSection('main', self.target)
+        sect = DeltaSection(target, self.base, 1024)
+        assert sect.name == 'delta'
+        assert sect.version == target.version
+        assert sect.base_version == 102213405
+        assert sect.block_size == 1024
+        assert len(sect.patch) < len(self.target)
+        assert sect.apply(self.base) == target
+        with pytest.raises(TypeError):
+            DeltaSection(PayloadSection('boot', self.target), self.base, 1024)
+        with pytest.raises(ValueError):
+            DeltaSection(target, b'No version', 1024)
+
+    def test_apply_wrong_base(self):
+        sect = DeltaSection(PayloadSection('main', self.target), self.base,
+                            1024)
+        with pytest.raises(ValueError):
+            sect.apply(self.target)
+
+    def test_serialization_valid(self):
+        target = PayloadSection('main', self.target)
+        a = DeltaSection(target, self.base, 1024)
+        b, offset = Section.deserialize(a.serialize(), 0)
+        assert isinstance(b, DeltaSection)
+        assert b == a
+        assert b.apply(self.base) == target
+        assert (make_signature_message([b.apply(self.base)]) ==
+                make_signature_message([target]))
+
+
 class TestSignatureSection:
     def test_creation(self):
         sect = SignatureSection(dsa_algorithm='secp256k1-sha256')
@@ -197,9 +261,38 @@ class TestSignatureSection:
         assert sect.version == VERSION_NA
         assert sect.attributes['bl_attr_algorithm'] == 'secp256k1-sha256'
         assert not sect.signatures
+        assert sect.dsa_algorithm == 'secp256k1-sha256'
         with pytest.raises(ValueError):
             sect2 = SignatureSection(dsa_algorithm='unsupported-algorithm')
 
+    def test_creation_schnorr(self):
+        sect = SignatureSection(dsa_algorithm='secp256k1-schnorr-sha256')
+        assert sect.dsa_algorithm == 'secp256k1-schnorr-sha256'
+        data = sect.serialize()
+        sect2, _ = Section.deserialize(data)
+        assert sect2.dsa_algorithm == 'secp256k1-schnorr-sha256'
+
+    def test_aggregate(self):
+        sect = SignatureSection(dsa_algorithm='secp256k1-musig2-sha256')
+        assert sect.is_aggregate
+        assert sect.aggregate_signature is None
+        sect2, _ = Section.deserialize(sect.serialize())
+        assert sect2 == sect
+        signers = [b'\xEE' * 16, b'\x11' * 16]
+        sect.set_aggregate(b'\x55' * 64, signers)
+        assert sect.signers == sorted(signers)
+        data = sect.serialize()
+        assert data.endswith(b'\x55' * 64 + b'\x11' * 16 + b'\xEE' * 16)
+        sect2, _ = Section.deserialize(data)
+        assert sect2 == sect
+        assert sect2.aggregate_signature == b'\x55' * 64
+        with pytest.raises(ValueError):
+            sect.set_aggregate(b'\x55' * 64, [])
+        with pytest.raises(ValueError):
+            sect.set_aggregate(b'\x55' * 64, [b'\x11' * 16] * 2)
+        with pytest.raises(ValueError):
+            SignatureSection().set_aggregate(b'\x55' * 64, signers)
+
     def test_signatures_valid(self):
         sect = SignatureSection()
         sigs = {b'a' * FINGERPRINT_LEN: b'1' * SIGNATURE_LEN,
@@ -0,0 +1,117 @@
+"""Patches transforming one firmware image into another in place."""
+
+from collections import defaultdict
+from bisect import bisect_left
+
+# Operation codes
+OP_COPY = 1
+OP_INSERT = 2
+# Size of a header of "copy" operation including operation code
+COPY_HDR_SIZE = 9
+# Size of a header of "insert" operation including operation code
+INSERT_HDR_SIZE = 5
+# Length of a key used to find matches in base firmware
+_KEY_LEN = 16
+# Maximum number of candidates checked for each match
+_MAX_CANDIDATES = 32
+
+
+def _encode_copy(src_offset, length):
+    return (bytes([OP_COPY]) + src_offset.to_bytes(4, byteorder='little') +
+            length.to_bytes(4, byteorder='little'))
+
+
+def _encode_insert(data):
+    return (bytes([OP_INSERT]) + len(data).to_bytes(4, byteorder='little') +
+            bytes(data))
+
+
+def _match_len(base, src, target, dst, max_len):
+    length = 0
+    while (length < max_len and src + length < len(base) and
+           base[src + length] == target[dst + length]):
+        length += 1
+    return length
+
+
+def make_delta(base, target, block_size):
+    """Creates a patch transforming base firmware into target firmware.
+
+    Target firmware is produced block by block, and each block of base firmware
+    is overwritten once its target block is written. Therefore data of a block
+    of target firmware can only be copied from the same or following blocks of
+    base firmware.
+    """
+    if block_size <= 0:
+        raise ValueError("Block size must be positive")
+
+    # Index base firmware by keys
+    index = defaultdict(list)
+    for pos in range(0, len(base) - _KEY_LEN + 1):
+        index[bytes(base[pos: pos + _KEY_LEN])].append(pos)
+
+    ops = b''
+    literal = bytearray()
+    pos = 0
+    while pos < len(target):
+        block_start = pos - pos % block_size
+        max_len = min(block_start + block_size, len(target)) - pos
+        best_src, best_len = 0, 0
+        if max_len >= _KEY_LEN:
+            candidates = index.get(bytes(target[pos: pos + _KEY_LEN]), [])
+            first = bisect_left(candidates, block_start)
+            for src in candidates[first: first + _MAX_CANDIDATES]:
+                length = _match_len(base, src, target, pos, max_len)
+                if length > best_len:
+                    best_src, best_len = src, length
+        if best_len > COPY_HDR_SIZE + INSERT_HDR_SIZE:
+            if literal:
+                ops += _encode_insert(literal)
+                literal = bytearray()
+            ops += _encode_copy(best_src, best_len)
+            pos += best_len
+        else:
+            literal.append(target[pos])
+            pos += 1
+    if literal:
+        ops += _encode_insert(literal)
+    return ops
+
+
+def apply_delta(base, ops, block_size, max_size=None):
+    """Applies a patch to base firmware, returning target firmware.
+
+    Follows the rules of the Bootloader: any reference to a block of base
+    firmware which is already overwritten raises ValueError.
+    """
+    target = bytearray()
+    offset = 0
+    while offset < len(ops):
+        code = ops[offset]
+        if code == OP_COPY:
+            if len(ops) - offset < COPY_HDR_SIZE:
+                raise ValueError("Truncated operation")
+            src = int.from_bytes(ops[offset + 1: offset + 5], 'little')
+            length = int.from_bytes(ops[offset + 5: offset + 9], 'little')
+            offset += COPY_HDR_SIZE
+            if max_size is not None and src + length > max_size:
+                raise ValueError("Reference outside of firmware area")
+            for i in range(length):
+                block_start = len(target) - len(target) % block_size
+                if src + i < block_start:
+                    raise ValueError("Reference to overwritten block")
+                target.append(base[src + i] if src + i < len(base) else 0xFF)
+        elif code == OP_INSERT:
+            if len(ops) - offset < INSERT_HDR_SIZE:
+                raise ValueError("Truncated operation")
+            length = int.from_bytes(ops[offset + 1: offset + 5], 'little')
+            offset += INSERT_HDR_SIZE
+            if len(ops) - offset < length:
+                raise ValueError("Truncated operation")
+            target += ops[offset: offset + length]
+            offset += length
+        else:
+            raise ValueError("Unknown operation")
+        if max_size is not None and len(target) > max_size:
+            raise ValueError("Target firmware is too large")
+    return bytes(target)
@@ -0,0 +1,41 @@
+import pytest
+from .delta import *
+
+
+def _blocks(n_blocks, block_size):
+    return b''.join(bytes([(i * 7 + j) & 0xFF for j in range(block_size)])
+                    for i in range(n_blocks))
+
+
+def test_make_delta_roundtrip():
+    base = _blocks(8, 256)
+    target = base[:300] + b'inserted data' + base[280:1000] + base[1500:]
+    ops = make_delta(base, target, 256)
+    assert apply_delta(base, ops, 256) == target
+    assert len(ops) < len(target)
+
+
+def test_make_delta_no_references_to_previous_blocks():
+    base = _blocks(4, 256)
+    # Target moves the first block to the end: it can't be copied there
+    target = base[256:] + base[:256]
+    ops = make_delta(base, target, 256)
+    assert apply_delta(base, ops, 256) == target
+
+
+def test_apply_delta_errors():
+    base = _blocks(4, 256)
+    with pytest.raises(ValueError):
+        apply_delta(base, bytes([OP_INSERT, 1, 0, 0, 0]), 256)
+    with pytest.raises(ValueError):
+        apply_delta(base, bytes([3]), 256)
+    # Copy from block 0 while producing block 1
+    ops = (bytes([OP_INSERT]) + (256).to_bytes(4, 'little') + bytes(256) +
+           bytes([OP_COPY]) + (0).to_bytes(4, 'little') +
+           (1).to_bytes(4, 'little'))
+    with pytest.raises(ValueError):
+        apply_delta(base, ops, 256)
+    # Target larger than allowed
+    ops = bytes([OP_INSERT]) + (257).to_bytes(4, 'little') + bytes(257)
+    with pytest.raises(ValueError):
+        apply_delta(base, ops, 256, max_size=256)
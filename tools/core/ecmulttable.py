@@ -0,0 +1,86 @@
+"""Generator of precomputed ecmult tables for libsecp256k1.
+
+Verification in libsecp256k1 computes a*P + b*G using a window of
+ECMULT_WINDOW_SIZE bits for the generator G. The library needs a table of
+odd multiples (1*G, 3*G, 5*G, ...) of the generator with 2^(window - 2)
+entries, which is normally computed at run time inside the context object.
+This module generates the same table as constant C data, so that it is
+placed in read-only memory together with the code.
+
+Entries are stored in the internal secp256k1_ge_storage format: normalized
+X and Y coordinates, each as eight 32-bit words starting from the most
+significant one.
+"""
+
+from .bip340 import G, point_add
+
+# Minimum window size supported by libsecp256k1
+MIN_WINDOW = 2
+# Maximum window size supported by this generator (2 MB table)
+MAX_WINDOW = 16
+# Size of one table entry (secp256k1_ge_storage) in bytes
+ENTRY_SIZE = 64
+# Name of the generated table
+TABLE_NAME = "secp256k1_ecmult_static_pre_g"
+# Name of macro defining the window size of the generated table
+WINDOW_MACRO = "ECMULT_STATIC_PRE_G_WINDOW"
+# Guard macro of the generated header
+GUARD_MACRO = "ECMULT_STATIC_PRE_G_H_INCLUDED"
+
+
+def _check_window(window):
+    if not MIN_WINDOW <= window <= MAX_WINDOW:
+        raise ValueError(f"Window size should be in range "
+                         f"[{MIN_WINDOW}..{MAX_WINDOW}]")
+
+
+def table_entries(window):
+    """Returns number of entries in the table for given window size."""
+    _check_window(window)
+    return 1 << (window - 2)
+
+
+def table_size(window):
+    """Returns size of the table in bytes for given window size."""
+    return table_entries(window) * ENTRY_SIZE
+
+
+def odd_multiples(point, n):
+    """Returns a list of n odd multiples of a point: 1*P, 3*P, 5*P, ..."""
+    double = point_add(point, point)
+    result = [point]
+    for _ in range(n - 1):
+        result.append(point_add(result[-1], double))
+    return result
+
+
+def _words(value):
+    return [(value >> (32 * i)) & 0xFFFFFFFF for i in range(7, -1, -1)]
+
+
+def _c_entry(point):
+    words = [f"0x{w:08X}UL" for w in _words(point[0]) + _words(point[1])]
+    lines = [", ".join(words[i:i + 4]) for i in range(0, len(words), 4)]
+    return ("    SECP256K1_GE_STORAGE_CONST(\n        " +
+            ",\n        ".join(lines) + "),")
+
+
+def generate_header(window):
+    """Returns C header with the table of odd multiples of the generator."""
+    n_entries = table_entries(window)
+    out = ["// Precomputed odd multiples of the secp256k1 generator for",
+           f"// ECMULT_WINDOW_SIZE {window}: {n_entries} entries, "
+           f"{table_size(window)} bytes.",
+           "// Generated by tools/ecmult-table.py, do not edit.",
+           "",
+           f"#ifndef {GUARD_MACRO}",
+           f"#define {GUARD_MACRO}",
+           "",
+           f"#define {WINDOW_MACRO} {window}",
+           "",
+           f"static const secp256k1_ge_storage {TABLE_NAME}[{n_entries}] = {{"]
+    out += [_c_entry(p) for p in odd_multiples(G, n_entries)]
+    out += ["};",
+            "",
+            f"#endif  // {GUARD_MACRO}"]
+    return "\n".join(out) + "\n"
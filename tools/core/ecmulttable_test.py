@@ -0,0 +1,42 @@
+import re
+import pytest
+from .ecmulttable import *
+from .bip340 import G, point_mul
+
+# Third multiple of the generator
+G3 = (0xF9308A019258C31049344F85F89D5229B531C845836F99B08601F113BCE036F9,
+      0x388F7B0F632DE8140FE337E62A37F3566500A99934C2231B6CB9FD7584B8E672)
+
+
+def test_table_size():
+    assert table_entries(2) == 1
+    assert table_entries(4) == 4
+    assert table_size(4) == 256
+    assert table_size(8) == 4096
+    with pytest.raises(ValueError):
+        table_entries(MIN_WINDOW - 1)
+    with pytest.raises(ValueError):
+        table_entries(MAX_WINDOW + 1)
+
+
+def test_odd_multiples():
+    points = odd_multiples(G, 8)
+    assert len(points) == 8
+    assert points[0] == G
+    assert points[1] == G3
+    for i, point in enumerate(points):
+        assert point == point_mul(G, 2 * i + 1)
+
+
+def test_generate_header():
+    header = generate_header(4)
+    assert f"#define {WINDOW_MACRO} 4\n" in header
+    assert f"{TABLE_NAME}[4] = {{" in header
+    entries = re.findall(r"SECP256K1_GE_STORAGE_CONST\(([^)]*)\)", header)
+    assert len(entries) == 4
+    words = [int(w.strip().rstrip('UL'), 16) for w in entries[1].split(',')]
+    assert len(words) == 16
+    x = sum(w << (32 * (7 - i)) for i, w in enumerate(words[:8]))
+    y = sum(w << (32 * (7 - i)) for i, w in enumerate(words[8:]))
+    assert (x, y) == G3
+    assert max(len(line) for line in header.splitlines()) <= 80
@@ -9,14 +9,26 @@ _byteslike = (bytes, bytearray)
 
 # Magic word, "INTG" in LE
 _BL_ICR_MAGIC = 0x47544E49
+# Magic word of block CRC table, "BCRC" in LE
+_BL_BCT_MAGIC = 0x43524342
+# Maximum number of blocks in block CRC table
+_BL_BCT_MAX_BLOCKS = 26
+# Minimum size of a block, the size is a power of two
+_BL_BCT_MIN_BLOCK_SIZE = 1024
 # Structure revision
 _STRUCT_REV = 1
 # Size of integrity check record
 _BL_ICR_SIZE = 32
 # Size of version check record
 _BL_VCR_SIZE = 32
+# Size of verification marker record, created by the Bootloader
+_BL_VMR_SIZE = 32
+# Size of block CRC table
+_BL_BCT_SIZE = 128
 # Total overhead from all metadata stored together with firmware
-BL_FW_SECT_OVERHEAD = (_BL_ICR_SIZE+_BL_VCR_SIZE)
+BL_FW_SECT_OVERHEAD = (_BL_BCT_SIZE+_BL_VMR_SIZE+_BL_ICR_SIZE+_BL_VCR_SIZE)
+# Offset of block CRC table from the end of firmware section
+BL_BCT_OFFSET_FROM_END = BL_FW_SECT_OVERHEAD
 # Offset of ICR record from the end of firmware section
 BL_ICR_OFFSET_FROM_END = (_BL_ICR_SIZE+_BL_VCR_SIZE)
 
@@ -67,3 +79,51 @@ def icr_create(firmware):
     icr.main_sect.pl_size = len(firmware)
     icr.main_sect.pl_crc = zlib.crc32(firmware)
     return icr.serialize()
+
+
+class _bl_block_crc_table_t(LittleEndianStructure):
+    """Block CRC table."""
+
+    _pack_ = 1        # Pack structure
+    _CRC_SIZE = 4     # CRC32 size in bytes
+    _fields_ = [('magic', c_uint32),
+                ('struct_rev', c_uint32),
+                ('icr_crc', c_uint32),
+                ('block_size', c_uint32),
+                ('n_blocks', c_uint32),
+                ('block_crc', c_uint32 * _BL_BCT_MAX_BLOCKS),
+                ('struct_crc', c_uint32)]
+
+    def __init__(self):
+        super(_bl_block_crc_table_t, self).__init__(
+            magic=_BL_BCT_MAGIC,
+            struct_rev=_STRUCT_REV,
+            struct_crc=0)
+
+    def serialize(self):
+        data = bytes(self)[:sizeof(self) - self._CRC_SIZE]
+        self.struct_crc = zlib.crc32(data)
+        return bytes(self)
+
+
+def bct_create(firmware, icr):
+    """Creates and returns block CRC table for the firmware, bound to its
+    integrity check record returned by icr_create().
+    """
+
+    if not isinstance(firmware, _byteslike) or not isinstance(icr, _byteslike):
+        raise TypeError("Firmware and ICR should be bytes-like")
+    if not firmware:
+        raise ValueError("Firmware is empty")
+
+    bct = _bl_block_crc_table_t()
+    bct.icr_crc = _bl_integrity_check_rec_t.from_buffer_copy(icr).struct_crc
+    bct.block_size = _BL_BCT_MIN_BLOCK_SIZE
+    while bct.block_size * _BL_BCT_MAX_BLOCKS < len(firmware):
+        bct.block_size *= 2
+    blocks = range(0, len(firmware), bct.block_size)
+    bct.n_blocks = len(blocks)
+    for idx, offset in enumerate(blocks):
+        bct.block_crc[idx] = zlib.crc32(
+            firmware[offset: offset + bct.block_size])
+    return bct.serialize()
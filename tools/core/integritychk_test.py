@@ -1,4 +1,5 @@
 import pytest
+import zlib
 from .integritychk import *
 
 #Reference firmware containing embedded version tag
@@ -27,3 +28,33 @@ ref_icr = bytes.fromhex(
 def test_icr_create():
     icr = icr_create(ref_firmware)
     assert icr == ref_icr
+
+# Reference block CRC table
+ref_bct = bytes.fromhex(
+    '42435243'  # .magic
+    '01000000'  # .struct_rev
+    '31731df9'  # .icr_crc
+    '00040000'  # .block_size
+    '01000000'  # .n_blocks
+    '22b922c7'  # .block_crc[0]
+    + '00000000' * 25 +  # .block_crc[1..25]
+    '2f6c1ccd'  # .struct_crc
+)
+
+
+def test_bct_create():
+    bct = bct_create(ref_firmware, ref_icr)
+    assert bct == ref_bct
+
+
+def test_bct_create_blocks():
+    firmware = bytes(range(256)) * 1000
+    bct = bct_create(firmware, icr_create(firmware))
+    block_size = int.from_bytes(bct[12:16], 'little')
+    n_blocks = int.from_bytes(bct[16:20], 'little')
+    assert block_size == 16384
+    assert n_blocks == 16
+    assert (int.from_bytes(bct[20 + 4 * 15: 24 + 4 * 15], 'little') ==
+            zlib.crc32(firmware[15 * block_size:]))
+    with pytest.raises(ValueError):
+        bct_create(b'', ref_icr)
@@ -0,0 +1,107 @@
+"""LZSS compression of payload sections, matching the Bootloader decoder."""
+
+# Identifier of compression algorithm stored in bl_attr_compression
+ALGORITHM = 'lzss'
+# Number of bits coding an offset of a match
+OFFSET_BITS = 11
+# Number of bits coding a length of a match
+LENGTH_BITS = 5
+# Size of the sliding window in bytes
+WINDOW_SIZE = 1 << OFFSET_BITS
+# Minimum length of a match
+MIN_MATCH = 3
+# Maximum length of a match
+MAX_MATCH = MIN_MATCH + (1 << LENGTH_BITS) - 1
+# Maximum number of candidates checked for each match
+_MAX_CANDIDATES = 64
+
+
+def compress(data):
+    """Compresses data.
+
+    Compressed stream consists of groups, each beginning with a flag byte
+    whose bits, starting from the least significant one, describe up to 8
+    following items: 1 - a literal byte, 0 - a match coded as 16-bit
+    little-endian word { offset - 1 : OFFSET_BITS, length - MIN_MATCH :
+    LENGTH_BITS }.
+    """
+    out = bytearray()
+    chains = {}  # { 3-byte key: list of positions }
+    flags_pos = 0
+    n_items = 8
+    pos = 0
+
+    def add_position(idx):
+        if idx + MIN_MATCH <= len(data):
+            chains.setdefault(bytes(data[idx: idx + MIN_MATCH]),
+                              []).append(idx)
+
+    while pos < len(data):
+        if n_items == 8:
+            flags_pos = len(out)
+            out.append(0)
+            n_items = 0
+
+        # Find the longest match within the window, checking latest first
+        best_len, best_offset = 0, 0
+        max_len = min(MAX_MATCH, len(data) - pos)
+        candidates = chains.get(bytes(data[pos: pos + MIN_MATCH]), [])
+        for src in reversed(candidates[-_MAX_CANDIDATES:]):
+            if pos - src > WINDOW_SIZE:
+                break
+            length = 0
+            while (length < max_len and
+                   data[src + length] == data[pos + length]):
+                length += 1
+            if length > best_len:
+                best_len, best_offset = length, pos - src
+                if length == max_len:
+                    break
+
+        if best_len >= MIN_MATCH:
+            token = (best_offset - 1) | ((best_len - MIN_MATCH) << OFFSET_BITS)
+            out += token.to_bytes(2, byteorder='little')
+            for idx in range(pos, pos + best_len):
+                add_position(idx)
+            pos += best_len
+        else:
+            out[flags_pos] |= 1 << n_items
+            out.append(data[pos])
+            add_position(pos)
+            pos += 1
+        n_items += 1
+    return bytes(out)
+
+
+def decompress(data, size):
+    """Decompresses data, expecting exactly size bytes of output."""
+    out = bytearray()
+    pos = 0
+    while len(out) < size:
+        if pos >= len(data):
+            raise ValueError("Compressed stream is truncated")
+        flags = data[pos]
+        pos += 1
+        for _ in range(8):
+            if len(out) >= size:
+                break
+            if flags & 1:
+                if pos >= len(data):
+                    raise ValueError("Compressed stream is truncated")
+                out.append(data[pos])
+                pos += 1
+            else:
+                if pos + 2 > len(data):
+                    raise ValueError("Compressed stream is truncated")
+                token = int.from_bytes(data[pos: pos + 2], byteorder='little')
+                pos += 2
+                offset = (token & (WINDOW_SIZE - 1)) + 1
+                length = (token >> OFFSET_BITS) + MIN_MATCH
+                if offset > len(out):
+                    raise ValueError("Reference before the beginning")
+                for _ in range(length):
+                    out.append(out[-offset])
+            flags >>= 1
+    if len(out) != size or pos != len(data):
+        raise ValueError("Compressed stream has wrong size")
+    return bytes(out)
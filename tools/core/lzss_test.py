@@ -0,0 +1,30 @@
+import pytest
+from .lzss import *
+
+
+def test_roundtrip():
+    data = (b'Specter bootloader ' * 200 + bytes(range(256)) * 3 +
+            bytes(5000) + b'tail')
+    compressed = compress(data)
+    assert len(compressed) < len(data) // 4
+    assert decompress(compressed, len(data)) == data
+
+
+def test_roundtrip_small():
+    for data in [b'a', b'ab', b'abc', b'aaaa', bytes(range(20))]:
+        assert decompress(compress(data), len(data)) == data
+
+
+def test_known_stream():
+    # Literals 'a', 'b', 'c', then match {offset 3, length 6}
+    assert compress(b'abcabcabc') == bytes([0x07, 97, 98, 99, 0x02, 0x18])
+
+
+def test_decompress_errors():
+    data = compress(b'Specter bootloader ' * 10)
+    with pytest.raises(ValueError):
+        decompress(data[:-1], 190)
+    with pytest.raises(ValueError):
+        decompress(data + b'\x00', 190)
+    with pytest.raises(ValueError):
+        decompress(bytes([0x01, 97, 0x01, 0x00]), 4)
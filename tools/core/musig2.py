@@ -0,0 +1,209 @@
+"""MuSig2 multi-signatures for secp256k1 as specified in BIP-327.
+
+Only the untweaked variant is implemented: signers aggregate their plain
+public keys into one X-only key and jointly produce a single BIP-340 Schnorr
+signature, which is verified as an ordinary BIP-340 signature. Like bip340.py
+this code is not constant-time and intended only for use on a host machine.
+
+Signing takes two rounds. In the first round each signer generates a secret
+and a public nonce and publishes the public nonce. In the second round each
+signer produces a partial signature from the aggregated nonce. Partial
+signatures are then combined into the final signature. A secret nonce must
+never be used twice.
+"""
+
+from .bip340 import N, G, P, tagged_hash, point_add, point_mul, lift_x
+
+# Size of a compressed public key in bytes
+PUBKEY_LEN = 33
+# Size of a public nonce in bytes
+PUBNONCE_LEN = 66
+# Size of a secret nonce in bytes: two scalars and the public key
+SECNONCE_LEN = 97
+# Size of a partial signature in bytes
+PSIG_LEN = 32
+
+
+def _bytes_from_int(x):
+    return x.to_bytes(32, byteorder='big')
+
+
+def _int_from_bytes(b):
+    return int.from_bytes(b, byteorder='big')
+
+
+def _has_even_y(point):
+    return point[1] % 2 == 0
+
+
+def _xbytes(point):
+    return _bytes_from_int(point[0])
+
+
+def _cbytes(point):
+    return (b'\x02' if _has_even_y(point) else b'\x03') + _xbytes(point)
+
+
+def _cbytes_ext(point):
+    return bytes(PUBKEY_LEN) if point is None else _cbytes(point)
+
+
+def _cpoint(data):
+    if len(data) != PUBKEY_LEN or data[0] not in (2, 3):
+        raise ValueError("Invalid compressed point")
+    point = lift_x(_int_from_bytes(data[1:]))
+    if point is None:
+        raise ValueError("Point is not on the curve")
+    return point if data[0] == 2 else (point[0], P - point[1])
+
+
+def _cpoint_ext(data):
+    return None if data == bytes(PUBKEY_LEN) else _cpoint(data)
+
+
+def compress_pubkey(pubkey):
+    """Converts a 65-byte uncompressed public key to 33-byte compressed."""
+    if len(pubkey) != 65 or pubkey[0] != 0x04:
+        raise ValueError("Uncompressed pubkey should be 65 bytes long")
+    return bytes([2 + (pubkey[64] & 1)]) + bytes(pubkey[1:33])
+
+
+def pubkey_from_seckey(seckey):
+    """Returns 33-byte compressed public key derived from a private key."""
+    d = _int_from_bytes(seckey)
+    if not (1 <= d <= N - 1):
+        raise ValueError("Private key is out of range")
+    return _cbytes(point_mul(G, d))
+
+
+def _second_key(pubkeys):
+    for pk in pubkeys[1:]:
+        if pk != pubkeys[0]:
+            return pk
+    return bytes(PUBKEY_LEN)
+
+
+def _key_agg_coeff(pubkeys, pubkey, pk2=None):
+    if pk2 is None:
+        pk2 = _second_key(pubkeys)
+    if pubkey == pk2:
+        return 1
+    keys_hash = tagged_hash("KeyAgg list", b''.join(pubkeys))
+    return _int_from_bytes(tagged_hash("KeyAgg coefficient",
+                                       keys_hash + pubkey)) % N
+
+
+def _key_agg_point(pubkeys):
+    if not pubkeys:
+        raise ValueError("List of public keys is empty")
+    pk2 = _second_key(pubkeys)
+    agg = None
+    for pk in pubkeys:
+        agg = point_add(agg, point_mul(_cpoint(pk),
+                                       _key_agg_coeff(pubkeys, pk, pk2)))
+    if agg is None:
+        raise ValueError("Aggregate public key is infinity")
+    return agg
+
+
+def key_agg(pubkeys):
+    """Aggregates compressed public keys returning 32-byte X-only key."""
+    return _xbytes(_key_agg_point(pubkeys))
+
+
+def nonce_gen(seckey, pubkey, msg, rand):
+    """Generates a nonce pair from 32 bytes of fresh randomness, returning a
+    tuple (secnonce, pubnonce)."""
+    if len(rand) != 32:
+        raise ValueError("Random data should be 32 bytes long")
+    if seckey is not None:
+        rand = bytes(a ^ b for a, b in zip(seckey, tagged_hash("MuSig/aux",
+                                                                rand)))
+    msg_prefixed = b'\x01' + len(msg).to_bytes(8, 'big') + msg
+    buf = (rand + len(pubkey).to_bytes(1, 'big') + pubkey + b'\x00' +
+           msg_prefixed + bytes(4))
+    k = [_int_from_bytes(tagged_hash("MuSig/nonce", buf + bytes([i]))) % N
+         for i in range(2)]
+    if 0 in k:
+        raise RuntimeError("Failure, probability of this is negligible")
+    secnonce = _bytes_from_int(k[0]) + _bytes_from_int(k[1]) + pubkey
+    pubnonce = _cbytes(point_mul(G, k[0])) + _cbytes(point_mul(G, k[1]))
+    return (secnonce, pubnonce)
+
+
+def nonce_agg(pubnonces):
+    """Aggregates public nonces of all signers."""
+    aggnonce = b''
+    for j in range(2):
+        r_j = None
+        for pubnonce in pubnonces:
+            if len(pubnonce) != PUBNONCE_LEN:
+                raise ValueError("Invalid public nonce")
+            r_j = point_add(r_j, _cpoint(
+                pubnonce[j * PUBKEY_LEN:(j + 1) * PUBKEY_LEN]))
+        aggnonce += _cbytes_ext(r_j)
+    return aggnonce
+
+
+def _session_values(aggnonce, pubkeys, msg):
+    agg = _key_agg_point(pubkeys)
+    b = _int_from_bytes(tagged_hash("MuSig/noncecoef",
+                                    aggnonce + _xbytes(agg) + msg)) % N
+    r_1 = _cpoint_ext(aggnonce[0:PUBKEY_LEN])
+    r_2 = _cpoint_ext(aggnonce[PUBKEY_LEN:PUBNONCE_LEN])
+    r = point_add(r_1, point_mul(r_2, b) if r_2 else None)
+    r = G if r is None else r
+    e = _int_from_bytes(tagged_hash("BIP0340/challenge",
+                                    _xbytes(r) + _xbytes(agg) + msg)) % N
+    return (agg, b, r, e)
+
+
+def sign(secnonce, seckey, aggnonce, pubkeys, msg):
+    """Produces a 32-byte partial signature of a message."""
+    if len(secnonce) != SECNONCE_LEN:
+        raise ValueError("Invalid secret nonce")
+    agg, b, r, e = _session_values(aggnonce, pubkeys, msg)
+    k_1 = _int_from_bytes(secnonce[0:32])
+    k_2 = _int_from_bytes(secnonce[32:64])
+    if not (1 <= k_1 <= N - 1 and 1 <= k_2 <= N - 1):
+        raise ValueError("Secret nonce is out of range")
+    if not _has_even_y(r):
+        k_1, k_2 = N - k_1, N - k_2
+    d_ = _int_from_bytes(seckey)
+    if not (1 <= d_ <= N - 1):
+        raise ValueError("Private key is out of range")
+    pubkey = pubkey_from_seckey(seckey)
+    if pubkey != secnonce[64:]:
+        raise ValueError("Secret nonce does not match the private key")
+    if pubkey not in pubkeys:
+        raise ValueError("Signer is not in the list of public keys")
+    a = _key_agg_coeff(pubkeys, pubkey)
+    d = d_ if _has_even_y(agg) else N - d_
+    return _bytes_from_int((k_1 + b * k_2 + e * a * d) % N)
+
+
+def partial_sig_verify(psig, pubnonce, pubkey, aggnonce, pubkeys, msg):
+    """Verifies a partial signature of one signer."""
+    s = _int_from_bytes(psig)
+    if len(psig) != PSIG_LEN or s >= N:
+        return False
+    agg, b, r, e = _session_values(aggnonce, pubkeys, msg)
+    r_s = point_add(_cpoint(pubnonce[0:PUBKEY_LEN]),
+                    point_mul(_cpoint(pubnonce[PUBKEY_LEN:]), b))
+    r_s = r_s if _has_even_y(r) else (r_s[0], P - r_s[1])
+    g = 1 if _has_even_y(agg) else N - 1
+    a = _key_agg_coeff(pubkeys, pubkey)
+    expected = point_add(r_s, point_mul(_cpoint(pubkey), e * a * g % N))
+    return point_mul(G, s) == expected
+
+
+def partial_sig_agg(psigs, aggnonce, pubkeys, msg):
+    """Combines partial signatures into a 64-byte BIP-340 signature."""
+    _, _, r, _ = _session_values(aggnonce, pubkeys, msg)
+    s = 0
+    for psig in psigs:
+        s_i = _int_from_bytes(psig)
+        if len(psig) != PSIG_LEN or s_i >= N:
+            raise ValueError("Invalid partial signature")
+        s = (s + s_i) % N
+    return _xbytes(r) + _bytes_from_int(s)
@@ -0,0 +1,96 @@
+import pytest
+from .musig2 import *
+from . import bip340
+
+# Public keys from key aggregation test vectors of BIP-327
+X = [bytes.fromhex(k) for k in (
+    '02F9308A019258C31049344F85F89D5229B531C845836F99B08601F113BCE036F9',
+    '03DFF1D77F2A671C5F36183726DB2341BE58FEAE1DA2DECED843240F7B502BA659',
+    '023590A94E768F8E1815C2F24B4D80A8E3149316C3518CE7B7AD338368D038CA66',
+)]
+
+# Key aggregation test vectors of BIP-327: (key indexes, aggregate key)
+key_agg_vectors = [
+    ([0, 1, 2],
+     '90539EEDE565F5D054F32CC0C220126889ED1E5D193BAF15AEF344FE59D4610C'),
+    ([2, 1, 0],
+     '6204DE8B083426DC6EAF9502D27024D53FC826BF7D2012148A0575435DF54B2B'),
+    ([0, 0, 0],
+     'B436E3BAD62B8CD409969A224731C193D051162D8C5AE8B109306127DA3AA935'),
+    ([0, 0, 1, 1],
+     '69BC22BFA5D106306E48A20679DE1D7389386124D07571D0D872686028C26A3E'),
+]
+
+# Private keys of signers used to test signing
+seckeys = [(i * 0x1234567).to_bytes(32, 'big') for i in range(1, 4)]
+# Message used to test signing
+message = bytes(range(32))
+
+
+def test_key_agg():
+    for indexes, agg_key in key_agg_vectors:
+        assert key_agg([X[i] for i in indexes]) == bytes.fromhex(agg_key)
+    with pytest.raises(ValueError):
+        key_agg([])
+    with pytest.raises(ValueError):
+        key_agg([b'\x05' + X[0][1:]])
+
+
+def test_compress_pubkey():
+    for seckey in seckeys:
+        point = point_mul(G, int.from_bytes(seckey, 'big'))
+        pubkey = (b'\x04' + point[0].to_bytes(32, 'big') +
+                  point[1].to_bytes(32, 'big'))
+        assert compress_pubkey(pubkey) == pubkey_from_seckey(seckey)
+    with pytest.raises(ValueError):
+        compress_pubkey(X[0])
+
+
+def make_signature(signers, msg=message):
+    pubkeys = sorted(pubkey_from_seckey(sk) for sk in signers)
+    nonces = [nonce_gen(sk, pubkey_from_seckey(sk), msg, bytes([i]) * 32)
+              for i, sk in enumerate(signers)]
+    aggnonce = nonce_agg([pubnonce for _, pubnonce in nonces])
+    psigs = [sign(secnonce, sk, aggnonce, pubkeys, msg)
+             for (secnonce, _), sk in zip(nonces, signers)]
+    for psig, (_, pubnonce), sk in zip(psigs, nonces, signers):
+        assert partial_sig_verify(psig, pubnonce, pubkey_from_seckey(sk),
+                                  aggnonce, pubkeys, msg)
+    return (pubkeys, nonces, aggnonce, psigs,
+            partial_sig_agg(psigs, aggnonce, pubkeys, msg))
+
+
+def test_sign_verify():
+    for n_signers in range(1, len(seckeys) + 1):
+        pubkeys, _, _, _, sig = make_signature(seckeys[:n_signers])
+        assert bip340.verify(sig, message, key_agg(pubkeys))
+        wrong_msg = message[:-1] + bytes([message[-1] ^ 1])
+        assert not bip340.verify(sig, wrong_msg, key_agg(pubkeys))
+        if n_signers > 1:
+            assert not bip340.verify(sig, message, key_agg(pubkeys[1:]))
+
+
+def test_partial_sig_invalid():
+    pubkeys, nonces, aggnonce, psigs, _ = make_signature(seckeys)
+    wrong_psig = (int.from_bytes(psigs[0], 'big') + 1).to_bytes(32, 'big')
+    assert not partial_sig_verify(wrong_psig, nonces[0][1],
+                                  pubkey_from_seckey(seckeys[0]), aggnonce,
+                                  pubkeys, message)
+    sig = partial_sig_agg([wrong_psig] + psigs[1:], aggnonce, pubkeys, message)
+    assert not bip340.verify(sig, message, key_agg(pubkeys))
+    with pytest.raises(ValueError):
+        partial_sig_agg([N.to_bytes(32, 'big')], aggnonce, pubkeys, message)
+
+
+def test_sign_invalid():
+    pubkeys = [pubkey_from_seckey(sk) for sk in seckeys]
+    secnonce, pubnonce = nonce_gen(seckeys[0], pubkeys[0], message, bytes(32))
+    aggnonce = nonce_agg([pubnonce])
+    # Secret nonce of another signer
+    with pytest.raises(ValueError):
+        sign(secnonce, seckeys[1], aggnonce, pubkeys, message)
+    # Signer is not in the list of public keys
+    with pytest.raises(ValueError):
+        sign(secnonce, seckeys[0], aggnonce, pubkeys[1:], message)
+    with pytest.raises(ValueError):
+        nonce_gen(seckeys[0], pubkeys[0], message, bytes(31))
@@ -0,0 +1,142 @@
+"""File-based MuSig2 signing session for upgrade files.
+
+Signers exchange data through a session directory, one file per signer and
+round, named after the fingerprint of the signer's public key:
+
+1. Each signer generates a nonce pair. The public nonce is written to the
+   session directory as "<fingerprint>.nonce", the secret nonce is written to
+   a separate file kept by the signer.
+2. When all nonces are present, each signer produces a partial signature,
+   written as "<fingerprint>.psig". The secret nonce file is destroyed so that
+   the nonce cannot be reused.
+3. Partial signatures are verified and combined into a single signature.
+
+All files are JSON objects with hex-encoded binary values. Each file includes
+the signed message, so that signers of different upgrade files are detected.
+The set of signers is the set of public nonces found in the session directory,
+ordered by fingerprints of public keys.
+"""
+
+import os
+import json
+from . import musig2
+from . import bip340
+from .signature import (pubkey_from_seckey, pubkey_fingerprint,
+                        message_digest)
+
+# Extension of a public nonce file
+NONCE_EXT = '.nonce'
+# Extension of a partial signature file
+PSIG_EXT = '.psig'
+
+
+class SessionError(Exception):
+    pass
+
+
+def _write_json(path, obj):
+    with open(path, 'x') as f:
+        json.dump(obj, f, indent=2)
+
+
+def _read_json(path):
+    with open(path, 'r') as f:
+        return json.load(f)
+
+
+def _session_path(session_dir, pubkey, ext):
+    return os.path.join(session_dir, pubkey_fingerprint(pubkey).hex() + ext)
+
+
+def _load_files(session_dir, ext, message):
+    """Loads files of all signers, returning {pubkey: object}."""
+    result = {}
+    for name in sorted(os.listdir(session_dir)):
+        if not name.endswith(ext):
+            continue
+        obj = _read_json(os.path.join(session_dir, name))
+        if obj.get('message') != message.decode('ascii'):
+            raise SessionError(f"{name}: message does not match")
+        pubkey = bytes.fromhex(obj['pubkey'])
+        if name != pubkey_fingerprint(pubkey).hex() + ext:
+            raise SessionError(f"{name}: file name does not match the key")
+        result[pubkey] = obj
+    return result
+
+
+def _signers(nonces):
+    """Returns public keys of signers sorted by fingerprint."""
+    return sorted(nonces.keys(), key=pubkey_fingerprint)
+
+
+def create_nonce(session_dir, secnonce_file, seckey, message):
+    """Round 1: generates a nonce pair of a signer."""
+    pubkey = pubkey_from_seckey(seckey)
+    secnonce, pubnonce = musig2.nonce_gen(
+        seckey, musig2.compress_pubkey(pubkey), message_digest(message),
+        os.urandom(32))
+    msg = message.decode('ascii')
+    _write_json(secnonce_file, {'message': msg, 'secnonce': secnonce.hex(),
+                                'pubnonce': pubnonce.hex()})
+    _write_json(_session_path(session_dir, pubkey, NONCE_EXT),
+                {'message': msg, 'pubkey': pubkey.hex(),
+                 'pubnonce': pubnonce.hex()})
+
+
+def create_partial_sig(session_dir, secnonce_file, seckey, message):
+    """Round 2: produces a partial signature, destroying the secret nonce."""
+    pubkey = pubkey_from_seckey(seckey)
+    nonces = _load_files(session_dir, NONCE_EXT, message)
+    secret = _read_json(secnonce_file)
+    if secret.get('message') != message.decode('ascii'):
+        raise SessionError("Secret nonce is made for another message")
+    if (pubkey not in nonces or
+            nonces[pubkey]['pubnonce'] != secret['pubnonce']):
+        raise SessionError("Public nonce of the signer is not found")
+
+    # Destroy the secret nonce before signing, so it is never used twice
+    secnonce = bytes.fromhex(secret['secnonce'])
+    with open(secnonce_file, 'r+') as f:
+        f.write(' ' * len(f.read()))
+    os.remove(secnonce_file)
+
+    signers = _signers(nonces)
+    aggnonce = musig2.nonce_agg(
+        [bytes.fromhex(nonces[pk]['pubnonce']) for pk in signers])
+    psig = musig2.sign(secnonce, seckey, aggnonce,
+                       [musig2.compress_pubkey(pk) for pk in signers],
+                       message_digest(message))
+    _write_json(_session_path(session_dir, pubkey, PSIG_EXT),
+                {'message': message.decode('ascii'), 'pubkey': pubkey.hex(),
+                 'psig': psig.hex()})
+
+
+def combine(session_dir, message):
+    """Round 3: verifies and combines partial signatures returning a tuple
+    (signature, fingerprints of signers)."""
+    nonces = _load_files(session_dir, NONCE_EXT, message)
+    psigs = _load_files(session_dir, PSIG_EXT, message)
+    if not nonces:
+        raise SessionError("No signers found")
+    if set(psigs.keys()) != set(nonces.keys()):
+        raise SessionError("Partial signatures do not match public nonces")
+
+    signers = _signers(nonces)
+    pubkeys = [musig2.compress_pubkey(pk) for pk in signers]
+    pubnonces = [bytes.fromhex(nonces[pk]['pubnonce']) for pk in signers]
+    aggnonce = musig2.nonce_agg(pubnonces)
+    digest = message_digest(message)
+    for pk, pubnonce in zip(signers, pubnonces):
+        psig = bytes.fromhex(psigs[pk]['psig'])
+        if not musig2.partial_sig_verify(psig, pubnonce,
+                                         musig2.compress_pubkey(pk), aggnonce,
+                                         pubkeys, digest):
+            fp = pubkey_fingerprint(pk).hex()
+            raise SessionError(f"Invalid partial signature of {fp}")
+
+    signature = musig2.partial_sig_agg(
+        [bytes.fromhex(psigs[pk]['psig']) for pk in signers], aggnonce,
+        pubkeys, digest)
+    if not bip340.verify(signature, digest, musig2.key_agg(pubkeys)):
+        raise SessionError("Aggregate signature does not pass verification")
+    return (signature, [pubkey_fingerprint(pk) for pk in signers])
@@ -0,0 +1,74 @@
+import os
+import tempfile
+import pytest
+from .musigsession import *
+from .signature import pubkey_from_seckey, pubkey_fingerprint, message_digest
+from . import musig2
+from . import bip340
+
+# Private keys of signers
+seckeys = [(i * 0x7654321).to_bytes(32, 'big') for i in range(1, 4)]
+# Signed message
+message = b'b1.0.0-1.0.0-1testmessage'
+
+
+def run_session(session_dir, signers, msg=message):
+    secnonce_files = [os.path.join(session_dir, f'secret{i}.json')
+                      for i in range(len(signers))]
+    for sk, secnonce_file in zip(signers, secnonce_files):
+        create_nonce(session_dir, secnonce_file, sk, msg)
+    for sk, secnonce_file in zip(signers, secnonce_files):
+        create_partial_sig(session_dir, secnonce_file, sk, msg)
+        assert not os.path.exists(secnonce_file)
+
+
+def test_session():
+    with tempfile.TemporaryDirectory() as session_dir:
+        run_session(session_dir, seckeys)
+        signature, signers = combine(session_dir, message)
+    pubkeys = sorted((pubkey_from_seckey(sk) for sk in seckeys),
+                     key=pubkey_fingerprint)
+    assert signers == [pubkey_fingerprint(pk) for pk in pubkeys]
+    agg_pubkey = musig2.key_agg([musig2.compress_pubkey(pk)
+                                 for pk in pubkeys])
+    assert bip340.verify(signature, message_digest(message), agg_pubkey)
+
+
+def test_secnonce_reuse():
+    with tempfile.TemporaryDirectory() as session_dir:
+        secnonce_file = os.path.join(session_dir, 'secret.json')
+        create_nonce(session_dir, secnonce_file, seckeys[0], message)
+        create_partial_sig(session_dir, secnonce_file, seckeys[0], message)
+        with pytest.raises(FileNotFoundError):
+            create_partial_sig(session_dir, secnonce_file, seckeys[0],
+                               message)
+
+
+def test_session_invalid():
+    with tempfile.TemporaryDirectory() as session_dir:
+        secnonce_file = os.path.join(session_dir, 'secret.json')
+        create_nonce(session_dir, secnonce_file, seckeys[0], message)
+        # Another message
+        with pytest.raises(SessionError):
+            create_partial_sig(session_dir, secnonce_file, seckeys[0],
+                               message + b'x')
+        # Another signer
+        with pytest.raises(SessionError):
+            create_partial_sig(session_dir, secnonce_file, seckeys[1],
+                               message)
+        # Partial signature is missing
+        with pytest.raises(SessionError):
+            combine(session_dir, message)
+
+    with tempfile.TemporaryDirectory() as session_dir:
+        run_session(session_dir, seckeys[:2])
+        # Corrupted partial signature
+        name = pubkey_fingerprint(pubkey_from_seckey(seckeys[1])).hex()
+        path = os.path.join(session_dir, name + PSIG_EXT)
+        with open(path, 'r') as f:
+            obj = json.load(f)
+        obj['psig'] = (int(obj['psig'], 16) ^ 1).to_bytes(32, 'big').hex()
+        with open(path, 'w') as f:
+            json.dump(obj, f)
+        with pytest.raises(SessionError):
+            combine(session_dir, message)
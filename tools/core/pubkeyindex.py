@@ -0,0 +1,112 @@
+"""Generator of public key fingerprint index for pubkeys.c files."""
+
+import re
+from .signature import pubkey_fingerprint
+
+# First line of generated fingerprint index
+INDEX_BEGIN = "// BEGIN PUBKEY INDEX"
+# Last line of generated fingerprint index
+INDEX_END = "// END PUBKEY INDEX"
+# Name of generated index array
+INDEX_NAME = "pubkey_index"
+
+# Definition of a public key list: static const bl_pubkey_t name[] = {...};
+_list_re = re.compile(
+    r"static\s+const\s+bl_pubkey_t\s+(\w+)\s*\[\s*\]\s*=\s*\{(.*?)"
+    r"BL_PUBKEY_END_OF_LIST\s*\}\s*;", re.S)
+# Public key record: {.bytes = {...}}
+_key_re = re.compile(r"\{\s*\.bytes\s*=\s*\{([^}]*)\}\s*\}")
+# Single-line comments
+_comment_re = re.compile(r"//[^\n]*")
+# Definition of the public key set with an optional comment line before it
+_set_re = re.compile(r"(^//[^\n]*\n)?^const\s+bl_pubkey_set_t\s", re.M)
+
+
+def _parse_byte(token):
+    token = token.strip().rstrip('uU')
+    value = int(token, 0)
+    if not 0 <= value <= 0xFF:
+        raise ValueError(f"Invalid byte value: {token}")
+    return value
+
+
+def parse_pubkey_lists(source):
+    """Parses public key lists from C source, returns a list of tuples
+    (list_name, [pubkey, ...]) in order of definition.
+    """
+    lists = []
+    for list_match in _list_re.finditer(source):
+        body = _comment_re.sub('', list_match.group(2))
+        keys = []
+        for key_match in _key_re.finditer(body):
+            tokens = [t for t in key_match.group(1).split(',') if t.strip()]
+            keys.append(bytes(_parse_byte(t) for t in tokens))
+        lists.append((list_match.group(1), keys))
+    return lists
+
+
+def make_index(lists):
+    """Makes fingerprint index for public key lists, returns a list of tuples
+    (fingerprint, list_name, key_index) sorted by fingerprint.
+    """
+    entries = []
+    for list_name, keys in lists:
+        for idx, key in enumerate(keys):
+            entries.append((pubkey_fingerprint(key), list_name, idx))
+    # Stable sort keeps order of lists for identical keys
+    return sorted(entries, key=lambda entry: entry[0])
+
+
+def _c_bytes(data, indent):
+    items = [f"0x{b:02X}U" for b in data]
+    lines = []
+    line = ""
+    for item in items:
+        candidate = f"{line}, {item}" if line else item
+        if len(indent) + len(candidate) + 1 > 80:
+            lines.append(line + ",")
+            line = item
+        else:
+            line = candidate
+    lines.append(line)
+    return ("\n" + indent).join(lines)
+
+
+def index_to_c(index):
+    """Returns C source of a fingerprint index, enclosed in marker lines"""
+    out = [INDEX_BEGIN,
+           "// Fingerprint index of all public keys, sorted by fingerprint.",
+           "// A key present in several lists has an entry for each list.",
+           "// Generated by tools/pubkey-index.py, do not edit.",
+           f"static const bl_pubkey_index_entry_t {INDEX_NAME}[] = {{"]
+    for fingerprint, list_name, idx in index:
+        out.append("    {.fingerprint = {" +
+                   _c_bytes(fingerprint, " " * 21) + "},")
+        out.append(f"     .p_pubkey = &{list_name}[{idx}]}},")
+    out.append("};")
+    out.append(INDEX_END)
+    return "\n".join(out) + "\n"
+
+
+def update_source(source):
+    """Returns C source with the fingerprint index generated or regenerated
+    for all public key lists it contains.
+    """
+    lists = parse_pubkey_lists(source)
+    if not lists:
+        raise ValueError("No public key lists found")
+    index_c = index_to_c(make_index(lists))
+
+    begin = source.find(INDEX_BEGIN)
+    if begin >= 0:
+        end = source.find(INDEX_END, begin)
+        if end < 0:
+            raise ValueError("End marker of fingerprint index not found")
+        end = source.index("\n", end) + 1
+        return source[:begin] + index_c + source[end:]
+
+    set_match = _set_re.search(source)
+    if not set_match:
+        raise ValueError("Definition of bl_pubkey_set not found")
+    pos = set_match.start()
+    return source[:pos] + index_c + "\n" + source[pos:]
@@ -0,0 +1,76 @@
+import pytest
+from .pubkeyindex import *
+from .signature import pubkey_fingerprint
+
+# Test keys: valid prefix, arbitrary contents
+_key1 = bytes([0x04]) + bytes(range(1, 65))
+_key2 = bytes([0x04]) + bytes(range(64, 0, -1))
+_key3 = bytes([0x04]) + bytes([0xA5] * 64)
+
+
+def _c_key(key):
+    return "{.bytes = {" + ", ".join(f"0x{b:02X}U" for b in key) + "}}"
+
+
+# Minimal pubkeys.c with a key shared by both lists
+_source = f"""#include "bootloader.h"
+
+// List of Vendor public keys
+static const bl_pubkey_t vendor_pubkey_list[] = {{
+    // Key 1
+    {_c_key(_key1)},
+    {_c_key(_key2)},
+    BL_PUBKEY_END_OF_LIST}};
+
+// List of Maintainer public keys
+static const bl_pubkey_t maintainer_pubkey_list[] = {{
+    {_c_key(_key3).lower()},
+    {_c_key(_key1)},
+    BL_PUBKEY_END_OF_LIST}};
+
+// Test set of public keys and signature thresholds
+const bl_pubkey_set_t bl_pubkey_set = {{
+    .vendor_pubkeys = vendor_pubkey_list}};
+"""
+
+
+def test_parse_pubkey_lists():
+    lists = parse_pubkey_lists(_source)
+    assert lists == [('vendor_pubkey_list', [_key1, _key2]),
+                     ('maintainer_pubkey_list', [_key3, _key1])]
+
+
+def test_make_index():
+    index = make_index(parse_pubkey_lists(_source))
+    assert len(index) == 4
+    fingerprints = [entry[0] for entry in index]
+    assert fingerprints == sorted(fingerprints)
+    assert (pubkey_fingerprint(_key3), 'maintainer_pubkey_list', 0) in index
+    # Identical keys keep order of lists
+    dup = [entry[1:] for entry in index
+           if entry[0] == pubkey_fingerprint(_key1)]
+    assert dup == [('vendor_pubkey_list', 0), ('maintainer_pubkey_list', 1)]
+
+
+def test_update_source():
+    updated = update_source(_source)
+    assert updated.count(INDEX_BEGIN) == 1
+    # Index is inserted before the comment of the key set definition
+    assert (updated.index(INDEX_END) <
+            updated.index("// Test set of public keys"))
+    assert "&maintainer_pubkey_list[0]" in updated
+    # A shared key has an entry for each list, as noted in the comment
+    assert "A key present in several lists" in updated
+    index_c = updated[updated.index(INDEX_BEGIN):updated.index(INDEX_END)]
+    assert all(len(line) <= 80 for line in index_c.splitlines())
+    # Regeneration replaces the existing index
+    assert update_source(updated) == updated
+
+
+def test_update_source_errors():
+    with pytest.raises(ValueError):
+        update_source("int x;")
+    with pytest.raises(ValueError):
+        update_source(_source.replace("const bl_pubkey_set_t", "int"))
+    with pytest.raises(ValueError):
+        update_source(update_source(_source).replace(INDEX_END, ""))
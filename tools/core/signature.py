@@ -1,6 +1,8 @@
 """Signature functions compliant with the format of Bootloader upgrade file."""
 
+import os
 from . import secp256k1
+from . import bip340
 from cryptography.hazmat.primitives import serialization
 from cryptography.hazmat.primitives.serialization import Encoding
 from cryptography.hazmat.backends import default_backend
@@ -17,6 +19,14 @@ FINGERPRINT_LEN = 16
 SIGNATURE_LEN = 64
 # Digital signature algorithm: secp256k1-sha256
 DSA_SECP256K1_SHA256 = 'secp256k1-sha256'
+# Digital signature algorithm: secp256k1-schnorr-sha256 (BIP-340)
+DSA_SECP256K1_SCHNORR_SHA256 = 'secp256k1-schnorr-sha256'
+# Digital signature algorithm: secp256k1-musig2-sha256 (BIP-327)
+DSA_SECP256K1_MUSIG2_SHA256 = 'secp256k1-musig2-sha256'
+# Supported digital signature algorithms with one signature per key
+DSA_ALGORITHMS = [DSA_SECP256K1_SHA256, DSA_SECP256K1_SCHNORR_SHA256]
+# Supported digital signature algorithms with one signature made jointly
+DSA_AGGREGATE_ALGORITHMS = [DSA_SECP256K1_MUSIG2_SHA256]
 
 
 class InvalidPassword(Exception):
@@ -53,6 +63,11 @@ def _validate_signature(signature):
         raise ValueError("Signature should be empty 64 bytes long")
 
 
+def _validate_algorithm(algorithm):
+    if algorithm not in DSA_ALGORITHMS:
+        raise ValueError("Digital signature algorithm not supported")
+
+
 def _to_bytes(value):
     if isinstance(value, bytes):
         return value
@@ -112,19 +127,36 @@ def _message_magic(message):
     return b"\x18Bitcoin Signed Message:\n" + bytes([len(message)]) + message
 
 
-def sign(message, seckey):
-    """Signs a message with given private key."""
+def message_digest(message):
+    """Returns 32-byte digest of a message, signed by all algorithms."""
+    return _sha256(_sha256(_message_magic(message)))
+
+
+def sign(message, seckey, algorithm=DSA_SECP256K1_SHA256):
+    """Signs a message with given private key.
+
+    Both algorithms sign the same digest of the message. Schnorr signatures
+    are made according to BIP-340 using fresh auxiliary random data.
+    """
     _validate_seckey(seckey)
-    msg_hash = _sha256(_sha256(_message_magic(message)))
+    _validate_algorithm(algorithm)
+    msg_hash = message_digest(message)
+    if algorithm == DSA_SECP256K1_SCHNORR_SHA256:
+        return bip340.sign(msg_hash, _to_bytes(seckey), os.urandom(32))
     sig_obj = secp256k1.ecdsa_sign(msg_hash, _to_bytes(seckey))
     return secp256k1.ecdsa_signature_serialize_compact(sig_obj)
 
 
-def verify(signature, message, pubkey):
+def verify(signature, message, pubkey, algorithm=DSA_SECP256K1_SHA256):
     """Verifies signature of a message with given public key."""
     _validate_signature(signature)
     _validate_pubkey(pubkey)
-    msg_hash = _sha256(_sha256(_message_magic(message)))
+    _validate_algorithm(algorithm)
+    msg_hash = message_digest(message)
+    if algorithm == DSA_SECP256K1_SCHNORR_SHA256:
+        # BIP-340 uses X coordinate of the public key
+        return bip340.verify(_to_bytes(signature), msg_hash,
+                             _to_bytes(pubkey[1:33]))
     pubkey_obj = secp256k1.ec_pubkey_parse(_to_bytes(pubkey))
     sig_obj = secp256k1.ecdsa_signature_parse_compact(_to_bytes(signature))
     return secp256k1.ecdsa_verify(sig_obj, msg_hash, pubkey_obj)
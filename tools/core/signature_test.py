@@ -105,6 +105,20 @@ def test_sign_verify():
     assert not verify(wrong_signature, ref_message, ref_pubkey)
 
 
+def test_sign_verify_schnorr():
+    algo = DSA_SECP256K1_SCHNORR_SHA256
+    signature = sign(ref_message, ref_seckey, algo)
+    assert isinstance(signature, bytes)
+    assert len(signature) == SIGNATURE_LEN
+    assert verify(signature, ref_message, ref_pubkey, algo)
+    assert not verify(signature, ref_message, wrong_pubkey, algo)
+    assert not verify(signature, ref_message + b"x", ref_pubkey, algo)
+    wrong_signature = sign(ref_message, wrong_seckey, algo)
+    assert not verify(wrong_signature, ref_message, ref_pubkey, algo)
+    with pytest.raises(ValueError):
+        sign(ref_message, ref_seckey, 'secp256k1-unknown')
+
+
 def test_parse_recoverable_sig():
     msg = b"Hello world"
     pubkey = secp256k1.ec_pubkey_serialize(
@@ -0,0 +1,41 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Generator of precomputed ecmult tables for libsecp256k1"""
+
+import click
+from core.ecmulttable import (generate_header, table_entries, table_size,
+                              MIN_WINDOW, MAX_WINDOW)
+__author__ = "Mike Tolkachev <contact@miketolkachev.dev>"
+__copyright__ = "Copyright 2020 Crypto Advance GmbH. All rights reserved"
+__version__ = "1.0.0"
+
+
+@click.command(no_args_is_help=True)
+@click.version_option(__version__, message="%(version)s")
+@click.option(
+    '-w', '--window', 'window',
+    type=click.IntRange(MIN_WINDOW, MAX_WINDOW),
+    required=True,
+    help='Window size, should match ECMULT_WINDOW_SIZE of the build.'
+)
+@click.argument(
+    'header_file',
+    required=True,
+    type=click.Path(dir_okay=False, writable=True),
+    metavar='<ecmult_static_pre_g.h>'
+)
+def cli(window, header_file):
+    """Generates a C header with a constant table of precomputed multiples of
+    secp256k1 generator, used for signature verification when the Bootloader
+    is built with ECMULT_STATIC=1. The header is normally generated by the
+    Makefile of a platform.
+    """
+    with open(header_file, 'w') as f:
+        f.write(generate_header(window))
+    click.echo(f"ecmult table: window {window}, {table_entries(window)} "
+               f"entries, {table_size(window)} bytes")
+
+
+if __name__ == '__main__':
+    cli()
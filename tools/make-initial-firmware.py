@@ -115,8 +115,8 @@ def intelhex_add_data(ih_obj, addr, data):
 
 
 def intelhex_add_icr(ih_obj, storage_size):
-    """Adds an integrity check record to to IntelHex object at address
-    calculated using provided storage size.
+    """Adds an integrity check record and a block CRC table to IntelHex object
+    at addresses calculated using provided storage size.
     """
 
     if not isinstance(ih_obj, IntelHex):
@@ -127,9 +127,12 @@ def intelhex_add_icr(ih_obj, storage_size):
             data_len + BL_FW_SECT_OVERHEAD > storage_size):
         raise click.ClickException(f"Error while parsing '{hex_file.name}'")
 
-    icr = icr_create(intelhex_to_bytes(ih_obj))
-    addr = ih_obj.minaddr() + storage_size - BL_ICR_OFFSET_FROM_END
-    intelhex_add_data(ih_obj, addr, icr)
+    firmware = intelhex_to_bytes(ih_obj)
+    icr = icr_create(firmware)
+    bct = bct_create(firmware, icr)
+    end_addr = ih_obj.minaddr() + storage_size
+    intelhex_add_data(ih_obj, end_addr - BL_BCT_OFFSET_FROM_END, bct)
+    intelhex_add_data(ih_obj, end_addr - BL_ICR_OFFSET_FROM_END, icr)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Generator of public key fingerprint index"""
+
+import click
+from core.pubkeyindex import update_source
+__author__ = "Mike Tolkachev <contact@miketolkachev.dev>"
+__copyright__ = "Copyright 2020 Crypto Advance GmbH. All rights reserved"
+__version__ = "1.0.0"
+
+
+@click.command(no_args_is_help=True)
+@click.version_option(__version__, message="%(version)s")
+@click.option(
+    '--check', 'check_only',
+    is_flag=True,
+    default=False,
+    help='Only check that the index is up to date, do not modify the file.'
+)
+@click.argument(
+    'pubkeys_file',
+    required=True,
+    type=click.Path(exists=True, dir_okay=False),
+    metavar='<pubkeys.c>'
+)
+def cli(pubkeys_file, check_only):
+    """Generates or updates a sorted index of public key fingerprints inside a
+    pubkeys.c file. The index is placed before the definition of bl_pubkey_set
+    and has to be referenced from it using pubkey_index and pubkey_index_size
+    fields. Run this tool each time when public keys are changed.
+    """
+    with open(pubkeys_file, 'r', newline='') as f:
+        source = f.read()
+    try:
+        updated = update_source(source)
+    except ValueError as e:
+        raise click.ClickException(str(e))
+
+    if updated == source:
+        click.echo("Fingerprint index is up to date")
+    elif check_only:
+        raise click.ClickException("Fingerprint index is outdated")
+    else:
+        with open(pubkeys_file, 'w', newline='') as f:
+            f.write(updated)
+        click.echo("Fingerprint index updated")
+
+
+if __name__ == '__main__':
+    cli()
@@ -7,6 +7,8 @@ import getpass
 from intelhex import IntelHex
 import click
 import core.signature as sig
+import core.lzss as lzss
+import core.musigsession as musig
 from core.blsection import *
 __author__ = "Mike Tolkachev <contact@miketolkachev.dev>"
 __copyright__ = "Copyright 2020 Crypto Advance GmbH. All rights reserved"
@@ -48,13 +50,26 @@ def cli():
     help='Platform identifier, i.e. stm32f469disco.',
     metavar='<platform>'
 )
+@click.option(
+    '-c', '--compress',
+    is_flag=True,
+    help='Compress payload of firmware sections.'
+)
+@click.option(
+    '-a', '--algorithm',
+    type=click.Choice(sig.DSA_ALGORITHMS),
+    default=sig.DSA_SECP256K1_SHA256,
+    show_default=True,
+    help='Digital signature algorithm of the Signature section.'
+)
 @click.argument(
     'upgrade_file',
     required=True,
     type=click.File('wb'),
     metavar='<upgrade_file.bin>'
 )
-def generate(upgrade_file, bootloader_hex, firmware_hex, platform, key_pem):
+def generate(upgrade_file, bootloader_hex, firmware_hex, platform, key_pem,
+             compress, algorithm):
     """This command generates an upgrade file from given firmware files
     in Intel HEX format. It is required to specify at least one firmware
     file: Firmware or Bootloader.
@@ -62,6 +77,14 @@ def generate(upgrade_file, bootloader_hex, firmware_hex, platform, key_pem):
     In addition, if a private key is provided it is used to sign produced
     upgrade file. Private key should be in PEM container with or without
     encryption.
+
+    Payload is hashed and signed in uncompressed form, but the compression
+    attributes in section headers are signed as well: an upgrade file must be
+    compressed before it is signed.
+
+    All signatures of an upgrade file use the same algorithm, chosen with
+    --algorithm: ECDSA (default) or BIP-340 Schnorr. Schnorr signatures are
+    verified by the Bootloader in a batch, which is faster for multisig.
     """
     # Load private key if needed
     seckey = None
@@ -70,16 +93,20 @@ def generate(upgrade_file, bootloader_hex, firmware_hex, platform, key_pem):
 
     # Create payload sections from HEX files
     sections = []
+    compression = lzss.ALGORITHM if compress else None
     if bootloader_hex:
         sections.append(create_payload_section(
-            bootloader_hex, 'boot', platform))
+            bootloader_hex, 'boot', platform, compression))
     if firmware_hex:
         sections.append(create_payload_section(
-            firmware_hex, 'main', platform))
+            firmware_hex, 'main', platform, compression))
     if not len(sections):
         raise click.ClickException("No input file specified")
 
-    # Sign firmware if requested
+    # Sign firmware if requested. An unsigned file gets an empty Signature
+    # section only to remember a non-default algorithm for the "sign" command.
+    if seckey or algorithm != sig.DSA_SECP256K1_SHA256:
+        sections.append(SignatureSection(dsa_algorithm=algorithm))
     if seckey:
         do_sign(sections, seckey)
 
@@ -98,21 +125,31 @@ def generate(upgrade_file, bootloader_hex, firmware_hex, platform, key_pem):
     help='Private key in PEM container used to sign produced upgrade file.',
     metavar='<filename.pem>'
 )
+@ click.option(
+    '-a', '--algorithm',
+    type=click.Choice(sig.DSA_ALGORITHMS),
+    help='Digital signature algorithm, by default the one of the existing '
+    'Signature section or secp256k1-sha256 if the file is not signed.'
+)
 @ click.argument(
     'upgrade_file',
     required=True,
     type=click.File('rb+'),
     metavar='<upgrade_file.bin>'
 )
-def sign(upgrade_file, key_pem):
+def sign(upgrade_file, key_pem, algorithm):
     """This command adds a signature to an existing upgrade file. Private key
     should be provided in PEM container with or without encryption.
 
     The signature is checked for duplication, and any duplicating signatures
     are removed automatically.
+
+    If the upgrade file already has signatures, the new signature is made with
+    the same algorithm; specifying a different algorithm is an error.
     """
     # Load sections from firmware file
     sections = load_sections(upgrade_file)
+    parse_sections(sections, algorithm)
 
     # Load private key and sign firmware
     seckey = load_seckey(key_pem)
@@ -145,7 +182,12 @@ def dump(upgrade_file):
         print(f'  attributes: {s.attributes_str}')
         if s.version_str:
             print(f'  version: {s.version_str}')
-        if isinstance(s, SignatureSection):
+        if isinstance(s, SignatureSection) and s.is_aggregate:
+            if s.aggregate_signature:
+                print(f"  aggregate signature: {s.aggregate_signature.hex()}")
+                print("  signers:\n    " +
+                      "\n    ".join(f.hex() for f in s.signers))
+        elif isinstance(s, SignatureSection):
             sigs = [f"{f.hex()}: {s.hex()}" for f, s in s.signatures.items()]
             print("  signatures:\n    " + "\n    ".join(sigs))
 
@@ -192,7 +234,7 @@ def import_sig(upgrade_file, b64_signature):
     Base64 format.
     """
     sections = load_sections(upgrade_file)
-    pl_sections, _ = parse_sections(sections)
+    pl_sections, _ = parse_sections(sections, sig.DSA_SECP256K1_SHA256)
     sig_message = make_signature_message(pl_sections)
     signature, pubkey = parse_recoverable_sig(b64_signature, sig_message)
     add_signature(sections, signature, pubkey)
@@ -203,7 +245,202 @@ def import_sig(upgrade_file, b64_signature):
     write_sections(upgrade_file, sections)
 
 
-def create_payload_section(hex_file, section_name, platform):
+@ cli.command(
+    'musig-nonce',
+    short_help='MuSig2 round 1: generate a nonce of a signer'
+)
+@ click.option(
+    '-k', '--private-key', 'key_pem',
+    required=True,
+    type=click.File('rb'),
+    help='Private key of the signer in PEM container.',
+    metavar='<filename.pem>'
+)
+@ click.option(
+    '-s', '--session', 'session_dir',
+    required=True,
+    type=click.Path(exists=True, file_okay=False, writable=True),
+    help='Session directory shared by all signers.',
+    metavar='<directory>'
+)
+@ click.option(
+    '-n', '--secret-nonce', 'secnonce_file',
+    required=True,
+    type=click.Path(exists=False, dir_okay=False),
+    help='New file receiving secret nonce, kept private by the signer.',
+    metavar='<file.json>'
+)
+@ click.argument(
+    'upgrade_file',
+    required=True,
+    type=click.File('rb'),
+    metavar='<upgrade_file.bin>'
+)
+def musig_nonce(upgrade_file, key_pem, session_dir, secnonce_file):
+    """This command starts MuSig2 signing of an upgrade file. Signers produce
+    one aggregated signature instead of separate signatures, which is verified
+    by the Bootloader at once.
+
+    In the first round each signer generates a nonce. The public nonce is
+    written into the session directory and the secret nonce into a separate
+    file. The set of signers is defined by nonces found in the session
+    directory.
+    """
+    sections = load_sections(upgrade_file)
+    pl_sections, _ = parse_sections(sections)
+    seckey = load_seckey(key_pem)
+    try:
+        musig.create_nonce(session_dir, secnonce_file, seckey,
+                           make_signature_message(pl_sections))
+    except FileExistsError as e:
+        raise click.ClickException(f"File already exists: {e.filename}")
+
+
+@ cli.command(
+    'musig-sign',
+    short_help='MuSig2 round 2: make a partial signature'
+)
+@ click.option(
+    '-k', '--private-key', 'key_pem',
+    required=True,
+    type=click.File('rb'),
+    help='Private key of the signer in PEM container.',
+    metavar='<filename.pem>'
+)
+@ click.option(
+    '-s', '--session', 'session_dir',
+    required=True,
+    type=click.Path(exists=True, file_okay=False, writable=True),
+    help='Session directory shared by all signers.',
+    metavar='<directory>'
+)
+@ click.option(
+    '-n', '--secret-nonce', 'secnonce_file',
+    required=True,
+    type=click.Path(exists=True, dir_okay=False),
+    help='Secret nonce made by "musig-nonce" command, deleted after use.',
+    metavar='<file.json>'
+)
+@ click.argument(
+    'upgrade_file',
+    required=True,
+    type=click.File('rb'),
+    metavar='<upgrade_file.bin>'
+)
+def musig_sign(upgrade_file, key_pem, session_dir, secnonce_file):
+    """In the second round of MuSig2 signing, when all signers have generated
+    nonces, each signer makes a partial signature and writes it into the
+    session directory. The secret nonce file is destroyed, so it cannot be
+    used again.
+    """
+    sections = load_sections(upgrade_file)
+    pl_sections, _ = parse_sections(sections)
+    seckey = load_seckey(key_pem)
+    try:
+        musig.create_partial_sig(session_dir, secnonce_file, seckey,
+                                 make_signature_message(pl_sections))
+    except (musig.SessionError, ValueError) as e:
+        raise click.ClickException(str(e))
+
+
+@ cli.command(
+    'musig-combine',
+    short_help='MuSig2 round 3: add aggregated signature to upgrade file'
+)
+@ click.option(
+    '-s', '--session', 'session_dir',
+    required=True,
+    type=click.Path(exists=True, file_okay=False),
+    help='Session directory shared by all signers.',
+    metavar='<directory>'
+)
+@ click.argument(
+    'upgrade_file',
+    required=True,
+    type=click.File('rb+'),
+    metavar='<upgrade_file.bin>'
+)
+def musig_combine(upgrade_file, session_dir):
+    """This command completes MuSig2 signing. Partial signatures of all
+    signers are verified and combined into one signature, which replaces the
+    Signature section of the upgrade file. The upgrade file must not contain
+    other signatures.
+    """
+    sections = load_sections(upgrade_file)
+    pl_sections, sig_section = parse_sections(sections)
+    if sig_section.signatures or sig_section.aggregate_signature:
+        raise click.ClickException("Upgrade file is already signed")
+    try:
+        signature, signers = musig.combine(
+            session_dir, make_signature_message(pl_sections))
+    except (musig.SessionError, ValueError) as e:
+        raise click.ClickException(str(e))
+    sig_section = SignatureSection(
+        dsa_algorithm=sig.DSA_SECP256K1_MUSIG2_SHA256)
+    sig_section.set_aggregate(signature, signers)
+
+    # Write new upgrade file to disk
+    upgrade_file.truncate(0)
+    upgrade_file.seek(0)
+    write_sections(upgrade_file, pl_sections + [sig_section])
+
+
+@ cli.command(
+    'delta',
+    short_help='make a delta upgrade file from a full upgrade file'
+)
+@ click.option(
+    '-B', '--base', 'base_hex',
+    required=True,
+    type=click.File('r'),
+    help='Intel HEX file containing the installed Main Firmware.',
+    metavar='<file.hex>'
+)
+@ click.option(
+    '--block-size',
+    type=int,
+    default=128 * 1024,
+    show_default=True,
+    help='Size of the first part of the Main Firmware area in flash memory.',
+    metavar='<bytes>'
+)
+@ click.argument(
+    'upgrade_file',
+    required=True,
+    type=click.File('rb'),
+    metavar='<upgrade_file.bin>'
+)
+@ click.argument(
+    'delta_file',
+    required=True,
+    type=click.File('wb'),
+    metavar='<delta_file.bin>'
+)
+def delta(upgrade_file, delta_file, base_hex, block_size):
+    """This command makes a delta upgrade file, patching the installed Main
+    Firmware in place instead of replacing it. The upgrade file should contain
+    the Main Firmware only.
+
+    Signatures of the upgrade file are copied to the delta file and remain
+    valid, so the upgrade file should be signed before making a delta file.
+    """
+    sections = load_sections(upgrade_file)
+    pl_sections, sig_section = parse_sections(sections)
+    if len(pl_sections) != 1 or pl_sections[0].name != 'main':
+        raise click.ClickException("Upgrade file should contain Main Firmware")
+    base = IntelHex(base_hex)
+    if base.minaddr() != pl_sections[0].attributes.get('bl_attr_base_addr'):
+        raise click.ClickException("Base firmware has different address")
+    try:
+        delta_section = DeltaSection(pl_sections[0], base.tobinstr(),
+                                     block_size)
+    except ValueError as e:
+        raise click.ClickException(f"Error making delta: {e}")
+    write_sections(delta_file, [delta_section, sig_section])
+
+
+def create_payload_section(hex_file, section_name, platform,
+                           compression=None):
     ih = IntelHex(hex_file)
     attr = {'bl_attr_base_addr': ih.minaddr()}
     if platform:
@@ -217,7 +454,8 @@ def create_payload_section(hex_file, section_name, platform):
     pl_bytes = ih.tobinstr()
     if len(pl_bytes) != exp_len:
         raise click.ClickException(f"Error while parsing '{hex_file.name}'")
-    return PayloadSection(name=section_name, payload=pl_bytes, attributes=attr)
+    return PayloadSection(name=section_name, payload=pl_bytes, attributes=attr,
+                          compression=compression)
 
 
 def load_seckey(key_pem):
@@ -247,13 +485,16 @@ def load_sections(upgrade_file):
     return sections
 
 
-def parse_sections(sections):
+def parse_sections(sections, algorithm=None):
     """Validates an upgrade file and separates Payload and Signature sections.
+    If the Signature section is missing it is created using given algorithm,
+    otherwise its algorithm must match the given one, if any.
     """
     if not len(sections):
         raise click.ClickException("Upgrade file is empty")
     if not isinstance(sections[-1], SignatureSection):
-        sections.append(SignatureSection())
+        sections.append(SignatureSection(
+            dsa_algorithm=algorithm or sig.DSA_SECP256K1_SHA256))
     sig_section = sections[-1]
     pl_sections = sections[:-1]
     for sect in pl_sections:
@@ -263,6 +504,10 @@ def parse_sections(sections):
     if not isinstance(sig_section, SignatureSection):
         err = "Last section must be the Signature Section"
         raise click.ClickException(err)
+    if algorithm and sig_section.dsa_algorithm != algorithm:
+        err = (f"Upgrade file is signed using {sig_section.dsa_algorithm}, "
+               f"not {algorithm}")
+        raise click.ClickException(err)
     return (pl_sections, sig_section)
 
 
@@ -270,6 +515,9 @@ def add_signature(sections, signature, pubkey):
     """Adds a new signature to Signature section.
     """
     _, sig_section = parse_sections(sections)
+    if sig_section.is_aggregate:
+        err = "Upgrade file is signed using MuSig2, use musig commands"
+        raise click.ClickException(err)
     fp = pubkey_fingerprint(pubkey)
     if fp in sig_section.signatures:
         err = "Upgrade file is already signed using this key"
@@ -280,10 +528,10 @@ def add_signature(sections, signature, pubkey):
 def do_sign(sections, seckey):
     """Signs payload sections.
     """
-    pl_sections, _ = parse_sections(sections)
+    pl_sections, sig_section = parse_sections(sections)
     msg = make_signature_message(pl_sections)
     pubkey = pubkey_from_seckey(seckey)
-    signature = sig.sign(msg, seckey)
+    signature = sig.sign(msg, seckey, sig_section.dsa_algorithm)
     add_signature(sections, signature, pubkey)
 
 